@@ -0,0 +1,81 @@
+/**
+ * @file BenchmarkMain.cpp
+ * @author Aydin Arik
+ * @brief Entry point of matcher_bench, which times each matcher stage (see
+ *        MatcherBenchmark). Built as its own executable, as the benchmark
+ *        replaces the global operator new to count allocations.
+ */
+
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+#include "MatcherBenchmark.h"
+#include "RecognitionConfig.h"
+
+using namespace std;
+
+/**
+ * Time each matcher stage at several keypoint counts, optionally comparing
+ * with and saving a baseline. Options: --images OBJECT FRAME to use recorded
+ * images rather than synthetic ones, --baseline FILE to flag regressions
+ * against FILE, --threshold T for the allowed slow down (default 0.1),
+ * --save FILE to save the results and --config FILE for the matcher
+ * settings (default ../../Images/recognition.yml).
+ *
+ * @param argc
+ * @param argv
+ * @return 0 on success, 1 if a stage regressed or files couldn't be used.
+ */
+int main(int argc, char** argv) {
+    string configFile("../../Images/recognition.yml");
+    string objectFile, frameFile, baselineFile, saveFile;
+    double threshold = 0.1;
+    for (int i = 1; i + 1 < argc; i++) {
+        string option(argv[i]);
+        if (option == "--images" && i + 2 < argc) {
+            objectFile = argv[++i];
+            frameFile = argv[++i];
+        } else if (option == "--baseline") {
+            baselineFile = argv[++i];
+        } else if (option == "--threshold") {
+            threshold = atof(argv[++i]);
+        } else if (option == "--save") {
+            saveFile = argv[++i];
+        } else if (option == "--config") {
+            configFile = argv[++i];
+        }
+    }
+    RecognitionConfig config; //Defaults if there is no file.
+    if (config.load(configFile)) {
+        std::cout << "Loaded " << configFile << ": " << config << std::endl;
+    }
+
+    MatcherBenchmark benchmark(config);
+    if (!objectFile.empty() && !benchmark.loadImages(objectFile, frameFile)) {
+        return 1;
+    }
+
+    const int counts[] = {100, 250, 500, 1000, 2000, 5000};
+    vector<int> sizes(counts, counts + sizeof (counts) / sizeof (counts[0]));
+    vector<MatcherBenchmark::Result> results;
+    benchmark.run(sizes, results);
+
+    vector<MatcherBenchmark::Result> baseline;
+    if (!baselineFile.empty() && !MatcherBenchmark::readResults(baselineFile, baseline)) {
+        return 1;
+    }
+    int numOfRegressions = MatcherBenchmark::compare(baseline, results, threshold, std::cout);
+    if (!baselineFile.empty()) {
+        std::cout << numOfRegressions << " regression(s) against " << baselineFile << std::endl;
+    }
+
+    if (!saveFile.empty() && !MatcherBenchmark::writeResults(saveFile, results)) {
+        return 1;
+    }
+    return numOfRegressions > 0 ? 1 : 0;
+}
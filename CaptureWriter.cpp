@@ -0,0 +1,304 @@
+/**
+ * @file CaptureWriter.cpp
+ * @author Aydin Arik
+ * @brief Writes raw RGB-D frames, with their driver timestamps, to a capture
+ *        file on a thread of its own.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "CaptureWriter.h"
+#include <iostream>
+#include <cstring>
+
+using namespace std;
+
+// Bytes buffered by stdio before each write to disk.
+#define WRITE_BUFFER_SIZE (4 * 1024 * 1024)
+
+
+/******************************************************************************
+ *                              Private Methods
+ ******************************************************************************/
+/**
+ * Entry point of the writer thread. Writes queued frames, oldest first,
+ * until stopped and the queue is empty, then finishes the capture.
+ *
+ * @param writer The CaptureWriter that started the thread.
+ * @return NULL.
+ */
+void* CaptureWriter::runWriter(void* writer) {
+    CaptureWriter* self = static_cast<CaptureWriter*> (writer);
+
+    while (true) {
+        self->mutex.lock();
+        while (self->frames.empty() && !self->stopping) {
+            self->queued.wait(self->mutex);
+        }
+        if (self->frames.empty()) {
+            self->mutex.unlock();
+            break; //Stopping and everything is written.
+        }
+        Frame* frame = self->frames.front();
+        self->frames.pop_front();
+        self->mutex.unlock();
+
+        uint64_t frameOffset = self->offset;
+        if (self->writeRecord(frame->type, frame->timestamp, frame->captured,
+                &frame->data[0], frame->data.size())) {
+            self->chunk.push_back(frameOffset);
+            if (self->chunk.size() >= RGBD_CHUNK_FRAMES) {
+                self->writeIndex();
+            }
+        }
+
+        self->mutex.lock();
+        self->spare.push_back(frame);
+        self->mutex.unlock();
+    }
+
+    //A closed capture ends with its last index, so readers needn't scan it.
+    self->writeIndex();
+    uint64_t lastIndex = self->lastIndex;
+    self->writeRecord(RGBD_END, 0, 0, &lastIndex, sizeof (lastIndex));
+    fclose(self->file);
+    self->file = NULL;
+    return NULL;
+}
+
+/**
+ * Append a record.
+ *
+ * @param type Record type.
+ * @param timestamp Driver timestamp (0 for other records).
+ * @param captured When a frame arrived (0 for other records).
+ * @param payload Payload.
+ * @param size Bytes of payload.
+ * @return True if written.
+ */
+bool CaptureWriter::writeRecord(uint32_t type, uint32_t timestamp, int64_t captured,
+        const void* payload, uint32_t size) {
+    RecordHeader header;
+    header.magic = RGBD_RECORD_MAGIC;
+    header.type = type;
+    header.timestamp = timestamp;
+    header.size = size;
+    header.captured = captured;
+
+    static const char padding[8] = {0};
+    uint64_t recordSize = rgbdRecordSize(size);
+    size_t paddingSize = recordSize - sizeof (header) - size;
+    if (fwrite(&header, sizeof (header), 1, file) != 1 ||
+            (size > 0 && fwrite(payload, size, 1, file) != 1) ||
+            (paddingSize > 0 && fwrite(padding, paddingSize, 1, file) != 1)) {
+        cout << "Unable to write capture: " << filename << endl;
+        return false;
+    }
+
+    offset += recordSize;
+    return true;
+}
+
+/**
+ * Append an index of the frames since the last index.
+ */
+void CaptureWriter::writeIndex() {
+    if (chunk.empty()) {
+        return;
+    }
+
+    vector<uint64_t> index;
+    index.reserve(chunk.size() + 1);
+    index.push_back(lastIndex);
+    index.insert(index.end(), chunk.begin(), chunk.end());
+
+    uint64_t indexOffset = offset;
+    if (writeRecord(RGBD_INDEX, 0, 0, &index[0], index.size() * sizeof (uint64_t))) {
+        lastIndex = indexOffset;
+    }
+    chunk.clear();
+}
+
+/**
+ * Queue a copy of a frame, unless the queue is full. Buffers of written
+ * frames are reused, so a steady capture doesn't allocate.
+ *
+ * @param type RGBD_VIDEO or RGBD_DEPTH.
+ * @param data The frame.
+ * @param timestamp Driver timestamp.
+ * @return True if queued.
+ */
+bool CaptureWriter::add(uint32_t type, const void* data, uint32_t timestamp) {
+    if (!data) {
+        return false;
+    }
+
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t captured = (int64_t) (now.tv_sec - started.tv_sec) * 1000000000LL + (now.tv_nsec - started.tv_nsec);
+
+    Frame* frame;
+    mutex.lock();
+    if (!running || stopping || frames.size() >= maxQueued) {
+        numOfDropped++;
+        mutex.unlock();
+        return false;
+    }
+    if (spare.empty()) {
+        frame = new Frame();
+    } else {
+        frame = spare.back();
+        spare.pop_back();
+    }
+    mutex.unlock();
+
+    //Copied outside of the lock; the frame isn't shared until it is queued.
+    frame->type = type;
+    frame->timestamp = timestamp;
+    frame->captured = captured;
+    frame->data.resize(rgbdFrameSize(type, width, height));
+    memcpy(&frame->data[0], data, frame->data.size());
+
+    ScopedLock lock(mutex);
+    if (stopping) {
+        spare.push_back(frame); //Closed while copying.
+        numOfDropped++;
+        return false;
+    }
+    frames.push_back(frame);
+    queued.signal();
+    return true;
+}
+
+
+/******************************************************************************
+ *                              Public Methods
+ ******************************************************************************/
+/**
+ * Constructor.
+ *
+ * @param maxQueued Longest the queue may get before frames are dropped.
+ */
+CaptureWriter::CaptureWriter(unsigned int maxQueued)
+: maxQueued(maxQueued > 0 ? maxQueued : 1), running(false), width(0), height(0),
+file(NULL), offset(0), lastIndex(0), numOfDropped(0), stopping(false) {
+    started.tv_sec = 0;
+    started.tv_nsec = 0;
+}
+
+/**
+ * Destructor. Closes the capture.
+ */
+CaptureWriter::~CaptureWriter() {
+    close();
+    for (unsigned int i = 0; i < spare.size(); i++) {
+        delete spare[i];
+    }
+    for (unsigned int i = 0; i < frames.size(); i++) {
+        delete frames[i];
+    }
+}
+
+/**
+ * Create a capture and start the writer thread.
+ *
+ * @param filename File to write (replaced if it exists).
+ * @param width Frame width.
+ * @param height Frame height.
+ * @return True if the capture was created.
+ */
+bool CaptureWriter::open(const string& filename, uint32_t width, uint32_t height) {
+    close();
+
+    file = fopen(filename.c_str(), "wb");
+    if (!file) {
+        cout << "Unable to create capture: " << filename << endl;
+        return false;
+    }
+    setvbuf(file, NULL, _IOFBF, WRITE_BUFFER_SIZE);
+
+    timespec epoch;
+    clock_gettime(CLOCK_REALTIME, &epoch);
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    CaptureHeader header;
+    memset(&header, 0, sizeof (header));
+    header.magic = RGBD_CAPTURE_MAGIC;
+    header.version = RGBD_CAPTURE_VERSION;
+    header.width = width;
+    header.height = height;
+    header.chunkFrames = RGBD_CHUNK_FRAMES;
+    header.started = (int64_t) epoch.tv_sec * 1000000000LL + epoch.tv_nsec;
+    if (fwrite(&header, sizeof (header), 1, file) != 1) {
+        cout << "Unable to write capture: " << filename << endl;
+        fclose(file);
+        file = NULL;
+        return false;
+    }
+
+    this->filename = filename;
+    this->width = width;
+    this->height = height;
+    offset = sizeof (header);
+    lastIndex = 0;
+    chunk.clear();
+
+    ScopedLock lock(mutex);
+    stopping = false;
+    running = (pthread_create(&thread, NULL, &CaptureWriter::runWriter, this) == 0);
+    if (!running) {
+        fclose(file);
+        file = NULL;
+    }
+    return running;
+}
+
+/**
+ * Write everything queued, finish the capture and stop the writer thread.
+ */
+void CaptureWriter::close() {
+    mutex.lock();
+    if (!running) {
+        mutex.unlock();
+        return;
+    }
+    stopping = true;
+    queued.signal();
+    mutex.unlock();
+
+    pthread_join(thread, NULL);
+
+    ScopedLock lock(mutex);
+    running = false;
+}
+
+/**
+ * Queue a copy of an RGB frame. Safe to call from a driver callback.
+ *
+ * @param data The frame (width * height * 3 bytes).
+ * @param timestamp Driver timestamp.
+ * @return True if queued, false if dropped.
+ */
+bool CaptureWriter::addVideo(const void* data, uint32_t timestamp) {
+    return add(RGBD_VIDEO, data, timestamp);
+}
+
+/**
+ * Queue a copy of a depth frame. Safe to call from a driver callback.
+ *
+ * @param data The frame (width * height 16 bit values).
+ * @param timestamp Driver timestamp.
+ * @return True if queued, false if dropped.
+ */
+bool CaptureWriter::addDepth(const void* data, uint32_t timestamp) {
+    return add(RGBD_DEPTH, data, timestamp);
+}
+
+/**
+ * @return Frames dropped because the queue was full.
+ */
+long CaptureWriter::getNumOfDropped() {
+    ScopedLock lock(mutex);
+    return numOfDropped;
+}
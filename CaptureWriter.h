@@ -0,0 +1,155 @@
+/**
+ * @file CaptureWriter.h
+ * @author Aydin Arik
+ * @brief Writes raw RGB-D frames, with their driver timestamps, to a capture
+ *        file (see RgbdCapture.h) on a thread of its own, so a session can be
+ *        replayed later (see ReplayCamera). Frames are copied out of the
+ *        driver's buffers and queued, so the driver's thread never waits on
+ *        the disk. When the queue is full, frames are dropped and counted.
+ */
+
+#ifndef CAPTUREWRITER_H
+#define	CAPTUREWRITER_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <string>
+#include <vector>
+#include <deque>
+#include <cstdio>
+#include <pthread.h>
+#include <time.h>
+#include "RgbdCapture.h"
+#include "Mutex.h"
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+class CaptureWriter {
+private:
+
+    struct Frame {
+        uint32_t type; //RGBD_VIDEO or RGBD_DEPTH.
+        uint32_t timestamp; //Driver timestamp.
+        int64_t captured; //When it arrived (nanoseconds since the capture started).
+        std::vector<uint8_t> data;
+    };
+
+    unsigned int maxQueued; //Longest the queue may get before frames are dropped.
+    pthread_t thread;
+    bool running; //True if thread was started.
+    timespec started; //When the capture was opened (CLOCK_MONOTONIC).
+    uint32_t width, height;
+
+    //
+    //File. Used by the writer thread only once started.
+    //
+    std::string filename;
+    FILE* file;
+    uint64_t offset; //Where the next record goes.
+    std::vector<uint64_t> chunk; //Offsets of the frames since the last index.
+    uint64_t lastIndex; //Offset of the last index (0 if none).
+
+    //
+    //Guarded by mutex.
+    //
+    Mutex mutex;
+    Condition queued; //Signalled when a frame is queued or on stopping.
+    std::deque<Frame*> frames;
+    std::vector<Frame*> spare; //Written frames, kept to save reallocating their buffers.
+    long numOfDropped; //Frames dropped because the queue was full.
+    bool stopping; //Set to make the writer thread exit once the queue is empty.
+
+    /**
+     * Entry point of the writer thread.
+     *
+     * @param writer The CaptureWriter that started the thread.
+     * @return NULL.
+     */
+    static void* runWriter(void* writer);
+
+    /**
+     * Append a record.
+     *
+     * @param type Record type.
+     * @param timestamp Driver timestamp (0 for other records).
+     * @param captured When a frame arrived (0 for other records).
+     * @param payload Payload.
+     * @param size Bytes of payload.
+     * @return True if written.
+     */
+    bool writeRecord(uint32_t type, uint32_t timestamp, int64_t captured,
+            const void* payload, uint32_t size);
+
+    /**
+     * Append an index of the frames since the last index.
+     */
+    void writeIndex();
+
+    /**
+     * Queue a copy of a frame, unless the queue is full.
+     *
+     * @param type RGBD_VIDEO or RGBD_DEPTH.
+     * @param data The frame.
+     * @param timestamp Driver timestamp.
+     * @return True if queued.
+     */
+    bool add(uint32_t type, const void* data, uint32_t timestamp);
+
+    CaptureWriter(const CaptureWriter&); //Not copyable.
+    CaptureWriter& operator=(const CaptureWriter&);
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param maxQueued Longest the queue may get before frames are dropped.
+     */
+    CaptureWriter(unsigned int maxQueued = 32);
+
+    /**
+     * Destructor. Closes the capture.
+     */
+    ~CaptureWriter();
+
+    /**
+     * Create a capture and start the writer thread.
+     *
+     * @param filename File to write (replaced if it exists).
+     * @param width Frame width.
+     * @param height Frame height.
+     * @return True if the capture was created.
+     */
+    bool open(const std::string& filename, uint32_t width = 640, uint32_t height = 480);
+
+    /**
+     * Write everything queued, finish the capture and stop the writer thread.
+     */
+    void close();
+
+    /**
+     * Queue a copy of an RGB frame. Safe to call from a driver callback.
+     *
+     * @param data The frame (width * height * 3 bytes).
+     * @param timestamp Driver timestamp.
+     * @return True if queued, false if dropped.
+     */
+    bool addVideo(const void* data, uint32_t timestamp);
+
+    /**
+     * Queue a copy of a depth frame. Safe to call from a driver callback.
+     *
+     * @param data The frame (width * height 16 bit values).
+     * @param timestamp Driver timestamp.
+     * @return True if queued, false if dropped.
+     */
+    bool addDepth(const void* data, uint32_t timestamp);
+
+    /**
+     * @return Frames dropped because the queue was full.
+     */
+    long getNumOfDropped();
+};
+
+#endif	/* CAPTUREWRITER_H */
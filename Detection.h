@@ -0,0 +1,65 @@
+/**
+ * @file Detection.h
+ * @author Aydin Arik
+ * @brief Objects found in a frame, and the result of recognising objects in
+ *        a (video) frame.
+ */
+
+#ifndef DETECTION_H
+#define	DETECTION_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <string>
+#include <vector>
+#include <time.h>
+#include <boost/shared_ptr.hpp>
+#include <opencv2/core/core.hpp>
+#include <opencv2/features2d/features2d.hpp>
+#include "LibraryStore.h"
+#include "FrameTrace.h"
+
+// Share of an object view's keypoints that must survive matching for the
+// object to count as found.
+#define MIN_MATCHED_SHARE 0.05f
+
+
+/******************************************************************************
+ *                              Classes
+ ******************************************************************************/
+/**
+ * An object found in a frame.
+ */
+struct Detection {
+    std::string objectName;
+    ObjectView view; //View of the object that matched best.
+    std::vector<cv::DMatch> matches; //View keypoints (query) to frame keypoints (train).
+    float score; //Share of the view's keypoints matched.
+    cv::Rect boundingBox; //Bounding box of the matched frame keypoints.
+
+    Detection() : score(0) {
+    }
+};
+
+/**
+ * Everything needed to draw the result of recognising objects in a frame.
+ * Published by recognition and read by rendering, so never changed once made.
+ */
+struct RecognitionResult {
+    cv::Mat frame; //The frame (shared, so never written to).
+    std::vector<cv::KeyPoint> frameKeypoints;
+    std::vector<Detection> detections; //Objects found, best first.
+    ObjectView object; //Object last looked for (shown beside the frame).
+    timespec timeDiff; //Average recognition time per frame.
+    bool reused; //True if detections were carried over from an earlier frame.
+    FrameTrace trace; //Where the frame came from and when it got this far.
+
+    RecognitionResult() : reused(false) {
+        timeDiff.tv_sec = 0;
+        timeDiff.tv_nsec = 0;
+    }
+};
+typedef boost::shared_ptr<const RecognitionResult> RecognitionResultPtr;
+
+#endif	/* DETECTION_H */
@@ -0,0 +1,117 @@
+/**
+ * @file DirectoryWatcher.cpp
+ * @author Aydin Arik
+ * @brief Reports files that are created, changed or removed in a directory.
+ *        Uses inotify, so it only watches on Linux.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "DirectoryWatcher.h"
+#include <iostream>
+#include <unistd.h>
+#include <poll.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+using namespace std;
+
+
+/******************************************************************************
+ *                              Methods
+ ******************************************************************************/
+/**
+ * Constructor. Starts watching the directory.
+ *
+ * @param dir Directory to watch.
+ */
+DirectoryWatcher::DirectoryWatcher(string dir) : dir(dir), inotifyFd(-1), watchDescriptor(-1) {
+    if (!this->dir.empty() && this->dir[this->dir.size() - 1] != '/') {
+        this->dir += '/';
+    }
+
+#ifdef __linux__
+    inotifyFd = inotify_init();
+    if (inotifyFd < 0) {
+        std::cout << "inotify not available, not watching: " << dir << std::endl;
+        return;
+    }
+
+    //IN_CLOSE_WRITE rather than IN_MODIFY so half-written images are never reported.
+    watchDescriptor = inotify_add_watch(inotifyFd, dir.c_str(),
+            IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE);
+    if (watchDescriptor < 0) {
+        std::cout << "Could not watch: " << dir << std::endl;
+        close(inotifyFd);
+        inotifyFd = -1;
+    }
+#endif
+}
+
+DirectoryWatcher::~DirectoryWatcher() {
+    if (inotifyFd >= 0) {
+        close(inotifyFd); //Also removes the watch.
+    }
+}
+
+/**
+ * @return True if the directory is being watched.
+ */
+bool DirectoryWatcher::isWatching() {
+    return inotifyFd >= 0;
+}
+
+/**
+ * Wait for changes in the directory.
+ *
+ * @param changes Changes found are appended to this.
+ * @param timeoutMs Maximum time to wait in milliseconds.
+ * @return Number of changes found (0 on timeout or error).
+ */
+int DirectoryWatcher::waitForChanges(vector<Change>& changes, int timeoutMs) {
+    if (!isWatching()) {
+        usleep(timeoutMs * 1000); //Behave like a timeout so callers can still poll.
+        return 0;
+    }
+
+#ifdef __linux__
+    pollfd pfd;
+    pfd.fd = inotifyFd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, timeoutMs) <= 0) {
+        return 0; //Timeout or error.
+    }
+
+    //Buffer is aligned for inotify_event and large enough for many events.
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t length = read(inotifyFd, buffer, sizeof (buffer));
+    if (length <= 0) {
+        return 0;
+    }
+
+    int found = 0;
+    for (char* ptr = buffer; ptr < buffer + length;
+            ptr += sizeof (struct inotify_event) + ((struct inotify_event*) ptr)->len) {
+        const struct inotify_event* event = (const struct inotify_event*) ptr;
+
+        Change change;
+        if (event->mask & IN_Q_OVERFLOW) {
+            change.type = EVENTS_LOST;
+        } else if (event->len == 0 || (event->mask & IN_ISDIR)) {
+            continue; //Not about a file in the directory.
+        } else {
+            change.type = (event->mask & (IN_DELETE | IN_MOVED_FROM)) ? FILE_REMOVED : FILE_CHANGED;
+            change.path = dir + event->name;
+        }
+
+        changes.push_back(change);
+        found++;
+    }
+
+    return found;
+#else
+    return 0;
+#endif
+}
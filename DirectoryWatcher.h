@@ -0,0 +1,67 @@
+/**
+ * @file DirectoryWatcher.h
+ * @author Aydin Arik
+ * @brief Reports files that are created, changed or removed in a directory.
+ *        Uses inotify, so it only watches on Linux; elsewhere isWatching()
+ *        is false and no changes are ever reported.
+ */
+
+#ifndef DIRECTORYWATCHER_H
+#define	DIRECTORYWATCHER_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <string>
+#include <vector>
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+class DirectoryWatcher {
+public:
+
+    enum ChangeType {
+        FILE_CHANGED, //File was created, written to or moved into the directory.
+        FILE_REMOVED, //File was deleted or moved out of the directory.
+        EVENTS_LOST //Event queue overflowed. Rescan the whole directory.
+    };
+
+    struct Change {
+        ChangeType type;
+        std::string path; //Full path of the file (empty for EVENTS_LOST).
+    };
+
+    /**
+     * Constructor. Starts watching the directory.
+     *
+     * @param dir Directory to watch.
+     */
+    DirectoryWatcher(std::string dir);
+
+    ~DirectoryWatcher();
+
+    /**
+     * @return True if the directory is being watched.
+     */
+    bool isWatching();
+
+    /**
+     * Wait for changes in the directory.
+     *
+     * @param changes Changes found are appended to this.
+     * @param timeoutMs Maximum time to wait in milliseconds.
+     * @return Number of changes found (0 on timeout or error).
+     */
+    int waitForChanges(std::vector<Change>& changes, int timeoutMs);
+
+private:
+    std::string dir;
+    int inotifyFd;
+    int watchDescriptor;
+
+    DirectoryWatcher(const DirectoryWatcher&); //Not copyable.
+    DirectoryWatcher& operator=(const DirectoryWatcher&);
+};
+
+#endif	/* DIRECTORYWATCHER_H */
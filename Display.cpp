@@ -10,7 +10,8 @@
  ******************************************************************************/
 #include "Display.h"
 #include <opencv2/highgui/highgui.hpp>
-#include <opencv2/calib3d/calib3d.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
 #include "Timer.h"
 
 using namespace std;
@@ -18,6 +19,14 @@ using namespace std;
 /*******************************************************************************
  *                              Methods
  ******************************************************************************/
+/**
+ * Constructor.
+ * 
+ * @param windowName Window to draw in (one per camera).
+ */
+Display::Display(const std::string& windowName) : windowName(windowName), drawMatches(false) {
+}
+
 /**
  * Convert a floating point number to a string.
  * 
@@ -41,79 +50,84 @@ void Display::displayFPS(cv::Mat& displayImg, timespec timeDiff) {
     float roundedFPS = std::floor(accurateFPS * 100) / 100; //Rounding down since accuracy is not important.
     
     //Attach FPS text to image that is to be displayed.
-    cv::putText(displayImg, toString(roundedFPS), cv::Point(640 * 2 - 75, 35), cv::FONT_HERSHEY_SIMPLEX, 0.7, cv::Scalar(0, 255, 0), 2, 8, false);
+    cv::putText(displayImg, toString(roundedFPS), cv::Point(displayImg.cols - 75, 35), cv::FONT_HERSHEY_SIMPLEX, 0.7, cv::Scalar(0, 255, 0), 2, 8, false);
 }
 
 /**
- * Call this to display matching of keypoints and the identification of objects.
+ * Draw a recognition result: the object beside the frame, with a box and
+ * name around each object found. The canvas is only reallocated if the
+ * size of the frame or object changes. Boxes come from the detections, so
+ * no homography is needed here.
  * 
- * @param object Current object that is being looked for in a frame.
- * @param frame Video frame.
- * @param frameKeypoints Keypoints of the video frame.
- * @param matches Matches between the objects image and video frame.
- * @param displayImg Image to display results.
+ * @param result Result to draw.
+ * @param canvas Image to draw into (reused between calls).
  */
-void Display::displayMatching(Object object, 
-        cv::Mat frame, std::vector<cv::KeyPoint> frameKeypoints, 
-        std::vector<cv::DMatch > matches, 
-        cv::Mat& displayImg) {
-
-    std::vector<cv::KeyPoint> keypoints1 = object.getKeypoints();
-    // draw the matches
-    cv::drawMatches(object.getImage(), keypoints1, // 1st image and its keypoints
-            frame, frameKeypoints, // 2nd image and its keypoints
-            matches, // the matches
-            displayImg, // the image produced
-            cv::Scalar(255, 255, 255)); // color of the lines
-
-    cv::Mat image1 = object.getImage();
+void Display::render(const RecognitionResult& result, cv::Mat& canvas) {
+    const cv::Mat& frame = result.frame;
+    cv::Mat objectImg;
+    if (!result.object.empty()) {
+        objectImg = result.object.getImage();
+    }
 
-    
-    //Attempt to draw an outline of the object if one is found.
-    try {
-        //-- Localize the object from img_1 in img_2 
-        cv::vector<cv::Point2f> obj;
-        cv::vector<cv::Point2f> scene;
+    //Object on the left, frame on the right.
+    int left = objectImg.cols;
+    canvas.create(std::max(frame.rows, objectImg.rows), left + frame.cols, CV_8UC3);
+    if (objectImg.rows < canvas.rows && left > 0) {
+        cv::Mat below = canvas(cv::Rect(0, objectImg.rows, left, canvas.rows - objectImg.rows));
+        below.setTo(cv::Scalar::all(0));
+    }
+    if (frame.rows < canvas.rows) {
+        cv::Mat below = canvas(cv::Rect(left, frame.rows, frame.cols, canvas.rows - frame.rows));
+        below.setTo(cv::Scalar::all(0));
+    }
 
-        for (int i = 0; i < matches.size(); i++) {
-            //-- Get the keypoints from the good matches
-            obj.push_back(keypoints1[ matches[i].queryIdx ].pt);
-            scene.push_back(frameKeypoints[ matches[i].trainIdx ].pt);
+    if (left > 0) {
+        cv::Mat objectArea = canvas(cv::Rect(0, 0, objectImg.cols, objectImg.rows));
+        if (objectImg.channels() == 1) {
+            cv::cvtColor(objectImg, objectArea, CV_GRAY2BGR);
+        } else {
+            objectImg.copyTo(objectArea);
         }
+    }
 
-        cv::Mat H = cv::findHomography(obj, scene, CV_RANSAC);
-
-
-        //-- Get the corners from the image_1 ( the object to be "detected" )
-        cv::Point2f obj_corners[4] = {cvPoint(0, 0), cvPoint(image1.cols, 0), cvPoint(image1.cols, image1.rows), cvPoint(0, image1.rows)};
-        cv::Point scene_corners[4];
-
-        //-- Map these corners in the scene ( image_2)
-        for (int i = 0; i < 4; i++) {
-            double x = obj_corners[i].x;
-            double y = obj_corners[i].y;
-
-            double Z = 1. / (H.at<double>(2, 0) * x + H.at<double>(2, 1) * y + H.at<double>(2, 2));
-            double X = (H.at<double>(0, 0) * x + H.at<double>(0, 1) * y + H.at<double>(0, 2)) * Z;
-            double Y = (H.at<double>(1, 0) * x + H.at<double>(1, 1) * y + H.at<double>(1, 2)) * Z;
-            scene_corners[i] = cvPoint(cvRound(X) + image1.cols, cvRound(Y));
+    if (frame.data) {
+        cv::Mat frameArea = canvas(cv::Rect(left, 0, frame.cols, frame.rows));
+        if (frame.channels() == 1) {
+            cv::cvtColor(frame, frameArea, CV_GRAY2BGR);
+        } else {
+            frame.copyTo(frameArea);
         }
+    }
 
-        if (matches.size() >= (0.05 * keypoints1.size())) { //Threshold for object recognition.
-            cv::line(displayImg, scene_corners[0], scene_corners[1], cv::Scalar(0, 255, 0), 2);
-            cv::line(displayImg, scene_corners[1], scene_corners[2], cv::Scalar(0, 255, 0), 2);
-            cv::line(displayImg, scene_corners[2], scene_corners[3], cv::Scalar(0, 255, 0), 2);
-            cv::line(displayImg, scene_corners[3], scene_corners[0], cv::Scalar(0, 255, 0), 2);
-
-            const string name = object.getObjectName();
-
-            cv::putText(displayImg, name, cv::Point(660, 30), cv::FONT_HERSHEY_SIMPLEX, 0.7, cv::Scalar(0, 255, 0), 2, 8, false);
+    //Match lines of the best object, if it's the one shown.
+    if (drawMatches && !result.detections.empty() && left > 0 &&
+            result.detections[0].view.getImage().data == objectImg.data) {
+        const Detection& best = result.detections[0];
+        for (unsigned int i = 0; i < best.matches.size(); i++) {
+            cv::Point2f from = best.view.getPoint(best.matches[i].queryIdx);
+            cv::Point2f to = result.frameKeypoints[best.matches[i].trainIdx].pt;
+            cv::line(canvas, cv::Point(cvRound(from.x), cvRound(from.y)),
+                    cv::Point(cvRound(to.x) + left, cvRound(to.y)), cv::Scalar(255, 255, 255));
         }
+    }
 
-
-    } catch (cv::Exception& ex) {
-        //Do nothing...This is required to prevent a crash due to no matches being found.
+    //Outline and name each object found.
+    for (unsigned int i = 0; i < result.detections.size(); i++) {
+        cv::Rect box = result.detections[i].boundingBox;
+        box.x += left;
+        cv::rectangle(canvas, box, cv::Scalar(0, 255, 0), 2);
+        cv::putText(canvas, result.detections[i].objectName, cv::Point(box.x, std::max(box.y - 5, 15)),
+                cv::FONT_HERSHEY_SIMPLEX, 0.7, cv::Scalar(0, 255, 0), 2, 8, false);
     }
+
+    displayFPS(canvas, result.timeDiff);
+}
+
+/**
+ * @param flag If true, draw a line for each match of the best object.
+ */
+void Display::setDrawMatches(bool flag) {
+    drawMatches = flag;
 }
 
 /**
@@ -123,5 +137,5 @@ void Display::displayMatching(Object object,
  */
 void Display::draw(cv::Mat displayImg) {
     this->displayImg = displayImg;
-    cv::imshow("Object Recognition", displayImg);
+    cv::imshow(windowName, displayImg);
 }
@@ -3,6 +3,7 @@
  * @author Aydin Arik 
  * @brief Creates an image to display for the object recognition system. The image
  *        shows the matches, highlights recognised objects and shows the frame rate. 
+ *        Images are drawn into a canvas that is reused from frame to frame.
  */
 
 #ifndef DISPLAY_H
@@ -14,7 +15,8 @@
 #include <vector>
 #include <opencv2/core/core.hpp>
 #include <cstring>
-#include "Object.h"
+#include "LibraryStore.h"
+#include "Detection.h"
 #include <time.h>
 
 /*******************************************************************************
@@ -23,6 +25,8 @@
 class Display {
 private:
     cv::Mat displayImg;
+    std::string windowName; //Window the image is drawn in.
+    bool drawMatches; //If true, draw a line for each match of the best object.
 
     /**
      * Convert a floating point number to a string.
@@ -33,6 +37,13 @@ private:
     std::string toString(float number);
 public:
 
+    /**
+     * Constructor.
+     * 
+     * @param windowName Window to draw in (one per camera).
+     */
+    Display(const std::string& windowName = "Object Recognition");
+
     /**
      * Call this to attach frame-rate information to an image that is to be displayed.
      * 
@@ -42,19 +53,19 @@ public:
     void displayFPS(cv::Mat& imageMatches, timespec timeDiff);
 
     /**
-     * Call this to display matching of keypoints and the identification of objects.
+     * Draw a recognition result: the object beside the frame, with a box and
+     * name around each object found. The canvas is only reallocated if the
+     * size of the frame or object changes.
      * 
-     * @param object Current object that is being looked for in a frame.
-     * @param frame Video frame.
-     * @param frameKeypoints Keypoints of the video frame.
-     * @param matches Matches between the objects image and video frame.
-     * @param displayImg Image to display results.
+     * @param result Result to draw.
+     * @param canvas Image to draw into (reused between calls).
+     */
+    void render(const RecognitionResult& result, cv::Mat& canvas);
+
+    /**
+     * @param flag If true, draw a line for each match of the best object.
      */
-    void displayMatching(Object object, // 1st image and its keypoints
-            cv::Mat image2, std::vector<cv::KeyPoint> keypoints2, // 2nd image and its keypoints
-            std::vector<cv::DMatch > matches, // the matches
-            cv::Mat& imageMatches // the image produced
-            );
+    void setDrawMatches(bool flag);
 
     void draw(cv::Mat displayImg);
 };
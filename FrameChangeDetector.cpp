@@ -0,0 +1,68 @@
+/**
+ * @file FrameChangeDetector.cpp
+ * @author Aydin Arik
+ * @brief Cheaply decides whether a (video) frame differs from the last one
+ *        that objects were recognised in.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "FrameChangeDetector.h"
+#include <opencv2/imgproc/imgproc.hpp>
+
+
+/******************************************************************************
+ *                              Methods
+ ******************************************************************************/
+/**
+ * Constructor.
+ *
+ * @param threshold Mean absolute difference (grey levels) above which a
+ *        frame has changed.
+ * @param thumbnailSize Size frames are shrunk to before comparing.
+ */
+FrameChangeDetector::FrameChangeDetector(double threshold, cv::Size thumbnailSize)
+: thumbnailSize(thumbnailSize), threshold(threshold) {
+}
+
+/**
+ * Compare a frame against the last accepted frame. The frame is shrunk
+ * before converting to grey, so only the thumbnail is converted. Area
+ * averaging also smooths away sensor noise.
+ *
+ * @param frame The frame.
+ * @return True if the frame has changed, or nothing has been accepted yet.
+ */
+bool FrameChangeDetector::hasChanged(const cv::Mat& frame) {
+    cv::resize(frame, small, thumbnailSize, 0, 0, cv::INTER_AREA);
+    if (small.channels() == 3) {
+        cv::cvtColor(small, thumbnail, CV_BGR2GRAY);
+    } else {
+        small.copyTo(thumbnail);
+    }
+
+    if (reference.empty() || reference.size() != thumbnail.size() || reference.type() != thumbnail.type()) {
+        return true;
+    }
+
+    double difference = cv::norm(thumbnail, reference, cv::NORM_L1) / thumbnail.total();
+    return difference > threshold;
+}
+
+/**
+ * Make the frame last given to hasChanged() the one later frames are
+ * compared against. Call once objects have been recognised in it. Comparing
+ * against this frame, rather than the previous one, stops a slow change
+ * from going unnoticed.
+ */
+void FrameChangeDetector::accept() {
+    thumbnail.copyTo(reference);
+}
+
+/**
+ * Forget the accepted frame, so the next frame counts as changed.
+ */
+void FrameChangeDetector::reset() {
+    reference.release();
+}
@@ -0,0 +1,62 @@
+/**
+ * @file FrameChangeDetector.h
+ * @author Aydin Arik
+ * @brief Cheaply decides whether a (video) frame differs from the last one
+ *        that objects were recognised in. Frames are shrunk to a small grey
+ *        thumbnail and compared by mean absolute difference, which takes a
+ *        small fraction of a millisecond, so recognition can be skipped when a
+ *        camera is watching a static scene.
+ */
+
+#ifndef FRAMECHANGEDETECTOR_H
+#define	FRAMECHANGEDETECTOR_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <opencv2/core/core.hpp>
+
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+class FrameChangeDetector {
+private:
+    cv::Size thumbnailSize;
+    double threshold; //Mean absolute difference (grey levels) above which a frame has changed.
+    cv::Mat small; //Colour thumbnail (buffer reused between frames).
+    cv::Mat thumbnail; //Grey thumbnail of the latest frame.
+    cv::Mat reference; //Grey thumbnail of the last accepted frame.
+
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param threshold Mean absolute difference (grey levels) above which a
+     *        frame has changed.
+     * @param thumbnailSize Size frames are shrunk to before comparing.
+     */
+    FrameChangeDetector(double threshold = 4.0, cv::Size thumbnailSize = cv::Size(32, 24));
+
+    /**
+     * Compare a frame against the last accepted frame.
+     *
+     * @param frame The frame.
+     * @return True if the frame has changed, or nothing has been accepted yet.
+     */
+    bool hasChanged(const cv::Mat& frame);
+
+    /**
+     * Make the frame last given to hasChanged() the one later frames are
+     * compared against. Call once objects have been recognised in it.
+     */
+    void accept();
+
+    /**
+     * Forget the accepted frame, so the next frame counts as changed.
+     */
+    void reset();
+};
+
+#endif	/* FRAMECHANGEDETECTOR_H */
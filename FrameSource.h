@@ -0,0 +1,82 @@
+/**
+ * @file FrameSource.h
+ * @author Aydin Arik
+ * @brief Anything that produces video frames for object recognition (e.g. a
+ *        KinectCamera). Lets a RecognitionStream run on any kind of camera.
+ *        Sources signal each new frame, so consumers can block on
+ *        waitVideo() rather than poll getVideo().
+ */
+
+#ifndef FRAMESOURCE_H
+#define	FRAMESOURCE_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <opencv2/core/core.hpp>
+#include "FrameTrace.h"
+
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+class FrameSource {
+public:
+
+    virtual ~FrameSource() {
+    }
+
+    /**
+     * Start producing frames.
+     */
+    virtual void startStream() = 0;
+
+    /**
+     * Stop producing frames.
+     */
+    virtual void stopStream() = 0;
+
+    /**
+     * Get the newest frame, if there is one that hasn't been got already.
+     * Must be safe to call from a thread other than the one producing frames.
+     *
+     * @param frame The frame (BGR).
+     * @return True if there was a new frame.
+     */
+    virtual bool getVideo(cv::Mat& frame) = 0;
+
+    /**
+     * Get the newest frame, and where and when it came from. Sources that
+     * don't know their driver's timestamps count the frame as arriving when
+     * it is got.
+     *
+     * @param frame The frame (BGR).
+     * @param trace Sequence number, driver timestamp, and when it arrived
+     *        and was got.
+     * @return True if there was a new frame.
+     */
+    virtual bool getVideo(cv::Mat& frame, FrameTrace& trace) {
+        if (!getVideo(frame)) {
+            return false;
+        }
+        trace = FrameTrace();
+        trace.arrived = trace.acquired = FrameTrace::now();
+        return true;
+    }
+
+    /**
+     * Wait for a frame that hasn't been got already, woken as soon as one
+     * arrives, so frames are neither polled for nor got twice. Gives up if
+     * the source is stopped (or has no more frames).
+     *
+     * @param frame The frame (BGR).
+     * @param trace Sequence number, driver timestamp, and when it arrived
+     *        and was got.
+     * @param timeoutMs Longest time to wait (milliseconds, negative to wait
+     *        until there is a frame or the source stops).
+     * @return True if there was a new frame.
+     */
+    virtual bool waitVideo(cv::Mat& frame, FrameTrace& trace, int timeoutMs) = 0;
+};
+
+#endif	/* FRAMESOURCE_H */
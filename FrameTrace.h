@@ -0,0 +1,43 @@
+/**
+ * @file FrameTrace.h
+ * @author Aydin Arik
+ * @brief Where a frame came from and when it reached each hand-off on its way
+ *        to a result: the driver delivering it, being got from the camera
+ *        (converted), and objects being recognised in it. Carried with the
+ *        frame's result, so latency can be measured from the sensor rather
+ *        than from the start of recognition (see LatencyTracker).
+ */
+
+#ifndef FRAMETRACE_H
+#define	FRAMETRACE_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <stdint.h>
+#include <time.h>
+
+/******************************************************************************
+ *                              Types
+ ******************************************************************************/
+struct FrameTrace {
+    uint64_t sequence; //Number of the frame at its source (1 for the first, 0 if unknown).
+    uint32_t driverTimestamp; //Timestamp the driver gave the frame.
+    double arrived; //When the driver delivered it (seconds, CLOCK_MONOTONIC, 0 if unknown).
+    double acquired; //When it was got from the source, converted.
+    double recognised; //When objects had been recognised in it.
+
+    FrameTrace() : sequence(0), driverTimestamp(0), arrived(0), acquired(0), recognised(0) {
+    }
+
+    /**
+     * @return Current time (seconds, CLOCK_MONOTONIC), as used for every stamp.
+     */
+    static double now() {
+        timespec time;
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        return time.tv_sec + time.tv_nsec / 1e9;
+    }
+};
+
+#endif	/* FRAMETRACE_H */
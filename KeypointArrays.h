@@ -0,0 +1,86 @@
+/**
+ * @file KeypointArrays.h
+ * @author Aydin Arik
+ * @brief Keypoints stored as a structure of arrays (one array per field) rather
+ *        than an array of cv::KeyPoint. Loops that only need positions (e.g.
+ *        RANSAC) then only touch the x and y arrays.
+ */
+
+#ifndef KEYPOINTARRAYS_H
+#define	KEYPOINTARRAYS_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <opencv2/features2d/features2d.hpp>
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+struct KeypointArrays {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> size;
+    std::vector<float> angle;
+    std::vector<float> response;
+    std::vector<int> octave;
+
+    int count() const {
+        return x.size();
+    }
+
+    void clear() {
+        x.clear();
+        y.clear();
+        size.clear();
+        angle.clear();
+        response.clear();
+        octave.clear();
+    }
+
+    void reserve(int n) {
+        x.reserve(n);
+        y.reserve(n);
+        size.reserve(n);
+        angle.reserve(n);
+        response.reserve(n);
+        octave.reserve(n);
+    }
+
+    /**
+     * Append keypoints to the end of the arrays.
+     *
+     * @param keypoints Keypoints to append.
+     */
+    void append(const std::vector<cv::KeyPoint>& keypoints) {
+        reserve(count() + keypoints.size());
+        for (unsigned int i = 0; i < keypoints.size(); i++) {
+            x.push_back(keypoints[i].pt.x);
+            y.push_back(keypoints[i].pt.y);
+            size.push_back(keypoints[i].size);
+            angle.push_back(keypoints[i].angle);
+            response.push_back(keypoints[i].response);
+            octave.push_back(keypoints[i].octave);
+        }
+    }
+
+    /**
+     * Append a range of another set of arrays to the end of these.
+     *
+     * @param other Arrays to copy from.
+     * @param begin First keypoint to copy.
+     * @param end One past the last keypoint to copy.
+     */
+    void append(const KeypointArrays& other, int begin, int end) {
+        x.insert(x.end(), other.x.begin() + begin, other.x.begin() + end);
+        y.insert(y.end(), other.y.begin() + begin, other.y.begin() + end);
+        size.insert(size.end(), other.size.begin() + begin, other.size.begin() + end);
+        angle.insert(angle.end(), other.angle.begin() + begin, other.angle.begin() + end);
+        response.insert(response.end(), other.response.begin() + begin, other.response.begin() + end);
+        octave.insert(octave.end(), other.octave.begin() + begin, other.octave.begin() + end);
+    }
+};
+
+#endif	/* KEYPOINTARRAYS_H */
@@ -0,0 +1,173 @@
+/**
+ * @file KeypointBudget.cpp
+ * @author Aydin Arik
+ * @brief Caps the number of keypoints found in a frame, keeping them spread
+ *        evenly over the frame.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "KeypointBudget.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+using namespace std;
+
+// A keypoint is only suppressed by keypoints this much stronger (Brown et al., 2005).
+#define ANMS_ROBUSTNESS 0.9f
+
+// ANMS only looks at this many times the budget of the strongest keypoints,
+// which bounds its (quadratic) cost however textured the scene is.
+#define ANMS_CANDIDATES_PER_KEYPOINT 4
+
+
+/******************************************************************************
+ *                              Functions
+ ******************************************************************************/
+static bool stronger(const cv::KeyPoint& a, const cv::KeyPoint& b) {
+    return a.response > b.response;
+}
+
+/**
+ * Keep the strongest keypoints.
+ *
+ * @param keypoints Keypoints (replaced by the strongest, strongest first).
+ * @param count Number to keep.
+ */
+static void keepStrongest(vector<cv::KeyPoint>& keypoints, unsigned int count) {
+    if (keypoints.size() > count) {
+        nth_element(keypoints.begin(), keypoints.begin() + count, keypoints.end(), stronger);
+        keypoints.resize(count);
+    }
+    sort(keypoints.begin(), keypoints.end(), stronger);
+}
+
+
+/******************************************************************************
+ *                              Private Methods
+ ******************************************************************************/
+/**
+ * Keep the keypoints furthest from any much stronger keypoint (adaptive
+ * non-maximal suppression). Each keypoint's suppression radius is the
+ * distance to the nearest keypoint that is clearly stronger, and those with
+ * the largest radii are kept. A strong keypoint in a cluster of strong
+ * keypoints loses to a weaker one standing on its own.
+ *
+ * @param keypoints Keypoints (replaced by those kept).
+ */
+void KeypointBudget::selectAnms(vector<cv::KeyPoint>& keypoints) const {
+    keepStrongest(keypoints, maxKeypoints * ANMS_CANDIDATES_PER_KEYPOINT);
+
+    vector<pair<float, int> > radii(keypoints.size()); //(squared radius, keypoint)
+    for (unsigned int i = 0; i < keypoints.size(); i++) {
+        float radius = numeric_limits<float>::max();
+        const cv::Point2f& p = keypoints[i].pt;
+        float response = keypoints[i].response;
+
+        //Sorted strongest first, so only earlier keypoints can be stronger.
+        for (unsigned int j = 0; j < i; j++) {
+            if (response < ANMS_ROBUSTNESS * keypoints[j].response) {
+                float dx = p.x - keypoints[j].pt.x;
+                float dy = p.y - keypoints[j].pt.y;
+                radius = min(radius, dx * dx + dy * dy);
+            }
+        }
+        radii[i] = make_pair(-radius, i); //Negated, so sorting puts largest first.
+    }
+
+    unsigned int count = min((unsigned int) maxKeypoints, (unsigned int) radii.size());
+    partial_sort(radii.begin(), radii.begin() + count, radii.end());
+
+    vector<cv::KeyPoint> kept(count);
+    for (unsigned int i = 0; i < count; i++) {
+        kept[i] = keypoints[radii[i].second];
+    }
+    keypoints.swap(kept);
+}
+
+/**
+ * Keep the strongest keypoints in each cell of a grid. The grid has about
+ * as many cells as the budget and the frame's aspect ratio. Budget left by
+ * empty cells goes to the strongest of the remaining keypoints.
+ *
+ * @param keypoints Keypoints (replaced by those kept).
+ * @param imageSize Size of the frame.
+ */
+void KeypointBudget::selectGrid(vector<cv::KeyPoint>& keypoints, cv::Size imageSize) const {
+    int width = max(imageSize.width, 1);
+    int height = max(imageSize.height, 1);
+    int cols = max((int) ceil(sqrt((double) maxKeypoints * width / height)), 1);
+    int rows = max((maxKeypoints + cols - 1) / cols, 1);
+    unsigned int perCell = max(maxKeypoints / (cols * rows), 1);
+
+    vector<vector<cv::KeyPoint> > cells(cols * rows);
+    for (unsigned int i = 0; i < keypoints.size(); i++) {
+        int col = min(max((int) (keypoints[i].pt.x * cols / width), 0), cols - 1);
+        int row = min(max((int) (keypoints[i].pt.y * rows / height), 0), rows - 1);
+        cells[row * cols + col].push_back(keypoints[i]);
+    }
+
+    vector<cv::KeyPoint> kept;
+    vector<cv::KeyPoint> spare; //Beyond the quota of their cell.
+    kept.reserve(maxKeypoints);
+    for (unsigned int c = 0; c < cells.size(); c++) {
+        vector<cv::KeyPoint>& cell = cells[c];
+        if (cell.size() > perCell) {
+            nth_element(cell.begin(), cell.begin() + perCell, cell.end(), stronger);
+            spare.insert(spare.end(), cell.begin() + perCell, cell.end());
+            cell.resize(perCell);
+        }
+        kept.insert(kept.end(), cell.begin(), cell.end());
+    }
+
+    if (kept.size() > (unsigned int) maxKeypoints) {
+        keepStrongest(kept, maxKeypoints);
+    } else {
+        keepStrongest(spare, maxKeypoints - kept.size());
+        kept.insert(kept.end(), spare.begin(), spare.end());
+    }
+    keypoints.swap(kept);
+}
+
+
+/******************************************************************************
+ *                              Public Methods
+ ******************************************************************************/
+/**
+ * Constructor.
+ *
+ * @param maxKeypoints Most keypoints kept (0 for no limit).
+ * @param method How keypoints are chosen.
+ */
+KeypointBudget::KeypointBudget(int maxKeypoints, Method method)
+: maxKeypoints(max(maxKeypoints, 0)), method(method) {
+}
+
+/**
+ * Keep at most the budgeted number of keypoints, spread over the frame.
+ * Does nothing if the frame is within budget.
+ *
+ * @param keypoints Keypoints (replaced by those kept).
+ * @param imageSize Size of the frame.
+ */
+void KeypointBudget::select(vector<cv::KeyPoint>& keypoints, cv::Size imageSize) const {
+    if (maxKeypoints == 0 || keypoints.size() <= (unsigned int) maxKeypoints) {
+        return;
+    }
+
+    if (method == GRID) {
+        selectGrid(keypoints, imageSize);
+    } else {
+        selectAnms(keypoints);
+    }
+}
+
+/**
+ * @return Most keypoints kept (0 for no limit).
+ */
+int KeypointBudget::getMaxKeypoints() const {
+    return maxKeypoints;
+}
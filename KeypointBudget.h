@@ -0,0 +1,75 @@
+/**
+ * @file KeypointBudget.h
+ * @author Aydin Arik
+ * @brief Caps the number of keypoints found in a frame, keeping them spread
+ *        evenly over the frame. The number of SURF keypoints swings with how
+ *        textured a scene is, and matching time swings with it; a fixed budget
+ *        keeps the time per frame predictable. Keypoints are chosen before
+ *        descriptors are extracted, so only the survivors are described.
+ */
+
+#ifndef KEYPOINTBUDGET_H
+#define	KEYPOINTBUDGET_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <opencv2/features2d/features2d.hpp>
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+class KeypointBudget {
+public:
+
+    enum Method {
+        ANMS, //Adaptive non-maximal suppression (most even, a little slower).
+        GRID //Strongest keypoints in each cell of a grid (fastest).
+    };
+
+private:
+    int maxKeypoints; //Most keypoints kept (0 for no limit).
+    Method method;
+
+    /**
+     * Keep the keypoints furthest from any much stronger keypoint.
+     *
+     * @param keypoints Keypoints (replaced by those kept).
+     */
+    void selectAnms(std::vector<cv::KeyPoint>& keypoints) const;
+
+    /**
+     * Keep the strongest keypoints in each cell of a grid.
+     *
+     * @param keypoints Keypoints (replaced by those kept).
+     * @param imageSize Size of the frame.
+     */
+    void selectGrid(std::vector<cv::KeyPoint>& keypoints, cv::Size imageSize) const;
+
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param maxKeypoints Most keypoints kept (0 for no limit).
+     * @param method How keypoints are chosen.
+     */
+    KeypointBudget(int maxKeypoints = 0, Method method = ANMS);
+
+    /**
+     * Keep at most the budgeted number of keypoints, spread over the frame.
+     *
+     * @param keypoints Keypoints (replaced by those kept).
+     * @param imageSize Size of the frame.
+     */
+    void select(std::vector<cv::KeyPoint>& keypoints, cv::Size imageSize) const;
+
+    /**
+     * @return Most keypoints kept (0 for no limit).
+     */
+    int getMaxKeypoints() const;
+};
+
+#endif	/* KEYPOINTBUDGET_H */
@@ -11,6 +11,7 @@
 /******************************************************************************
  *                              Header Files
  ******************************************************************************/
+#include <cmath>
 #include <vector>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/highgui/highgui.hpp>
@@ -28,11 +29,49 @@ KinectCamera::KinectCamera(freenect_context *context, int index)
 : Freenect::FreenectDevice(context, index),
 bufferDepth(FREENECT_DEPTH_11BIT),
 bufferRGB(FREENECT_VIDEO_RGB),
-newRGBFrame(false), newDepthFrame(false),
+RGBStreaming(false), newRGBFrame(false), newDepthFrame(false), RGBTimestamp(0), RGBSequence(0), RGBArrived(0), depthTimestamp(0), capture(NULL),
 depthMat(Size(640, 480), CV_16UC1),
 RGBMat(Size(640, 480), CV_8UC3, Scalar(0)) {
 }
 
+/**
+ * Copy every raw frame, with its driver timestamp, to a capture. Call before
+ * startStream(); depth is streamed too.
+ * 
+ * @param capture An open capture (NULL to stop capturing).
+ */
+void KinectCamera::setCapture(CaptureWriter* capture) {
+    this->capture = capture;
+}
+
+/**
+ * Start the RGB stream (and the depth stream, if capturing).
+ */
+void KinectCamera::startStream() {
+    RGBMutex.lock();
+    RGBStreaming = true;
+    RGBMutex.unlock();
+    startVideo();
+    if (capture) {
+        startDepth();
+    }
+}
+
+/**
+ * Stop the RGB stream (and the depth stream, if capturing).
+ */
+void KinectCamera::stopStream() {
+    stopVideo();
+    if (capture) {
+        stopDepth();
+    }
+
+    RGBMutex.lock();
+    RGBStreaming = false;
+    RGBReady.broadcast(); //Nothing more is coming.
+    RGBMutex.unlock();
+}
+
 /**
  * Get RGB data.
  * 
@@ -40,11 +79,57 @@ RGBMat(Size(640, 480), CV_8UC3, Scalar(0)) {
  * @return 
  */
 bool KinectCamera::getVideo(Mat& outputRGB) {
+    FrameTrace trace;
+    return getVideo(outputRGB, trace);
+}
+
+/**
+ * Get RGB data, and where and when it came from.
+ * 
+ * @param outputRGB
+ * @param trace Sequence number, driver timestamp, and when the frame arrived
+ *        and was got.
+ * @return 
+ */
+bool KinectCamera::getVideo(Mat& outputRGB, FrameTrace& trace) {
+    return waitVideo(outputRGB, trace, 0);
+}
+
+/**
+ * Wait for an RGB frame that hasn't been got already. The video callback
+ * wakes the wait as soon as a frame arrives.
+ * 
+ * @param outputRGB
+ * @param trace Sequence number, driver timestamp, and when the frame arrived
+ *        and was got.
+ * @param timeoutMs Longest time to wait (milliseconds, negative to wait until
+ *        there is a frame or the stream stops).
+ * @return True if there was a new frame.
+ */
+bool KinectCamera::waitVideo(Mat& outputRGB, FrameTrace& trace, int timeoutMs) {
+    double deadline = FrameTrace::now() + timeoutMs / 1000.0;
     RGBMutex.lock();
+    while (!newRGBFrame && RGBStreaming && timeoutMs != 0) {
+        if (timeoutMs < 0) {
+            RGBReady.wait(RGBMutex);
+            continue;
+        }
+        int remainingMs = (int) ceil((deadline - FrameTrace::now()) * 1000);
+        if (remainingMs <= 0) {
+            break;
+        }
+        RGBReady.wait(RGBMutex, remainingMs); //Woken early by a frame (or spuriously).
+    }
+
     if (newRGBFrame) {//If there is a new RGB image, copy to outputRGB.
         cv::cvtColor(RGBMat, outputRGB, CV_RGB2BGR);
         newRGBFrame = false;
+        trace = FrameTrace();
+        trace.sequence = RGBSequence;
+        trace.driverTimestamp = RGBTimestamp;
+        trace.arrived = RGBArrived;
         RGBMutex.unlock();
+        trace.acquired = FrameTrace::now();
         return true;
     } else {
         RGBMutex.unlock();
@@ -84,9 +169,18 @@ bool KinectCamera::getDepth(Mat& outputDepth) {
  * @param timestamp Time of callback.
  */
 void KinectCamera::VideoCallback(void* RGBData, uint32_t timestamp) {
+    if (capture) {
+        capture->addVideo(RGBData, timestamp); //Copies, so the driver isn't held up.
+    }
+
+    double arrived = FrameTrace::now();
     RGBMutex.lock();
     RGBMat.data = static_cast<uint8_t*> (RGBData);
+    RGBTimestamp = timestamp;
+    RGBSequence++; //Frames overwritten before being got leave gaps.
+    RGBArrived = arrived;
     newRGBFrame = true;
+    RGBReady.broadcast();
     RGBMutex.unlock();
 };
 
@@ -97,8 +191,13 @@ void KinectCamera::VideoCallback(void* RGBData, uint32_t timestamp) {
  * @param timestamp Time of callback.
  */
 void KinectCamera::DepthCallback(void* depthData, uint32_t timestamp) {
+    if (capture) {
+        capture->addDepth(depthData, timestamp);
+    }
+
     depthMutex.lock();
     depthMat.data = (uchar*) static_cast<uint16_t*> (depthData);
+    depthTimestamp = timestamp;
     newDepthFrame = true;
     depthMutex.unlock();
 }
@@ -16,44 +16,31 @@
  ******************************************************************************/
 #include "libfreenect.hpp"
 #include <opencv2/core/core.hpp>
-#include <pthread.h>
+#include "Mutex.h"
+#include "FrameSource.h"
+#include "CaptureWriter.h"
 
 
 /******************************************************************************
  *                              Class
  ******************************************************************************/
-/**
- * Mutexes required by the KinectCamera class.
- */
-class Mutex {
-public:
-    
-    Mutex() {
-        pthread_mutex_init(&m_mutex, NULL);
-    }
-    
-    void lock() {
-        pthread_mutex_lock(&m_mutex);
-    }
-    
-    void unlock() {
-        pthread_mutex_unlock(&m_mutex);
-    }
-private:
-    pthread_mutex_t m_mutex;
-};
-
-
-class KinectCamera : public Freenect::FreenectDevice {
+class KinectCamera : public Freenect::FreenectDevice, public FrameSource {
 private:
     std::vector<uint8_t> bufferDepth;
     std::vector<uint8_t> bufferRGB;
     cv::Mat depthMat;
     cv::Mat RGBMat;
     Mutex RGBMutex;
+    Condition RGBReady; //Signalled when a new RGB frame arrives or the stream stops.
+    bool RGBStreaming; //True between startStream() and stopStream() (guarded by RGBMutex).
     Mutex depthMutex;
     bool newRGBFrame;
     bool newDepthFrame;
+    uint32_t RGBTimestamp; //Driver timestamp of RGBMat.
+    uint64_t RGBSequence; //Number of RGBMat (1 for the first frame).
+    double RGBArrived; //When RGBMat arrived (seconds, CLOCK_MONOTONIC).
+    uint32_t depthTimestamp; //Driver timestamp of depthMat.
+    CaptureWriter* capture; //Gets a copy of every raw frame (NULL for none).
 
     // Do not call directly even in child
     void VideoCallback(void* _rgb, uint32_t timestamp);
@@ -68,6 +55,24 @@ public:
      * @param index
      */
     KinectCamera(freenect_context *context, int index);
+
+    /**
+     * Copy every raw frame, with its driver timestamp, to a capture (see
+     * ReplayCamera). Call before startStream(); depth is streamed too.
+     *
+     * @param capture An open capture (NULL to stop capturing).
+     */
+    void setCapture(CaptureWriter* capture);
+
+    /**
+     * Start the RGB stream (and the depth stream, if capturing).
+     */
+    void startStream();
+
+    /**
+     * Stop the RGB stream (and the depth stream, if capturing).
+     */
+    void stopStream();
     
     /**
      * 
@@ -75,6 +80,27 @@ public:
      * @return 
      */
     bool getVideo(cv::Mat& outputRGB);
+
+    /**
+     * 
+     * @param outputRGB
+     * @param trace Sequence number, driver timestamp, and when the frame
+     *        arrived and was got.
+     * @return 
+     */
+    bool getVideo(cv::Mat& outputRGB, FrameTrace& trace);
+
+    /**
+     * Wait for an RGB frame that hasn't been got already.
+     *
+     * @param outputRGB
+     * @param trace Sequence number, driver timestamp, and when the frame
+     *        arrived and was got.
+     * @param timeoutMs Longest time to wait (milliseconds, negative to wait
+     *        until there is a frame or the stream stops).
+     * @return True if there was a new frame.
+     */
+    bool waitVideo(cv::Mat& outputRGB, FrameTrace& trace, int timeoutMs);
     
     /**
      * 
@@ -0,0 +1,188 @@
+/**
+ * @file LatencyTracker.cpp
+ * @author Aydin Arik
+ * @brief Measures how old results are, per camera, from the frame arriving
+ *        from the driver.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "LatencyTracker.h"
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+// Width (seconds) and number of the bins ages are counted in. Older results
+// all go in the last bin.
+#define AGE_BIN_SIZE 0.001
+#define NUM_OF_AGE_BINS 1000
+
+
+/******************************************************************************
+ *                              Private Methods
+ ******************************************************************************/
+LatencyTracker::Stats::Stats()
+: numOfResults(0), numOfDropped(0), numOfReprocessed(0), meanAge(0), maxAge(0),
+p95Age(0), meanQueue(0), meanRecognise(0), meanPublish(0), meanInterval(0),
+jitter(0), numOfDisplayed(0), meanGlassAge(0), maxGlassAge(0) {
+}
+
+LatencyTracker::Camera::Camera()
+: histogram(NUM_OF_AGE_BINS, 0), totalAge(0), totalQueue(0), totalRecognise(0),
+totalPublish(0), totalGlassAge(0), lastPublished(0), totalInterval(0),
+totalIntervalSquared(0), numOfIntervals(0), lastSequence(0) {
+}
+
+/**
+ * @param camera Camera.
+ * @return Its stats, with the means and percentile filled in.
+ */
+LatencyTracker::Stats LatencyTracker::summarise(const Camera& camera) {
+    Stats stats = camera.stats;
+
+    long n = stats.numOfResults;
+    if (n > 0) {
+        stats.meanAge = camera.totalAge / n;
+        stats.meanQueue = camera.totalQueue / n;
+        stats.meanRecognise = camera.totalRecognise / n;
+        stats.meanPublish = camera.totalPublish / n;
+
+        //Upper edge of the bin the 95th percentile falls in.
+        long wanted = (long) ceil(0.95 * n);
+        long count = 0;
+        for (int i = 0; i < NUM_OF_AGE_BINS; i++) {
+            count += camera.histogram[i];
+            if (count >= wanted) {
+                stats.p95Age = std::min((i + 1) * AGE_BIN_SIZE, stats.maxAge);
+                break;
+            }
+        }
+    }
+
+    if (camera.numOfIntervals > 0) {
+        stats.meanInterval = camera.totalInterval / camera.numOfIntervals;
+        double variance = camera.totalIntervalSquared / camera.numOfIntervals -
+                stats.meanInterval * stats.meanInterval;
+        stats.jitter = sqrt(std::max(variance, 0.0));
+    }
+
+    if (stats.numOfDisplayed > 0) {
+        stats.meanGlassAge = camera.totalGlassAge / stats.numOfDisplayed;
+    }
+    return stats;
+}
+
+
+/******************************************************************************
+ *                              Public Methods
+ ******************************************************************************/
+/**
+ * Count a result as published. Results whose frames have no arrival time
+ * (e.g. from sources without a driver timestamp) count towards intervals
+ * only.
+ *
+ * @param camera Camera the frame came from.
+ * @param trace The result's trace.
+ * @param when When it was published (see FrameTrace::now()).
+ */
+void LatencyTracker::published(int camera, const FrameTrace& trace, double when) {
+    ScopedLock lock(mutex);
+    Camera& c = cameras[camera];
+    Stats& stats = c.stats;
+
+    if (c.lastPublished > 0) {
+        double interval = when - c.lastPublished;
+        c.totalInterval += interval;
+        c.totalIntervalSquared += interval * interval;
+        c.numOfIntervals++;
+    }
+    c.lastPublished = when;
+
+    if (trace.sequence > 0) {
+        if (c.lastSequence > 0 && trace.sequence <= c.lastSequence) {
+            stats.numOfReprocessed++;
+        } else if (c.lastSequence > 0 && trace.sequence > c.lastSequence + 1) {
+            stats.numOfDropped += (long) (trace.sequence - c.lastSequence - 1);
+        }
+        c.lastSequence = std::max(c.lastSequence, trace.sequence);
+    }
+
+    if (trace.arrived <= 0) {
+        return; //Age unknown.
+    }
+
+    double age = when - trace.arrived;
+    stats.numOfResults++;
+    stats.maxAge = std::max(stats.maxAge, age);
+    c.totalAge += age;
+    c.totalQueue += trace.acquired - trace.arrived;
+    c.totalRecognise += trace.recognised - trace.acquired;
+    c.totalPublish += when - trace.recognised;
+
+    int bin = std::min(std::max((int) (age / AGE_BIN_SIZE), 0), NUM_OF_AGE_BINS - 1);
+    c.histogram[bin]++;
+}
+
+/**
+ * Count a result as shown for the first time.
+ *
+ * @param camera Camera the frame came from.
+ * @param trace The result's trace.
+ * @param when When it was shown (see FrameTrace::now()).
+ */
+void LatencyTracker::displayed(int camera, const FrameTrace& trace, double when) {
+    if (trace.arrived <= 0) {
+        return; //Age unknown.
+    }
+
+    ScopedLock lock(mutex);
+    Camera& c = cameras[camera];
+    double age = when - trace.arrived;
+    c.stats.numOfDisplayed++;
+    c.stats.maxGlassAge = std::max(c.stats.maxGlassAge, age);
+    c.totalGlassAge += age;
+}
+
+/**
+ * @param camera Camera.
+ * @return Latency of the camera's results so far.
+ */
+LatencyTracker::Stats LatencyTracker::getStats(int camera) {
+    ScopedLock lock(mutex);
+    map<int, Camera>::const_iterator found = cameras.find(camera);
+    if (found == cameras.end()) {
+        return Stats();
+    }
+    return summarise(found->second);
+}
+
+/**
+ * Write a line of latency figures per camera (in milliseconds).
+ *
+ * @param out Stream to write to.
+ */
+void LatencyTracker::report(ostream& out) {
+    ScopedLock lock(mutex);
+    for (map<int, Camera>::const_iterator i = cameras.begin(); i != cameras.end(); i++) {
+        Stats stats = summarise(i->second);
+        out << "Camera " << i->first << ": " << stats.numOfResults << " results, age "
+                << stats.meanAge * 1000 << " mean / " << stats.p95Age * 1000 << " p95 / "
+                << stats.maxAge * 1000 << " max ms (queue " << stats.meanQueue * 1000
+                << ", recognise " << stats.meanRecognise * 1000 << ", publish "
+                << stats.meanPublish * 1000 << "), on screen " << stats.meanGlassAge * 1000
+                << " mean / " << stats.maxGlassAge * 1000 << " max ms, interval "
+                << stats.meanInterval * 1000 << " +/- " << stats.jitter * 1000 << " ms, "
+                << stats.numOfDropped << " dropped, " << stats.numOfReprocessed
+                << " reprocessed" << endl;
+    }
+}
+
+/**
+ * Forget everything measured so far.
+ */
+void LatencyTracker::reset() {
+    ScopedLock lock(mutex);
+    cameras.clear();
+}
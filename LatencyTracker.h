@@ -0,0 +1,114 @@
+/**
+ * @file LatencyTracker.h
+ * @author Aydin Arik
+ * @brief Measures how old results are, per camera, from the frame arriving from
+ *        the driver rather than from recognition starting. Each published
+ *        result is broken down into time queued (arrived to got), recognising
+ *        (got to recognised) and publishing (recognised to published), and how
+ *        old it was when published and when first shown. Sequence numbers
+ *        show frames dropped (overwritten before being got) and frames
+ *        recognised more than once. The spread of intervals between results
+ *        is kept as jitter.
+ */
+
+#ifndef LATENCYTRACKER_H
+#define	LATENCYTRACKER_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <map>
+#include <vector>
+#include <ostream>
+#include <stdint.h>
+#include "FrameTrace.h"
+#include "Mutex.h"
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+class LatencyTracker {
+public:
+
+    /**
+     * Latency of one camera's results. Times are in seconds.
+     */
+    struct Stats {
+        long numOfResults; //Results published with a known arrival time.
+        long numOfDropped; //Frames never got (gaps in sequence numbers).
+        long numOfReprocessed; //Frames recognised again (sequence numbers not increasing).
+        double meanAge, maxAge, p95Age; //Arrival to publication.
+        double meanQueue; //Arrival to being got.
+        double meanRecognise; //Being got to recognised.
+        double meanPublish; //Recognised to published.
+        double meanInterval; //Between results.
+        double jitter; //Standard deviation of the interval between results.
+        long numOfDisplayed; //Results shown.
+        double meanGlassAge, maxGlassAge; //Arrival to being shown.
+
+        Stats();
+    };
+
+private:
+
+    struct Camera {
+        Stats stats;
+        std::vector<long> histogram; //Results by age, in AGE_BIN_SIZE bins.
+        double totalAge, totalQueue, totalRecognise, totalPublish, totalGlassAge;
+        double lastPublished; //When the last result was published (0 if none).
+        double totalInterval, totalIntervalSquared;
+        long numOfIntervals;
+        uint64_t lastSequence; //Sequence number of the last result (0 if none).
+
+        Camera();
+    };
+
+    Mutex mutex;
+    std::map<int, Camera> cameras; //Guarded by mutex.
+
+    /**
+     * @param camera Camera.
+     * @return Its stats, with the means and percentile filled in.
+     */
+    static Stats summarise(const Camera& camera);
+
+public:
+
+    /**
+     * Count a result as published.
+     *
+     * @param camera Camera the frame came from.
+     * @param trace The result's trace.
+     * @param when When it was published (see FrameTrace::now()).
+     */
+    void published(int camera, const FrameTrace& trace, double when);
+
+    /**
+     * Count a result as shown for the first time.
+     *
+     * @param camera Camera the frame came from.
+     * @param trace The result's trace.
+     * @param when When it was shown (see FrameTrace::now()).
+     */
+    void displayed(int camera, const FrameTrace& trace, double when);
+
+    /**
+     * @param camera Camera.
+     * @return Latency of the camera's results so far.
+     */
+    Stats getStats(int camera);
+
+    /**
+     * Write a line of latency figures per camera (in milliseconds).
+     *
+     * @param out Stream to write to.
+     */
+    void report(std::ostream& out);
+
+    /**
+     * Forget everything measured so far.
+     */
+    void reset();
+};
+
+#endif	/* LATENCYTRACKER_H */
@@ -0,0 +1,378 @@
+/**
+ * @file LibraryStore.cpp
+ * @author Aydin Arik
+ * @brief Contiguous storage of the features of every library object model.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "LibraryStore.h"
+#include <map>
+#include <cstdlib>
+#include <opencv2/features2d/features2d.hpp>
+#include <cstring>
+
+// Alignment of the descriptor block and of each descriptor row (a cache line).
+#define ALIGNMENT 64
+
+using namespace std;
+
+
+/******************************************************************************
+ *                              Functions
+ ******************************************************************************/
+/**
+ * Merge the words of several views into one bag of words (the mean term
+ * frequency of each word).
+ * 
+ * @param objects Every view.
+ * @param views The views to merge.
+ * @return Merged words, sorted by word.
+ */
+static BagOfWords mergeWords(const vector<ObjectPtr>& objects, const vector<int>& views) {
+    map<int, float> merged;
+    for (unsigned int v = 0; v < views.size(); v++) {
+        const BagOfWords& words = objects[views[v]]->getWords();
+        for (unsigned int j = 0; j < words.size(); j++) {
+            merged[words[j].first] += words[j].second / views.size();
+        }
+    }
+
+    return BagOfWords(merged.begin(), merged.end());
+}
+
+/******************************************************************************
+ *                              ObjectView Methods
+ ******************************************************************************/
+ObjectView::ObjectView() : object(NULL), x(NULL), y(NULL), size(NULL), angle(NULL),
+response(NULL), octave(NULL), numOfKeypoints(0) {
+}
+
+/**
+ * View an object's own features (used for objects not yet in a store).
+ *
+ * @param object The object.
+ */
+ObjectView::ObjectView(const ObjectPtr& object)
+: owner(object), object(object.get()), descriptors(object->getDescriptors()) {
+    const KeypointArrays& keypoints = object->getKeypoints();
+    numOfKeypoints = keypoints.count();
+    x = numOfKeypoints ? &keypoints.x[0] : NULL;
+    y = numOfKeypoints ? &keypoints.y[0] : NULL;
+    size = numOfKeypoints ? &keypoints.size[0] : NULL;
+    angle = numOfKeypoints ? &keypoints.angle[0] : NULL;
+    response = numOfKeypoints ? &keypoints.response[0] : NULL;
+    octave = numOfKeypoints ? &keypoints.octave[0] : NULL;
+}
+
+/**
+ * View a range of a store's features.
+ *
+ * @param owner Keeps the storage alive.
+ * @param object Name, image and words of the object.
+ * @param descriptors Descriptor rows of the object.
+ * @param keypoints Keypoint arrays containing the object.
+ * @param begin Index of the object's first keypoint.
+ * @param end One past the object's last keypoint.
+ */
+ObjectView::ObjectView(const boost::shared_ptr<const void>& owner, const Object* object,
+        const cv::Mat& descriptors, const KeypointArrays& keypoints, int begin, int end)
+: owner(owner), object(object), descriptors(descriptors), numOfKeypoints(end - begin) {
+    bool any = (numOfKeypoints > 0);
+    x = any ? &keypoints.x[begin] : NULL;
+    y = any ? &keypoints.y[begin] : NULL;
+    size = any ? &keypoints.size[begin] : NULL;
+    angle = any ? &keypoints.angle[begin] : NULL;
+    response = any ? &keypoints.response[begin] : NULL;
+    octave = any ? &keypoints.octave[begin] : NULL;
+}
+
+/**
+ * Build cv::KeyPoints from the arrays. This copies, so keep it out of
+ * the matching loop (it's meant for drawing).
+ *
+ * @param keypoints Resulting keypoints.
+ */
+void ObjectView::getKeypoints(vector<cv::KeyPoint>& keypoints) const {
+    keypoints.clear();
+    keypoints.reserve(numOfKeypoints);
+    for (int i = 0; i < numOfKeypoints; i++) {
+        keypoints.push_back(cv::KeyPoint(x[i], y[i], size[i], angle[i], response[i], octave[i]));
+    }
+}
+
+
+/******************************************************************************
+ *                              ModelView Methods
+ ******************************************************************************/
+ModelView::ModelView() : slot(0), refOffsets(NULL), refViews(NULL), refKeypoints(NULL) {
+}
+
+/**
+ * A model of an object that isn't in a store yet.
+ *
+ * @param object The object.
+ */
+ModelView::ModelView(const ObjectPtr& object)
+: slot(0), single(object), descriptors(object->getDescriptors()),
+refOffsets(NULL), refViews(NULL), refKeypoints(NULL) {
+}
+
+/**
+ * A model in a store.
+ *
+ * @param store The store.
+ * @param slot Model number in the store.
+ */
+ModelView::ModelView(const boost::shared_ptr<const LibraryStore>& store, int slot)
+: store(store), slot(slot),
+descriptors(store->descriptors.rowRange(store->modelRows[slot], store->modelRows[slot + 1])),
+refOffsets(&store->refOffsets[store->modelRows[slot]]),
+refViews(store->refViews.empty() ? NULL : &store->refViews[0]),
+refKeypoints(store->refKeypoints.empty() ? NULL : &store->refKeypoints[0]) {
+}
+
+const string& ModelView::getObjectName() const {
+    return store ? store->modelNames[slot] : single.getObjectName();
+}
+
+int ModelView::getNumOfViews() const {
+    if (!store) {
+        return single.empty() ? 0 : 1;
+    }
+    return store->modelViewOffsets[slot + 1] - store->modelViewOffsets[slot];
+}
+
+/**
+ * @param v View number, from 0 to getNumOfViews() - 1.
+ * @return The view. Views in a store have no descriptors of their own.
+ */
+ObjectView ModelView::getView(int v) const {
+    if (!store) {
+        return single;
+    }
+
+    int view = store->modelViews[store->modelViewOffsets[slot] + v];
+    return ObjectView(store, store->objects[view].get(), cv::Mat(),
+            store->keypoints, store->viewOffsets[view], store->viewOffsets[view + 1]);
+}
+
+
+/******************************************************************************
+ *                              LibraryStore Methods
+ ******************************************************************************/
+/**
+ * Constructor. Groups objects with the same name into models, merges the
+ * near identical descriptors of each model and copies everything into
+ * contiguous memory. Models that are already in the previous store keep
+ * their representatives, so only the descriptors of new views are merged.
+ *
+ * @param objects Objects (views) to store, in order.
+ * @param previous Store the objects may have come from (may be NULL).
+ * @param mergeDistance Descriptors closer than this (L2) to a representative
+ *        are merged into it.
+ */
+LibraryStore::LibraryStore(const vector<ObjectPtr>& objects, const LibraryStore* previous,
+        float mergeDistance)
+: descriptorData(NULL) {
+
+    //Where each view's keypoints and each model's representatives currently live.
+    map<const Object*, int> previousViews;
+    map<string, int> previousModels;
+    if (previous) {
+        for (unsigned int i = 0; i < previous->objects.size(); i++) {
+            previousViews[previous->objects[i].get()] = i;
+        }
+        for (int i = 0; i < previous->size(); i++) {
+            previousModels[previous->modelNames[i]] = i;
+        }
+    }
+
+    //Copy keypoints in, one view after another.
+    vector<int> previousView(objects.size(), -1);
+    viewOffsets.push_back(0);
+    for (unsigned int i = 0; i < objects.size(); i++) {
+        map<const Object*, int>::iterator found = previousViews.find(objects[i].get());
+        if (found != previousViews.end()) {
+            previousView[i] = found->second;
+            keypoints.append(previous->keypoints, previous->viewOffsets[found->second],
+                    previous->viewOffsets[found->second + 1]);
+            this->objects.push_back(objects[i]); //Already without features.
+        } else {
+            const KeypointArrays& own = objects[i]->getKeypoints();
+            keypoints.append(own, 0, own.count());
+            this->objects.push_back(ObjectPtr(new Object(objects[i]->withoutFeatures())));
+        }
+
+        viewOffsets.push_back(keypoints.count());
+    }
+
+    //Views with the same name are views of the same model.
+    map<string, int> modelSlots;
+    vector<vector<int> > members;
+    for (unsigned int i = 0; i < objects.size(); i++) {
+        const string& name = objects[i]->getObjectName();
+        map<string, int>::iterator found = modelSlots.find(name);
+        if (found == modelSlots.end()) {
+            found = modelSlots.insert(make_pair(name, (int) members.size())).first;
+            members.push_back(vector<int>());
+            modelNames.push_back(name);
+        }
+        members[found->second].push_back(i);
+    }
+
+    //Find the representatives of each model.
+    cv::BruteForceMatcher<cv::L2<float> > matcher;
+    vector<cv::Mat> representatives(members.size());
+    int rows = 0;
+    int cols = 0;
+    int type = CV_32F;
+    refOffsets.push_back(0);
+    modelRows.push_back(0);
+    modelViewOffsets.push_back(0);
+    for (unsigned int m = 0; m < members.size(); m++) {
+        const vector<int>& views = members[m];
+        cv::Mat& reps = representatives[m];
+        vector<vector<pair<int, int> > > refs; //(view, keypoint) of each representative.
+
+        //Keep the previous representatives that still refer to a view.
+        map<string, int>::iterator prev = previousModels.find(modelNames[m]);
+        if (prev != previousModels.end()) {
+            int p = prev->second;
+            int firstView = previous->modelViewOffsets[p];
+            map<int, int> newView; //Previous view number (within the model) to new one.
+            for (int pv = firstView; pv < previous->modelViewOffsets[p + 1]; pv++) {
+                for (unsigned int v = 0; v < views.size(); v++) {
+                    if (previousView[views[v]] == previous->modelViews[pv]) {
+                        newView[pv - firstView] = v;
+                    }
+                }
+            }
+
+            for (int r = previous->modelRows[p]; r < previous->modelRows[p + 1]; r++) {
+                vector<pair<int, int> > kept;
+                for (int j = previous->refOffsets[r]; j < previous->refOffsets[r + 1]; j++) {
+                    map<int, int>::iterator to = newView.find(previous->refViews[j]);
+                    if (to != newView.end()) {
+                        kept.push_back(make_pair(to->second, previous->refKeypoints[j]));
+                    }
+                }
+                if (!kept.empty()) {
+                    reps.push_back(previous->descriptors.row(r));
+                    refs.push_back(kept);
+                }
+            }
+        }
+
+        //Merge the descriptors of new views into the representatives. A view's
+        //descriptors are only compared against other views, not each other.
+        for (unsigned int v = 0; v < views.size(); v++) {
+            if (previousView[views[v]] >= 0) {
+                continue;
+            }
+
+            const cv::Mat& own = objects[views[v]]->getDescriptors();
+            vector<cv::DMatch> nearest;
+            if (reps.rows > 0 && own.rows > 0) {
+                matcher.match(own, reps, nearest);
+            }
+
+            for (int k = 0; k < own.rows; k++) {
+                if (k < (int) nearest.size() && nearest[k].distance < mergeDistance) {
+                    refs[nearest[k].trainIdx].push_back(make_pair((int) v, k));
+                } else {
+                    reps.push_back(own.row(k));
+                    refs.push_back(vector<pair<int, int> >(1, make_pair((int) v, k)));
+                }
+            }
+        }
+
+        for (unsigned int r = 0; r < refs.size(); r++) {
+            for (unsigned int j = 0; j < refs[r].size(); j++) {
+                refViews.push_back(refs[r][j].first);
+                refKeypoints.push_back(refs[r][j].second);
+            }
+            refOffsets.push_back(refViews.size());
+        }
+
+        if (reps.rows > 0) {
+            cols = reps.cols;
+            type = reps.type();
+        }
+        rows += reps.rows;
+        modelRows.push_back(rows);
+        modelViews.insert(modelViews.end(), views.begin(), views.end());
+        modelViewOffsets.push_back(modelViews.size());
+        modelWords.push_back(mergeWords(objects, views));
+    }
+
+    //Pad rows out to the alignment so every descriptor starts on a cache line.
+    size_t rowBytes = cols * CV_ELEM_SIZE(type);
+    size_t step = ((rowBytes + ALIGNMENT - 1) / ALIGNMENT) * ALIGNMENT;
+    if (rows > 0 && step > 0 && posix_memalign(&descriptorData, ALIGNMENT, rows * step) == 0) {
+        descriptors = cv::Mat(rows, cols, type, descriptorData, step);
+    } else {
+        descriptorData = NULL;
+        descriptors = cv::Mat(0, cols, type);
+    }
+
+    //Copy representatives in, one model after another.
+    int row = 0;
+    for (unsigned int m = 0; m < representatives.size() && descriptorData; m++) {
+        for (int r = 0; r < representatives[m].rows; r++, row++) {
+            memcpy(descriptors.ptr(row), representatives[m].ptr(r), rowBytes);
+        }
+    }
+}
+
+LibraryStore::~LibraryStore() {
+    free(descriptorData);
+}
+
+/**
+ * @return Number of models in the store.
+ */
+int LibraryStore::size() const {
+    return modelNames.size();
+}
+
+/**
+ * Get a model. The store must be owned by a boost::shared_ptr.
+ *
+ * @param slot Model number in the store.
+ * @return The model.
+ */
+ModelView LibraryStore::model(int slot) const {
+    return ModelView(shared_from_this(), slot);
+}
+
+/**
+ * @param slot Model number in the store.
+ * @return Words of every view of the model, merged.
+ */
+const BagOfWords& LibraryStore::getWords(int slot) const {
+    return modelWords[slot];
+}
+
+/**
+ * @return The stored views, without features, in the order they were given.
+ */
+const vector<ObjectPtr>& LibraryStore::getObjects() const {
+    return objects;
+}
+
+/**
+ * @return Representative descriptors of every model (one per row).
+ */
+const cv::Mat& LibraryStore::getDescriptors() const {
+    return descriptors;
+}
+
+/**
+ * @return Number of keypoints in every view (the number of descriptors
+ *         before merging).
+ */
+int LibraryStore::getNumOfKeypoints() const {
+    return keypoints.count();
+}
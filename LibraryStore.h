@@ -0,0 +1,275 @@
+/**
+ * @file LibraryStore.h
+ * @author Aydin Arik
+ * @brief Contiguous storage of the features of every library object. All
+ *        descriptors are kept in one 64 byte aligned matrix and all keypoints
+ *        in one set of field arrays, with each object owning a range of rows.
+ *        Objects are handed out as lightweight views into this storage, so
+ *        nothing is copied when matching.
+ * 
+ *        An object may have several views (images). Near identical descriptors
+ *        from different views are merged into one representative descriptor,
+ *        which refers back to the keypoint it came from in each view.
+ */
+
+#ifndef LIBRARYSTORE_H
+#define	LIBRARYSTORE_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <opencv2/core/core.hpp>
+#include "Object.h"
+#include "KeypointArrays.h"
+
+class LibraryStore;
+
+/******************************************************************************
+ *                              Classes
+ ******************************************************************************/
+/**
+ * Immutable handle to an object's name, image and features. Copying a view only
+ * copies pointers (and bumps a reference count that keeps the storage alive).
+ */
+class ObjectView {
+private:
+    boost::shared_ptr<const void> owner; //Keeps the viewed storage alive.
+    const Object* object; //Name, image and words.
+    cv::Mat descriptors; //Header onto the owners rows; no data is copied.
+    const float* x;
+    const float* y;
+    const float* size;
+    const float* angle;
+    const float* response;
+    const int* octave;
+    int numOfKeypoints;
+
+public:
+    ObjectView();
+
+    /**
+     * View an object's own features (used for objects not yet in a store).
+     *
+     * @param object The object.
+     */
+    ObjectView(const ObjectPtr& object);
+
+    /**
+     * View a range of a store's features.
+     *
+     * @param owner Keeps the storage alive.
+     * @param object Name, image and words of the object.
+     * @param descriptors Descriptor rows of the object (may be empty, see ModelView).
+     * @param keypoints Keypoint arrays containing the object.
+     * @param begin Index of the object's first keypoint.
+     * @param end One past the object's last keypoint.
+     */
+    ObjectView(const boost::shared_ptr<const void>& owner, const Object* object,
+            const cv::Mat& descriptors, const KeypointArrays& keypoints, int begin, int end);
+
+    bool empty() const {
+        return object == NULL;
+    }
+
+    const std::string& getObjectName() const {
+        return object->getObjectName();
+    }
+
+    const cv::Mat& getImage() const {
+        return object->getImage();
+    }
+
+    const BagOfWords& getWords() const {
+        return object->getWords();
+    }
+
+    const cv::Mat& getDescriptors() const {
+        return descriptors;
+    }
+
+    int getNumOfKeypoints() const {
+        return numOfKeypoints;
+    }
+
+    cv::Point2f getPoint(int i) const {
+        return cv::Point2f(x[i], y[i]);
+    }
+
+    float getSize(int i) const {
+        return size[i];
+    }
+
+    float getAngle(int i) const {
+        return angle[i];
+    }
+
+    float getResponse(int i) const {
+        return response[i];
+    }
+
+    int getOctave(int i) const {
+        return octave[i];
+    }
+
+    /**
+     * Build cv::KeyPoints from the arrays. This copies, so keep it out of
+     * the matching loop (it's meant for drawing).
+     *
+     * @param keypoints Resulting keypoints.
+     */
+    void getKeypoints(std::vector<cv::KeyPoint>& keypoints) const;
+};
+
+/**
+ * Immutable handle to an object model: every view of an object, and the
+ * representative descriptors shared by those views. Representative r is found
+ * at keypoint getRefKeypoint(j) of view getRefView(j), for each j from
+ * getRefBegin(r) to getRefEnd(r) - 1. An object that isn't in a store yet is
+ * a model with one view whose descriptors are its own.
+ */
+class ModelView {
+private:
+    boost::shared_ptr<const LibraryStore> store; //Empty for a single object.
+    int slot; //Model number in store.
+    ObjectView single; //The view of a single object.
+    cv::Mat descriptors; //Representative descriptors (one per row).
+    const int* refOffsets; //NULL for a single object (representatives are its keypoints).
+    const int* refViews;
+    const int* refKeypoints;
+
+public:
+    ModelView();
+
+    /**
+     * A model of an object that isn't in a store yet.
+     *
+     * @param object The object.
+     */
+    ModelView(const ObjectPtr& object);
+
+    /**
+     * A model in a store.
+     *
+     * @param store The store.
+     * @param slot Model number in the store.
+     */
+    ModelView(const boost::shared_ptr<const LibraryStore>& store, int slot);
+
+    bool empty() const {
+        return !store && single.empty();
+    }
+
+    const std::string& getObjectName() const;
+
+    int getNumOfViews() const;
+
+    /**
+     * @param v View number, from 0 to getNumOfViews() - 1.
+     * @return The view. Views in a store have no descriptors of their own.
+     */
+    ObjectView getView(int v) const;
+
+    const cv::Mat& getDescriptors() const {
+        return descriptors;
+    }
+
+    int getRefBegin(int r) const {
+        return refOffsets ? refOffsets[r] : r;
+    }
+
+    int getRefEnd(int r) const {
+        return refOffsets ? refOffsets[r + 1] : r + 1;
+    }
+
+    int getRefView(int j) const {
+        return refViews ? refViews[j] : 0;
+    }
+
+    int getRefKeypoint(int j) const {
+        return refKeypoints ? refKeypoints[j] : j;
+    }
+};
+
+/**
+ * Features of a set of object models in contiguous memory. Immutable once built.
+ */
+class LibraryStore : public boost::enable_shared_from_this<LibraryStore> {
+private:
+    friend class ModelView;
+
+    void* descriptorData; //64 byte aligned block owned by the store.
+    cv::Mat descriptors; //Header onto descriptorData. Each row starts on a 64 byte boundary.
+    std::vector<int> refOffsets; //Representative r is shared by refs [refOffsets[r], refOffsets[r + 1]).
+    std::vector<int> refViews; //View (within its model) of each ref.
+    std::vector<int> refKeypoints; //Keypoint (within its view) of each ref.
+
+    KeypointArrays keypoints; //Keypoints of every view, back to back.
+    std::vector<int> viewOffsets; //View i owns keypoints [viewOffsets[i], viewOffsets[i + 1]).
+    std::vector<ObjectPtr> objects; //Views without their features (see Object::withoutFeatures()).
+
+    std::vector<std::string> modelNames;
+    std::vector<int> modelRows; //Model i owns representatives [modelRows[i], modelRows[i + 1]).
+    std::vector<int> modelViewOffsets; //Model i owns modelViews [modelViewOffsets[i], modelViewOffsets[i + 1]).
+    std::vector<int> modelViews; //Views of each model, back to back.
+    std::vector<BagOfWords> modelWords; //Words of every view of each model, merged.
+
+    LibraryStore(const LibraryStore&); //Not copyable.
+    LibraryStore& operator=(const LibraryStore&);
+public:
+
+    /**
+     * Constructor. Groups objects with the same name into models, merges the
+     * near identical descriptors of each model and copies everything into
+     * contiguous memory. Models that are already in the previous store keep
+     * their representatives, so only the descriptors of new views are merged.
+     *
+     * @param objects Objects (views) to store, in order.
+     * @param previous Store the objects may have come from (may be NULL).
+     * @param mergeDistance Descriptors closer than this (L2) to a representative
+     *        are merged into it.
+     */
+    LibraryStore(const std::vector<ObjectPtr>& objects, const LibraryStore* previous,
+            float mergeDistance = 0.15f);
+
+    ~LibraryStore();
+
+    /**
+     * @return Number of models in the store.
+     */
+    int size() const;
+
+    /**
+     * Get a model. The store must be owned by a boost::shared_ptr.
+     *
+     * @param slot Model number in the store.
+     * @return The model.
+     */
+    ModelView model(int slot) const;
+
+    /**
+     * @param slot Model number in the store.
+     * @return Words of every view of the model, merged.
+     */
+    const BagOfWords& getWords(int slot) const;
+
+    /**
+     * @return The stored views, without features, in the order they were given.
+     */
+    const std::vector<ObjectPtr>& getObjects() const;
+
+    /**
+     * @return Representative descriptors of every model (one per row).
+     */
+    const cv::Mat& getDescriptors() const;
+
+    /**
+     * @return Number of keypoints in every view (the number of descriptors
+     *         before merging).
+     */
+    int getNumOfKeypoints() const;
+};
+
+#endif	/* LIBRARYSTORE_H */
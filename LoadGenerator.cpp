@@ -0,0 +1,235 @@
+/**
+ * @file LoadGenerator.cpp
+ * @author Aydin Arik
+ * @brief Loads a RecognitionServer with several clients at once.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "LoadGenerator.h"
+#include "RecognitionClient.h"
+#include "FrameTrace.h"
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <pthread.h>
+#include <unistd.h>
+#include <opencv2/imgproc/imgproc.hpp>
+
+using namespace std;
+
+// Longest to wait for replies still in flight at the end of a run (milliseconds).
+#define DRAIN_TIMEOUT_MS 2000
+
+// Pause before sending again after being turned away (microseconds).
+#define BUSY_BACKOFF_US 1000
+
+
+/******************************************************************************
+ *                              Functions
+ ******************************************************************************/
+/**
+ * @param sorted Values, smallest first.
+ * @param share Share of the values at or below the percentile (0 to 1).
+ * @return The percentile (0 if there are no values).
+ */
+static double percentile(const vector<double>& sorted, double share) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    unsigned int i = (unsigned int) ceil(share * sorted.size());
+    return sorted[std::min(std::max(i, 1u), (unsigned int) sorted.size()) - 1];
+}
+
+
+/******************************************************************************
+ *                              Private Methods
+ ******************************************************************************/
+/**
+ * Entry point of a client thread. Keeps the generator's depth of requests in
+ * flight until the run ends, then waits for the last replies.
+ *
+ * @param client The client's Client.
+ * @return NULL.
+ */
+void* LoadGenerator::runClient(void* client) {
+    Client* self = static_cast<Client*> (client);
+    const LoadGenerator& generator = *self->generator;
+
+    size_t slotSize = 0;
+    for (unsigned int i = 0; i < generator.frames.size(); i++) {
+        slotSize = std::max(slotSize, generator.frames[i].total() * generator.frames[i].elemSize());
+    }
+
+    RecognitionClient connection;
+    if (!connection.connect(generator.socketPath, generator.depth, slotSize)) {
+        self->failed = true;
+        return NULL;
+    }
+
+    map<uint64_t, double> submitted; //When each request in flight was sent.
+    unsigned int next = 0;
+    double end = FrameTrace::now() + generator.seconds;
+    while (connection.isConnected()) {
+        double now = FrameTrace::now();
+        bool running = (now < end);
+        if (!running && submitted.empty()) {
+            break;
+        }
+
+        uint64_t id;
+        while (running && connection.getNumOfInFlight() < generator.depth &&
+                connection.submit(generator.frames[next], id)) {
+            submitted[id] = FrameTrace::now();
+            next = (next + 1) % generator.frames.size();
+        }
+
+        int timeoutMs = running ? std::max((int) ((end - now) * 1000), 1) : DRAIN_TIMEOUT_MS;
+        RecognitionReply reply;
+        if (!connection.receive(reply, timeoutMs)) {
+            if (!running) {
+                break; //Replies still in flight never came.
+            }
+            continue;
+        }
+        if (reply.type != RECOGNITION_REPLY) {
+            continue;
+        }
+
+        map<uint64_t, double>::iterator sent = submitted.find(reply.id);
+        if (sent == submitted.end()) {
+            continue;
+        }
+        if (reply.status == RECOGNITION_OK) {
+            self->latencies.push_back(FrameTrace::now() - sent->second);
+            self->totalQueued += reply.queued / 1e9;
+            self->totalBatchSize += reply.batchSize;
+        } else {
+            self->numOfRejected++;
+            usleep(BUSY_BACKOFF_US);
+        }
+        submitted.erase(sent);
+    }
+
+    self->failed = !connection.isConnected();
+    return NULL;
+}
+
+
+/******************************************************************************
+ *                              Public Methods
+ ******************************************************************************/
+/**
+ * Constructor.
+ *
+ * @param socketPath Socket the server listens on.
+ * @param numOfClients Clients connected at once.
+ * @param depth Requests each client keeps in flight.
+ * @param seconds Length of a run.
+ */
+LoadGenerator::LoadGenerator(const string& socketPath, int numOfClients, int depth, double seconds)
+: socketPath(socketPath), numOfClients(std::max(numOfClients, 1)),
+depth(std::max(std::min(depth, RECOGNITION_MAX_SLOTS), 1)), seconds(seconds) {
+}
+
+/**
+ * Add a frame to send.
+ *
+ * @param frame The frame (8 bit, 1 or 3 channels).
+ */
+void LoadGenerator::addFrame(const cv::Mat& frame) {
+    frames.push_back(frame);
+}
+
+/**
+ * Add a synthetic frame to send (blurred noise, which SURF finds plenty of
+ * features in), for when there are no recorded ones.
+ *
+ * @param seed Seed of the frame's noise.
+ */
+void LoadGenerator::addSyntheticFrame(int seed) {
+    cv::RNG rng(seed);
+    cv::Mat noise(480, 640, CV_8UC3);
+    rng.fill(noise, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(256));
+    cv::Mat frame;
+    cv::GaussianBlur(noise, frame, cv::Size(0, 0), 2.0);
+    frames.push_back(frame);
+}
+
+/**
+ * Load the server for the run's length. Uses a synthetic frame if none
+ * were added.
+ *
+ * @return What the run achieved.
+ */
+LoadGenerator::Result LoadGenerator::run() {
+    if (frames.empty()) {
+        addSyntheticFrame(0);
+    }
+
+    vector<Client> clients(numOfClients);
+    vector<pthread_t> threads(numOfClients);
+    vector<bool> started(numOfClients, false);
+    double start = FrameTrace::now();
+    for (int i = 0; i < numOfClients; i++) {
+        clients[i].generator = this;
+        clients[i].numOfRejected = 0;
+        clients[i].totalQueued = 0;
+        clients[i].totalBatchSize = 0;
+        clients[i].failed = false;
+        started[i] = (pthread_create(&threads[i], NULL, &LoadGenerator::runClient, &clients[i]) == 0);
+    }
+
+    Result result;
+    vector<double> latencies;
+    double totalQueued = 0, totalBatchSize = 0;
+    for (int i = 0; i < numOfClients; i++) {
+        if (!started[i]) {
+            result.numOfFailed++;
+            continue;
+        }
+        pthread_join(threads[i], NULL);
+
+        latencies.insert(latencies.end(), clients[i].latencies.begin(), clients[i].latencies.end());
+        result.numOfRejected += clients[i].numOfRejected;
+        result.numOfFailed += clients[i].failed ? 1 : 0;
+        totalQueued += clients[i].totalQueued;
+        totalBatchSize += clients[i].totalBatchSize;
+    }
+    result.seconds = FrameTrace::now() - start;
+
+    sort(latencies.begin(), latencies.end());
+    result.numOfReplies = latencies.size();
+    if (!latencies.empty()) {
+        double totalLatency = 0;
+        for (unsigned int i = 0; i < latencies.size(); i++) {
+            totalLatency += latencies[i];
+        }
+        result.throughput = latencies.size() / result.seconds;
+        result.meanLatency = totalLatency / latencies.size();
+        result.p50Latency = percentile(latencies, 0.50);
+        result.p95Latency = percentile(latencies, 0.95);
+        result.p99Latency = percentile(latencies, 0.99);
+        result.maxLatency = latencies.back();
+        result.meanQueued = totalQueued / latencies.size();
+        result.meanBatchSize = totalBatchSize / latencies.size();
+    }
+    return result;
+}
+
+/**
+ * Write a result (times in milliseconds).
+ *
+ * @param result The result.
+ * @param out Stream to write to.
+ */
+void LoadGenerator::report(const Result& result, ostream& out) {
+    out << result.numOfReplies << " replies in " << result.seconds << " s ("
+            << result.throughput << " per second), " << result.numOfRejected << " rejected, "
+            << result.numOfFailed << " clients failed" << endl;
+    out << "Latency " << result.meanLatency * 1000 << " mean / " << result.p50Latency * 1000
+            << " p50 / " << result.p95Latency * 1000 << " p95 / " << result.p99Latency * 1000
+            << " p99 / " << result.maxLatency * 1000 << " max ms, queued "
+            << result.meanQueued * 1000 << " ms, batches of " << result.meanBatchSize << endl;
+}
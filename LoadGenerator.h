@@ -0,0 +1,118 @@
+/**
+ * @file LoadGenerator.h
+ * @author Aydin Arik
+ * @brief Loads a RecognitionServer with several clients at once, each keeping
+ *        a number of requests in flight, to measure throughput, latency and
+ *        how well requests are batched. Each client runs on a thread of its
+ *        own and sends the same frames round and round.
+ */
+
+#ifndef LOADGENERATOR_H
+#define	LOADGENERATOR_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <string>
+#include <vector>
+#include <ostream>
+#include <opencv2/core/core.hpp>
+#include "RecognitionProtocol.h"
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+class LoadGenerator {
+public:
+
+    /**
+     * What a run achieved. Times are in seconds.
+     */
+    struct Result {
+        long numOfReplies; //Requests recognised.
+        long numOfRejected; //Requests turned away (busy or bad).
+        long numOfFailed; //Clients that couldn't connect or lost the server.
+        double seconds; //Length of the run.
+        double throughput; //Requests recognised per second.
+        double meanLatency, p50Latency, p95Latency, p99Latency, maxLatency; //Submitted to replied.
+        double meanQueued; //Arrived at the server to its batch starting.
+        double meanBatchSize;
+
+        Result() : numOfReplies(0), numOfRejected(0), numOfFailed(0), seconds(0),
+        throughput(0), meanLatency(0), p50Latency(0), p95Latency(0), p99Latency(0),
+        maxLatency(0), meanQueued(0), meanBatchSize(0) {
+        }
+    };
+
+private:
+
+    /**
+     * What one client thread did.
+     */
+    struct Client {
+        const LoadGenerator* generator;
+        std::vector<double> latencies; //Of each reply.
+        long numOfRejected;
+        double totalQueued;
+        double totalBatchSize;
+        bool failed;
+    };
+
+    std::string socketPath;
+    std::vector<cv::Mat> frames; //Sent in turn.
+    int numOfClients;
+    int depth; //Requests each client keeps in flight.
+    double seconds; //Length of a run.
+
+    /**
+     * Entry point of a client thread.
+     *
+     * @param client The client's Client.
+     * @return NULL.
+     */
+    static void* runClient(void* client);
+
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param socketPath Socket the server listens on.
+     * @param numOfClients Clients connected at once.
+     * @param depth Requests each client keeps in flight.
+     * @param seconds Length of a run.
+     */
+    LoadGenerator(const std::string& socketPath = RECOGNITION_SOCKET, int numOfClients = 4,
+            int depth = 2, double seconds = 10);
+
+    /**
+     * Add a frame to send.
+     *
+     * @param frame The frame (8 bit, 1 or 3 channels).
+     */
+    void addFrame(const cv::Mat& frame);
+
+    /**
+     * Add a synthetic frame to send, for when there are no recorded ones.
+     *
+     * @param seed Seed of the frame's noise.
+     */
+    void addSyntheticFrame(int seed);
+
+    /**
+     * Load the server for the run's length.
+     *
+     * @return What the run achieved.
+     */
+    Result run();
+
+    /**
+     * Write a result.
+     *
+     * @param result The result.
+     * @param out Stream to write to.
+     */
+    static void report(const Result& result, std::ostream& out);
+};
+
+#endif	/* LOADGENERATOR_H */
@@ -11,19 +11,395 @@
 #include <vector>
 #include <opencv2/core/core.hpp>
 #include "KinectCamera.h"
+#include "ReplayCamera.h"
+#include "CaptureWriter.h"
 #include <cstring>
 #include "ObjectRecognition.h"
+#include "RecognitionStream.h"
+#include "OverlayRenderer.h"
+#include "Recorder.h"
+#include "ResultPublisher.h"
+#include "LatencyTracker.h"
+#include "RecognitionConfig.h"
+#include "ParameterTuner.h"
+#include "TaskExecutor.h"
+#include "RecognitionServer.h"
+#include "LoadGenerator.h"
+#include "ShardCoordinator.h"
+#include "ShardWorker.h"
 #include <highgui/highgui.hpp>
+#include <cstdlib>
+#include <algorithm>
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+#include "boost/filesystem/operations.hpp"
+#include "boost/filesystem/path.hpp"
+#include <iostream>
+#include <signal.h>
 
 using namespace std;
+namespace fs = boost::filesystem;
 
 /**
+ * Recognise objects in every image in a directory (e.g. an archive), a batch
+ * at a time, and print what was found in each.
+ * 
+ * @param directory Directory of images.
+ * @param batchSize Number of images per batch.
+ * @param config Recognition settings.
+ * @return 0 on success, 1 if the directory can't be read.
+ */
+static int runArchive(const string& directory, unsigned int batchSize,
+        const RecognitionConfig& config) {
+    if (!fs::is_directory(fs::path(directory))) {
+        std::cout << "Not a directory: " << directory << std::endl;
+        return 1;
+    }
+
+    vector<string> files;
+    for (fs::directory_iterator it((fs::path(directory))), end; it != end; ++it) {
+        if (fs::is_regular_file(it->status())) {
+            files.push_back(it->path().string());
+        }
+    }
+    sort(files.begin(), files.end());
+
+    ObjectLibrary library(0, true, false, config);
+    ObjectRecognition recognition(library);
+    for (unsigned int first = 0; first < files.size(); first += batchSize) {
+        unsigned int last = std::min(first + batchSize, (unsigned int) files.size());
+        vector<cv::Mat> frames;
+        for (unsigned int i = first; i < last; i++) {
+            frames.push_back(cv::imread(files[i])); //Empty if not an image.
+        }
+
+        vector<vector<Detection> > detections;
+        recognition.runBatch(frames, detections);
+
+        for (unsigned int i = 0; i < detections.size(); i++) {
+            std::cout << files[first + i] << ":";
+            for (unsigned int d = 0; d < detections[i].size(); d++) {
+                std::cout << " " << detections[i][d].objectName << " (" << detections[i][d].score << ")";
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    vector<TaskExecutor::WorkerStats> stats;
+    TaskExecutor::getDefault().getStats(stats);
+    for (unsigned int i = 0; i < stats.size(); i++) {
+        std::cout << "Worker " << i << ": " << stats[i].tasksRun << " tasks ("
+                << stats[i].tasksStolen << " stolen), " << 100 * stats[i].utilisation << "% busy" << std::endl;
+    }
+
+    return 0;
+}
+
+/**
+ * Search recognition settings on a labelled set of frames (see ParameterTuner),
+ * print the Pareto frontier of speed against precision and recall, and save
+ * the chosen settings.
+ * 
+ * @param labelsFile Labels of the frames.
+ * @param configFile File to save the chosen settings to.
+ * @param config Settings that aren't searched.
+ * @return 0 on success, 1 if there are no frames or nothing could be saved.
+ */
+static int runTuner(const string& labelsFile, const string& configFile,
+        const RecognitionConfig& config) {
+    ParameterTuner tuner(config);
+    if (tuner.loadLabels(labelsFile) == 0) {
+        std::cout << "No labelled frames in " << labelsFile << std::endl;
+        return 1;
+    }
+
+    vector<ParameterTuner::Trial> trials;
+    tuner.run(trials);
+    ParameterTuner::writeReport(configFile + ".csv", trials);
+
+    std::cout << "Pareto frontier (fps, precision, recall):" << std::endl;
+    for (unsigned int i = 0; i < trials.size(); i++) {
+        if (trials[i].pareto) {
+            std::cout << "  " << trials[i].fps << ", " << trials[i].precision << ", "
+                    << trials[i].recall << ": " << trials[i].config << std::endl;
+        }
+    }
+
+    int chosen = ParameterTuner::choose(trials, 15.0); //At least 15hz if possible.
+    if (chosen < 0 || !trials[chosen].config.save(configFile)) {
+        return 1;
+    }
+    std::cout << "Saved " << configFile << ": " << trials[chosen].config << std::endl;
+    return 0;
+}
+
+/**
+ * Load the library once and recognise objects in frames sent by local
+ * clients (see RecognitionServer) until interrupted, printing what the
+ * server has done every so often. Options (after --serve): --socket PATH to
+ * listen on PATH, --max-batch N for the most requests per batch (default 8)
+ * and --batch-window MS for how long a batch waits for more requests
+ * (default 5).
+ * 
+ * @param argc
+ * @param argv
+ * @param config Recognition settings.
+ * @return 0 on success, 1 if the server couldn't start.
+ */
+static int runServer(int argc, char** argv, const RecognitionConfig& config) {
+    string socketPath(RECOGNITION_SOCKET);
+    int maxBatch = 8;
+    int batchWindowMs = 5;
+    for (int i = 2; i + 1 < argc; i++) {
+        string option(argv[i]);
+        if (option == "--socket") {
+            socketPath = argv[++i];
+        } else if (option == "--max-batch") {
+            maxBatch = std::max(atoi(argv[++i]), 1);
+        } else if (option == "--batch-window") {
+            batchWindowMs = std::max(atoi(argv[++i]), 0);
+        }
+    }
+
+    //Signals are taken here rather than by whichever thread they land on, so
+    //blocked before any thread starts.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    ObjectLibrary library(0, true, false, config);
+    RecognitionServer server(library, socketPath, maxBatch, batchWindowMs);
+    if (!server.start()) {
+        return 1;
+    }
+    std::cout << "Serving on " << socketPath << std::endl;
+
+    long lastRequests = 0;
+    timespec interval;
+    interval.tv_sec = 10;
+    interval.tv_nsec = 0;
+    while (sigtimedwait(&signals, NULL, &interval) < 0) {
+        RecognitionServer::Stats stats = server.getStats();
+        if (stats.numOfRequests != lastRequests) {
+            std::cout << stats.numOfClients << " clients, " << stats.numOfRequests << " requests ("
+                    << stats.numOfRejected << " rejected) in batches of " << stats.meanBatchSize
+                    << ", queued " << stats.meanQueued * 1000 << " ms, "
+                    << stats.meanRecognised * 1000 << " ms per batch" << std::endl;
+            lastRequests = stats.numOfRequests;
+        }
+    }
+
+    server.stop();
+    return 0;
+}
+
+/**
+ * Load a running server with several clients at once (see LoadGenerator) and
+ * print the throughput and latency achieved. Options (after --load):
+ * --socket PATH of the server, --clients N (default 4), --depth N requests
+ * in flight per client (default 2), --seconds S (default 10) and --image FILE
+ * (repeatable) for frames to send rather than a synthetic one.
  * 
  * @param argc
  * @param argv
+ * @return 0 on success, 1 if any client failed.
+ */
+static int runLoad(int argc, char** argv) {
+    string socketPath(RECOGNITION_SOCKET);
+    int numOfClients = 4;
+    int depth = 2;
+    double seconds = 10;
+    vector<string> images;
+    for (int i = 2; i + 1 < argc; i++) {
+        string option(argv[i]);
+        if (option == "--socket") {
+            socketPath = argv[++i];
+        } else if (option == "--clients") {
+            numOfClients = atoi(argv[++i]);
+        } else if (option == "--depth") {
+            depth = atoi(argv[++i]);
+        } else if (option == "--seconds") {
+            seconds = atof(argv[++i]);
+        } else if (option == "--image") {
+            images.push_back(argv[++i]);
+        }
+    }
+
+    LoadGenerator generator(socketPath, numOfClients, depth, seconds);
+    for (unsigned int i = 0; i < images.size(); i++) {
+        cv::Mat image = cv::imread(images[i]);
+        if (!image.data) {
+            std::cout << "Not an image: " << images[i] << std::endl;
+            return 1;
+        }
+        generator.addFrame(image);
+    }
+
+    LoadGenerator::Result result = generator.run();
+    LoadGenerator::report(result, std::cout);
+    return result.numOfFailed > 0 ? 1 : 0;
+}
+
+/**
+ * Recognise objects in every image in a directory with the library split
+ * into shards, each served by a worker process (see ShardCoordinator), and
+ * print what was found in each and what each shard did. The library
+ * directory is checked for changes (and the shards rebalanced) between images.
+ * 
+ * @param numOfShards Number of workers.
+ * @param directory Directory of images.
+ * @param config Recognition settings.
+ * @param configFile Settings file passed to the workers.
+ * @return 0 on success, 1 if the directory can't be read or no worker started.
+ */
+static int runSharded(int numOfShards, const string& directory,
+        const RecognitionConfig& config, const string& configFile) {
+    if (!fs::is_directory(fs::path(directory))) {
+        std::cout << "Not a directory: " << directory << std::endl;
+        return 1;
+    }
+
+    vector<string> files;
+    for (fs::directory_iterator it((fs::path(directory))), end; it != end; ++it) {
+        if (fs::is_regular_file(it->status())) {
+            files.push_back(it->path().string());
+        }
+    }
+    sort(files.begin(), files.end());
+
+    ShardCoordinator coordinator(numOfShards, config, configFile);
+    if (!coordinator.start()) {
+        return 1;
+    }
+    coordinator.waitUntilLoaded();
+    coordinator.report(std::cout);
+
+    for (unsigned int i = 0; i < files.size(); i++) {
+        cv::Mat frame = cv::imread(files[i]);
+        if (!frame.data) {
+            continue;
+        }
+
+        vector<Detection> detections;
+        coordinator.recognise(frame, detections);
+        std::cout << files[i] << ":";
+        for (unsigned int d = 0; d < detections.size(); d++) {
+            std::cout << " " << detections[d].objectName << " (" << detections[d].score << ")";
+        }
+        std::cout << std::endl;
+
+        coordinator.update();
+    }
+
+    coordinator.report(std::cout);
+    return 0;
+}
+
+/**
+ * 
+ * @param argc
+ * @param argv Pass --train-vocabulary to build the libraries visual vocabulary
+ *        offline and exit. Pass --cameras N to recognise objects in N Kinects
+ *        at once (all sharing one library). Pass --record DIR to also record
+ *        annotated video of each camera into DIR (--record-raw DIR for raw
+ *        frames). Pass --publish NAME to publish results in the shared memory
+ *        ring NAME (--publish-frames NAME to publish frames too). Pass --batch DIR
+ *        to recognise objects in every image in DIR and exit. Pass --tune LABELS
+ *        [FILE] to search settings on labelled frames and save the best to FILE.
+ *        Pass --serve to recognise objects for local clients (see
+ *        runServer()), and --load to load a server (see runLoad()).
+ *        Pass --sharded N DIR to recognise objects in every image in DIR with
+ *        the library split over N worker processes (see runSharded()).
+ *        Pass --capture DIR to also capture raw RGB-D frames of each camera
+ *        into DIR, and --replay FILE to play a capture back instead of using
+ *        Kinects (--replay-fast FILE to play it unthrottled), quitting at
+ *        the end of the capture. Pass --target-fps F to hold each camera at
+ *        F frames per second by lowering recognition quality (see
+ *        QualityController). Press 'l' to print how old results are
+ *        (also printed on quitting).
+ *        Settings are loaded from ../../Images/recognition.yml, or --config FILE.
  * @return 
  */
 int main(int argc, char **argv) {
+    string configFile("../../Images/recognition.yml");
+    for (int i = 1; i + 1 < argc; i++) {
+        if (string(argv[i]) == "--config") {
+            configFile = argv[i + 1];
+        }
+    }
+    RecognitionConfig config; //Defaults if there is no file.
+    if (config.load(configFile)) {
+        std::cout << "Loaded " << configFile << ": " << config << std::endl;
+    }
+
+    if (argc > 1 && string(argv[1]) == "--train-vocabulary") {
+        ObjectLibrary library(0, true, false, config);
+        library.trainVocabulary(10, 4); //Up to 10^4 words.
+        return 0;
+    }
+
+    if (argc > 2 && string(argv[1]) == "--batch") {
+        return runArchive(argv[2], 32, config);
+    }
+
+    if (argc > 1 && string(argv[1]) == "--serve") {
+        return runServer(argc, argv, config);
+    }
+
+    if (argc > 1 && string(argv[1]) == "--load") {
+        return runLoad(argc, argv);
+    }
+
+    if (argc > 3 && string(argv[1]) == "--sharded") {
+        bool haveConfig = fs::exists(fs::path(configFile));
+        return runSharded(atoi(argv[2]), argv[3], config, haveConfig ? configFile : "");
+    }
+
+    if (argc > 2 && string(argv[1]) == "--shard-worker") { //Started by a ShardCoordinator.
+        ShardWorker worker(atoi(argv[2]), config);
+        return worker.run();
+    }
+
+    if (argc > 2 && string(argv[1]) == "--tune") {
+        bool haveOutput = (argc > 3 && argv[3][0] != '-');
+        return runTuner(argv[2], haveOutput ? argv[3] : configFile, config);
+    }
+
+    int numOfCameras = 1;
+    string recordDir; //Empty for no video.
+    bool recordAnnotated = true;
+    string publishName; //Empty to not publish.
+    bool publishFrames = false;
+    string captureDir; //Empty for no raw capture.
+    string replayFile; //Empty to use Kinects.
+    bool replayThrottled = true;
+    for (int i = 1; i + 1 < argc; i++) {
+        string option(argv[i]);
+        if (option == "--cameras") {
+            numOfCameras = std::max(atoi(argv[++i]), 1);
+        } else if (option == "--record" || option == "--record-raw") {
+            recordDir = argv[++i];
+            recordAnnotated = (option == "--record");
+        } else if (option == "--publish" || option == "--publish-frames") {
+            publishName = argv[++i];
+            publishFrames = (option == "--publish-frames");
+        } else if (option == "--capture") {
+            captureDir = argv[++i];
+        } else if (option == "--replay" || option == "--replay-fast") {
+            replayFile = argv[++i];
+            replayThrottled = (option == "--replay");
+        } else if (option == "--target-fps") {
+            config.targetFps = atof(argv[++i]);
+        } else if (option == "--config") {
+            i++; //Already loaded.
+        }
+    }
+    if (!replayFile.empty()) {
+        numOfCameras = 1; //A capture is of one camera.
+    }
+
     /* Snapshot related variables */
     string filename("../../Images/Snapshots/snapshot");
     string suffix(".png");
@@ -31,37 +407,139 @@ int main(int argc, char **argv) {
     char keyPressed = -1;
 
 
-    cv::Mat frame;
     bool stop(false);
 
     // Delay between each frame
     // corresponds to video frame rate
     int delay = 1000 / 30; //30hz
 
-    Freenect::Freenect freenect;
-    KinectCamera& device = freenect.createDevice< KinectCamera > (0);
+    //One library, shared read-only by every camera.
+    ObjectLibrary library(0, false, true, config);
 
-    device.startVideo();
+    vector<string> windowNames;
+    for (int i = 0; i < numOfCameras; i++) {
+        std::ostringstream windowName;
+        windowName << "Object Recognition";
+        if (numOfCameras > 1) {
+            windowName << " (camera " << i << ")";
+        }
+        windowNames.push_back(windowName.str());
+    }
 
-    ObjectRecognition recognition;
-    cv::Mat image;
-    // for all frames in video
-    while (!stop) {
-        device.getVideo(frame);
+    //Windows are only drawn by the renderer's thread, at the monitor rate.
+    OverlayRenderer renderer(windowNames, 60.0);
+
+    //How old results are, from the frame arriving to being published and shown.
+    LatencyTracker tracker;
+    renderer.setTracker(&tracker);
 
-        recognition.run(frame, image);
+    //Snapshots and video are written by a recorder thread per camera.
+    vector<boost::shared_ptr<Recorder> > recorders;
+    for (int i = 0; i < numOfCameras; i++) {
+        recorders.push_back(boost::shared_ptr<Recorder>(new Recorder()));
+        if (!recordDir.empty()) {
+            std::ostringstream videoName;
+            videoName << recordDir << "/camera" << i;
+            recorders.back()->setVideo(videoName.str(), recordAnnotated);
+        }
+        recorders.back()->start();
+    }
+
+    //Results shared with other local processes (e.g. a controller).
+    ResultPublisher publisher(publishName);
+    bool publishing = false;
+    if (!publishName.empty()) {
+        publishing = publisher.open(64, publishFrames ? 640 * 480 * 3 : 0);
+    }
 
-        keyPressed = cv::waitKey(delay);
+    boost::scoped_ptr<Freenect::Freenect> freenect; //Only created for Kinects, so replays run without libfreenect.
+    vector<FrameSource*> devices;
+    boost::shared_ptr<ReplayCamera> replay;
+    vector<boost::shared_ptr<CaptureWriter> > captures;
+    vector<boost::shared_ptr<RecognitionStream> > streams;
+    vector<vector<int> > cpus;
+    RecognitionStream::allocateCpus(numOfCameras, cpus);
+    for (int i = 0; i < numOfCameras; i++) {
+        FrameSource* device;
+        if (!replayFile.empty()) {
+            replay.reset(new ReplayCamera(replayFile, replayThrottled));
+            if (!replay->open()) {
+                return 1;
+            }
+            device = replay.get();
+        } else {
+            if (!freenect) {
+                freenect.reset(new Freenect::Freenect());
+            }
+            KinectCamera& kinect = freenect->createDevice< KinectCamera > (i);
+            if (!captureDir.empty()) {
+                std::ostringstream captureFile;
+                captureFile << captureDir << "/camera" << i << ".rgbd";
+                captures.push_back(boost::shared_ptr<CaptureWriter>(new CaptureWriter()));
+                if (captures.back()->open(captureFile.str())) {
+                    kinect.setCapture(captures.back().get());
+                }
+            }
+            device = &kinect;
+        }
+        device->startStream();
+        devices.push_back(device);
+
+        streams.push_back(boost::shared_ptr<RecognitionStream>(
+                new RecognitionStream(*device, library, renderer, i, cpus[i])));
+        streams.back()->setRecorder(recorders[i].get());
+        if (publishing) {
+            streams.back()->setPublisher(&publisher);
+        }
+        streams.back()->setTracker(&tracker);
+        streams.back()->start();
+    }
+    renderer.start();
+
+    //Recognition runs on the stream threads and drawing on the renderer's.
+    while (!stop) {
+        keyPressed = renderer.waitKey(delay);
         if (keyPressed == 'q') {//any key
             stop = true;
+        } else if (replay && replay->isFinished()) {
+            stop = true; //Every frame of the capture has been played.
         } else if (keyPressed == 's') {
-            std::ostringstream file;
-            file << filename << snapCount << suffix;
-            cv::imwrite(file.str(), image);
+            for (unsigned int i = 0; i < streams.size(); i++) {
+                RecognitionResultPtr result = renderer.getResult(i);
+                if (!result) {
+                    continue;
+                }
+
+                std::ostringstream file;
+                file << filename << snapCount;
+                if (streams.size() > 1) {
+                    file << "_" << i;
+                }
+                file << suffix;
+                if (!recorders[i]->snapshot(file.str(), result)) {
+                    std::cout << "Snapshot dropped: " << file.str() << std::endl;
+                }
+            }
             snapCount++;
+        } else if (keyPressed == 'l') {
+            tracker.report(std::cout);
         }
     }
 
-    device.stopVideo();
+    for (unsigned int i = 0; i < streams.size(); i++) {
+        streams[i]->stop();
+    }
+    renderer.stop();
+    tracker.report(std::cout);
+    for (unsigned int i = 0; i < devices.size(); i++) {
+        recorders[i]->stop(); //Finishes writing what is queued.
+        devices[i]->stopStream();
+    }
+    for (unsigned int i = 0; i < captures.size(); i++) {
+        captures[i]->close(); //Finishes the capture, so it can be replayed.
+        if (captures[i]->getNumOfDropped() > 0) {
+            std::cout << "Capture " << i << " dropped " << captures[i]->getNumOfDropped() << " frames" << std::endl;
+        }
+    }
     return 0;
 }
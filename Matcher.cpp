@@ -27,7 +27,20 @@
 #include "Matcher.h"
 #include <opencv2/features2d/features2d.hpp>
 #include <calib3d/calib3d.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
 #include <iostream>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <map>
+
+// Fewest matches a view needs before RANSAC is worth trying (8-point F matrix).
+#define MIN_VIEW_VOTES 8
+
+// Pose bins (Lowe, 2004): 30 degrees of rotation, a factor of 2 in scale, and
+// a quarter of the (scaled) object size in location.
+#define POSE_ANGLE_BIN 30.0f
+#define POSE_LOCATION_BIN 0.25f
 
 using namespace std;
 
@@ -111,32 +124,111 @@ void Matcher::symmetryTest(const std::vector<std::vector<cv::DMatch> >& objectIm
 }
 
 
+/**
+ * Keep the largest set of matches that agree on the object's pose. Each
+ * match of SURF keypoints implies a rotation (difference in orientation),
+ * a scale (ratio of sizes) and a location of the object's centre in the 
+ * frame. Each match votes for the two nearest bins of each of these four,
+ * and the matches of the bin with the most votes are kept. Matches to a
+ * second instance of the object, or to clutter, fall in other bins, so
+ * RANSAC sees far fewer outliers.
+ * 
+ * @param matches Matches between the view (query) and frame (train).
+ * @param object The view.
+ * @param frameKeypoints
+ * @param outMatches Matches in the largest pose cluster.
+ */
+void Matcher::poseTest(const std::vector<cv::DMatch>& matches,
+        const ObjectView& object,
+        const std::vector<cv::KeyPoint>& frameKeypoints,
+        std::vector<cv::DMatch>& outMatches) {
+
+    // Centre and size of the view, from its keypoints
+    int numOfKeypoints = object.getNumOfKeypoints();
+    if (numOfKeypoints == 0 || matches.empty()) {
+        return;
+    }
+    cv::Point2f low = object.getPoint(0), high = object.getPoint(0);
+    for (int i = 1; i < numOfKeypoints; i++) {
+        cv::Point2f p = object.getPoint(i);
+        low = cv::Point2f(std::min(low.x, p.x), std::min(low.y, p.y));
+        high = cv::Point2f(std::max(high.x, p.x), std::max(high.y, p.y));
+    }
+    cv::Point2f centre = (low + high) * 0.5f;
+    float objectSize = std::max(std::max(high.x - low.x, high.y - low.y), 1.0f);
+
+    // Vote
+    const int numOfAngleBins = (int) (360 / POSE_ANGLE_BIN);
+    std::map<int64, std::vector<int> > bins;
+    for (unsigned int m = 0; m < matches.size(); m++) {
+        const cv::KeyPoint& frameKeypoint = frameKeypoints[matches[m].trainIdx];
+        int q = matches[m].queryIdx;
+        float objectAngle = std::max(object.getAngle(q), 0.0f); // -1 if not oriented
+        float frameAngle = std::max(frameKeypoint.angle, 0.0f);
+
+        float scale = frameKeypoint.size / std::max(object.getSize(q), 1e-3f);
+        float rotation = frameAngle - objectAngle;
+        float c = std::cos(rotation * (float) CV_PI / 180), s = std::sin(rotation * (float) CV_PI / 180);
+        cv::Point2f d = centre - object.getPoint(q);
+        cv::Point2f location = frameKeypoint.pt + cv::Point2f(c * d.x - s * d.y, s * d.x + c * d.y) * scale;
+
+        float angleBin = rotation / POSE_ANGLE_BIN - 0.5f;
+        float scaleBin = std::log(std::max(scale, 1e-3f)) / std::log(2.0f) - 0.5f;
+        int a0 = (int) std::floor(angleBin), s0 = (int) std::floor(scaleBin);
+        for (int sb = s0; sb <= s0 + 1; sb++) {
+            float locationBin = POSE_LOCATION_BIN * objectSize * std::pow(2.0f, (float) sb);
+            int x0 = (int) std::floor(location.x / locationBin - 0.5f);
+            int y0 = (int) std::floor(location.y / locationBin - 0.5f);
+            for (int ab = a0; ab <= a0 + 1; ab++)
+                for (int xb = x0; xb <= x0 + 1; xb++)
+                    for (int yb = y0; yb <= y0 + 1; yb++) {
+                        int wrapped = ((ab % numOfAngleBins) + numOfAngleBins) % numOfAngleBins;
+                        int64 key = ((((int64) wrapped * 256 + (sb + 128)) * 65536
+                                + (xb + 32768)) * 65536) + (yb + 32768);
+                        bins[key].push_back(m);
+                    }
+        }
+    }
+
+    // Keep the largest cluster
+    std::map<int64, std::vector<int> >::const_iterator best = bins.begin();
+    for (std::map<int64, std::vector<int> >::const_iterator it = bins.begin();
+            it != bins.end(); ++it) {
+        if (it->second.size() > best->second.size()) {
+            best = it;
+        }
+    }
+    for (unsigned int i = 0; i < best->second.size(); i++) {
+        outMatches.push_back(matches[best->second[i]]);
+    }
+}
+
 /**
  * Identify good matches using RANSAC
  * 
  * @param matches
- * @param objectImgKeypoints
+ * @param object
  * @param frameKeypoints
  * @param outMatches
  * @return 
  */
 cv::Mat Matcher::ransacTest(const std::vector<cv::DMatch>& matches,
-        const std::vector<cv::KeyPoint>& objectImgKeypoints,
+        const ObjectView& object,
         const std::vector<cv::KeyPoint>& frameKeypoints,
         std::vector<cv::DMatch>& outMatches) {
 
     // Convert keypoints into Point2f	
     std::vector<cv::Point2f> points1, points2;
+    points1.reserve(matches.size());
+    points2.reserve(matches.size());
     for (std::vector<cv::DMatch>::const_iterator it = matches.begin();
             it != matches.end(); ++it) {
 
         // Get the position of left keypoints
-        float x = objectImgKeypoints[it->queryIdx].pt.x;
-        float y = objectImgKeypoints[it->queryIdx].pt.y;
-        points1.push_back(cv::Point2f(x, y));
+        points1.push_back(object.getPoint(it->queryIdx));
         // Get the position of right keypoints
-        x = frameKeypoints[it->trainIdx].pt.x;
-        y = frameKeypoints[it->trainIdx].pt.y;
+        float x = frameKeypoints[it->trainIdx].pt.x;
+        float y = frameKeypoints[it->trainIdx].pt.y;
         points2.push_back(cv::Point2f(x, y));
     }
 
@@ -179,12 +271,10 @@ cv::Mat Matcher::ransacTest(const std::vector<cv::DMatch>& matches,
                 it != outMatches.end(); ++it) {
 
             // Get the position of left keypoints
-            float x = objectImgKeypoints[it->queryIdx].pt.x;
-            float y = objectImgKeypoints[it->queryIdx].pt.y;
-            points1.push_back(cv::Point2f(x, y));
+            points1.push_back(object.getPoint(it->queryIdx));
             // Get the position of right keypoints
-            x = frameKeypoints[it->trainIdx].pt.x;
-            y = frameKeypoints[it->trainIdx].pt.y;
+            float x = frameKeypoints[it->trainIdx].pt.x;
+            float y = frameKeypoints[it->trainIdx].pt.y;
             points2.push_back(cv::Point2f(x, y));
         }
 
@@ -207,7 +297,8 @@ cv::Mat Matcher::ransacTest(const std::vector<cv::DMatch>& matches,
 /******************************************************************************
  *                              Public Methods
  ******************************************************************************/
-Matcher::Matcher() : ratio(0.65f), refineF(true), confidence(0.99), distance(3.0) {
+Matcher::Matcher() : ratio(0.65f), refineF(true), confidence(0.99), distance(3.0),
+minMatchedShare(MIN_MATCHED_SHARE), clusterPoses(true), pyramidLevel(0) {
 
     // SURF is the default feature
     detector = new cv::SurfFeatureDetector();
@@ -250,35 +341,139 @@ void Matcher::refineFundamental(bool flag) {
     refineF = flag;
 }
 
+// Set the share of an object view's keypoints that must survive matching
+void Matcher::setMinMatchedShare(float share) {
+
+    minMatchedShare = share;
+}
+
+// Set the most frame keypoints kept, and how they are chosen
+void Matcher::setKeypointBudget(const KeypointBudget& budget) {
+
+    this->budget = budget;
+}
+
+// if you want matches clustered by pose before RANSAC
+void Matcher::setPoseClustering(bool flag) {
+
+    clusterPoses = flag;
+}
+
+// Set how many times frames are halved in size before finding features
+void Matcher::setPyramidLevel(int level) {
+
+    pyramidLevel = std::max(level, 0);
+}
+
 /**
  * Match feature points using symmetry test and RANSAC.
  * 
- * @param object
+ * @param model
  * @param frame
  * @param matches
  * @param frameKeypoints
+ * @param matchedView
  */
-void Matcher::match(Object object, cv::Mat& frame, // input images 
+void Matcher::match(const ModelView& model, cv::Mat& frame, // input images 
         std::vector<cv::DMatch>& matches, // output matches and keypoints
-        std::vector<cv::KeyPoint>& frameKeypoints) {
+        std::vector<cv::KeyPoint>& frameKeypoints,
+        ObjectView& matchedView) {
 
+    cv::Mat frameDescriptors;
+    detectFeatures(frame, frameKeypoints, frameDescriptors);
+    match(model, frameKeypoints, frameDescriptors, matches, matchedView);
+}
 
-    // 1a. Detection of the SURF features
-    detector->detect(frame, frameKeypoints);
-    std::vector<cv::KeyPoint> objectImgKeypoint = object.getKeypoints();
+/**
+ * Detect and describe the SURF features of a frame. Do this once per frame,
+ * then match each object against the result. Keypoints beyond the budget are
+ * dropped before extraction, so only the survivors are described. Above
+ * pyramid level 0, features are found in a smaller copy of the frame and
+ * scaled back up.
+ * 
+ * @param frame
+ * @param frameKeypoints
+ * @param frameDescriptors
+ */
+void Matcher::detectFeatures(cv::Mat& frame,
+        std::vector<cv::KeyPoint>& frameKeypoints,
+        cv::Mat& frameDescriptors) {
+
+    cv::Mat image = frame;
+    for (int level = 0; level < pyramidLevel; level++) {
+        cv::Mat smaller;
+        cv::pyrDown(image, smaller);
+        image = smaller;
+    }
 
+    // 1a. Detection of the SURF features
+    detector->detect(image, frameKeypoints);
 
-    std::cout << "Number of SURF points (1): " << objectImgKeypoint.size() << std::endl;
     std::cout << "Number of SURF points (2): " << frameKeypoints.size() << std::endl;
 
+    // Keep a bounded number, spread over the frame
+    budget.select(frameKeypoints, image.size());
+
     // 1b. Extraction of the SURF descriptors
-    cv::Mat frameDescriptors;
-    extractor->compute(frame, frameKeypoints, frameDescriptors);
-    
-    cv::Mat objectImgDesciptors = object.getDescriptors();
-    
+    extractor->compute(image, frameKeypoints, frameDescriptors);
+
+    // Back to the frame's coordinates
+    if (pyramidLevel > 0) {
+        float scale = (float) (1 << pyramidLevel);
+        for (unsigned int i = 0; i < frameKeypoints.size(); i++) {
+            frameKeypoints[i].pt.x *= scale;
+            frameKeypoints[i].pt.y *= scale;
+            frameKeypoints[i].size *= scale;
+        }
+    }
+}
+
+/**
+ * Match an object model against features already found in a frame, using 
+ * symmetry test and RANSAC. The frame is matched against the model's 
+ * representative descriptors, and each match is a vote for every view that
+ * shares the representative. The votes of each view are clustered by the
+ * pose they imply, and RANSAC is then only run on the largest cluster of
+ * views with enough votes, most votes first.
+ * 
+ * This is a cascade: no stage can add matches, so once fewer matches survive 
+ * than any view needs to be accepted, the model is abandoned without running 
+ * the later (more expensive) stages.
+ * 
+ * @param model
+ * @param frameKeypoints
+ * @param frameDescriptors
+ * @param matches Matches between matchedView (query) and the frame (train).
+ *        Empty unless the object was found.
+ * @param matchedView View with the most matches surviving RANSAC.
+ */
+void Matcher::match(const ModelView& model,
+        const std::vector<cv::KeyPoint>& frameKeypoints,
+        const cv::Mat& frameDescriptors,
+        std::vector<cv::DMatch>& matches,
+        ObjectView& matchedView) {
+
+    const cv::Mat& objectImgDesciptors = model.getDescriptors();
+
+    std::cout << "Number of views: " << model.getNumOfViews() << std::endl;
     std::cout << "descriptor matrix size: " << objectImgDesciptors.rows << " by " << objectImgDesciptors.cols << std::endl;
 
+    matches.clear();
+    matchedView = model.getView(0);
+
+    // 1. Matches each view needs to be accepted
+    std::vector<int> needed(model.getNumOfViews());
+    int fewestNeeded = INT_MAX;
+    for (unsigned int v = 0; v < needed.size(); v++) {
+        int numOfKeypoints = model.getView(v).getNumOfKeypoints();
+        needed[v] = std::max(MIN_VIEW_VOTES, (int) std::ceil(minMatchedShare * numOfKeypoints));
+        fewestNeeded = std::min(fewestNeeded, needed[v]);
+    }
+
+    if (std::min(objectImgDesciptors.rows, frameDescriptors.rows) < fewestNeeded) {
+        return; // can't possibly be accepted
+    }
+
     // 2. Match the two image descriptors
 
     // Construction of the matcher 
@@ -291,6 +486,17 @@ void Matcher::match(Object object, cv::Mat& frame, // input images
             matches1, // vector of matches (up to 2 per entry) 
             2); // return 2 nearest neighbours
 
+    std::cout << "Number of matched points 1->2: " << matches1.size() << std::endl;
+
+    // 3. Remove matches for which NN ratio is > than threshold
+
+    // clean image 1 -> image 2 matches
+    int removed = ratioTest(matches1);
+    std::cout << "Number of matched points 1->2 (ratio test) : " << matches1.size() - removed << std::endl;
+    if ((int) matches1.size() - removed < fewestNeeded) {
+        return; // rejected before matching the other way
+    }
+
     // from image 2 to image 1
     // based on k nearest neighbours (with k=2)
     std::vector<std::vector<cv::DMatch> > matches2;
@@ -298,27 +504,73 @@ void Matcher::match(Object object, cv::Mat& frame, // input images
             matches2, // vector of matches (up to 2 per entry) 
             2); // return 2 nearest neighbours
 
-    std::cout << "Number of matched points 1->2: " << matches1.size() << std::endl;
     std::cout << "Number of matched points 2->1: " << matches2.size() << std::endl;
 
+    // clean image 2 -> image 1 matches
+    removed = ratioTest(matches2);
+    std::cout << "Number of matched points 1->2 (ratio test) : " << matches2.size() - removed << std::endl;
+    if ((int) matches2.size() - removed < fewestNeeded) {
+        return; // rejected before the symmetry test
+    }
 
-    if (matches2.size() > 0) {
-        // 3. Remove matches for which NN ratio is > than threshold
+    // 4. Remove non-symmetrical matches
+    std::vector<cv::DMatch> symMatches;
+    symmetryTest(matches1, matches2, symMatches);
 
-        // clean image 1 -> image 2 matches
-        int removed = ratioTest(matches1);
-        std::cout << "Number of matched points 1->2 (ratio test) : " << matches1.size() - removed << std::endl;
-        // clean image 2 -> image 1 matches
-        removed = ratioTest(matches2);
-        std::cout << "Number of matched points 1->2 (ratio test) : " << matches2.size() - removed << std::endl;
+    std::cout << "Number of matched points (symmetry test): " << symMatches.size() << std::endl;
+    if ((int) symMatches.size() < fewestNeeded) {
+        return; // rejected before RANSAC
+    }
 
-        // 4. Remove non-symmetrical matches
-        std::vector<cv::DMatch> symMatches;
-        symmetryTest(matches1, matches2, symMatches);
+    // 5. Spread each match over the views that share its representative
+    // (at most once per view, so a view never has more votes than symMatches)
+    std::vector<std::vector<cv::DMatch> > viewMatches(model.getNumOfViews());
+    for (std::vector<cv::DMatch>::const_iterator it = symMatches.begin();
+            it != symMatches.end(); ++it) {
 
-        std::cout << "Number of matched points (symmetry test): " << symMatches.size() << std::endl;
+        for (int j = model.getRefBegin(it->queryIdx); j < model.getRefEnd(it->queryIdx); j++) {
+            std::vector<cv::DMatch>& spread = viewMatches[model.getRefView(j)];
+            if (!spread.empty() && spread.back().trainIdx == it->trainIdx) {
+                continue;
+            }
+            spread.push_back(cv::DMatch(model.getRefKeypoint(j), it->trainIdx, it->distance));
+        }
+    }
 
-        // 5. Validate matches using RANSAC
-        cv::Mat fundemental = ransacTest(symMatches, objectImgKeypoint, frameKeypoints, matches); //TODO: reuse this?
+    // 6. Keep the matches of each view that agree on a pose
+    std::vector<std::pair<int, int> > votes; // (votes, view), most first
+    for (unsigned int v = 0; v < viewMatches.size(); v++) {
+        if ((int) viewMatches[v].size() < needed[v]) {
+            continue;
+        }
+
+        if (clusterPoses) {
+            std::vector<cv::DMatch> cluster;
+            poseTest(viewMatches[v], model.getView(v), frameKeypoints, cluster);
+            std::cout << "Number of matched points (pose test): " << cluster.size() << std::endl;
+            if ((int) cluster.size() < needed[v]) {
+                continue; // rejected before RANSAC
+            }
+            viewMatches[v].swap(cluster);
+        }
+        votes.push_back(std::make_pair((int) viewMatches[v].size(), (int) v));
+    }
+    std::sort(votes.rbegin(), votes.rend());
+
+    // 7. Validate matches using RANSAC, view by view
+    for (unsigned int i = 0; i < votes.size(); i++) {
+        if (votes[i].first <= (int) matches.size()) {
+            break; // no remaining view can do better
+        }
+
+        int v = votes[i].second;
+        ObjectView view = model.getView(v);
+        std::vector<cv::DMatch> viewInliers;
+        cv::Mat fundemental = ransacTest(viewMatches[v], view, frameKeypoints, viewInliers); //TODO: reuse this?
+
+        if ((int) viewInliers.size() >= needed[v] && viewInliers.size() > matches.size()) {
+            matches.swap(viewInliers);
+            matchedView = view;
+        }
     }
 }
@@ -31,7 +31,9 @@
 #include <string>
 #include <vector>
 #include <opencv2/core/core.hpp>
-#include "Object.h"
+#include "LibraryStore.h"
+#include "Detection.h"
+#include "KeypointBudget.h"
 
 
 /******************************************************************************
@@ -39,6 +41,7 @@
  ******************************************************************************/
 class Matcher {
 private:
+    friend class MatcherBenchmark; // times the stages below on their own
 
     // pointer to the feature point detector object
     cv::Ptr<cv::FeatureDetector> detector;
@@ -48,6 +51,10 @@ private:
     bool refineF; // if true will refine the F matrix
     double distance; // min distance to epipolar
     double confidence; // confidence level (probability)
+    float minMatchedShare; // share of a view's keypoints that must match for acceptance
+    KeypointBudget budget; // most frame keypoints described and matched
+    bool clusterPoses; // if true, only the largest pose cluster of a view goes to RANSAC
+    int pyramidLevel; // times the frame is halved before finding its features
 
     
     int ratioTest(std::vector<std::vector<cv::DMatch> >& matches);
@@ -58,11 +65,18 @@ private:
             const std::vector<std::vector<cv::DMatch> >& matches2,
             std::vector<cv::DMatch> & symMatches);
 
+    // Keep the largest set of matches that agree on the object's pose
+
+    void poseTest(const std::vector<cv::DMatch>& matches,
+            const ObjectView& object,
+            const std::vector<cv::KeyPoint>& keypoints2,
+            std::vector<cv::DMatch>& outMatches);
+
     // Identify good matches using RANSAC
     // Return fundemental matrix
 
     cv::Mat ransacTest(const std::vector<cv::DMatch>& matches,
-            const std::vector<cv::KeyPoint>& keypoints1,
+            const ObjectView& object,
             const std::vector<cv::KeyPoint>& keypoints2,
             std::vector<cv::DMatch>& outMatches);
     
@@ -95,6 +109,21 @@ public:
 
     void refineFundamental(bool flag);
 
+    // Set the share of an object view's keypoints that must survive matching
+    // for the object to be accepted (objects are rejected as soon as they can't)
+
+    void setMinMatchedShare(float share);
+
+    // Set the most frame keypoints kept, and how they are chosen
+    void setKeypointBudget(const KeypointBudget& budget);
+
+    // if you want matches clustered by pose before RANSAC
+    void setPoseClustering(bool flag);
+
+    // Set how many times frames are halved in size before finding features
+    // (0 for full size). Keypoints are still given in full size coordinates.
+    void setPyramidLevel(int level);
+
     // Clear matches for which NN ratio is > than threshold
     // return the number of removed points 
     // (corresponding entries being cleared, i.e. size will be 0)
@@ -104,9 +133,27 @@ public:
     // Match feature points using symmetry test and RANSAC
     // returns fundemental matrix
 
-    void match(Object object, cv::Mat& image2, // input images 
+    void match(const ModelView& model, cv::Mat& image2, // input images 
             std::vector<cv::DMatch>& matches, // output matches and keypoints
-            std::vector<cv::KeyPoint>& keypoints2);
+            std::vector<cv::KeyPoint>& keypoints2,
+            ObjectView& matchedView);
+
+    // Detect and describe the SURF features of a frame
+    // (do this once per frame, then match each object against them)
+
+    void detectFeatures(cv::Mat& frame,
+            std::vector<cv::KeyPoint>& frameKeypoints,
+            cv::Mat& frameDescriptors);
+
+    // Match an object model against features already found in a frame
+    // (matches are to the keypoints of matchedView, the best view, and are
+    // empty unless the object is accepted)
+
+    void match(const ModelView& model,
+            const std::vector<cv::KeyPoint>& frameKeypoints,
+            const cv::Mat& frameDescriptors,
+            std::vector<cv::DMatch>& matches,
+            ObjectView& matchedView);
 
 };
 
@@ -0,0 +1,462 @@
+/**
+ * @file MatcherBenchmark.cpp
+ * @author Aydin Arik
+ * @brief Times each stage of matching on its own.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "MatcherBenchmark.h"
+#include "Object.h"
+#include "LibraryStore.h"
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <boost/shared_ptr.hpp>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <new>
+#include <time.h>
+
+using namespace std;
+
+// Hessian threshold low enough for thousands of keypoints per image.
+#define BENCHMARK_HESSIAN_THRESHOLD 50
+
+// Fewest and most calls timed per stage.
+#define MIN_OPS 3
+#define MAX_OPS 10000
+
+// Extra allocations per call allowed before a stage counts as regressed.
+#define ALLOCATION_TOLERANCE 0.5
+
+
+/******************************************************************************
+ *                              Functions
+ ******************************************************************************/
+static volatile long numOfAllocations = 0;
+
+//Every operator new in matcher_bench is counted, so stages can be compared by
+//how much they allocate. OpenCV's own buffers (cv::fastMalloc) aren't seen.
+//This file is only linked into matcher_bench, never into enel427_project.
+void* operator new(size_t size) throw (std::bad_alloc) {
+    __sync_fetch_and_add(&numOfAllocations, 1);
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) throw (std::bad_alloc) {
+    return operator new(size);
+}
+
+void operator delete(void* p) throw () {
+    free(p);
+}
+
+void operator delete[](void* p) throw () {
+    free(p);
+}
+
+/**
+ * Times the calls of one stage, and counts what they allocate.
+ */
+class StageTimer {
+private:
+    double minSeconds;
+    timespec started;
+    long allocationsAtStart;
+    int numOfOps;
+    double seconds;
+    long allocations;
+
+public:
+
+    StageTimer(double minSeconds)
+    : minSeconds(minSeconds), allocationsAtStart(0), numOfOps(0), seconds(0), allocations(0) {
+    }
+
+    void start() {
+        allocationsAtStart = numOfAllocations;
+        clock_gettime(CLOCK_MONOTONIC, &started);
+    }
+
+    void stop() {
+        timespec stopped;
+        clock_gettime(CLOCK_MONOTONIC, &stopped);
+        seconds += (stopped.tv_sec - started.tv_sec) + (stopped.tv_nsec - started.tv_nsec) / 1e9;
+        allocations += numOfAllocations - allocationsAtStart;
+        numOfOps++;
+    }
+
+    /**
+     * @return True once enough calls have been timed.
+     */
+    bool done() const {
+        return numOfOps >= MIN_OPS && (seconds >= minSeconds || numOfOps >= MAX_OPS);
+    }
+
+    /**
+     * @param stage Name of the stage.
+     * @param numOfKeypoints Keypoints per image.
+     * @return How the stage did.
+     */
+    MatcherBenchmark::Result result(const string& stage, int numOfKeypoints) const {
+        MatcherBenchmark::Result result;
+        result.stage = stage;
+        result.numOfKeypoints = numOfKeypoints;
+        result.nsPerOp = numOfOps ? 1e9 * seconds / numOfOps : 0;
+        result.keypointsPerSecond = (seconds > 0) ? numOfKeypoints * numOfOps / seconds : 0;
+        result.allocationsPerOp = numOfOps ? (double) allocations / numOfOps : 0;
+        return result;
+    }
+};
+
+/**
+ * Orders keypoint indices by response, strongest first.
+ */
+struct StrongerResponse {
+    const vector<float>& response;
+
+    StrongerResponse(const vector<float>& response) : response(response) {
+    }
+
+    bool operator()(int a, int b) const {
+        return response[a] > response[b];
+    }
+};
+
+/**
+ * Keep the strongest keypoints of an object.
+ *
+ * @param object An object with features.
+ * @param numOfKeypoints Most keypoints kept.
+ * @return A copy of the object with only its strongest keypoints.
+ */
+static ObjectPtr strongestKeypoints(const Object& object, int numOfKeypoints) {
+    const vector<float>& response = object.getKeypoints().response;
+    vector<int> indices(response.size());
+    for (unsigned int i = 0; i < indices.size(); i++) {
+        indices[i] = i;
+    }
+
+    unsigned int kept = std::min((unsigned int) numOfKeypoints, (unsigned int) indices.size());
+    std::partial_sort(indices.begin(), indices.begin() + kept, indices.end(), StrongerResponse(response));
+    indices.resize(kept);
+    std::sort(indices.begin(), indices.end()); //keepKeypoints() wants ascending order.
+
+    boost::shared_ptr<Object> strongest(new Object(object));
+    strongest->keepKeypoints(indices);
+    return strongest;
+}
+
+/**
+ * Make a textured object image (blurred noise, which SURF finds thousands of
+ * blobs in) and a frame that is the object rotated and scaled. Seeded, so
+ * every run sees the same images.
+ *
+ * @param object Object image.
+ * @param frame Frame image.
+ */
+static void makeSyntheticImages(cv::Mat& object, cv::Mat& frame) {
+    cv::RNG rng(0x0b1ec7);
+    cv::Mat noise(480, 640, CV_8UC1);
+    rng.fill(noise, cv::RNG::UNIFORM, cv::Scalar(0), cv::Scalar(256));
+    cv::GaussianBlur(noise, object, cv::Size(0, 0), 2.0);
+
+    cv::Mat transform = cv::getRotationMatrix2D(cv::Point2f(320, 240), 15, 0.9);
+    cv::warpAffine(object, frame, transform, object.size());
+}
+
+
+/******************************************************************************
+ *                              Private Methods
+ ******************************************************************************/
+/**
+ * Time every stage with the strongest keypoints of the object and frame. The
+ * inputs of each stage are the outputs of the one before, as in
+ * Matcher::match(), and are copied outside of the timed calls.
+ *
+ * @param numOfKeypoints Keypoints kept in each image.
+ * @param object The object with all of its features.
+ * @param frameKeypoints Every keypoint of the frame image.
+ * @param results Results are appended.
+ */
+void MatcherBenchmark::runSize(int numOfKeypoints, const Object& object,
+        const vector<cv::KeyPoint>& frameKeypoints, vector<Result>& results) {
+    ObjectPtr strongest = strongestKeypoints(object, numOfKeypoints);
+    ObjectView view(strongest);
+    const cv::Mat& objectDescriptors = strongest->getDescriptors();
+
+    vector<cv::KeyPoint> keypoints(frameKeypoints);
+    cv::KeyPointsFilter::retainBest(keypoints, numOfKeypoints);
+    if ((int) keypoints.size() > numOfKeypoints) {
+        keypoints.resize(numOfKeypoints); //Ties are all kept by retainBest().
+    }
+    int count = std::min((int) keypoints.size(), view.getNumOfKeypoints());
+
+    //SURF description of the frame.
+    cv::Mat frameDescriptors;
+    for (StageTimer timer(minSeconds); !timer.done();) {
+        vector<cv::KeyPoint> described(keypoints);
+        cv::Mat descriptors;
+        timer.start();
+        extractor->compute(frameImage, described, descriptors);
+        timer.stop();
+        if (timer.done()) {
+            results.push_back(timer.result("surf-describe", count));
+            keypoints.swap(described); //compute() may drop keypoints near the border.
+            frameDescriptors = descriptors;
+        }
+    }
+
+    //kNN matching (k = 2), both ways.
+    cv::BruteForceMatcher<cv::L2<float> > bruteForce;
+    vector<vector<cv::DMatch> > matches1, matches2;
+    for (StageTimer timer(minSeconds); !timer.done();) {
+        vector<vector<cv::DMatch> > knn;
+        timer.start();
+        bruteForce.knnMatch(objectDescriptors, frameDescriptors, knn, 2);
+        timer.stop();
+        if (timer.done()) {
+            results.push_back(timer.result("knn", count));
+            matches1.swap(knn);
+        }
+    }
+    bruteForce.knnMatch(frameDescriptors, objectDescriptors, matches2, 2);
+
+    //Ratio test.
+    for (StageTimer timer(minSeconds); !timer.done();) {
+        vector<vector<cv::DMatch> > cleaned(matches1);
+        timer.start();
+        matcher.ratioTest(cleaned);
+        timer.stop();
+        if (timer.done()) {
+            results.push_back(timer.result("ratio", count));
+        }
+    }
+    matcher.ratioTest(matches1);
+    matcher.ratioTest(matches2);
+
+    //Symmetry test.
+    vector<cv::DMatch> symMatches;
+    for (StageTimer timer(minSeconds); !timer.done();) {
+        vector<cv::DMatch> symmetrical;
+        timer.start();
+        matcher.symmetryTest(matches1, matches2, symmetrical);
+        timer.stop();
+        if (timer.done()) {
+            results.push_back(timer.result("symmetry", count));
+            symMatches.swap(symmetrical);
+        }
+    }
+
+    //Pose clustering.
+    for (StageTimer timer(minSeconds); !timer.done();) {
+        vector<cv::DMatch> cluster;
+        timer.start();
+        matcher.poseTest(symMatches, view, keypoints, cluster);
+        timer.stop();
+        if (timer.done()) {
+            results.push_back(timer.result("pose", count));
+        }
+    }
+
+    //RANSAC (which reports each call on cout, so that is silenced).
+    std::streambuf* console = cout.rdbuf(NULL);
+    for (StageTimer timer(minSeconds); !timer.done();) {
+        vector<cv::DMatch> inliers;
+        timer.start();
+        matcher.ransacTest(symMatches, view, keypoints, inliers);
+        timer.stop();
+        if (timer.done()) {
+            results.push_back(timer.result("ransac", count));
+        }
+    }
+    cout.rdbuf(console);
+    cout.clear();
+}
+
+
+/******************************************************************************
+ *                              Public Methods
+ ******************************************************************************/
+/**
+ * Constructor. Uses synthetic images until others are loaded.
+ *
+ * @param config Matcher settings (the Hessian threshold is lowered, so
+ *        there are enough keypoints for the largest counts).
+ * @param minSeconds Least time spent timing each stage.
+ */
+MatcherBenchmark::MatcherBenchmark(const RecognitionConfig& config, double minSeconds)
+: minSeconds(minSeconds) {
+    detector = new cv::SurfFeatureDetector(BENCHMARK_HESSIAN_THRESHOLD);
+    extractor = new cv::SurfDescriptorExtractor();
+
+    matcher.setConfidenceLevel(config.confidenceLevel);
+    matcher.setMinDistanceToEpipolar(config.minDistanceToEpipolar);
+    matcher.setRatio(config.ratio);
+
+    makeSyntheticImages(objectImage, frameImage);
+}
+
+/**
+ * Use recorded images rather than synthetic ones.
+ *
+ * @param objectFile Image of an object.
+ * @param frameFile Frame containing the object.
+ * @return True if both images were loaded.
+ */
+bool MatcherBenchmark::loadImages(const string& objectFile, const string& frameFile) {
+    cv::Mat object = cv::imread(objectFile);
+    cv::Mat frame = cv::imread(frameFile);
+    if (!object.data || !frame.data) {
+        cout << "Could not load " << objectFile << " and " << frameFile << endl;
+        return false;
+    }
+
+    objectImage = object;
+    frameImage = frame;
+    return true;
+}
+
+/**
+ * Time every stage at each keypoint count. Counts larger than the images
+ * have are run with every keypoint. SURF detection doesn't depend on the
+ * count, so it is timed once, with every keypoint found.
+ *
+ * @param sizes Keypoint counts.
+ * @param results How each stage did at each count.
+ */
+void MatcherBenchmark::run(const vector<int>& sizes, vector<Result>& results) {
+    results.clear();
+
+    Object object("benchmark", objectImage, detector, extractor);
+
+    vector<cv::KeyPoint> frameKeypoints;
+    for (StageTimer timer(minSeconds); !timer.done();) {
+        vector<cv::KeyPoint> detected;
+        timer.start();
+        detector->detect(frameImage, detected);
+        timer.stop();
+        if (timer.done()) {
+            results.push_back(timer.result("surf-detect", detected.size()));
+            frameKeypoints.swap(detected);
+        }
+    }
+
+    cout << "Object keypoints: " << object.getKeypoints().count()
+            << ", frame keypoints: " << frameKeypoints.size() << endl;
+    for (unsigned int i = 0; i < sizes.size(); i++) {
+        runSize(sizes[i], object, frameKeypoints, results);
+    }
+}
+
+/**
+ * Save results (CSV), e.g. as a baseline.
+ *
+ * @param filename File to write.
+ * @param results Results.
+ * @return True if the file was written.
+ */
+bool MatcherBenchmark::writeResults(const string& filename, const vector<Result>& results) {
+    ofstream out(filename.c_str());
+    if (!out) {
+        cout << "Could not write results: " << filename << endl;
+        return false;
+    }
+
+    out << "stage,keypoints,nsPerOp,keypointsPerSecond,allocationsPerOp" << endl;
+    for (unsigned int i = 0; i < results.size(); i++) {
+        const Result& result = results[i];
+        out << result.stage << "," << result.numOfKeypoints << "," << result.nsPerOp << ","
+                << result.keypointsPerSecond << "," << result.allocationsPerOp << endl;
+    }
+    return true;
+}
+
+/**
+ * Load results saved by writeResults().
+ *
+ * @param filename File to read.
+ * @param results Results.
+ * @return True if the file was read.
+ */
+bool MatcherBenchmark::readResults(const string& filename, vector<Result>& results) {
+    ifstream in(filename.c_str());
+    if (!in) {
+        cout << "Could not read results: " << filename << endl;
+        return false;
+    }
+
+    results.clear();
+    string line;
+    getline(in, line); //Header.
+    while (getline(in, line)) {
+        std::replace(line.begin(), line.end(), ',', ' ');
+        istringstream fields(line);
+        Result result;
+        if (fields >> result.stage >> result.numOfKeypoints >> result.nsPerOp
+                >> result.keypointsPerSecond >> result.allocationsPerOp) {
+            results.push_back(result);
+        }
+    }
+    return true;
+}
+
+/**
+ * Compare results with a baseline. A stage has regressed if it is slower
+ * than the baseline by more than the threshold, or allocates more.
+ *
+ * @param baseline Earlier results.
+ * @param results Current results.
+ * @param threshold Largest allowed slow down (e.g. 0.1 for 10%).
+ * @param report Comparison of each stage, with regressions flagged.
+ * @return Number of regressions.
+ */
+int MatcherBenchmark::compare(const vector<Result>& baseline, const vector<Result>& results,
+        double threshold, ostream& report) {
+    int numOfRegressions = 0;
+    for (unsigned int i = 0; i < results.size(); i++) {
+        const Result& result = results[i];
+        report << std::left << std::setw(14) << result.stage << std::right << std::setw(6)
+                << result.numOfKeypoints << std::setw(14) << (long) result.nsPerOp << " ns"
+                << std::setw(10) << result.allocationsPerOp << " allocs";
+
+        const Result* base = NULL;
+        for (unsigned int j = 0; j < baseline.size() && !base; j++) {
+            if (baseline[j].stage == result.stage && baseline[j].numOfKeypoints == result.numOfKeypoints) {
+                base = &baseline[j];
+            }
+        }
+        if (!base) {
+            report << "  (no baseline)" << endl;
+            continue;
+        }
+
+        double change = (base->nsPerOp > 0) ? result.nsPerOp / base->nsPerOp - 1 : 0;
+        report << "  " << std::showpos << std::fixed << std::setprecision(1) << 100 * change
+                << "%" << std::noshowpos;
+        report.unsetf(std::ios::floatfield);
+        report << std::setprecision(6);
+        if (change > threshold || result.allocationsPerOp > base->allocationsPerOp + ALLOCATION_TOLERANCE) {
+            report << "  REGRESSION";
+            numOfRegressions++;
+        }
+        report << endl;
+    }
+    return numOfRegressions;
+}
+
+/**
+ * @return Heap allocations (operator new) made by the process so far.
+ */
+long MatcherBenchmark::getNumOfAllocations() {
+    return numOfAllocations;
+}
@@ -0,0 +1,134 @@
+/**
+ * @file MatcherBenchmark.h
+ * @author Aydin Arik
+ * @brief Times each stage of matching on its own: SURF detection and
+ *        description, kNN matching, and the ratio, symmetry, pose and RANSAC
+ *        tests of Matcher. Each stage is run on a fixed pair of images (a
+ *        synthetic object and a rotated and scaled copy of it, or a
+ *        recorded object image and frame) cut down to several keypoint counts,
+ *        and reported as time per call, keypoints per second and heap
+ *        allocations per call. Results can be saved as a baseline, and later
+ *        runs compared against it to flag regressions.
+ */
+
+#ifndef MATCHERBENCHMARK_H
+#define	MATCHERBENCHMARK_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <string>
+#include <vector>
+#include <ostream>
+#include <opencv2/core/core.hpp>
+#include <opencv2/features2d/features2d.hpp>
+#include "Matcher.h"
+#include "RecognitionConfig.h"
+#include "Object.h"
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+class MatcherBenchmark {
+public:
+
+    /**
+     * How a stage did at one keypoint count.
+     */
+    struct Result {
+        std::string stage;
+        int numOfKeypoints; //Keypoints of the object and of the frame.
+        double nsPerOp; //Mean time per call (nanoseconds).
+        double keypointsPerSecond;
+        double allocationsPerOp; //Mean heap allocations (operator new) per call.
+
+        Result() : numOfKeypoints(0), nsPerOp(0), keypointsPerSecond(0), allocationsPerOp(0) {
+        }
+    };
+
+private:
+    Matcher matcher; //Stages are called directly (see friend in Matcher).
+    cv::Ptr<cv::FeatureDetector> detector;
+    cv::Ptr<cv::DescriptorExtractor> extractor;
+    cv::Mat objectImage;
+    cv::Mat frameImage;
+    double minSeconds; //Least time spent timing each stage.
+
+    /**
+     * Time every stage with the strongest keypoints of the object and frame.
+     *
+     * @param numOfKeypoints Keypoints kept in each image.
+     * @param object The object with all of its features.
+     * @param frameKeypoints Every keypoint of the frame image.
+     * @param results Results are appended.
+     */
+    void runSize(int numOfKeypoints, const Object& object,
+            const std::vector<cv::KeyPoint>& frameKeypoints, std::vector<Result>& results);
+
+public:
+
+    /**
+     * Constructor. Uses synthetic images until others are loaded.
+     *
+     * @param config Matcher settings (the Hessian threshold is lowered, so
+     *        there are enough keypoints for the largest counts).
+     * @param minSeconds Least time spent timing each stage.
+     */
+    MatcherBenchmark(const RecognitionConfig& config = RecognitionConfig(), double minSeconds = 0.2);
+
+    /**
+     * Use recorded images rather than synthetic ones.
+     *
+     * @param objectFile Image of an object.
+     * @param frameFile Frame containing the object.
+     * @return True if both images were loaded.
+     */
+    bool loadImages(const std::string& objectFile, const std::string& frameFile);
+
+    /**
+     * Time every stage at each keypoint count. Counts larger than the
+     * images have are run with every keypoint.
+     *
+     * @param sizes Keypoint counts.
+     * @param results How each stage did at each count.
+     */
+    void run(const std::vector<int>& sizes, std::vector<Result>& results);
+
+    /**
+     * Save results (CSV), e.g. as a baseline.
+     *
+     * @param filename File to write.
+     * @param results Results.
+     * @return True if the file was written.
+     */
+    static bool writeResults(const std::string& filename, const std::vector<Result>& results);
+
+    /**
+     * Load results saved by writeResults().
+     *
+     * @param filename File to read.
+     * @param results Results.
+     * @return True if the file was read.
+     */
+    static bool readResults(const std::string& filename, std::vector<Result>& results);
+
+    /**
+     * Compare results with a baseline. A stage has regressed if it is slower
+     * than the baseline by more than the threshold, or allocates more.
+     *
+     * @param baseline Earlier results.
+     * @param results Current results.
+     * @param threshold Largest allowed slow down (e.g. 0.1 for 10%).
+     * @param report Comparison of each stage, with regressions flagged.
+     * @return Number of regressions.
+     */
+    static int compare(const std::vector<Result>& baseline, const std::vector<Result>& results,
+            double threshold, std::ostream& report);
+
+    /**
+     * @return Heap allocations (operator new) made by the process so far.
+     */
+    static long getNumOfAllocations();
+};
+
+#endif	/* MATCHERBENCHMARK_H */
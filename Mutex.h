@@ -0,0 +1,126 @@
+/**
+ * @file Mutex.h
+ * @author Aydin Arik
+ * @brief Thin wrappers around pthread mutexes and condition variables. Used by
+ *        classes that share data between threads (camera callbacks, library
+ *        loading, etc.).
+ */
+
+#ifndef MUTEX_H
+#define	MUTEX_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <pthread.h>
+#include <time.h>
+
+
+/******************************************************************************
+ *                              Classes
+ ******************************************************************************/
+/**
+ * Mutual exclusion lock.
+ */
+class Mutex {
+public:
+
+    Mutex() {
+        pthread_mutex_init(&m_mutex, NULL);
+    }
+
+    ~Mutex() {
+        pthread_mutex_destroy(&m_mutex);
+    }
+
+    void lock() {
+        pthread_mutex_lock(&m_mutex);
+    }
+
+    void unlock() {
+        pthread_mutex_unlock(&m_mutex);
+    }
+
+    pthread_mutex_t* native() {
+        return &m_mutex;
+    }
+private:
+    pthread_mutex_t m_mutex;
+
+    Mutex(const Mutex&); //Not copyable.
+    Mutex& operator=(const Mutex&);
+};
+
+/**
+ * Locks a mutex for the lifetime of the object. Handy when a function has
+ * several return points.
+ */
+class ScopedLock {
+public:
+
+    explicit ScopedLock(Mutex& mutex) : m_mutex(mutex) {
+        m_mutex.lock();
+    }
+
+    ~ScopedLock() {
+        m_mutex.unlock();
+    }
+private:
+    Mutex& m_mutex;
+
+    ScopedLock(const ScopedLock&); //Not copyable.
+    ScopedLock& operator=(const ScopedLock&);
+};
+
+/**
+ * Condition variable. The given mutex must be locked when calling wait().
+ */
+class Condition {
+public:
+
+    Condition() {
+        pthread_cond_init(&m_cond, NULL);
+    }
+
+    ~Condition() {
+        pthread_cond_destroy(&m_cond);
+    }
+
+    void wait(Mutex& mutex) {
+        pthread_cond_wait(&m_cond, mutex.native());
+    }
+
+    /**
+     * Wait until signalled or a timeout passes.
+     * 
+     * @param mutex Locked mutex.
+     * @param timeoutMs Longest time to wait (milliseconds).
+     * @return False if the timeout passed.
+     */
+    bool wait(Mutex& mutex, int timeoutMs) {
+        timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeoutMs / 1000;
+        deadline.tv_nsec += (long) (timeoutMs % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        return pthread_cond_timedwait(&m_cond, mutex.native(), &deadline) == 0;
+    }
+
+    void signal() {
+        pthread_cond_signal(&m_cond);
+    }
+
+    void broadcast() {
+        pthread_cond_broadcast(&m_cond);
+    }
+private:
+    pthread_cond_t m_cond;
+
+    Condition(const Condition&); //Not copyable.
+    Condition& operator=(const Condition&);
+};
+
+#endif	/* MUTEX_H */
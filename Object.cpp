@@ -11,6 +11,7 @@
  *                              Header Files
  ******************************************************************************/
 #include "Object.h"
+#include "RecognitionConfig.h"
 using namespace std;
 
 /******************************************************************************
@@ -34,26 +35,121 @@ Object::Object(string objectName, cv::Mat image) {
     //Find keypoints/ descriptors of image.
     //
     // pointer to the feature point detector object
-    cv::Ptr<cv::FeatureDetector> detector = new cv::SurfFeatureDetector(1250);
+    cv::Ptr<cv::FeatureDetector> detector = new cv::SurfFeatureDetector(DEFAULT_HESSIAN_THRESHOLD);
     // pointer to the feature descriptor extractor object
     cv::Ptr<cv::DescriptorExtractor> extractor  = new cv::SurfDescriptorExtractor();
 
-    detector->detect(this->image, keypoints);
-    extractor->compute(image, keypoints, descriptors);
+    findFeatures(detector, extractor);
 }
 
-string Object::getObjectName() {
+/**
+ * Constructor. Uses the given detector and extractor to find the keypoints
+ * and descriptors of the image, rather than allocating new ones.
+ * 
+ * @param objectName Name of object.
+ * @param image Image of object.
+ * @param detector Feature detector used on the image.
+ * @param extractor Descriptor extractor used on the image.
+ */
+Object::Object(string objectName, cv::Mat image,
+        const cv::Ptr<cv::FeatureDetector>& detector,
+        const cv::Ptr<cv::DescriptorExtractor>& extractor) {
+    this->objectName = objectName;
+    this->image = image;
+
+    findFeatures(detector, extractor);
+}
+
+/**
+ * Constructor. Uses keypoints and descriptors found elsewhere (e.g. by a
+ * ShardWorker), rather than finding them in the image.
+ * 
+ * @param objectName Name of object.
+ * @param image Image of object (may be empty).
+ * @param keypoints Keypoints of the image.
+ * @param descriptors Descriptors of the keypoints (one per row).
+ */
+Object::Object(string objectName, cv::Mat image, const KeypointArrays& keypoints,
+        const cv::Mat& descriptors)
+: objectName(objectName), image(image), keypoints(keypoints), descriptors(descriptors) {
+}
+
+/**
+ * Find keypoints and descriptors of the objects image.
+ * 
+ * @param detector Feature detector used on the image.
+ * @param extractor Descriptor extractor used on the image.
+ */
+void Object::findFeatures(const cv::Ptr<cv::FeatureDetector>& detector,
+        const cv::Ptr<cv::DescriptorExtractor>& extractor) {
+    std::vector<cv::KeyPoint> found;
+    detector->detect(image, found);
+    extractor->compute(image, found, descriptors);
+
+    keypoints.append(found); //compute() may have dropped some, so this comes last.
+}
+
+const string& Object::getObjectName() const {
     return objectName;
 }
 
-cv::Mat Object::getImage() {
+const cv::Mat& Object::getImage() const {
     return image;
 }
 
-vector<cv::KeyPoint> Object::getKeypoints() {
+const KeypointArrays& Object::getKeypoints() const {
     return keypoints;
 }
 
-cv::Mat Object::getDescriptors() {
+const cv::Mat& Object::getDescriptors() const {
     return descriptors;
 }
+
+/**
+ * Get a copy of the object without its keypoints and descriptors. Used once
+ * the features have been moved into a LibraryStore.
+ * 
+ * @return The object without features.
+ */
+Object Object::withoutFeatures() const {
+    Object anObject;
+    anObject.objectName = objectName;
+    anObject.image = image;
+    anObject.words = words;
+
+    return anObject;
+}
+
+/**
+ * Keep only some of the objects keypoints (and their descriptors). Call
+ * before quantize(), so the words match what is kept.
+ * 
+ * @param indices Keypoints to keep, in ascending order.
+ */
+void Object::keepKeypoints(const vector<int>& indices) {
+    KeypointArrays kept;
+    cv::Mat keptDescriptors(indices.size(), descriptors.cols, descriptors.type());
+    kept.reserve(indices.size());
+    for (unsigned int i = 0; i < indices.size(); i++) {
+        kept.append(keypoints, indices[i], indices[i] + 1);
+        cv::Mat keptRow = keptDescriptors.row(i);
+        descriptors.row(indices[i]).copyTo(keptRow);
+    }
+
+    keypoints = kept;
+    descriptors = keptDescriptors;
+}
+
+/**
+ * Quantise the objects descriptors into visual words. Done once, when the
+ * object is created, so the library index can be rebuilt cheaply.
+ * 
+ * @param vocabulary Visual vocabulary.
+ */
+void Object::quantize(const VocabularyTree& vocabulary) {
+    vocabulary.quantize(descriptors, words);
+}
+
+const BagOfWords& Object::getWords() const {
+    return words;
+}
@@ -16,6 +16,9 @@
  ******************************************************************************/
 #include <cstring>
 #include <opencv2/core/core.hpp>
+#include <boost/shared_ptr.hpp>
+#include "KeypointArrays.h"
+#include "VocabularyTree.h"
 
 /******************************************************************************
  *                              Class
@@ -24,8 +27,18 @@ class Object {
 private:
     std::string objectName;
     cv::Mat image; //Image of the object.
-    std::vector<cv::KeyPoint> keypoints;
+    KeypointArrays keypoints;
     cv::Mat descriptors;
+    BagOfWords words; //Visual words of the descriptors (empty without a vocabulary).
+
+    /**
+     * Find keypoints and descriptors of the objects image.
+     * 
+     * @param detector Feature detector used on the image.
+     * @param extractor Descriptor extractor used on the image.
+     */
+    void findFeatures(const cv::Ptr<cv::FeatureDetector>& detector,
+            const cv::Ptr<cv::DescriptorExtractor>& extractor);
 
 public:
     Object();
@@ -38,14 +51,68 @@ public:
      */
     Object(std::string objectName, cv::Mat image);
 
-    std::string getObjectName();
+    /**
+     * Constructor. Uses the given detector and extractor to find the keypoints
+     * and descriptors of the image, rather than allocating new ones. Used when
+     * many objects are created at once (e.g. by the ObjectLibrary loader threads).
+     * 
+     * @param objectName Name of object.
+     * @param image Image of object.
+     * @param detector Feature detector used on the image.
+     * @param extractor Descriptor extractor used on the image.
+     */
+    Object(std::string objectName, cv::Mat image,
+            const cv::Ptr<cv::FeatureDetector>& detector,
+            const cv::Ptr<cv::DescriptorExtractor>& extractor);
+
+    /**
+     * Constructor. Uses keypoints and descriptors found elsewhere (e.g. by a
+     * ShardWorker), rather than finding them in the image.
+     * 
+     * @param objectName Name of object.
+     * @param image Image of object (may be empty).
+     * @param keypoints Keypoints of the image.
+     * @param descriptors Descriptors of the keypoints (one per row).
+     */
+    Object(std::string objectName, cv::Mat image, const KeypointArrays& keypoints,
+            const cv::Mat& descriptors);
+
+    const std::string& getObjectName() const;
 
-    cv::Mat getImage();
+    const cv::Mat& getImage() const;
 
-    std::vector<cv::KeyPoint> getKeypoints();
+    const KeypointArrays& getKeypoints() const;
 
-    cv::Mat getDescriptors();
+    const cv::Mat& getDescriptors() const;
+
+    /**
+     * Get a copy of the object without its keypoints and descriptors. Used once
+     * the features have been moved into a LibraryStore.
+     * 
+     * @return The object without features.
+     */
+    Object withoutFeatures() const;
+
+    /**
+     * Keep only some of the objects keypoints (and their descriptors). Call
+     * before quantize(), so the words match what is kept.
+     * 
+     * @param indices Keypoints to keep, in ascending order.
+     */
+    void keepKeypoints(const std::vector<int>& indices);
+
+    /**
+     * Quantise the objects descriptors into visual words. Done once, when the
+     * object is created, so the library index can be rebuilt cheaply.
+     * 
+     * @param vocabulary Visual vocabulary.
+     */
+    void quantize(const VocabularyTree& vocabulary);
+
+    const BagOfWords& getWords() const;
 };
 
+typedef boost::shared_ptr<const Object> ObjectPtr;
+
 #endif	/* OBJECT_H */
 
@@ -0,0 +1,186 @@
+/**
+ * @file ObjectIndex.cpp
+ * @author Aydin Arik
+ * @brief TF-IDF inverted index over library objects.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "ObjectIndex.h"
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+
+/******************************************************************************
+ *                              Functions
+ ******************************************************************************/
+/**
+ * Order (score, object) pairs best first.
+ */
+static bool higherScore(const pair<float, int>& a, const pair<float, int>& b) {
+    return a.first > b.first;
+}
+
+
+/******************************************************************************
+ *                              Methods
+ ******************************************************************************/
+/**
+ * Constructor. Builds the index from the models' cached bags of words, so
+ * no descriptors are quantised here. Models without words are left out.
+ *
+ * @param numOfWords Number of words in the vocabulary.
+ * @param store Objects to index.
+ */
+ObjectIndex::ObjectIndex(int numOfWords, const LibraryStore& store)
+: numOfObjects(store.size()), postings(numOfWords), idf(numOfWords, 0) {
+
+    //Document frequency of each word.
+    int numOfDocuments = 0;
+    for (int i = 0; i < numOfObjects; i++) {
+        const BagOfWords& words = store.getWords(i);
+        for (unsigned int j = 0; j < words.size(); j++) {
+            idf[words[j].first] += 1;
+        }
+        numOfDocuments += words.empty() ? 0 : 1;
+    }
+    for (int w = 0; w < numOfWords; w++) {
+        idf[w] = (idf[w] > 0) ? log(numOfDocuments / idf[w]) : 0;
+    }
+
+    //Postings hold L2 normalised tf-idf weights, so a query score is a cosine similarity.
+    for (int i = 0; i < numOfObjects; i++) {
+        const BagOfWords& words = store.getWords(i);
+
+        float norm = 0;
+        for (unsigned int j = 0; j < words.size(); j++) {
+            float weight = words[j].second * idf[words[j].first];
+            norm += weight * weight;
+        }
+        norm = sqrt(norm);
+        if (norm == 0) {
+            continue; //No words, or only words that are in every object; can never score.
+        }
+
+        for (unsigned int j = 0; j < words.size(); j++) {
+            Posting posting;
+            posting.object = i;
+            posting.weight = words[j].second * idf[words[j].first] / norm;
+            postings[words[j].first].push_back(posting);
+        }
+    }
+}
+
+/**
+ * Find the objects that best match a frame.
+ *
+ * @param frameWords Bag of words of the frame.
+ * @param maxCandidates Maximum number of objects to return (top-K).
+ * @param candidates Store slots of the best objects found, best first.
+ * @param scores Cosine similarity of each candidate (optional).
+ */
+void ObjectIndex::query(const BagOfWords& frameWords, int maxCandidates,
+        vector<int>& candidates,
+        vector<float>* scores) const {
+
+    //Only the posting lists of words in the frame are visited.
+    vector<pair<float, int> > objectScores(numOfObjects);
+    for (int i = 0; i < numOfObjects; i++) {
+        objectScores[i] = make_pair(0.0f, i);
+    }
+
+    float norm = 0;
+    for (unsigned int j = 0; j < frameWords.size(); j++) {
+        int word = frameWords[j].first;
+        if (word >= (int) postings.size()) {
+            continue;
+        }
+
+        float weight = frameWords[j].second * idf[word];
+        norm += weight * weight;
+
+        const vector<Posting>& list = postings[word];
+        for (unsigned int p = 0; p < list.size(); p++) {
+            objectScores[list[p].object].first += weight * list[p].weight;
+        }
+    }
+    norm = sqrt(norm);
+
+    int k = min(maxCandidates, numOfObjects);
+    partial_sort(objectScores.begin(), objectScores.begin() + k, objectScores.end(), higherScore);
+
+    for (int i = 0; i < k && objectScores[i].first > 0; i++) {
+        candidates.push_back(objectScores[i].second);
+        if (scores) {
+            scores->push_back(objectScores[i].first / norm);
+        }
+    }
+}
+
+/**
+ * Find the objects that best match each frame of a batch. Every posting
+ * list used by the batch is read once, rather than once per frame.
+ *
+ * @param frameWords Bag of words of each frame.
+ * @param maxCandidates Maximum number of objects to return per frame (top-K).
+ * @param candidates Store slots of the best objects found for each frame, best first.
+ */
+void ObjectIndex::query(const vector<BagOfWords>& frameWords, int maxCandidates,
+        vector<vector<int> >& candidates) const {
+    int numOfFrames = frameWords.size();
+    candidates.assign(numOfFrames, vector<int>());
+    if (numOfObjects == 0) {
+        return;
+    }
+
+    //Every (word, frame) pair of the batch, grouped by word.
+    vector<pair<int, pair<int, float> > > entries;
+    for (int f = 0; f < numOfFrames; f++) {
+        for (unsigned int j = 0; j < frameWords[f].size(); j++) {
+            int word = frameWords[f][j].first;
+            if (word < (int) postings.size() && idf[word] > 0) {
+                entries.push_back(make_pair(word, make_pair(f, frameWords[f][j].second * idf[word])));
+            }
+        }
+    }
+    sort(entries.begin(), entries.end());
+
+    //Scores of every frame against every object. Frames aren't normalised,
+    //since that doesn't change their ranking.
+    vector<float> scores(numOfFrames * numOfObjects, 0);
+    for (unsigned int begin = 0, end = 0; begin < entries.size(); begin = end) {
+        int word = entries[begin].first;
+        for (end = begin; end < entries.size() && entries[end].first == word; end++);
+
+        const vector<Posting>& list = postings[word];
+        for (unsigned int p = 0; p < list.size(); p++) {
+            for (unsigned int e = begin; e < end; e++) {
+                scores[entries[e].second.first * numOfObjects + list[p].object] +=
+                        entries[e].second.second * list[p].weight;
+            }
+        }
+    }
+
+    int k = min(maxCandidates, numOfObjects);
+    vector<pair<float, int> > objectScores(numOfObjects);
+    for (int f = 0; f < numOfFrames; f++) {
+        for (int i = 0; i < numOfObjects; i++) {
+            objectScores[i] = make_pair(scores[f * numOfObjects + i], i);
+        }
+        partial_sort(objectScores.begin(), objectScores.begin() + k, objectScores.end(), higherScore);
+
+        for (int i = 0; i < k && objectScores[i].first > 0; i++) {
+            candidates[f].push_back(objectScores[i].second);
+        }
+    }
+}
+
+/**
+ * @return Number of objects in the store the index was built from.
+ */
+int ObjectIndex::size() const {
+    return numOfObjects;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file ObjectIndex.h
+ * @author Aydin Arik
+ * @brief TF-IDF inverted index over library objects. Scores a frame's bag of
+ *        visual words against every indexed object at once, so only the most
+ *        likely objects need to go through the full Matcher pipeline.
+ */
+
+#ifndef OBJECTINDEX_H
+#define	OBJECTINDEX_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <vector>
+#include "LibraryStore.h"
+#include "VocabularyTree.h"
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+class ObjectIndex {
+private:
+
+    struct Posting {
+        int object; //Slot of the object in the store.
+        float weight; //Normalised tf-idf weight of the word in the object.
+    };
+
+    int numOfObjects; //Objects in the store the index was built from.
+    std::vector<std::vector<Posting> > postings; //Objects that contain each word.
+    std::vector<float> idf; //Inverse document frequency of each word.
+
+public:
+
+    /**
+     * Constructor. Builds the index from the models' cached bags of words, so
+     * no descriptors are quantised here. Models without words are left out.
+     *
+     * @param numOfWords Number of words in the vocabulary.
+     * @param store Objects to index.
+     */
+    ObjectIndex(int numOfWords, const LibraryStore& store);
+
+    /**
+     * Find the objects that best match a frame.
+     *
+     * @param frameWords Bag of words of the frame.
+     * @param maxCandidates Maximum number of objects to return (top-K).
+     * @param candidates Store slots of the best objects found, best first.
+     * @param scores Cosine similarity of each candidate (optional).
+     */
+    void query(const BagOfWords& frameWords, int maxCandidates,
+            std::vector<int>& candidates,
+            std::vector<float>* scores = NULL) const;
+
+    /**
+     * Find the objects that best match each frame of a batch. Every posting
+     * list used by the batch is read once, rather than once per frame.
+     *
+     * @param frameWords Bag of words of each frame.
+     * @param maxCandidates Maximum number of objects to return per frame (top-K).
+     * @param candidates Store slots of the best objects found for each frame, best first.
+     */
+    void query(const std::vector<BagOfWords>& frameWords, int maxCandidates,
+            std::vector<std::vector<int> >& candidates) const;
+
+    /**
+     * @return Number of objects in the store the index was built from.
+     */
+    int size() const;
+};
+
+#endif	/* OBJECTINDEX_H */
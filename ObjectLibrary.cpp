@@ -2,7 +2,10 @@
  * @file ObjectLibrary.cpp
  * @author Aydin Arik 
  * @brief A library of objects to easily scan over when trying to find an object
- *        in a (video) frame.
+ *        in a (video) frame. Object images are decoded and their features
+ *        extracted by loader tasks on the shared TaskExecutor. The library
+ *        directory is then watched, and objects are added, re-extracted or
+ *        removed as their image files change.
  */
 
 
@@ -16,6 +19,13 @@
 #include "boost/filesystem/path.hpp"
 #include "boost/progress.hpp"
 #include <iostream>//todo
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <iterator>
+#include "DirectoryWatcher.h"
+#include "StabilityPruner.h"
+#include <boost/scoped_ptr.hpp>
 
 using namespace cv;
 using namespace std;
@@ -39,57 +49,838 @@ template <class T> double sizeOf(T& array) {
     return (sizeof (array) / sizeof (array[0]));
 }
 
+/**
+ * Number of models that can be viewed in a snapshot: those in its store,
+ * then each object still pending.
+ * 
+ * @param snapshot Library snapshot.
+ * @return Number of models.
+ */
+static int numOfModels(const LibrarySnapshot& snapshot) {
+    return (snapshot.store ? snapshot.store->size() : 0) + snapshot.pending.size();
+}
+
+/**
+ * Get a model in a snapshot.
+ * 
+ * @param snapshot Library snapshot.
+ * @param i Model number, from 0 to numOfModels(snapshot) - 1.
+ * @return The model.
+ */
+static ModelView modelView(const LibrarySnapshot& snapshot, int i) {
+    int stored = snapshot.store ? snapshot.store->size() : 0;
+    if (i < stored) {
+        return snapshot.store->model(i);
+    }
+
+    return ModelView(snapshot.pending.at(i - stored));
+}
+
+/**
+ * Get the modification time of a file, to the nanosecond, so writes within
+ * the same second are told apart.
+ * 
+ * @param file File path.
+ * @return Modification time (nanoseconds), or 0 if the file can't be found.
+ */
+static int64_t modificationTime(const string& file) {
+    struct stat status;
+    if (stat(file.c_str(), &status) != 0) {
+        return 0;
+    }
+    return (int64_t) status.st_mtim.tv_sec * 1000000000 + status.st_mtim.tv_nsec;
+}
+
 
 /******************************************************************************
  *                              Methods
  ******************************************************************************/
 /**
- * Get the next object in the library.
+ * Wait (objectsMutex must be locked) until at least one object is available
+ * or loading has finished.
+ */
+void ObjectLibrary::waitForFirstObject() {
+    while (snapshot->objects.empty() && numOfLoaders > 0) {
+        objectsChanged.wait(objectsMutex);
+    }
+}
+
+/**
+ * Get the next object in the library. Blocks until at least one object
+ * has been loaded. Objects still being loaded join the rotation when ready.
  * 
- * @return The next object in library.
+ * @return Model of the next object in library.
  */
-Object ObjectLibrary::getNextObject() {
-    Object anObject = objects.at(objectIterator);
+ModelView ObjectLibrary::getNextObject() {
+    return getNextObject(objectIterator);
+}
 
+/**
+ * Get the next object in the library for a caller that keeps its own place
+ * in the rotation (e.g. one per camera).
+ * 
+ * @param iterator The callers current object of interest. Advanced past the
+ *        object returned.
+ * @return Model of the next object in library.
+ */
+ModelView ObjectLibrary::getNextObject(int& iterator) {
+    objectsMutex.lock();
+    waitForFirstObject();
+    LibrarySnapshotPtr current = snapshot;
+    int numOfViews = numOfModels(*current);
+
+    //Objects may have been removed since the last call.
+    if (iterator >= numOfViews) {
+        iterator = 0;
+    }
+    int anObject = iterator;
     
-    if (objectIterator == (objects.size() - 1)) { //Start at the start of library if we have reached the end.
-        objectIterator = 0;
+    if (iterator >= (numOfViews - 1)) { //Start at the start of library if we have reached the end.
+        iterator = 0;
     } else { //Iterate to next object in library.
-        objectIterator++;
+        iterator++;
+    }
+    objectsMutex.unlock();
+
+    return modelView(*current, anObject);
+}
+
+/**
+ * Get the objects worth matching against a frame. With a vocabulary, the
+ * frame is quantised once and scored against the index, and only the best
+ * objects are returned. Without one, this is just the next object.
+ * 
+ * @param frameDescriptors Descriptors of the frame.
+ * @param maxCandidates Maximum number of indexed objects to return (top-K).
+ * @param candidates Objects to match against the frame, best first.
+ * @param iterator The callers place in the rotation, used without an index.
+ */
+void ObjectLibrary::getCandidates(const cv::Mat& frameDescriptors, int maxCandidates,
+        std::vector<ModelView>& candidates, int& iterator) {
+    LibrarySnapshotPtr current = getSnapshot();
+
+    if (!current->index) { //No vocabulary, or index not built yet.
+        candidates.push_back(getNextObject(iterator));
+        return;
     }
 
-    return anObject;
+    BagOfWords frameWords;
+    std::vector<int> slots;
+    vocabulary.quantize(frameDescriptors, frameWords);
+    current->index->query(frameWords, maxCandidates, slots);
+    for (unsigned int i = 0; i < slots.size(); i++) {
+        candidates.push_back(current->store->model(slots[i]));
+    }
+
+    //Objects that arrived after the index was built can't be scored, so they
+    //are always checked until the next index is published.
+    for (unsigned int i = 0; i < current->pending.size() && (int) i < maxCandidates; i++) {
+        candidates.push_back(ModelView(current->pending[i]));
+    }
 }
 
 /**
- * Get the first object in the library.
+ * Get the objects worth matching against a frame, with how well the frame
+ * matches each on the index, so shortlists of several libraries can be merged
+ * (see ShardCoordinator). Without an index, this is the next objects in the
+ * rotation.
  * 
- * @return The first object in library.
+ * @param frameDescriptors Descriptors of the frame.
+ * @param maxCandidates Maximum number of objects to return (top-K).
+ * @param candidates Objects to match against the frame, best first.
+ * @param scores Index score of each candidate (1 for objects not yet
+ *        indexed, 0 without an index).
+ * @param iterator The callers place in the rotation, used without an index.
  */
-Object ObjectLibrary::getFirst() {
-    return objects.at(0);
+void ObjectLibrary::getCandidates(const cv::Mat& frameDescriptors, int maxCandidates,
+        std::vector<ModelView>& candidates, std::vector<float>& scores, int& iterator) {
+    LibrarySnapshotPtr current = getSnapshot();
+    int numOfViews = numOfModels(*current);
+
+    if (!current->index) { //No vocabulary, or index not built yet.
+        for (int i = 0; i < numOfViews && i < maxCandidates; i++) {
+            if (iterator >= numOfViews) {
+                iterator = 0;
+            }
+            candidates.push_back(modelView(*current, iterator++));
+            scores.push_back(0.0f);
+        }
+        return;
+    }
+
+    if (frameDescriptors.rows > 0) {
+        BagOfWords frameWords;
+        std::vector<int> slots;
+        std::vector<float> slotScores;
+        vocabulary.quantize(frameDescriptors, frameWords);
+        current->index->query(frameWords, maxCandidates, slots, &slotScores);
+        for (unsigned int i = 0; i < slots.size(); i++) {
+            candidates.push_back(current->store->model(slots[i]));
+            scores.push_back(slotScores[i]);
+        }
+    }
+
+    //Objects that arrived after the index was built can't be scored, so they
+    //rank first until the next index is published.
+    for (unsigned int i = 0; i < current->pending.size() && (int) i < maxCandidates; i++) {
+        candidates.push_back(ModelView(current->pending[i]));
+        scores.push_back(1.0f);
+    }
 }
 
-ObjectLibrary::ObjectLibrary() {
+/**
+ * Get an object by name.
+ * 
+ * @param objectName Name of the object.
+ * @param model Model of the object, if found.
+ * @return True if the object is in the library.
+ */
+bool ObjectLibrary::getModel(const string& objectName, ModelView& model) {
+    LibrarySnapshotPtr current = getSnapshot();
+
+    //Stored models come first, and hold every view stored so far.
+    for (int i = 0; i < numOfModels(*current); i++) {
+        ModelView candidate = modelView(*current, i);
+        if (candidate.getObjectName() == objectName) {
+            model = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Get every object in the library, with how well the frame matches it on
+ * the index (see ObjectScheduler). Blocks until at least one object has
+ * been loaded.
+ * 
+ * @param frameDescriptors Descriptors of the frame.
+ * @param models Every object.
+ * @param scores Index score of each object (0 if it isn't indexed, or there
+ *        is no vocabulary).
+ */
+void ObjectLibrary::scoreObjects(const cv::Mat& frameDescriptors, std::vector<ModelView>& models,
+        std::vector<float>& scores) {
+    objectsMutex.lock();
+    waitForFirstObject();
+    LibrarySnapshotPtr current = snapshot;
+    objectsMutex.unlock();
+
+    int numOfViews = numOfModels(*current);
+    models.clear();
+    for (int i = 0; i < numOfViews; i++) {
+        models.push_back(modelView(*current, i));
+    }
+    scores.assign(numOfViews, 0.0f);
+
+    if (current->index && frameDescriptors.rows > 0) {
+        BagOfWords frameWords;
+        std::vector<int> slots;
+        std::vector<float> slotScores;
+        vocabulary.quantize(frameDescriptors, frameWords);
+        current->index->query(frameWords, current->index->size(), slots, &slotScores);
+        for (unsigned int i = 0; i < slots.size(); i++) {
+            scores[slots[i]] = slotScores[i]; //Index slots are store slots, which come first.
+        }
+    }
+}
+
+/**
+ * Get the objects worth matching against each frame of a batch. The whole
+ * batch is scored against the index at once. Without an index, every
+ * object is a candidate for every frame.
+ * 
+ * @param frameDescriptors Descriptors of each frame.
+ * @param maxCandidates Maximum number of indexed objects to return per frame (top-K).
+ * @param candidates Objects to match against each frame, best first.
+ */
+void ObjectLibrary::getCandidates(const std::vector<cv::Mat>& frameDescriptors, int maxCandidates,
+        std::vector<std::vector<ModelView> >& candidates) {
+    objectsMutex.lock();
+    waitForFirstObject();
+    LibrarySnapshotPtr current = snapshot;
+    objectsMutex.unlock();
+
+    candidates.assign(frameDescriptors.size(), std::vector<ModelView>());
+    if (!current->index) { //No vocabulary, or index not built yet.
+        std::vector<ModelView> all;
+        for (int i = 0; i < numOfModels(*current); i++) {
+            all.push_back(modelView(*current, i));
+        }
+        candidates.assign(frameDescriptors.size(), all);
+        return;
+    }
+
+    std::vector<BagOfWords> frameWords(frameDescriptors.size());
+    for (unsigned int f = 0; f < frameDescriptors.size(); f++) {
+        vocabulary.quantize(frameDescriptors[f], frameWords[f]);
+    }
+
+    std::vector<std::vector<int> > slots;
+    current->index->query(frameWords, maxCandidates, slots);
+    for (unsigned int f = 0; f < slots.size(); f++) {
+        for (unsigned int i = 0; i < slots[f].size(); i++) {
+            candidates[f].push_back(current->store->model(slots[f][i]));
+        }
+
+        //Objects that arrived after the index was built can't be scored.
+        for (unsigned int i = 0; i < current->pending.size() && (int) i < maxCandidates; i++) {
+            candidates[f].push_back(ModelView(current->pending[i]));
+        }
+    }
+}
+
+/**
+ * Train a visual vocabulary from the descriptors of every loaded object,
+ * and save it where the library will load it next time. Slow; run offline.
+ * 
+ * @param branching Number of children of each vocabulary tree node.
+ * @param depth Number of levels in the vocabulary tree.
+ */
+void ObjectLibrary::trainVocabulary(int branching, int depth) {
+    waitUntilLoaded();
+    updateStore(); //All descriptors in one matrix.
+    LibrarySnapshotPtr current = getSnapshot();
+    if (!current->store || current->store->getDescriptors().rows == 0) {
+        std::cout << "No object descriptors to train a vocabulary from" << std::endl;
+        return;
+    }
+
+    cv::Mat descriptors = current->store->getDescriptors();
+    if (!descriptors.isContinuous()) { //Padded rows; k-means wants them packed.
+        descriptors = descriptors.clone();
+    }
+
+    std::cout << "Training vocabulary from " << descriptors.rows << " descriptors of "
+            << current->store->size() << " objects..." << std::endl;
+
+    VocabularyTree trained;
+    trained.train(descriptors, branching, depth);
+    trained.save(vocabularyFile);
+
+    std::cout << "Saved " << trained.getNumOfWords() << " word vocabulary to: " << vocabularyFile << std::endl;
+}
+
+/**
+ * Get the first object in the library. Blocks until at least one object
+ * has been loaded.
+ * 
+ * @return Model of the first object in library.
+ */
+ModelView ObjectLibrary::getFirst() {
+    objectsMutex.lock();
+    waitForFirstObject();
+    LibrarySnapshotPtr current = snapshot;
+    objectsMutex.unlock();
+
+    return modelView(*current, 0);
+}
+
+/**
+ * Get the current library snapshot. The snapshot never changes, so it can
+ * be used without locking for as long as it is held.
+ * 
+ * @return The current snapshot.
+ */
+LibrarySnapshotPtr ObjectLibrary::getSnapshot() {
+    ScopedLock lock(objectsMutex);
+    return snapshot;
+}
+
+/**
+ * Change which files of the library directory this library owns. Objects of
+ * files no longer owned are removed, and newly owned files are loaded by
+ * loader tasks, so this returns before they are ready.
+ * 
+ * @param files Files of the library directory to own.
+ */
+void ObjectLibrary::assignFiles(const std::vector<string>& files) {
+    std::set<string> owned(files.begin(), files.end());
+    std::vector<string> dropped, added;
+
+    updateMutex.lock();
+    std::set_difference(ownedFiles.begin(), ownedFiles.end(), owned.begin(), owned.end(),
+            std::back_inserter(dropped));
+    std::set_difference(owned.begin(), owned.end(), ownedFiles.begin(), ownedFiles.end(),
+            std::back_inserter(added));
+    ownedFiles.swap(owned);
+    sharded = true;
+    updateMutex.unlock();
+
+    //Files dropped while they are being loaded are ignored by publishObject().
+    for (unsigned int i = 0; i < dropped.size(); i++) {
+        removeObject(dropped[i]);
+    }
+    if (added.empty()) {
+        return;
+    }
+
+    int numOfThreads = std::min(TaskExecutor::getDefault().size(), (int) added.size());
+    objectsMutex.lock();
+    filesToLoad.insert(filesToLoad.end(), added.begin(), added.end());
+    numOfLoaders += numOfThreads;
+    objectsMutex.unlock();
+
+    for (int i = 0; i < numOfThreads; i++) {
+        loaders.run(&ObjectLibrary::loadObjects, this);
+    }
+}
+
+/**
+ * Block until every object in the library directory has been loaded, and
+ * stored and indexed.
+ */
+void ObjectLibrary::waitUntilLoaded() {
+    ScopedLock lock(objectsMutex);
+    while (numOfLoaders > 0) {
+        objectsChanged.wait(objectsMutex);
+    }
+}
+
+/**
+ * @return True if every object in the library directory has been loaded,
+ *         and stored and indexed.
+ */
+bool ObjectLibrary::isLoaded() {
+    ScopedLock lock(objectsMutex);
+    return numOfLoaders == 0;
+}
+
+/**
+ * @return Number of object images (views) currently loaded.
+ */
+int ObjectLibrary::getNumOfObjects() {
+    return getSnapshot()->objects.size();
+}
+
+/**
+ * @return Settings the library was built with.
+ */
+const RecognitionConfig& ObjectLibrary::getConfig() const {
+    return config;
+}
+
+/**
+ * Constructor. Starts loading the library.
+ * 
+ * @param numOfThreads Number of loader tasks to use (0 for one per worker).
+ * @param waitForAll If true, block until every object is loaded. Otherwise
+ *        return straight away, and let objects stream in as they're ready.
+ * @param watch If true, watch the library directory for changes.
+ * @param config Settings used to find and prune object features.
+ * @param files If given, only these files of the library directory are
+ *        loaded (e.g. one shard of it, see ShardWorker), rather than all.
+ */
+ObjectLibrary::ObjectLibrary(int numOfThreads, bool waitForAll, bool watch,
+        const RecognitionConfig& config, const std::vector<string>* files)
+: config(config), snapshot(new LibrarySnapshot()) {
     objectIterator = 0;
-    totalNumOfObjects = 0;
+    nextFileToLoad = 0;
+    numOfLoaders = 0;
+    stopLoading = false;
+    storeStale = false;
+    watchDirectory = watch;
+    sharded = (files != NULL);
+    if (files) {
+        ownedFiles.insert(files->begin(), files->end());
+    }
     
     //Library folder.
-    libDirString = "../../Images/Objects/";
+    libDirString = OBJECT_LIBRARY_DIR;
+
+    //Optional visual vocabulary (see trainVocabulary()). Without it every 
+    //object is checked in turn.
+    vocabularyFile = libDirString + "../vocabulary";
+    if (vocabulary.load(vocabularyFile)) {
+        std::cout << "Loaded " << vocabulary.getNumOfWords() << " word vocabulary" << std::endl;
+    }
 
-    createObjects();
+    createObjects(numOfThreads);
+
+    watching = (pthread_create(&watcherThread, NULL, &ObjectLibrary::watchObjects, this) == 0);
+
+    if (waitForAll) {
+        waitUntilLoaded();
+    }
 }
 
+/**
+ * Destructor. Stops any loader tasks and the watcher thread.
+ */
+ObjectLibrary::~ObjectLibrary() {
+    objectsMutex.lock();
+    stopLoading = true;
+    objectsMutex.unlock();
+
+    loaders.wait();
+    if (watching) {
+        pthread_join(watcherThread, NULL);
+    }
+}
 
 /**
- * Searches a specified folder for object images, then stores them. The filename 
- * is used as the name of the object. Uses the Boost Filesystem Library.
+ * Decode an image file, extract its features, prune unstable keypoints
+ * (see StabilityPruner) and quantise them. Files named
+ * <name>.<anything>.<ext> are all views of the object <name>.
+ * 
+ * @param file Image file.
+ * @param detector Feature detector used on the image.
+ * @param extractor Descriptor extractor used on the image.
+ * @return The new object, or an empty pointer if the image could not be read.
+ */
+ObjectPtr ObjectLibrary::createObject(const string& file,
+        const cv::Ptr<cv::FeatureDetector>& detector,
+        const cv::Ptr<cv::DescriptorExtractor>& extractor) {
+    cv::Mat image = cv::imread(file, CV_LOAD_IMAGE_GRAYSCALE);
+    if (!image.data) {
+        std::cout << "Could not read object image: " << file << std::endl;
+        return ObjectPtr();
+    }
+
+    //Views of the same object share the part of the filename before the first '.'.
+    string fileName = fs::path(file).stem().string();
+    fileName = fileName.substr(0, fileName.find('.'));
+    Object* anObject = new Object(fileName, image, detector, extractor);
+
+    //Drop keypoints that don't survive synthetic changes of view and lighting.
+    if (config.keypointsPerObject > 0) {
+        int before = anObject->getKeypoints().count();
+        StabilityPruner pruner(config.keypointsPerObject);
+        int after = pruner.prune(*anObject, detector, extractor);
+        std::cout << "Pruned " << file << ": " << before << " -> " << after << " keypoints" << std::endl;
+    }
+
+    anObject->quantize(vocabulary);
+    return ObjectPtr(anObject);
+}
+
+/**
+ * Swap in a new snapshot. updateMutex must be locked.
+ * 
+ * @param newSnapshot The snapshot to publish.
+ */
+void ObjectLibrary::publish(const LibrarySnapshotPtr& newSnapshot) {
+    objectsMutex.lock();
+    snapshot = newSnapshot;
+    objectsChanged.broadcast();
+    objectsMutex.unlock();
+}
+
+/**
+ * Publish a new snapshot in which the object for a file is added or replaced.
+ * Ignored if a newer version of the file has already been published.
+ * 
+ * @param file Image file the object was created from.
+ * @param modified Modification time of the file when it was read (nanoseconds).
+ * @param object The object.
+ */
+void ObjectLibrary::publishObject(const string& file, int64_t modified, const ObjectPtr& object) {
+    ScopedLock lock(updateMutex);
+
+    if (sharded && ownedFiles.find(file) == ownedFiles.end()) {
+        return; //Not (or no longer) one of this library's files.
+    }
+    std::map<string, int64_t>::iterator published = fileTimes.find(file);
+    if (published != fileTimes.end() && published->second > modified) {
+        return; //A newer version is already in the library.
+    }
+    if (!fs::exists(fs::path(file))) {
+        return; //Removed while it was being extracted.
+    }
+
+    //Copy the current snapshot (only pointers are copied) and modify the copy.
+    boost::shared_ptr<LibrarySnapshot> newSnapshot(new LibrarySnapshot(*getSnapshot()));
+    std::vector<string>::iterator existing =
+            std::find(newSnapshot->files.begin(), newSnapshot->files.end(), file);
+    if (existing != newSnapshot->files.end()) {
+        //The replaced object mustn't stay a candidate until the next rebuild.
+        ObjectPtr replaced = newSnapshot->objects[existing - newSnapshot->files.begin()];
+        newSnapshot->pending.erase(std::remove(newSnapshot->pending.begin(),
+                newSnapshot->pending.end(), replaced), newSnapshot->pending.end());
+        newSnapshot->objects[existing - newSnapshot->files.begin()] = object;
+    } else {
+        newSnapshot->objects.push_back(object);
+        newSnapshot->files.push_back(file);
+    }
+    newSnapshot->pending.push_back(object);
+    storeStale = true;
+
+    fileTimes[file] = modified;
+    publish(newSnapshot);
+}
+
+/**
+ * Publish a new snapshot without the object for a file.
+ * 
+ * @param file Image file the object was created from.
+ */
+void ObjectLibrary::removeObject(const string& file) {
+    ScopedLock lock(updateMutex);
+
+    if (fileTimes.erase(file) == 0) {
+        return; //Not in the library.
+    }
+
+    boost::shared_ptr<LibrarySnapshot> newSnapshot(new LibrarySnapshot(*getSnapshot()));
+    std::vector<string>::iterator existing =
+            std::find(newSnapshot->files.begin(), newSnapshot->files.end(), file);
+    if (existing != newSnapshot->files.end()) {
+        ObjectPtr removed = newSnapshot->objects[existing - newSnapshot->files.begin()];
+        newSnapshot->objects.erase(newSnapshot->objects.begin() + (existing - newSnapshot->files.begin()));
+        newSnapshot->files.erase(existing);
+        newSnapshot->pending.erase(std::remove(newSnapshot->pending.begin(),
+                newSnapshot->pending.end(), removed), newSnapshot->pending.end());
+    }
+    storeStale = true;
+
+    std::cout << "Removed object: " << file << std::endl;
+    publish(newSnapshot);
+}
+
+/**
+ * Publish a new snapshot with a freshly built store and index, if objects
+ * have changed since the last ones were built.
+ */
+void ObjectLibrary::updateStore() {
+    ScopedLock lock(updateMutex);
+    if (!storeStale) {
+        return;
+    }
+
+    //Objects already in the old store are copied from it; only pending objects
+    //bring their own features. The index is built from each objects cached
+    //words, so this is cheap compared to extraction.
+    LibrarySnapshotPtr current = getSnapshot();
+    boost::shared_ptr<LibrarySnapshot> newSnapshot(new LibrarySnapshot(*current));
+    boost::shared_ptr<LibraryStore> store(new LibraryStore(current->objects, current->store.get()));
+    newSnapshot->store = store;
+    newSnapshot->objects = store->getObjects(); //Drop the duplicate features.
+    newSnapshot->pending.clear();
+    if (!vocabulary.empty()) {
+        newSnapshot->index.reset(new ObjectIndex(vocabulary.getNumOfWords(), *store));
+    }
+
+    std::cout << "Stored " << store->getObjects().size() << " views of " << store->size()
+            << " objects: " << store->getNumOfKeypoints() << " descriptors merged into "
+            << store->getDescriptors().rows << std::endl;
+
+    storeStale = false;
+    publish(newSnapshot);
+}
+
+/**
+ * Compare the library directory against the published files, extract any
+ * new or changed files and remove any missing ones. Used when inotify
+ * events have been lost.
+ * 
+ * @param detector Feature detector used on new images.
+ * @param extractor Descriptor extractor used on new images.
+ */
+void ObjectLibrary::rescan(const cv::Ptr<cv::FeatureDetector>& detector,
+        const cv::Ptr<cv::DescriptorExtractor>& extractor) {
+    std::vector<string> files;
+    findImageFiles(libDirString, files);
+
+    //Copy the published file times so extraction happens without updateMutex held.
+    updateMutex.lock();
+    keepOwnedFiles(files);
+    std::map<string, int64_t> published = fileTimes;
+    updateMutex.unlock();
+
+    for (unsigned int i = 0; i < files.size(); i++) {
+        int64_t modified = modificationTime(files[i]);
+        std::map<string, int64_t>::iterator it = published.find(files[i]);
+        if (it == published.end() || it->second != modified) {
+            ObjectPtr object = createObject(files[i], detector, extractor);
+            if (object) {
+                publishObject(files[i], modified, object);
+            }
+        }
+        if (it != published.end()) {
+            published.erase(it);
+        }
+    }
+
+    //Anything left over is no longer in the directory.
+    for (std::map<string, int64_t>::iterator it = published.begin(); it != published.end(); ++it) {
+        removeObject(it->first);
+    }
+}
+
+/**
+ * A loader task. Claims files one at a time, decodes them and extracts
+ * features. Each task only holds one decoded image at a time, which bounds
+ * memory use while loading. The last task to finish builds the store and
+ * index, so a loaded library is always indexed.
+ * 
+ * @param library The ObjectLibrary that started the task.
+ */
+void ObjectLibrary::loadObjects(void* library) {
+    ObjectLibrary* self = static_cast<ObjectLibrary*> (library);
+
+    //One detector/extractor per task, shared by every object this task loads.
+    cv::Ptr<cv::FeatureDetector> detector = new cv::SurfFeatureDetector(self->config.hessianThreshold);
+    cv::Ptr<cv::DescriptorExtractor> extractor = new cv::SurfDescriptorExtractor();
+
+    while (true) {
+        //Claim the next file.
+        self->objectsMutex.lock();
+        if (self->stopLoading || self->nextFileToLoad >= self->filesToLoad.size()) {
+            self->objectsMutex.unlock();
+            break;
+        }
+        string file = self->filesToLoad[self->nextFileToLoad++];
+        self->objectsMutex.unlock();
+
+        //Decode and extract outside of the lock.
+        try {
+            int64_t modified = modificationTime(file);
+            ObjectPtr object = self->createObject(file, detector, extractor);
+            if (object) {
+                self->publishObject(file, modified, object);
+            }
+        } catch (const std::exception & ex) {
+            //Do nothing and ignore error.
+        }
+    }
+
+    //The last loader stays counted until the store is built, so waitUntilLoaded()
+    //and isLoaded() don't see the library as loaded before it is indexed.
+    self->objectsMutex.lock();
+    bool last = (self->numOfLoaders == 1 && !self->stopLoading);
+    if (!last) {
+        self->numOfLoaders--;
+        self->objectsChanged.broadcast();
+    }
+    self->objectsMutex.unlock();
+
+    if (last) {
+        self->updateStore();
+        self->objectsMutex.lock();
+        self->numOfLoaders--;
+        self->objectsChanged.broadcast();
+        self->objectsMutex.unlock();
+    }
+}
+
+/**
+ * Entry point of the watcher thread. Extracts features of files that are
+ * created or changed in the library directory and removes objects whose
+ * files are removed. Also rebuilds the store and index when objects have changed.
+ * 
+ * @param library The ObjectLibrary that started the thread.
+ * @return NULL.
+ */
+void* ObjectLibrary::watchObjects(void* library) {
+    ObjectLibrary* self = static_cast<ObjectLibrary*> (library);
+    boost::scoped_ptr<DirectoryWatcher> watcher;
+    if (self->watchDirectory) {
+        watcher.reset(new DirectoryWatcher(self->libDirString));
+    }
+
+    cv::Ptr<cv::FeatureDetector> detector = new cv::SurfFeatureDetector(self->config.hessianThreshold);
+    cv::Ptr<cv::DescriptorExtractor> extractor = new cv::SurfDescriptorExtractor();
+    string extArr[] = {".jpg", ".png", ".bmp", ".tiff"}; //Same as createObjects.
+
+    while (true) {
+        self->objectsMutex.lock();
+        bool stop = self->stopLoading;
+        self->objectsMutex.unlock();
+        if (stop) {
+            break;
+        }
+
+        //Objects added by the loaders or by the last round of changes are
+        //stored and indexed in batches, rather than rebuilding for each one.
+        self->updateStore();
+
+        //Short timeout so the destructor isn't kept waiting.
+        std::vector<DirectoryWatcher::Change> changes;
+        if (!watcher || !watcher->isWatching()) {
+            usleep(250 * 1000);
+            continue;
+        }
+        if (watcher->waitForChanges(changes, 250) == 0) {
+            continue;
+        }
+
+        //An editor may write the same file several times; only the last change counts.
+        bool rescanNeeded = false;
+        std::map<string, DirectoryWatcher::ChangeType> latest;
+        for (unsigned int i = 0; i < changes.size(); i++) {
+            if (changes[i].type == DirectoryWatcher::EVENTS_LOST) {
+                rescanNeeded = true;
+            } else {
+                latest[changes[i].path] = changes[i].type;
+            }
+        }
+
+        try {
+            if (rescanNeeded) {
+                self->rescan(detector, extractor);
+                continue;
+            }
+
+            for (std::map<string, DirectoryWatcher::ChangeType>::iterator it = latest.begin();
+                    it != latest.end(); ++it) {
+                bool isImage = false;
+                for (int i = 0; i < sizeOf(extArr); i++) {
+                    isImage = isImage || (fs::path(it->first).extension() == extArr[i]);
+                }
+                if (!isImage) {
+                    continue;
+                }
+
+                if (it->second == DirectoryWatcher::FILE_REMOVED) {
+                    self->removeObject(it->first);
+                } else {
+                    int64_t modified = modificationTime(it->first);
+                    ObjectPtr object = self->createObject(it->first, detector, extractor);
+                    if (object) {
+                        std::cout << "Updated object: " << it->first << std::endl;
+                        self->publishObject(it->first, modified, object);
+                    }
+                }
+            }
+        } catch (const std::exception & ex) {
+            //Do nothing and ignore error.
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * Drop the files this library doesn't own (if sharded). updateMutex must be
+ * locked.
+ * 
+ * @param files Paths of image files.
+ */
+void ObjectLibrary::keepOwnedFiles(std::vector<string>& files) {
+    if (!sharded) {
+        return;
+    }
+
+    std::vector<string> owned;
+    for (unsigned int i = 0; i < files.size(); i++) {
+        if (ownedFiles.find(files[i]) != ownedFiles.end()) {
+            owned.push_back(files[i]);
+        }
+    }
+    files.swap(owned);
+}
+
+/**
+ * Find the image files in a directory.
  * 
  * @authors Jeff Garland, Beman Dawes and Aydin Arik
- * @return Objects created sucessfully (0), not path specified was not found (1).
+ * @param directory Directory to search.
+ * @param files Paths of image files found.
+ * @return Directory found (0), not found (1).
  */
-int ObjectLibrary::createObjects() {
-    fs::path path(libDirString);
+int ObjectLibrary::findImageFiles(const string& directory, std::vector<string>& files) {
+    fs::path path(directory);
     string extArr[] = {".jpg", ".png", ".bmp", ".tiff"}; //More files could be added if necessary.
 
 
@@ -111,12 +902,10 @@ int ObjectLibrary::createObjects() {
                     
                     //Check file in directory is a valid image file.
                     for (int i = 0; i < sizeOf(extArr); i++) { 
-                        //If it is a valid image file, then create an 'Object' object and place this in the library.
+                        //If it is a valid image file, add it to the list.
                         if (dir_itr->path().extension() == extArr[i]) { 
-                            string fileName = dir_itr->path().stem().string();
-                            objects.push_back(*(new Object(fileName, cv::imread(dir_itr->path().string(), CV_LOAD_IMAGE_GRAYSCALE))));
+                            files.push_back(dir_itr->path().string());
                             ++file_count;
-                            totalNumOfObjects = file_count;
                         }
                     }
                 }
@@ -135,3 +924,40 @@ int ObjectLibrary::createObjects() {
     return 0;
 }
 
+/**
+ * Searches a specified folder for object images, then stores them. The filename 
+ * is used as the name of the object, up to the first '.', so several images 
+ * (e.g. mug.jpg, mug.side.jpg) can be views of one object. Uses the Boost Filesystem Library.
+ * Objects are created by loader tasks, so this returns before all objects
+ * are ready.
+ * 
+ * @param numOfThreads Number of loader tasks to use (0 for one per worker).
+ * @return Objects created sucessfully (0), not path specified was not found (1).
+ */
+int ObjectLibrary::createObjects(int numOfThreads) {
+    if (findImageFiles(libDirString, filesToLoad) != 0) {
+        return 1;
+    }
+    updateMutex.lock();
+    keepOwnedFiles(filesToLoad);
+    updateMutex.unlock();
+
+    //Queue the loader tasks. No more tasks than workers or files.
+    int numOfWorkers = TaskExecutor::getDefault().size();
+    if (numOfThreads <= 0 || numOfThreads > numOfWorkers) {
+        numOfThreads = numOfWorkers;
+    }
+    if (numOfThreads > (int) filesToLoad.size()) {
+        numOfThreads = filesToLoad.size();
+    }
+
+    objectsMutex.lock();
+    numOfLoaders += numOfThreads;
+    objectsMutex.unlock();
+
+    for (int i = 0; i < numOfThreads; i++) {
+        loaders.run(&ObjectLibrary::loadObjects, this);
+    }
+    
+    return 0;
+}
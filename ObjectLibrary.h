@@ -1,7 +1,11 @@
 /** 
  * @file ObjectLibrary.h
  * @author Aydin Arik 
- * @brief 
+ * @brief A library of objects to easily scan over when trying to find an object
+ *        in a (video) frame. Object images are decoded and their features
+ *        extracted by loader tasks on the shared TaskExecutor. The library directory is
+ *        then watched, and objects are added, re-extracted or removed as their
+ *        image files change.
  */
 
 #ifndef OBJECTLIBRARY_H
@@ -11,46 +15,359 @@
  *                              Header Files
  ******************************************************************************/
 #include <cstring>
+#include <vector>
+#include <map>
+#include <set>
+#include <ctime>
+#include <stdint.h>
+#include <pthread.h>
+#include <boost/shared_ptr.hpp>
 #include "Object.h"
+#include "Mutex.h"
+#include "TaskExecutor.h"
+#include "VocabularyTree.h"
+#include "ObjectIndex.h"
+#include "LibraryStore.h"
+#include "RecognitionConfig.h"
+
+// Directory searched for object images.
+#define OBJECT_LIBRARY_DIR "../../Images/Objects/"
+
+
+/******************************************************************************
+ *                              Types
+ ******************************************************************************/
+/**
+ * An immutable view of the library. A new snapshot is published (copy-on-write)
+ * whenever objects are added, changed or removed. Readers that hold an older
+ * snapshot keep using it untouched until they let it go, so they never wait on
+ * feature extraction.
+ * 
+ * The store and index are rebuilt together in the background, so they may lag
+ * behind objects for a moment. Objects added since they were built are listed
+ * in pending, and carry their own features until the next rebuild.
+ */
+struct LibrarySnapshot {
+    std::vector<ObjectPtr> objects;
+    std::vector<std::string> files; //Image file of each object (parallel to objects).
+    boost::shared_ptr<const LibraryStore> store; //Contiguous features of stored objects.
+    boost::shared_ptr<const ObjectIndex> index; //Index of store (empty without a vocabulary).
+    std::vector<ObjectPtr> pending; //Objects not yet in store or index.
+};
+typedef boost::shared_ptr<const LibrarySnapshot> LibrarySnapshotPtr;
 
 /******************************************************************************
  *                              Class
  ******************************************************************************/
 class ObjectLibrary {
 private:
-    int objectIterator; //Current object of interest in the library.
-    int totalNumOfObjects;
+    int objectIterator; //Current object of interest in the library (see getNextObject()).
     std::string libDirString; //Directory to search for object images.
-    std::vector <Object> objects; //List (library) of objects.
+    std::string vocabularyFile; //Base name of the visual vocabulary files.
+    VocabularyTree vocabulary; //Loaded before any objects are created, then read-only.
+    RecognitionConfig config; //Feature and pruning settings (read-only once constructed).
+
+    //
+    //Published library. snapshot, numOfLoaders and stopLoading are guarded by
+    //objectsMutex, which is only ever held long enough to copy or swap a pointer.
+    //
+    LibrarySnapshotPtr snapshot;
+    Mutex objectsMutex;
+    Condition objectsChanged; //Signalled when a snapshot is published or loading finishes.
+
+    //
+    //Loading related variables. filesToLoad and nextFileToLoad are guarded by
+    //objectsMutex.
+    //
+    std::vector<std::string> filesToLoad; //Image files found in libDirString.
+    TaskGroup loaders; //Loader tasks, run on the shared TaskExecutor.
+    unsigned int nextFileToLoad; //Index into filesToLoad of the next file to claim.
+    int numOfLoaders; //Loader tasks that are still running.
+    bool stopLoading; //Set to make loader tasks and the watcher thread exit early.
+
+    //
+    //Updating related variables. Guarded by updateMutex, which serialises
+    //writers (loaders and the watcher) without blocking readers.
+    //
+    std::map<std::string, int64_t> fileTimes; //Modification time of each published file (nanoseconds).
+    std::set<std::string> ownedFiles; //Files of the library directory this library may load (if sharded).
+    bool sharded; //True if only ownedFiles are loaded (see assignFiles()).
+    bool storeStale; //True if objects have changed since the store was built.
+    Mutex updateMutex;
+    pthread_t watcherThread;
+    bool watching; //True if watcherThread was started.
+    bool watchDirectory; //True if watcherThread should watch libDirString.
 
     /**
-     * Searches a specified folder for object images, then stores them. The filename 
-     * is used as the name of the object. Uses the Boost Filesystem Library.
-     * 
+     * Searches a specified folder for object images, then stores them. The filename
+     * is used as the name of the object, up to the first '.', so several images
+     * (e.g. mug.jpg, mug.side.jpg) can be views of one object. Uses the Boost Filesystem Library.
+     * Objects are created by loader tasks, so this returns before all objects
+     * are ready.
+     *
      * @authors Jeff Garland, Beman Dawes and Aydin Arik
+     * @param numOfThreads Number of loader tasks to use (0 for one per worker).
      * @return Objects created sucessfully (0), not path specified was not found (1).
      */
-    int createObjects();
+    int createObjects(int numOfThreads);
+
+    /**
+     * Drop the files this library doesn't own (if sharded). updateMutex must
+     * be locked.
+     *
+     * @param files Paths of image files.
+     */
+    void keepOwnedFiles(std::vector<std::string>& files);
+
+    /**
+     * A loader task. Claims files one at a time, decodes them and extracts
+     * features. Each task only holds one decoded image at a time, which bounds
+     * memory use while loading. The last task to finish builds the store and
+     * index.
+     *
+     * @param library The ObjectLibrary that started the task.
+     */
+    static void loadObjects(void* library);
+
+    /**
+     * Entry point of the watcher thread. Extracts features of files that are
+     * created or changed in the library directory and removes objects whose
+     * files are removed. Also rebuilds the store and index when objects have changed.
+     *
+     * @param library The ObjectLibrary that started the thread.
+     * @return NULL.
+     */
+    static void* watchObjects(void* library);
+
+    /**
+     * Decode an image file, extract its features, prune unstable keypoints
+     * (see StabilityPruner) and quantise them. Files named
+     * <name>.<anything>.<ext> are all views of the object <name>.
+     *
+     * @param file Image file.
+     * @param detector Feature detector used on the image.
+     * @param extractor Descriptor extractor used on the image.
+     * @return The new object, or an empty pointer if the image could not be read.
+     */
+    ObjectPtr createObject(const std::string& file,
+            const cv::Ptr<cv::FeatureDetector>& detector,
+            const cv::Ptr<cv::DescriptorExtractor>& extractor);
+
+    /**
+     * Publish a new snapshot in which the object for a file is added or replaced.
+     * Ignored if a newer version of the file has already been published.
+     *
+     * @param file Image file the object was created from.
+     * @param modified Modification time of the file when it was read (nanoseconds).
+     * @param object The object.
+     */
+    void publishObject(const std::string& file, int64_t modified, const ObjectPtr& object);
+
+    /**
+     * Publish a new snapshot without the object for a file.
+     *
+     * @param file Image file the object was created from.
+     */
+    void removeObject(const std::string& file);
+
+    /**
+     * Compare the library directory against the published files, extract any
+     * new or changed files and remove any missing ones. Used when inotify
+     * events have been lost.
+     *
+     * @param detector Feature detector used on new images.
+     * @param extractor Descriptor extractor used on new images.
+     */
+    void rescan(const cv::Ptr<cv::FeatureDetector>& detector,
+            const cv::Ptr<cv::DescriptorExtractor>& extractor);
+
+    /**
+     * Publish a new snapshot with a freshly built store and index, if objects
+     * have changed since the last ones were built.
+     */
+    void updateStore();
+
+    /**
+     * Swap in a new snapshot. updateMutex must be locked.
+     *
+     * @param newSnapshot The snapshot to publish.
+     */
+    void publish(const LibrarySnapshotPtr& newSnapshot);
+
+    /**
+     * Wait (objectsMutex must be locked) until at least one object is available
+     * or loading has finished.
+     */
+    void waitForFirstObject();
+
+    ObjectLibrary(const ObjectLibrary&); //Not copyable.
+    ObjectLibrary& operator=(const ObjectLibrary&);
 public:
-    ObjectLibrary();
 
     /**
-     * Get the first object in the library.
-     * 
-     * @return The first object in library.
+     * Constructor. Starts loading the library.
+     *
+     * @param numOfThreads Number of loader tasks to use (0 for one per worker).
+     * @param waitForAll If true, block until every object is loaded. Otherwise
+     *        return straight away, and let objects stream in as they're ready.
+     * @param watch If true, watch the library directory for changes.
+     * @param config Settings used to find and prune object features.
+     * @param files If given, only these files of the library directory are
+     *        loaded (e.g. one shard of it, see ShardWorker), rather than all.
      */
-    Object getFirst();
+    ObjectLibrary(int numOfThreads = 0, bool waitForAll = false, bool watch = true,
+            const RecognitionConfig& config = RecognitionConfig(),
+            const std::vector<std::string>* files = NULL);
+
+    ~ObjectLibrary();
 
     /**
-     * Get the next object in the library.
-     * 
-     * @return The next object in library.
+     * Get the first object in the library. Blocks until at least one object
+     * has been loaded.
+     *
+     * @return Model of the first object in library.
      */
-    Object getNextObject();
+    ModelView getFirst();
 
+    /**
+     * Get the next object in the library. Blocks until at least one object
+     * has been loaded. Objects still being loaded join the rotation when ready.
+     *
+     * @return Model of the next object in library.
+     */
+    ModelView getNextObject();
+
+    /**
+     * Get the next object in the library for a caller that keeps its own place
+     * in the rotation (e.g. one per camera).
+     *
+     * @param iterator The callers current object of interest. Advanced past the
+     *        object returned.
+     * @return Model of the next object in library.
+     */
+    ModelView getNextObject(int& iterator);
+
+    /**
+     * Get the current library snapshot. The snapshot never changes, so it can
+     * be used without locking for as long as it is held.
+     *
+     * @return The current snapshot.
+     */
+    LibrarySnapshotPtr getSnapshot();
+
+    /**
+     * Get the objects worth matching against a frame. With a vocabulary, the
+     * frame is quantised once and scored against the index, and only the best
+     * objects are returned. Without one, this is just the next object.
+     *
+     * @param frameDescriptors Descriptors of the frame.
+     * @param maxCandidates Maximum number of indexed objects to return (top-K).
+     * @param candidates Objects to match against the frame, best first.
+     * @param iterator The callers place in the rotation, used without an index.
+     */
+    void getCandidates(const cv::Mat& frameDescriptors, int maxCandidates,
+            std::vector<ModelView>& candidates, int& iterator);
+
+    /**
+     * Get the objects worth matching against a frame, with how well the frame
+     * matches each on the index, so shortlists of several libraries can be
+     * merged (see ShardCoordinator). Without an index, this is the next
+     * objects in the rotation.
+     *
+     * @param frameDescriptors Descriptors of the frame.
+     * @param maxCandidates Maximum number of objects to return (top-K).
+     * @param candidates Objects to match against the frame, best first.
+     * @param scores Index score of each candidate (1 for objects not yet
+     *        indexed, 0 without an index).
+     * @param iterator The callers place in the rotation, used without an index.
+     */
+    void getCandidates(const cv::Mat& frameDescriptors, int maxCandidates,
+            std::vector<ModelView>& candidates, std::vector<float>& scores, int& iterator);
+
+    /**
+     * Get an object by name.
+     *
+     * @param objectName Name of the object.
+     * @param model Model of the object, if found.
+     * @return True if the object is in the library.
+     */
+    bool getModel(const std::string& objectName, ModelView& model);
+
+    /**
+     * Get every object in the library, with how well the frame matches it
+     * on the index (see ObjectScheduler). Blocks until at least one object
+     * has been loaded.
+     *
+     * @param frameDescriptors Descriptors of the frame.
+     * @param models Every object.
+     * @param scores Index score of each object (0 if it isn't indexed, or
+     *        there is no vocabulary).
+     */
+    void scoreObjects(const cv::Mat& frameDescriptors, std::vector<ModelView>& models,
+            std::vector<float>& scores);
+
+    /**
+     * Get the objects worth matching against each frame of a batch. The whole
+     * batch is scored against the index at once. Without an index, every
+     * object is a candidate for every frame.
+     *
+     * @param frameDescriptors Descriptors of each frame.
+     * @param maxCandidates Maximum number of indexed objects to return per frame (top-K).
+     * @param candidates Objects to match against each frame, best first.
+     */
+    void getCandidates(const std::vector<cv::Mat>& frameDescriptors, int maxCandidates,
+            std::vector<std::vector<ModelView> >& candidates);
+
+    /**
+     * Train a visual vocabulary from the descriptors of every loaded object,
+     * and save it where the library will load it next time. Slow; run offline.
+     *
+     * @param branching Number of children of each vocabulary tree node.
+     * @param depth Number of levels in the vocabulary tree.
+     */
+    void trainVocabulary(int branching, int depth);
+
+    /**
+     * Change which files of the library directory this library owns. Objects
+     * of files no longer owned are removed, and newly owned files are loaded
+     * by loader tasks, so this returns before they are ready.
+     *
+     * @param files Files of the library directory to own.
+     */
+    void assignFiles(const std::vector<std::string>& files);
+
+    /**
+     * Find the image files in a directory.
+     *
+     * @param directory Directory to search.
+     * @param files Paths of image files found.
+     * @return Directory found (0), not found (1).
+     */
+    static int findImageFiles(const std::string& directory, std::vector<std::string>& files);
+
+    /**
+     * Block until every object in the library directory has been loaded, and
+     * stored and indexed.
+     */
+    void waitUntilLoaded();
+
+    /**
+     * @return True if every object in the library directory has been loaded,
+     *         and stored and indexed.
+     */
+    bool isLoaded();
+
+    /**
+     * @return Number of object images (views) currently loaded.
+     */
+    int getNumOfObjects();
+
+    /**
+     * @return Settings the library was built with.
+     */
+    const RecognitionConfig& getConfig() const;
 };
 
 
 
 #endif	/* OBJECTLIBRARY_H */
-
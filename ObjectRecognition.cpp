@@ -9,58 +9,457 @@
  *                              Header Files
  ******************************************************************************/
 #include "ObjectRecognition.h"
+#include "Mutex.h"
+#include "TaskExecutor.h"
+#include <algorithm>
+
+
+/******************************************************************************
+ *                              Types
+ ******************************************************************************/
+/**
+ * Work shared by the tasks of ObjectRecognition::runBatch(). Frames are
+ * claimed one at a time, first to find features, then to match candidates.
+ */
+struct BatchJob {
+    const std::vector<cv::Mat>* frames;
+    const Matcher* matcher; //Settings copied by each worker.
+    double hessianThreshold; //SURF Hessian threshold of frame features.
+    bool matching; //False while finding features, true while matching.
+    std::vector<std::vector<cv::KeyPoint> > keypoints; //Of each frame.
+    std::vector<cv::Mat> descriptors; //Of each frame.
+    std::vector<std::vector<ModelView> > candidates; //Of each frame.
+    std::vector<std::vector<Detection> >* detections; //Of each frame.
+    Mutex mutex; //Guards next.
+    unsigned int next; //Next frame to claim.
+};
+
+/**
+ * One candidate object to match against a frame, as a task of its own.
+ */
+struct CandidateJob {
+    Matcher matcher; //Copy of the recogniser's matcher.
+    const ModelView* candidate;
+    const std::vector<cv::KeyPoint>* frameKeypoints;
+    const cv::Mat* frameDescriptors;
+    Detection detection;
+    bool found;
+};
+
+
+/******************************************************************************
+ *                              Functions
+ ******************************************************************************/
+static bool betterDetection(const Detection& a, const Detection& b) {
+    return a.score > b.score;
+}
+
+/**
+ * @return Current time (seconds, CLOCK_MONOTONIC).
+ */
+static double monotonicSeconds() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * Match an object against a frame.
+ * 
+ * @param matcher Matcher to use.
+ * @param candidate Object to look for.
+ * @param frameKeypoints Keypoints of the frame.
+ * @param frameDescriptors Descriptors of the frame.
+ * @param detection The object, if found.
+ * @return True if the matcher accepted the object.
+ */
+static bool findDetection(Matcher& matcher, const ModelView& candidate,
+        const std::vector<cv::KeyPoint>& frameKeypoints, const cv::Mat& frameDescriptors,
+        Detection& detection) {
+    if (candidate.getNumOfViews() == 0) {
+        return false;
+    }
+
+    matcher.match(candidate, frameKeypoints, frameDescriptors, detection.matches, detection.view);
+    int numOfKeypoints = detection.view.getNumOfKeypoints();
+    if (detection.matches.empty()) {
+        return false; //Not accepted by the matcher.
+    }
+
+    std::vector<cv::Point2f> points;
+    for (unsigned int m = 0; m < detection.matches.size(); m++) {
+        points.push_back(frameKeypoints[detection.matches[m].trainIdx].pt);
+    }
+    detection.objectName = candidate.getObjectName();
+    detection.score = (float) detection.matches.size() / std::max(numOfKeypoints, 1);
+    detection.boundingBox = cv::boundingRect(cv::Mat(points));
+    return true;
+}
+
+/**
+ * Match one candidate object against a frame.
+ * 
+ * @param candidateJob The CandidateJob.
+ */
+static void runCandidateJob(void* candidateJob) {
+    CandidateJob* job = static_cast<CandidateJob*> (candidateJob);
+    try {
+        job->found = findDetection(job->matcher, *job->candidate, *job->frameKeypoints,
+                *job->frameDescriptors, job->detection);
+    } catch (cv::Exception& ex) {
+        //Do nothing...the candidate is treated as not found.
+    }
+}
+
+/**
+ * Match candidate objects against a frame and keep the ones found.
+ * 
+ * @param matcher Matcher to use.
+ * @param candidates Objects to look for.
+ * @param frameKeypoints Keypoints of the frame.
+ * @param frameDescriptors Descriptors of the frame.
+ * @param detections Objects found, best first.
+ * @param parallel If true, match each candidate as a task of its own (each
+ *        with a copy of the matcher) on the shared TaskExecutor.
+ */
+static void findDetections(Matcher& matcher, const std::vector<ModelView>& candidates,
+        const std::vector<cv::KeyPoint>& frameKeypoints, const cv::Mat& frameDescriptors,
+        std::vector<Detection>& detections, bool parallel = false) {
+    if (parallel && candidates.size() > 1) {
+        std::vector<CandidateJob> jobs(candidates.size());
+        TaskGroup group;
+        for (unsigned int i = 0; i < candidates.size(); i++) {
+            jobs[i].matcher = matcher;
+            jobs[i].candidate = &candidates[i];
+            jobs[i].frameKeypoints = &frameKeypoints;
+            jobs[i].frameDescriptors = &frameDescriptors;
+            jobs[i].found = false;
+            group.run(runCandidateJob, &jobs[i]);
+        }
+        group.wait();
+
+        for (unsigned int i = 0; i < jobs.size(); i++) {
+            if (jobs[i].found) {
+                detections.push_back(jobs[i].detection);
+            }
+        }
+    } else {
+        for (unsigned int i = 0; i < candidates.size(); i++) {
+            Detection detection;
+            if (findDetection(matcher, candidates[i], frameKeypoints, frameDescriptors, detection)) {
+                detections.push_back(detection);
+            }
+        }
+    }
+
+    std::sort(detections.begin(), detections.end(), betterDetection);
+}
+
+/**
+ * A runBatch() task. Claims frames until none are left.
+ * 
+ * @param batchJob The BatchJob.
+ */
+static void runBatchWorker(void* batchJob) {
+    BatchJob* job = static_cast<BatchJob*> (batchJob);
+
+    //Each worker has its own matcher, and its own detector while finding features.
+    Matcher matcher = *job->matcher;
+    if (!job->matching) {
+        cv::Ptr<cv::FeatureDetector> detector = new cv::SurfFeatureDetector(job->hessianThreshold);
+        cv::Ptr<cv::DescriptorExtractor> extractor = new cv::SurfDescriptorExtractor();
+        matcher.setFeatureDetector(detector);
+        matcher.setDescriptorExtractor(extractor);
+    }
+
+    while (true) {
+        job->mutex.lock();
+        unsigned int f = job->next++;
+        job->mutex.unlock();
+        if (f >= job->frames->size()) {
+            break;
+        }
+
+        try {
+            if (!job->matching) {
+                cv::Mat frame = (*job->frames)[f];
+                if (frame.data) {
+                    matcher.detectFeatures(frame, job->keypoints[f], job->descriptors[f]);
+                }
+            } else {
+                findDetections(matcher, job->candidates[f], job->keypoints[f],
+                        job->descriptors[f], (*job->detections)[f]);
+            }
+        } catch (cv::Exception& ex) {
+            //Do nothing...leave this frame without features or detections.
+        }
+    }
+}
+
+/**
+ * Run every frame of a batch job through the shared TaskExecutor, and wait
+ * for it.
+ * 
+ * @param job The job.
+ * @param numOfTasks Number of tasks claiming frames.
+ */
+static void runBatchWorkers(BatchJob& job, int numOfTasks) {
+    job.next = 0;
+    TaskGroup group;
+    for (int i = 0; i < numOfTasks; i++) {
+        group.run(runBatchWorker, &job);
+    }
+    group.wait();
+}
 
 
 /******************************************************************************
  *                              Methods
  ******************************************************************************/
-ObjectRecognition::ObjectRecognition() {
-    currObjectToLookFor = objects.getFirst();
+/**
+ * Constructor. One per camera; the library is only read, so any number of
+ * these can share it and run on different threads. Uses the library's
+ * settings (see configure()).
+ * 
+ * @param objects Library of objects to look for.
+ * @param windowName Window to draw results in.
+ */
+ObjectRecognition::ObjectRecognition(ObjectLibrary& objects, const std::string& windowName)
+: objects(objects), display(windowName) {
+    currObjectToLookFor = objects.getFirst().getView(0);
+    objectIterator = 0;
+    haveResult = false;
+    resultTime.tv_sec = 0;
+    resultTime.tv_nsec = 0;
     
-    // Prepare the matcher
-    matcher.setConfidenceLevel(0.85);
-    matcher.setMinDistanceToEpipolar(3.0);
-    matcher.setRatio(1.5f);
     matcher.refineFundamental(true);
-    cv::Ptr<cv::FeatureDetector> pfd = new cv::SurfFeatureDetector(1250);
+    configure(objects.getConfig());
+}
+
+/**
+ * Change the matcher, shortlist and reuse settings. The Hessian threshold
+ * should match the library's, so frame and object features are alike.
+ * 
+ * @param config Settings to use.
+ */
+void ObjectRecognition::configure(const RecognitionConfig& config) {
+    maxCandidates = config.maxCandidates;
+    maxReuseAge = config.maxReuseAge;
+    hessianThreshold = config.hessianThreshold;
+    scheduled = (config.frameBudget > 0);
+    scheduler.setBudget(config.frameBudget, config.maxObjectStaleness);
+    configureMatcher(matcher, config);
+
+    haveResult = false; //Results found with old settings aren't reused.
+    changeDetector.reset();
+}
+
+/**
+ * Apply the matcher settings of a configuration (and a frame feature detector
+ * with its Hessian threshold) to a matcher.
+ * 
+ * @param matcher Matcher to configure.
+ * @param config Settings to use.
+ */
+void ObjectRecognition::configureMatcher(Matcher& matcher, const RecognitionConfig& config) {
+    matcher.setConfidenceLevel(config.confidenceLevel);
+    matcher.setMinDistanceToEpipolar(config.minDistanceToEpipolar);
+    matcher.setRatio(config.ratio);
+    matcher.setMinMatchedShare(config.minMatchedShare);
+    matcher.setKeypointBudget(KeypointBudget(config.maxFrameKeypoints,
+            config.gridSelection ? KeypointBudget::GRID : KeypointBudget::ANMS));
+    matcher.setPoseClustering(config.poseClustering);
+    matcher.setPyramidLevel(config.pyramidLevel);
+    cv::Ptr<cv::FeatureDetector> pfd = new cv::SurfFeatureDetector(config.hessianThreshold);
     matcher.setFeatureDetector(pfd);
 }
 
 /**
- * Run through and find matches in the (video) frame and current object image and 
- * display results.
+ * Match candidate objects against a frame, each as a task of its own on the
+ * shared TaskExecutor, and keep the ones found.
+ * 
+ * @param matcher Matcher to use (copied by each task).
+ * @param candidates Objects to look for.
+ * @param frameKeypoints Keypoints of the frame.
+ * @param frameDescriptors Descriptors of the frame.
+ * @param detections Objects found, best first.
+ */
+void ObjectRecognition::verify(Matcher& matcher, const std::vector<ModelView>& candidates,
+        const std::vector<cv::KeyPoint>& frameKeypoints, const cv::Mat& frameDescriptors,
+        std::vector<Detection>& detections) {
+    findDetections(matcher, candidates, frameKeypoints, frameDescriptors, detections, true);
+}
+
+/**
+ * Run through and find matches in the (video) frame and the objects shortlisted
+ * by the library (or the next object, without a vocabulary) and display results.
  * 
  * @param frame Input frame from camera.
  * @param displayImg Image to display or save.
  * @return Success (1) or failure (0) to completely execute object recognition.
  */
 int ObjectRecognition::run(cv::Mat frame, cv::Mat& displayImg) {
+    RecognitionResultPtr result = recognise(frame);
+    if (!result) {
+        return 0;
+    }
+
+    display.render(*result, displayImg);
+    display.draw(displayImg);
+
+    return 1; //Success.
+}
+
+/**
+ * Find objects in a (video) frame without drawing anything, so it can run on
+ * a different thread to rendering (see OverlayRenderer). If the frame has 
+ * barely changed since objects were last recognised, and that result is 
+ * younger than the maximum reuse age, the result is reused rather than found
+ * again.
+ * 
+ * @param frame Input frame from camera. The result refers to it, so it must 
+ *        not be written to afterwards.
+ * @param trace Where the frame came from and when it got here (carried into
+ *        the result, stamped with when it was recognised).
+ * @return The result, or an empty pointer if the frame has no data.
+ */
+RecognitionResultPtr ObjectRecognition::recognise(cv::Mat frame, const FrameTrace& trace) {
     
     timer.recordTime(); //Start profiling.
     
-    currObjectToLookFor = objects.getNextObject();
-    cv::Mat currObjImg = currObjectToLookFor.getImage();
-    
     //Double checking to see there is image data. This should never be entered 
-    //unless initialisation of camera and ObjectLibrary isn't done.
-    if (!currObjImg.data || !frame.data)
-        return 0; //Failure to process further in object recognition code.
+    //unless initialisation of camera isn't done.
+    if (!frame.data)
+        return RecognitionResultPtr(); //Failure to process further in object recognition code.
+
+    //A static scene gives the same answer as last time, so reuse it (for a while).
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double resultAge = (now.tv_sec - resultTime.tv_sec) + (now.tv_nsec - resultTime.tv_nsec) / 1e9;
+    bool changed = changeDetector.hasChanged(frame);
+    bool reuse = !changed && haveResult && resultAge < maxReuseAge;
+    if (!reuse) {
+
+        double frameStart = monotonicSeconds();
+
+        //Frame features are found once and shared by every candidate object.
+        frameKeypoints.clear();
+        cv::Mat frameDescriptors;
+        matcher.detectFeatures(frame, frameKeypoints, frameDescriptors);
+
+        std::vector<ModelView> candidates;
+        detections.clear();
+        if (scheduled) {
+            //Verify objects most likely to be in view first, until the frame's
+            //time is used up (at least one object is always verified).
+            std::vector<float> scores;
+            std::vector<int> order;
+            objects.scoreObjects(frameDescriptors, candidates, scores);
+            scheduler.schedule(candidates, scores, monotonicSeconds(), order);
 
-    //Aids in matching and drawing...
-    std::vector<cv::DMatch> matches;
-    std::vector<cv::KeyPoint> frameKeypoints;
+            std::vector<ModelView> verified;
+            for (unsigned int i = 0; i < order.size(); i++) {
+                const ModelView& candidate = candidates[order[i]];
+                double start = monotonicSeconds();
+                if (i > 0 && !scheduler.fits(candidate.getObjectName(), start - frameStart)) {
+                    break;
+                }
 
-    //Finds physical similarities in image of object and video frame.
-    matcher.match(currObjectToLookFor, frame, matches, frameKeypoints);
+                Detection detection;
+                bool found = findDetection(matcher, candidate, frameKeypoints, frameDescriptors, detection);
+                double end = monotonicSeconds();
+                scheduler.checked(candidate.getObjectName(), end, end - start, found ? detection.score : 0);
+                if (found) {
+                    detections.push_back(detection);
+                }
+                verified.push_back(candidate);
+            }
+            std::sort(detections.begin(), detections.end(), betterDetection);
+            candidates.swap(verified);
+        } else {
+            objects.getCandidates(frameDescriptors, maxCandidates, candidates, objectIterator);
+
+            //Finds physical similarities in the views of each candidate object and
+            //video frame, keeping those the matcher accepts. Candidates are
+            //independent, so they are matched in parallel.
+            findDetections(matcher, candidates, frameKeypoints, frameDescriptors, detections, true);
+        }
+
+        if (!detections.empty()) {
+            currObjectToLookFor = detections[0].view;
+        } else if (!candidates.empty() && candidates[0].getNumOfViews() > 0) {
+            currObjectToLookFor = candidates[0].getView(0);
+        }
+
+        changeDetector.accept();
+        resultTime = now;
+        haveResult = true;
+    }
 
     timer.recordTime(); //End profiling.
-    
-    display.displayMatching(currObjectToLookFor, frame, frameKeypoints, matches, displayImg);
-    display.displayFPS(displayImg, timer.getTimeDiffAvg());
- 
-    display.draw(displayImg);
-    
-    
-    
-    return 1; //Success.
-}
\ No newline at end of file
+
+    boost::shared_ptr<RecognitionResult> result(new RecognitionResult());
+    result->frame = frame;
+    result->frameKeypoints = frameKeypoints;
+    result->detections = detections;
+    result->object = currObjectToLookFor;
+    result->timeDiff = timer.getTimeDiffAvg();
+    result->reused = reuse;
+    result->trace = trace;
+    result->trace.recognised = FrameTrace::now();
+
+    return result;
+}
+
+/**
+ * Set how long a result may be reused while frames are unchanged.
+ * 
+ * @param seconds Maximum age of a reused result (0 to recognise every frame).
+ */
+void ObjectRecognition::setMaxReuseAge(double seconds) {
+    maxReuseAge = seconds;
+}
+
+/**
+ * Recognise objects in a batch of frames (e.g. an archive of images), with
+ * no display. Features of the whole batch are found in parallel, the batch
+ * is scored against the library index at once, and then the frames are
+ * matched against their candidates in parallel.
+ * 
+ * @param frames Input frames.
+ * @param detections Objects found in each frame, best first.
+ * @param numOfThreads Number of tasks to split the batch over (0 for one per
+ *        TaskExecutor worker).
+ */
+void ObjectRecognition::runBatch(const std::vector<cv::Mat>& frames,
+        std::vector<std::vector<Detection> >& detections,
+        int numOfThreads) {
+    detections.assign(frames.size(), std::vector<Detection>());
+    if (frames.empty()) {
+        return;
+    }
+
+    if (numOfThreads <= 0) {
+        numOfThreads = TaskExecutor::getDefault().size();
+    }
+    numOfThreads = std::max(std::min(numOfThreads, (int) frames.size()), 1);
+
+    BatchJob job;
+    job.frames = &frames;
+    job.matcher = &matcher;
+    job.hessianThreshold = hessianThreshold;
+    job.detections = &detections;
+    job.keypoints.resize(frames.size());
+    job.descriptors.resize(frames.size());
+
+    //1. Features of every frame.
+    job.matching = false;
+    runBatchWorkers(job, numOfThreads);
+
+    //2. Candidates of every frame, from one pass over the index.
+    objects.getCandidates(job.descriptors, maxCandidates, job.candidates);
+
+    //3. Match and verify the candidates of every frame.
+    job.matching = true;
+    runBatchWorkers(job, numOfThreads);
+}
@@ -17,6 +17,11 @@
 #include "Display.h"
 #include "ObjectLibrary.h"
 #include "Matcher.h"
+#include "Detection.h"
+#include "FrameChangeDetector.h"
+#include "RecognitionConfig.h"
+#include "ObjectScheduler.h"
+#include <time.h>
 
 /******************************************************************************
  *                              Class
@@ -24,22 +29,115 @@
 class ObjectRecognition {
 private:
     Timer timer; //Used to get average time difference so that the frame-rate can be displayed.
-    ObjectLibrary objects; //Library of known object that need to be found if seen.
+    ObjectLibrary& objects; //Library of known object that need to be found if seen (shared by every camera).
     Display display; //Displays what the camera sees along with matches, FPS, etc.
-    Object currObjectToLookFor; //The current object from the objects library we are looking for in video frame.
+    ObjectView currObjectToLookFor; //The current object from the objects library we are looking for in video frame.
     Matcher matcher; //Finds physical similarities in image of object and video frame.
+    int maxCandidates; //Most objects shortlisted by the library index per frame.
+    double hessianThreshold; //SURF Hessian threshold of frame features.
+    int objectIterator; //This cameras place in the library rotation (without an index or scheduler).
+    ObjectScheduler scheduler; //Picks the objects to verify within the frame's time.
+    bool scheduled; //If true, use the scheduler, else the index shortlist (or rotation).
+
+    //
+    //Last result, reused while frames are unchanged.
+    //
+    FrameChangeDetector changeDetector;
+    std::vector<cv::KeyPoint> frameKeypoints; //Keypoints of the last recognised frame.
+    std::vector<Detection> detections; //Objects found in the last recognised frame.
+    timespec resultTime; //When the result was found (CLOCK_MONOTONIC).
+    bool haveResult;
+    double maxReuseAge; //Seconds a result may be reused for.
 public:
-    ObjectRecognition();
 
     /**
-     * Run through and find matches in the (video) frame and current object image and 
-     * display results.
+     * Constructor. One per camera; the library is only read, so any number of
+     * these can share it and run on different threads. Uses the library's
+     * settings (see configure()).
+     * 
+     * @param objects Library of objects to look for.
+     * @param windowName Window to draw results in.
+     */
+    ObjectRecognition(ObjectLibrary& objects,
+            const std::string& windowName = "Object Recognition");
+
+    /**
+     * Run through and find matches in the (video) frame and the objects shortlisted
+     * by the library (or the next object, without a vocabulary) and display results.
      * 
      * @param frame Input frame from camera.
      * @param displayImg Image to display or save.
      * @return Success (1) or failure (0) to completely execute object recognition.
      */
     int run(cv::Mat frame, cv::Mat& displayImg);
+
+    /**
+     * Find objects in a (video) frame without drawing anything, so it can run on
+     * a different thread to rendering (see OverlayRenderer). If the frame has 
+     * barely changed since objects were last recognised, and that result is 
+     * younger than the maximum reuse age, the result is reused rather than found
+     * again.
+     * 
+     * @param frame Input frame from camera. The result refers to it, so it must 
+     *        not be written to afterwards.
+     * @param trace Where the frame came from and when it got here (carried
+     *        into the result, stamped with when it was recognised).
+     * @return The result, or an empty pointer if the frame has no data.
+     */
+    RecognitionResultPtr recognise(cv::Mat frame, const FrameTrace& trace = FrameTrace());
+
+    /**
+     * Change the matcher, shortlist and reuse settings. The Hessian threshold
+     * should match the library's, so frame and object features are alike.
+     * 
+     * @param config Settings to use.
+     */
+    void configure(const RecognitionConfig& config);
+
+    /**
+     * Apply the matcher settings of a configuration (and a frame feature
+     * detector with its Hessian threshold) to a matcher.
+     * 
+     * @param matcher Matcher to configure.
+     * @param config Settings to use.
+     */
+    static void configureMatcher(Matcher& matcher, const RecognitionConfig& config);
+
+    /**
+     * Match candidate objects against a frame, each as a task of its own on
+     * the shared TaskExecutor, and keep the ones found.
+     * 
+     * @param matcher Matcher to use (copied by each task).
+     * @param candidates Objects to look for.
+     * @param frameKeypoints Keypoints of the frame.
+     * @param frameDescriptors Descriptors of the frame.
+     * @param detections Objects found, best first.
+     */
+    static void verify(Matcher& matcher, const std::vector<ModelView>& candidates,
+            const std::vector<cv::KeyPoint>& frameKeypoints, const cv::Mat& frameDescriptors,
+            std::vector<Detection>& detections);
+
+    /**
+     * Set how long a result may be reused while frames are unchanged.
+     * 
+     * @param seconds Maximum age of a reused result (0 to recognise every frame).
+     */
+    void setMaxReuseAge(double seconds);
+
+    /**
+     * Recognise objects in a batch of frames (e.g. an archive of images), with
+     * no display. Features of the whole batch are found in parallel, the batch
+     * is scored against the library index at once, and then the frames are
+     * matched against their candidates in parallel.
+     * 
+     * @param frames Input frames.
+     * @param detections Objects found in each frame, best first.
+     * @param numOfThreads Number of tasks to split the batch over (0 for one per
+     *        TaskExecutor worker).
+     */
+    void runBatch(const std::vector<cv::Mat>& frames,
+            std::vector<std::vector<Detection> >& detections,
+            int numOfThreads = 0);
 };
 
 
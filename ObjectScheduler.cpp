@@ -0,0 +1,169 @@
+/**
+ * @file ObjectScheduler.cpp
+ * @author Aydin Arik
+ * @brief Decides which library objects to verify in a frame, and in what
+ *        order, so recognition fits in a fixed time per frame.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "ObjectScheduler.h"
+#include "Detection.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+using namespace std;
+
+// Weight of each part of an object's priority.
+#define DETECTION_WEIGHT 2.0
+#define INDEX_WEIGHT 1.0
+#define STALENESS_WEIGHT 0.5
+
+// Share of the old average kept when a new verification time is recorded.
+#define COST_SMOOTHING 0.8
+
+
+/******************************************************************************
+ *                              Functions
+ ******************************************************************************/
+static bool higherPriority(const pair<double, int>& a, const pair<double, int>& b) {
+    return a.first > b.first;
+}
+
+
+/******************************************************************************
+ *                              Private Methods
+ ******************************************************************************/
+ObjectScheduler::ObjectState::ObjectState()
+: lastChecked(0), lastDetected(-1e9), lastScore(0), cost(0) {
+}
+
+/**
+ * The priority of an object is the sum of: how recently and how strongly it
+ * was last found (fading over time), its index score relative to the best
+ * in the frame, and how close it is to going unchecked for too long.
+ *
+ * @param state An object.
+ * @param score Index score of the object in this frame.
+ * @param bestScore Highest index score in this frame.
+ * @param now Current time (seconds).
+ * @return Priority of the object (higher first).
+ */
+double ObjectScheduler::priority(const ObjectState& state, float score, float bestScore,
+        double now) const {
+    double strength = min(state.lastScore / MIN_MATCHED_SHARE, 4.0f); //Barely found is 1.
+    double detection = state.lastScore > 0 ? exp(-(now - state.lastDetected) / memory) * strength : 0;
+    double index = bestScore > 0 ? score / bestScore : 0;
+    double staleness = min((now - state.lastChecked) / maxStaleness, 1.0);
+
+    return DETECTION_WEIGHT * detection + INDEX_WEIGHT * index + STALENESS_WEIGHT * staleness;
+}
+
+
+/******************************************************************************
+ *                              Public Methods
+ ******************************************************************************/
+/**
+ * Constructor.
+ *
+ * @param frameBudget Time allowed per frame (seconds, 0 for no limit).
+ * @param maxStaleness Longest an object may go unchecked (seconds).
+ */
+ObjectScheduler::ObjectScheduler(double frameBudget, double maxStaleness) : memory(2.0) {
+    setBudget(frameBudget, maxStaleness);
+}
+
+/**
+ * Change the time allowed per frame and the longest an object may go
+ * unchecked.
+ *
+ * @param frameBudget Time allowed per frame (seconds, 0 for no limit).
+ * @param maxStaleness Longest an object may go unchecked (seconds).
+ */
+void ObjectScheduler::setBudget(double frameBudget, double maxStaleness) {
+    this->frameBudget = max(frameBudget, 0.0);
+    this->maxStaleness = max(maxStaleness, 0.001);
+}
+
+/**
+ * Rank objects for a frame. Objects that have gone unchecked for too long
+ * come first, most overdue first, then the rest by priority. Objects never
+ * seen before count as unchecked since time 0, so they are checked soon
+ * after they join the library.
+ *
+ * @param models Every object in the library.
+ * @param scores Index score of each object for this frame.
+ * @param now Current time (seconds, CLOCK_MONOTONIC).
+ * @param order Indices into models, to be verified in order.
+ */
+void ObjectScheduler::schedule(const vector<ModelView>& models, const vector<float>& scores,
+        double now, vector<int>& order) {
+    float bestScore = 0;
+    for (unsigned int i = 0; i < scores.size(); i++) {
+        bestScore = max(bestScore, scores[i]);
+    }
+
+    vector<pair<double, int> > overdue; //(time unchecked, model)
+    vector<pair<double, int> > ranked; //(priority, model)
+    for (unsigned int i = 0; i < models.size(); i++) {
+        if (models[i].getNumOfViews() == 0) {
+            continue;
+        }
+
+        const ObjectState& state = states[models[i].getObjectName()];
+        double unchecked = now - state.lastChecked;
+        if (unchecked >= maxStaleness) {
+            overdue.push_back(make_pair(unchecked, i));
+        } else {
+            float score = i < scores.size() ? scores[i] : 0;
+            ranked.push_back(make_pair(priority(state, score, bestScore, now), i));
+        }
+    }
+
+    sort(overdue.begin(), overdue.end(), higherPriority);
+    sort(ranked.begin(), ranked.end(), higherPriority);
+
+    order.clear();
+    for (unsigned int i = 0; i < overdue.size(); i++) {
+        order.push_back(overdue[i].second);
+    }
+    for (unsigned int i = 0; i < ranked.size(); i++) {
+        order.push_back(ranked[i].second);
+    }
+}
+
+/**
+ * @param objectName An object.
+ * @param elapsed Time already spent on the frame (seconds).
+ * @return True if verifying the object is expected to fit in the rest of
+ *         the frame's budget.
+ */
+bool ObjectScheduler::fits(const string& objectName, double elapsed) const {
+    if (frameBudget <= 0) {
+        return true;
+    }
+
+    map<string, ObjectState>::const_iterator it = states.find(objectName);
+    double cost = (it != states.end()) ? it->second.cost : 0;
+    return elapsed + cost <= frameBudget;
+}
+
+/**
+ * Record that an object was verified.
+ *
+ * @param objectName The object.
+ * @param now When it was verified (seconds, CLOCK_MONOTONIC).
+ * @param cost Time taken to verify it (seconds).
+ * @param score Score if it was found, or 0.
+ */
+void ObjectScheduler::checked(const string& objectName, double now, double cost, float score) {
+    ObjectState& state = states[objectName];
+    state.lastChecked = now;
+    state.cost = (state.cost > 0) ? COST_SMOOTHING * state.cost + (1 - COST_SMOOTHING) * cost : cost;
+    if (score > 0) {
+        state.lastDetected = now;
+        state.lastScore = score;
+    }
+}
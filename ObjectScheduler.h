@@ -0,0 +1,105 @@
+/**
+ * @file ObjectScheduler.h
+ * @author Aydin Arik
+ * @brief Decides which library objects to verify in a frame, and in what
+ *        order, so recognition fits in a fixed time per frame. Objects are
+ *        ranked by how likely they are to be in view: recently detected
+ *        objects and objects the index scores highly come first, and objects
+ *        rise the longer they go unchecked. No object goes unchecked for
+ *        longer than a set time, so every object is still covered.
+ */
+
+#ifndef OBJECTSCHEDULER_H
+#define	OBJECTSCHEDULER_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <string>
+#include <vector>
+#include <map>
+#include "LibraryStore.h"
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+class ObjectScheduler {
+private:
+
+    /**
+     * What is known about an object.
+     */
+    struct ObjectState {
+        double lastChecked; //When last verified (seconds, CLOCK_MONOTONIC).
+        double lastDetected; //When last found (seconds, or a large negative number if never).
+        float lastScore; //Score when last found.
+        double cost; //Average time to verify (seconds).
+
+        ObjectState();
+    };
+
+    std::map<std::string, ObjectState> states; //By object name.
+    double frameBudget; //Time allowed per frame (seconds, 0 for no limit).
+    double maxStaleness; //Longest an object may go unchecked (seconds).
+    double memory; //Time for a detection's influence to fall by e (seconds).
+
+    /**
+     * @param state An object.
+     * @param score Index score of the object in this frame.
+     * @param bestScore Highest index score in this frame.
+     * @param now Current time (seconds).
+     * @return Priority of the object (higher first).
+     */
+    double priority(const ObjectState& state, float score, float bestScore, double now) const;
+
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param frameBudget Time allowed per frame (seconds, 0 for no limit).
+     * @param maxStaleness Longest an object may go unchecked (seconds).
+     */
+    ObjectScheduler(double frameBudget = 0.05, double maxStaleness = 2.0);
+
+    /**
+     * Change the time allowed per frame and the longest an object may go
+     * unchecked.
+     *
+     * @param frameBudget Time allowed per frame (seconds, 0 for no limit).
+     * @param maxStaleness Longest an object may go unchecked (seconds).
+     */
+    void setBudget(double frameBudget, double maxStaleness);
+
+    /**
+     * Rank objects for a frame. Objects that have gone unchecked for too long
+     * come first, most overdue first, then the rest by priority.
+     *
+     * @param models Every object in the library.
+     * @param scores Index score of each object for this frame.
+     * @param now Current time (seconds, CLOCK_MONOTONIC).
+     * @param order Indices into models, to be verified in order.
+     */
+    void schedule(const std::vector<ModelView>& models, const std::vector<float>& scores,
+            double now, std::vector<int>& order);
+
+    /**
+     * @param objectName An object.
+     * @param elapsed Time already spent on the frame (seconds).
+     * @return True if verifying the object is expected to fit in the rest of
+     *         the frame's budget.
+     */
+    bool fits(const std::string& objectName, double elapsed) const;
+
+    /**
+     * Record that an object was verified.
+     *
+     * @param objectName The object.
+     * @param now When it was verified (seconds, CLOCK_MONOTONIC).
+     * @param cost Time taken to verify it (seconds).
+     * @param score Score if it was found, or 0.
+     */
+    void checked(const std::string& objectName, double now, double cost, float score);
+};
+
+#endif	/* OBJECTSCHEDULER_H */
@@ -0,0 +1,188 @@
+/**
+ * @file OverlayRenderer.cpp
+ * @author Aydin Arik
+ * @brief Draws recognition results in their windows on a thread of its own, at
+ *        the monitor rate.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "OverlayRenderer.h"
+#include <opencv2/highgui/highgui.hpp>
+#include <unistd.h>
+#include <time.h>
+
+using namespace std;
+
+
+/******************************************************************************
+ *                              Private Methods
+ ******************************************************************************/
+/**
+ * Entry point of the render thread. Each tick, draws any window with a new
+ * result and collects key presses.
+ *
+ * @param renderer The OverlayRenderer that started the thread.
+ * @return NULL.
+ */
+void* OverlayRenderer::render(void* renderer) {
+    OverlayRenderer* self = static_cast<OverlayRenderer*> (renderer);
+    long period = (long) (1000000 / self->rate); //Microseconds.
+
+    vector<int> shown; //Windows drawn this tick.
+    while (true) {
+        timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        shown.clear();
+
+        for (unsigned int i = 0; i < self->windows.size(); i++) {
+            Window& window = self->windows[i];
+            self->mutex.lock();
+            RecognitionResultPtr result = window.result;
+            bool stop = self->stopping;
+            self->mutex.unlock();
+            if (stop) {
+                return NULL;
+            }
+
+            if (result && result != window.drawn) {
+                window.display.render(*result, window.canvas);
+                window.display.draw(window.canvas);
+                window.drawn = result;
+                shown.push_back(i);
+            }
+        }
+
+        //Also lets HighGUI process window events.
+        int key = cv::waitKey(1);
+
+        //Drawn images are on screen once HighGUI has processed its events.
+        if (self->tracker && !shown.empty()) {
+            double now = FrameTrace::now();
+            for (unsigned int i = 0; i < shown.size(); i++) {
+                self->tracker->displayed(shown[i], self->windows[shown[i]].drawn->trace, now);
+            }
+        }
+        if (key >= 0) {
+            self->mutex.lock();
+            self->keys.push_back(key);
+            self->keyPressed.broadcast();
+            self->mutex.unlock();
+        }
+
+        timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        long elapsed = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000;
+        if (elapsed < period) {
+            usleep(period - elapsed);
+        }
+    }
+}
+
+
+/******************************************************************************
+ *                              Public Methods
+ ******************************************************************************/
+/**
+ * Constructor.
+ *
+ * @param windowNames Name of each window (one per camera).
+ * @param rate Frames drawn per second (e.g. the monitor refresh rate).
+ * @param drawMatches If true, draw a line for each match of the best object.
+ */
+OverlayRenderer::OverlayRenderer(const vector<string>& windowNames, double rate, bool drawMatches)
+: rate(rate > 0 ? rate : 60.0), tracker(NULL), running(false), stopping(false) {
+    windows.resize(windowNames.size());
+    for (unsigned int i = 0; i < windowNames.size(); i++) {
+        windows[i].display = Display(windowNames[i]);
+        windows[i].display.setDrawMatches(drawMatches);
+    }
+}
+
+/**
+ * Destructor. Stops the render thread.
+ */
+OverlayRenderer::~OverlayRenderer() {
+    stop();
+}
+
+/**
+ * Start the render thread. All HighGUI calls are made from it from then on.
+ *
+ * @return True if the thread was started.
+ */
+bool OverlayRenderer::start() {
+    if (!running) {
+        running = (pthread_create(&thread, NULL, &OverlayRenderer::render, this) == 0);
+    }
+    return running;
+}
+
+/**
+ * Measure how old every result is when first shown. Call before start().
+ *
+ * @param tracker Tracker (NULL for none). Must outlive the renderer.
+ */
+void OverlayRenderer::setTracker(LatencyTracker* tracker) {
+    this->tracker = tracker;
+}
+
+/**
+ * Stop the render thread and wait for it to finish.
+ */
+void OverlayRenderer::stop() {
+    if (!running) {
+        return;
+    }
+
+    mutex.lock();
+    stopping = true;
+    keyPressed.broadcast();
+    mutex.unlock();
+
+    pthread_join(thread, NULL);
+    running = false;
+    stopping = false;
+}
+
+/**
+ * Publish a result to be drawn. Results published faster than the render
+ * rate replace each other, so only the newest is drawn.
+ *
+ * @param window Window number.
+ * @param result The result.
+ */
+void OverlayRenderer::publish(int window, const RecognitionResultPtr& result) {
+    ScopedLock lock(mutex);
+    windows.at(window).result = result;
+}
+
+/**
+ * @param window Window number.
+ * @return The newest result published to a window (may be empty).
+ */
+RecognitionResultPtr OverlayRenderer::getResult(int window) {
+    ScopedLock lock(mutex);
+    return windows.at(window).result;
+}
+
+/**
+ * Wait for a key to be pressed in any window.
+ *
+ * @param delayMs Longest time to wait (milliseconds).
+ * @return The key, or -1 if none was pressed.
+ */
+int OverlayRenderer::waitKey(int delayMs) {
+    ScopedLock lock(mutex);
+    if (keys.empty() && !stopping) {
+        keyPressed.wait(mutex, delayMs);
+    }
+    if (keys.empty()) {
+        return -1;
+    }
+
+    int key = keys.front();
+    keys.pop_front();
+    return key;
+}
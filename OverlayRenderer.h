@@ -0,0 +1,123 @@
+/**
+ * @file OverlayRenderer.h
+ * @author Aydin Arik
+ * @brief Draws recognition results in their windows on a thread of its own, at
+ *        the monitor rate. Recognition publishes each result and moves on, so
+ *        drawing and showing images never holds up recognition. Each window has
+ *        a canvas that is reused from frame to frame.
+ */
+
+#ifndef OVERLAYRENDERER_H
+#define	OVERLAYRENDERER_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <string>
+#include <vector>
+#include <deque>
+#include <pthread.h>
+#include <opencv2/core/core.hpp>
+#include "Detection.h"
+#include "Display.h"
+#include "LatencyTracker.h"
+#include "Mutex.h"
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+class OverlayRenderer {
+private:
+
+    struct Window {
+        Display display; //Knows the window name.
+        cv::Mat canvas; //Reused for every result drawn in the window.
+        RecognitionResultPtr result; //Newest result published (guarded by mutex).
+        RecognitionResultPtr drawn; //Result last drawn (render thread only).
+    };
+
+    std::vector<Window> windows;
+    double rate; //Frames drawn per second.
+    LatencyTracker* tracker; //Measures how old results are when shown (NULL for none).
+    pthread_t thread;
+    bool running; //True if thread was started.
+
+    //
+    //Guarded by mutex.
+    //
+    Mutex mutex;
+    Condition keyPressed; //Signalled when a key is added to keys.
+    std::deque<int> keys; //Keys pressed in any window, oldest first.
+    bool stopping; //Set to make the render thread exit.
+
+    /**
+     * Entry point of the render thread.
+     *
+     * @param renderer The OverlayRenderer that started the thread.
+     * @return NULL.
+     */
+    static void* render(void* renderer);
+
+    OverlayRenderer(const OverlayRenderer&); //Not copyable.
+    OverlayRenderer& operator=(const OverlayRenderer&);
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param windowNames Name of each window (one per camera).
+     * @param rate Frames drawn per second (e.g. the monitor refresh rate).
+     * @param drawMatches If true, draw a line for each match of the best object.
+     */
+    OverlayRenderer(const std::vector<std::string>& windowNames, double rate = 60.0,
+            bool drawMatches = false);
+
+    /**
+     * Destructor. Stops the render thread.
+     */
+    ~OverlayRenderer();
+
+    /**
+     * Start the render thread. All HighGUI calls are made from it from then on.
+     *
+     * @return True if the thread was started.
+     */
+    bool start();
+
+    /**
+     * Measure how old every result is when first shown. Call before start().
+     *
+     * @param tracker Tracker (NULL for none). Must outlive the renderer.
+     */
+    void setTracker(LatencyTracker* tracker);
+
+    /**
+     * Stop the render thread and wait for it to finish.
+     */
+    void stop();
+
+    /**
+     * Publish a result to be drawn. Results published faster than the render
+     * rate replace each other, so only the newest is drawn.
+     *
+     * @param window Window number.
+     * @param result The result.
+     */
+    void publish(int window, const RecognitionResultPtr& result);
+
+    /**
+     * @param window Window number.
+     * @return The newest result published to a window (may be empty).
+     */
+    RecognitionResultPtr getResult(int window);
+
+    /**
+     * Wait for a key to be pressed in any window.
+     *
+     * @param delayMs Longest time to wait (milliseconds).
+     * @return The key, or -1 if none was pressed.
+     */
+    int waitKey(int delayMs);
+};
+
+#endif	/* OVERLAYRENDERER_H */
@@ -0,0 +1,252 @@
+/**
+ * @file ParameterTuner.cpp
+ * @author Aydin Arik
+ * @brief Searches recognition settings for the best trade-off between speed
+ *        and accuracy.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "ParameterTuner.h"
+#include "ObjectLibrary.h"
+#include "ObjectRecognition.h"
+#include <opencv2/highgui/highgui.hpp>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <time.h>
+#include "boost/filesystem/path.hpp"
+
+using namespace std;
+namespace fs = boost::filesystem;
+
+
+/******************************************************************************
+ *                              Functions
+ ******************************************************************************/
+/**
+ * @param a A trial.
+ * @param b Another trial.
+ * @return True if a is at least as good as b on speed, precision and recall,
+ *         and better on at least one.
+ */
+static bool dominates(const ParameterTuner::Trial& a, const ParameterTuner::Trial& b) {
+    bool noWorse = a.fps >= b.fps && a.precision >= b.precision && a.recall >= b.recall;
+    bool better = a.fps > b.fps || a.precision > b.precision || a.recall > b.recall;
+    return noWorse && better;
+}
+
+
+/******************************************************************************
+ *                              Public Methods
+ ******************************************************************************/
+/**
+ * Constructor. Sets up a default grid around the base settings. A ratio of
+ * 1.5 turns the ratio test off, as the system has always run.
+ *
+ * @param base Settings that aren't searched.
+ */
+ParameterTuner::ParameterTuner(const RecognitionConfig& base) : base(base) {
+    double hessians[] = {800, 1250, 2000};
+    float ratioValues[] = {0.65f, 0.8f, 1.5f};
+    double distances[] = {1.0, 3.0};
+    double confidences[] = {0.85, 0.99};
+    float shares[] = {0.03f, 0.05f, 0.08f};
+
+    hessianThresholds.assign(hessians, hessians + 3);
+    ratios.assign(ratioValues, ratioValues + 3);
+    epipolarDistances.assign(distances, distances + 2);
+    confidenceLevels.assign(confidences, confidences + 2);
+    matchedShares.assign(shares, shares + 3);
+}
+
+/**
+ * Load the labelled frames. Each line of the labels file is an image file
+ * (relative to the labels file) followed by the names of the objects in it,
+ * separated by spaces. Lines starting with '#' are skipped.
+ *
+ * @param labelsFile The labels file.
+ * @return Number of frames loaded.
+ */
+int ParameterTuner::loadLabels(const string& labelsFile) {
+    ifstream in(labelsFile.c_str());
+    if (!in) {
+        cout << "Could not read labels: " << labelsFile << endl;
+        return 0;
+    }
+
+    fs::path directory = fs::path(labelsFile).parent_path();
+    string line;
+    while (getline(in, line)) {
+        istringstream words(line);
+        string file;
+        if (!(words >> file) || file[0] == '#') {
+            continue;
+        }
+
+        cv::Mat frame = cv::imread((directory / file).string());
+        if (!frame.data) {
+            cout << "Could not read frame: " << file << endl;
+            continue;
+        }
+
+        vector<string> names;
+        string name;
+        while (words >> name) {
+            names.push_back(name);
+        }
+        frames.push_back(frame);
+        labels.push_back(names);
+    }
+
+    return frames.size();
+}
+
+/**
+ * Recognise the labelled frames with every combination of settings on the
+ * grid, and mark the Pareto frontier. The library is built once per Hessian
+ * threshold, and the frames are recognised one at a time (no reuse between
+ * frames), as they would be live.
+ *
+ * @param trials Settings tried, and how they did.
+ */
+void ParameterTuner::run(vector<Trial>& trials) {
+    trials.clear();
+    if (frames.empty()) {
+        return;
+    }
+
+    for (unsigned int h = 0; h < hessianThresholds.size(); h++) {
+        RecognitionConfig libraryConfig = base;
+        libraryConfig.hessianThreshold = hessianThresholds[h];
+        ObjectLibrary library(0, true, false, libraryConfig);
+        ObjectRecognition recognition(library);
+
+        for (unsigned int r = 0; r < ratios.size(); r++)
+            for (unsigned int d = 0; d < epipolarDistances.size(); d++)
+                for (unsigned int c = 0; c < confidenceLevels.size(); c++)
+                    for (unsigned int s = 0; s < matchedShares.size(); s++) {
+                        Trial trial;
+                        trial.config = libraryConfig;
+                        trial.config.ratio = ratios[r];
+                        trial.config.minDistanceToEpipolar = epipolarDistances[d];
+                        trial.config.confidenceLevel = confidenceLevels[c];
+                        trial.config.minMatchedShare = matchedShares[s];
+                        trial.config.maxReuseAge = 0; //Every frame is new.
+                        trial.config.frameBudget = 0; //Results mustn't depend on machine load.
+                        recognition.configure(trial.config);
+
+                        int truePositives = 0, falsePositives = 0, falseNegatives = 0;
+                        timespec start, end;
+                        clock_gettime(CLOCK_MONOTONIC, &start);
+                        for (unsigned int f = 0; f < frames.size(); f++) {
+                            RecognitionResultPtr result = recognition.recognise(frames[f]);
+                            vector<string> found;
+                            for (unsigned int i = 0; result && i < result->detections.size(); i++) {
+                                found.push_back(result->detections[i].objectName);
+                            }
+                            sort(found.begin(), found.end());
+                            found.erase(unique(found.begin(), found.end()), found.end());
+
+                            for (unsigned int i = 0; i < found.size(); i++) {
+                                if (find(labels[f].begin(), labels[f].end(), found[i]) != labels[f].end()) {
+                                    truePositives++;
+                                } else {
+                                    falsePositives++;
+                                }
+                            }
+                            for (unsigned int i = 0; i < labels[f].size(); i++) {
+                                if (find(found.begin(), found.end(), labels[f][i]) == found.end()) {
+                                    falseNegatives++;
+                                }
+                            }
+                        }
+                        clock_gettime(CLOCK_MONOTONIC, &end);
+
+                        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+                        trial.config.maxReuseAge = base.maxReuseAge;
+                        trial.fps = (seconds > 0) ? frames.size() / seconds : 0;
+                        trial.precision = (truePositives + falsePositives > 0) ?
+                                (double) truePositives / (truePositives + falsePositives) : 1.0;
+                        trial.recall = (truePositives + falseNegatives > 0) ?
+                                (double) truePositives / (truePositives + falseNegatives) : 1.0;
+                        trials.push_back(trial);
+
+                        cout << "Trial " << trials.size() << ": " << trial.config << " -> "
+                                << trial.fps << " fps, precision " << trial.precision
+                                << ", recall " << trial.recall << endl;
+                    }
+    }
+
+    findParetoFrontier(trials);
+}
+
+/**
+ * Mark the trials on the Pareto frontier of speed, precision and recall.
+ *
+ * @param trials Trials.
+ */
+void ParameterTuner::findParetoFrontier(vector<Trial>& trials) {
+    for (unsigned int i = 0; i < trials.size(); i++) {
+        trials[i].pareto = true;
+        for (unsigned int j = 0; j < trials.size() && trials[i].pareto; j++) {
+            if (dominates(trials[j], trials[i])) {
+                trials[i].pareto = false;
+            }
+        }
+    }
+}
+
+/**
+ * Choose the frontier trial with the best F1 score that is fast enough.
+ * If none is fast enough, the fastest frontier trial is chosen.
+ *
+ * @param trials Trials (see findParetoFrontier()).
+ * @param minFps Slowest acceptable frame rate.
+ * @return Index of the chosen trial, or -1 if there are none.
+ */
+int ParameterTuner::choose(const vector<Trial>& trials, double minFps) {
+    int best = -1;
+    int fastest = -1;
+    for (unsigned int i = 0; i < trials.size(); i++) {
+        if (!trials[i].pareto) {
+            continue;
+        }
+        if (fastest < 0 || trials[i].fps > trials[fastest].fps) {
+            fastest = i;
+        }
+        if (trials[i].fps >= minFps && (best < 0 || trials[i].f1() > trials[best].f1() ||
+                (trials[i].f1() == trials[best].f1() && trials[i].fps > trials[best].fps))) {
+            best = i;
+        }
+    }
+    return (best >= 0) ? best : fastest;
+}
+
+/**
+ * Write every trial to a CSV file.
+ *
+ * @param filename CSV file.
+ * @param trials Trials.
+ * @return True if the file was written.
+ */
+bool ParameterTuner::writeReport(const string& filename, const vector<Trial>& trials) {
+    ofstream out(filename.c_str());
+    if (!out) {
+        cout << "Could not write report: " << filename << endl;
+        return false;
+    }
+
+    out << "hessianThreshold,ratio,minDistanceToEpipolar,confidenceLevel,minMatchedShare,"
+            << "maxFrameKeypoints,fps,precision,recall,f1,pareto" << endl;
+    for (unsigned int i = 0; i < trials.size(); i++) {
+        const Trial& trial = trials[i];
+        out << trial.config.hessianThreshold << "," << trial.config.ratio << ","
+                << trial.config.minDistanceToEpipolar << "," << trial.config.confidenceLevel << ","
+                << trial.config.minMatchedShare << "," << trial.config.maxFrameKeypoints << "," << trial.fps << "," << trial.precision << ","
+                << trial.recall << "," << trial.f1() << "," << (trial.pareto ? 1 : 0) << endl;
+    }
+    return true;
+}
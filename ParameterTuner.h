@@ -0,0 +1,118 @@
+/**
+ * @file ParameterTuner.h
+ * @author Aydin Arik
+ * @brief Searches recognition settings for the best trade-off between speed
+ *        and accuracy. A labelled set of frames is recognised with every
+ *        combination of settings on a grid, measuring frames per second,
+ *        precision and recall. The trials no other trial beats on all three
+ *        (the Pareto frontier) are reported, and one is chosen to be saved as
+ *        the configuration loaded at startup.
+ */
+
+#ifndef PARAMETERTUNER_H
+#define	PARAMETERTUNER_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include "RecognitionConfig.h"
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+class ParameterTuner {
+public:
+
+    /**
+     * Settings tried, and how they did.
+     */
+    struct Trial {
+        RecognitionConfig config;
+        double fps; //Frames recognised per second (one thread).
+        double precision; //Share of objects found that are in the frame.
+        double recall; //Share of objects in the frame that are found.
+        bool pareto; //True if no other trial is at least as good on all three and better on one.
+
+        Trial() : fps(0), precision(0), recall(0), pareto(false) {
+        }
+
+        /**
+         * @return Harmonic mean of precision and recall.
+         */
+        double f1() const {
+            return (precision + recall > 0) ? 2 * precision * recall / (precision + recall) : 0;
+        }
+    };
+
+private:
+    RecognitionConfig base; //Settings that aren't searched.
+    std::vector<cv::Mat> frames; //Labelled frames.
+    std::vector<std::vector<std::string> > labels; //Names of the objects in each frame.
+
+    //
+    //Grid searched. The library is rebuilt for each Hessian threshold.
+    //
+    std::vector<double> hessianThresholds;
+    std::vector<float> ratios;
+    std::vector<double> epipolarDistances;
+    std::vector<double> confidenceLevels;
+    std::vector<float> matchedShares;
+
+public:
+
+    /**
+     * Constructor. Sets up a default grid around the base settings.
+     *
+     * @param base Settings that aren't searched.
+     */
+    ParameterTuner(const RecognitionConfig& base = RecognitionConfig());
+
+    /**
+     * Load the labelled frames. Each line of the labels file is an image file
+     * (relative to the labels file) followed by the names of the objects in it,
+     * separated by spaces. Lines starting with '#' are skipped.
+     *
+     * @param labelsFile The labels file.
+     * @return Number of frames loaded.
+     */
+    int loadLabels(const std::string& labelsFile);
+
+    /**
+     * Recognise the labelled frames with every combination of settings on the
+     * grid, and mark the Pareto frontier.
+     *
+     * @param trials Settings tried, and how they did.
+     */
+    void run(std::vector<Trial>& trials);
+
+    /**
+     * Mark the trials on the Pareto frontier of speed, precision and recall.
+     *
+     * @param trials Trials.
+     */
+    static void findParetoFrontier(std::vector<Trial>& trials);
+
+    /**
+     * Choose the frontier trial with the best F1 score that is fast enough.
+     * If none is fast enough, the fastest frontier trial is chosen.
+     *
+     * @param trials Trials (see findParetoFrontier()).
+     * @param minFps Slowest acceptable frame rate.
+     * @return Index of the chosen trial, or -1 if there are none.
+     */
+    static int choose(const std::vector<Trial>& trials, double minFps);
+
+    /**
+     * Write every trial to a CSV file.
+     *
+     * @param filename CSV file.
+     * @param trials Trials.
+     * @return True if the file was written.
+     */
+    static bool writeReport(const std::string& filename, const std::vector<Trial>& trials);
+};
+
+#endif	/* PARAMETERTUNER_H */
@@ -0,0 +1,217 @@
+/**
+ * @file QualityController.cpp
+ * @author Aydin Arik
+ * @brief Holds a camera at a target frame rate by trading recognition quality
+ *        for speed.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "QualityController.h"
+#include <algorithm>
+
+using namespace std;
+
+// Number of quality levels (level 0 is full quality).
+#define NUM_OF_LEVELS 12
+
+// Each step down keeps this share of the objects verified per frame (and
+// of the time allowed for them) or of the frame keypoints.
+#define STEP_SHARE 0.7
+
+// Each step down raises the SURF Hessian threshold by this factor.
+#define HESSIAN_STEP 1.4
+
+// Frame keypoints are capped at this before the first step down, if they
+// aren't capped at all.
+#define UNCAPPED_KEYPOINTS 1000
+
+// Fewest frame keypoints kept.
+#define MIN_FRAME_KEYPOINTS 100
+
+// Most times a frame is halved in size by lowering quality.
+#define MAX_PYRAMID_LEVEL 2
+
+// Weight of the newest frame time in the smoothed time.
+#define SMOOTHING 0.2
+
+// Frames after a change of level that aren't acted on, as the first frames
+// at new settings aren't typical.
+#define SETTLE_FRAMES 3
+
+// Quality is lowered once the smoothed time has been over the target by more
+// than this share for this many frames in a row...
+#define SLOW_MARGIN 0.1
+#define SLOW_FRAMES 3
+
+// ...and raised once it has been under this share of the target for this
+// many frames in a row (doubled, up to the maximum, each time a raise has to
+// be undone).
+#define FAST_SHARE 0.7
+#define FAST_FRAMES 30
+#define MAX_FAST_FRAMES 480
+
+// A raise undone within this long is taken as a sign the level is too slow
+// (seconds).
+#define RAISE_PROBATION 5.0
+
+// How long a level is remembered as too slow (seconds).
+#define SLOW_MEMORY 10.0
+
+
+/******************************************************************************
+ *                              Private Methods
+ ******************************************************************************/
+/**
+ * Move to a quality level.
+ *
+ * @param newLevel The level.
+ */
+void QualityController::setLevel(int newLevel) {
+    level = std::max(std::min(newLevel, NUM_OF_LEVELS - 1), 0);
+    numOfSamples = 0;
+    numOfSlow = 0;
+    numOfFast = 0;
+}
+
+
+/******************************************************************************
+ *                              Public Methods
+ ******************************************************************************/
+/**
+ * Constructor. Starts at level 0.
+ *
+ * @param base Settings at full quality.
+ * @param targetFps Frame rate to hold.
+ */
+QualityController::QualityController(const RecognitionConfig& base, double targetFps)
+: base(base), targetTime(1.0 / std::max(targetFps, 0.1)), level(0), smoothedTime(0),
+numOfSamples(0), numOfSlow(0), numOfFast(0), raiseHold(FAST_FRAMES), lastRaise(0),
+levelTimes(NUM_OF_LEVELS, 0.0), levelSeen(NUM_OF_LEVELS, 0.0) {
+}
+
+/**
+ * Add the time a frame took, and change the quality level if needed. A frame
+ * far over the target lowers quality two levels at once, so a sudden jump
+ * in load is caught up with quickly.
+ *
+ * @param frameTime Time to recognise objects in the frame (seconds).
+ * @param now Current time (seconds, CLOCK_MONOTONIC).
+ * @return True if the level changed (see getConfig()).
+ */
+bool QualityController::update(double frameTime, double now) {
+    smoothedTime = (numOfSamples == 0) ? frameTime : SMOOTHING * frameTime + (1 - SMOOTHING) * smoothedTime;
+    numOfSamples++;
+    if (numOfSamples <= SETTLE_FRAMES) {
+        return false;
+    }
+    levelTimes[level] = smoothedTime;
+    levelSeen[level] = now;
+
+    //A raise that has held for long enough resets the wait for the next one.
+    if (lastRaise > 0 && now - lastRaise > RAISE_PROBATION) {
+        lastRaise = 0;
+        raiseHold = FAST_FRAMES;
+    }
+
+    if (smoothedTime > targetTime * (1 + SLOW_MARGIN)) {
+        numOfSlow++;
+        numOfFast = 0;
+    } else if (smoothedTime < targetTime * FAST_SHARE) {
+        numOfFast++;
+        numOfSlow = 0;
+    } else { //Close enough; hold.
+        numOfSlow = 0;
+        numOfFast = 0;
+    }
+
+    if (numOfSlow >= SLOW_FRAMES && level < NUM_OF_LEVELS - 1) {
+        if (lastRaise > 0) { //The last raise didn't hold.
+            raiseHold = std::min(raiseHold * 2, MAX_FAST_FRAMES);
+            lastRaise = 0;
+        }
+        setLevel(level + (smoothedTime > 2 * targetTime ? 2 : 1));
+        return true;
+    }
+
+    if (numOfFast >= raiseHold && level > 0) {
+        //Don't go back to a level that was too slow not long ago.
+        int better = level - 1;
+        bool knownSlow = levelSeen[better] > 0 && now - levelSeen[better] < SLOW_MEMORY &&
+                levelTimes[better] > targetTime * (1 + SLOW_MARGIN);
+        if (!knownSlow) {
+            lastRaise = now;
+            setLevel(better);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @return Current quality level (0 is best).
+ */
+int QualityController::getLevel() const {
+    return level;
+}
+
+/**
+ * @return Settings at the current quality level.
+ */
+RecognitionConfig QualityController::getConfig() const {
+    return degrade(base, level);
+}
+
+/**
+ * @return Recent frame time (seconds).
+ */
+double QualityController::getFrameTime() const {
+    return smoothedTime;
+}
+
+/**
+ * Lower the quality of settings, one step at a time: fewer objects verified
+ * per frame (they are still verified in later frames), then fewer frame
+ * keypoints, then a higher Hessian threshold, then a smaller frame (which
+ * loses small objects, so is tried last), and round again.
+ *
+ * @param base Settings at full quality.
+ * @param level Number of steps down (0 to getNumOfLevels() - 1).
+ * @return The lowered settings.
+ */
+RecognitionConfig QualityController::degrade(const RecognitionConfig& base, int level) {
+    RecognitionConfig config = base;
+    for (int step = 0; step < level; step++) {
+        switch (step % 4) {
+            case 0:
+                config.maxCandidates = std::max((int) (config.maxCandidates * STEP_SHARE), 1);
+                config.frameBudget *= STEP_SHARE;
+                break;
+            case 1:
+                if (config.maxFrameKeypoints <= 0) {
+                    config.maxFrameKeypoints = UNCAPPED_KEYPOINTS;
+                }
+                config.maxFrameKeypoints = std::max((int) (config.maxFrameKeypoints * STEP_SHARE),
+                        MIN_FRAME_KEYPOINTS);
+                break;
+            case 2:
+                config.hessianThreshold *= HESSIAN_STEP;
+                break;
+            case 3:
+                if (config.pyramidLevel < MAX_PYRAMID_LEVEL) { //Never undo a configured level.
+                    config.pyramidLevel++;
+                }
+                break;
+        }
+    }
+    return config;
+}
+
+/**
+ * @return Number of quality levels.
+ */
+int QualityController::getNumOfLevels() {
+    return NUM_OF_LEVELS;
+}
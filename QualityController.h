@@ -0,0 +1,100 @@
+/**
+ * @file QualityController.h
+ * @author Aydin Arik
+ * @brief Holds a camera at a target frame rate by trading recognition quality
+ *        for speed as the scene or the machine's load changes. Quality comes
+ *        in levels: level 0 is the configured settings, and each level above
+ *        it takes one small step down, in turn, in objects verified per frame,
+ *        frame keypoints kept, SURF Hessian threshold and frame pyramid level.
+ *        So quality bends a little at a time rather than frames piling up.
+ *
+ *        Frame times are smoothed, and quality is only lowered after several
+ *        frames over the target, and only raised after many frames well
+ *        under it. A level that was recently too slow isn't gone back to,
+ *        and a raise that has to be undone makes the next one wait longer,
+ *        so the level doesn't oscillate.
+ */
+
+#ifndef QUALITYCONTROLLER_H
+#define	QUALITYCONTROLLER_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <vector>
+#include "RecognitionConfig.h"
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+class QualityController {
+private:
+    RecognitionConfig base; //Settings at level 0.
+    double targetTime; //Longest a frame should take (seconds).
+    int level; //Current quality level (0 is best).
+    double smoothedTime; //Recent frame time (seconds).
+    int numOfSamples; //Frames measured since the level last changed.
+    int numOfSlow; //Frames in a row over the target.
+    int numOfFast; //Frames in a row well under the target.
+    int raiseHold; //Frames in a row well under the target needed to raise quality.
+    double lastRaise; //When quality was last raised (0 once the raise has held).
+    std::vector<double> levelTimes; //Smoothed frame time last seen at each level.
+    std::vector<double> levelSeen; //When each level's time was seen (0 for never).
+
+    /**
+     * Move to a quality level.
+     *
+     * @param newLevel The level.
+     */
+    void setLevel(int newLevel);
+
+public:
+
+    /**
+     * Constructor. Starts at level 0.
+     *
+     * @param base Settings at full quality.
+     * @param targetFps Frame rate to hold.
+     */
+    QualityController(const RecognitionConfig& base, double targetFps);
+
+    /**
+     * Add the time a frame took, and change the quality level if needed.
+     *
+     * @param frameTime Time to recognise objects in the frame (seconds).
+     * @param now Current time (seconds, CLOCK_MONOTONIC).
+     * @return True if the level changed (see getConfig()).
+     */
+    bool update(double frameTime, double now);
+
+    /**
+     * @return Current quality level (0 is best).
+     */
+    int getLevel() const;
+
+    /**
+     * @return Settings at the current quality level.
+     */
+    RecognitionConfig getConfig() const;
+
+    /**
+     * @return Recent frame time (seconds).
+     */
+    double getFrameTime() const;
+
+    /**
+     * Lower the quality of settings.
+     *
+     * @param base Settings at full quality.
+     * @param level Number of steps down (0 to getNumOfLevels() - 1).
+     * @return The lowered settings.
+     */
+    static RecognitionConfig degrade(const RecognitionConfig& base, int level);
+
+    /**
+     * @return Number of quality levels.
+     */
+    static int getNumOfLevels();
+};
+
+#endif	/* QUALITYCONTROLLER_H */
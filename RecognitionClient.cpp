@@ -0,0 +1,254 @@
+/**
+ * @file RecognitionClient.cpp
+ * @author Aydin Arik
+ * @brief Sends frames to a RecognitionServer and gets back the objects found
+ *        in them.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "RecognitionClient.h"
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace std;
+
+// Longest to wait for the server to accept a client (milliseconds).
+#define WELCOME_TIMEOUT_MS 5000
+
+
+/******************************************************************************
+ *                              Public Methods
+ ******************************************************************************/
+/**
+ * Constructor.
+ */
+RecognitionClient::RecognitionClient()
+: socket(-1), slots(NULL), slotsSize(0), slotSize(0), nextId(1) {
+}
+
+/**
+ * Destructor. Disconnects.
+ */
+RecognitionClient::~RecognitionClient() {
+    disconnect();
+}
+
+/**
+ * Make frame slots and connect to a server. The slots' shared memory object
+ * is removed once the server has mapped it, so nothing is left behind if
+ * either side dies.
+ *
+ * @param socketPath Socket the server listens on.
+ * @param numOfSlots Most requests in flight at once.
+ * @param slotSize Bytes of the largest frame to be sent.
+ * @return True if the server accepted the client.
+ */
+bool RecognitionClient::connect(const string& socketPath, unsigned int numOfSlots, uint64_t slotSize) {
+    disconnect();
+    numOfSlots = std::max(std::min(numOfSlots, (unsigned int) RECOGNITION_MAX_SLOTS), 1u);
+
+    static int numOfClients = 0; //Makes each client's slots name unique.
+    std::ostringstream name;
+    name << "/object-recognition-" << getpid() << "-" << __sync_fetch_and_add(&numOfClients, 1);
+
+    //1. Frame slots.
+    slotsSize = (size_t) numOfSlots * slotSize;
+    int fd = shm_open(name.str().c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        cout << "Unable to create shared memory: " << name.str() << endl;
+        return false;
+    }
+    void* memory = MAP_FAILED;
+    if (ftruncate(fd, slotsSize) == 0) {
+        memory = mmap(NULL, slotsSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (memory == MAP_FAILED) {
+        cout << "Unable to map shared memory: " << name.str() << endl;
+        shm_unlink(name.str().c_str());
+        return false;
+    }
+    slots = static_cast<char*> (memory);
+    this->slotSize = slotSize;
+    busy.assign(numOfSlots, false);
+
+    //2. Connection.
+    sockaddr_un address;
+    memset(&address, 0, sizeof (address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath.c_str(), sizeof (address.sun_path) - 1);
+    socket = ::socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (socket < 0 || ::connect(socket, (sockaddr*) &address, sizeof (address)) != 0) {
+        cout << "Unable to connect to: " << socketPath << endl;
+        shm_unlink(name.str().c_str());
+        disconnect();
+        return false;
+    }
+
+    //3. Hello, and wait to be welcomed.
+    RecognitionHello hello;
+    memset(&hello, 0, sizeof (hello));
+    hello.magic = RECOGNITION_MAGIC;
+    hello.type = RECOGNITION_HELLO;
+    hello.version = RECOGNITION_VERSION;
+    hello.numOfSlots = numOfSlots;
+    hello.slotSize = slotSize;
+    strncpy(hello.slotsName, name.str().c_str(), RECOGNITION_MAX_NAME - 1);
+
+    RecognitionReply welcome;
+    bool welcomed = (send(socket, &hello, sizeof (hello), MSG_NOSIGNAL) == sizeof (hello) &&
+            receive(welcome, WELCOME_TIMEOUT_MS) && welcome.type == RECOGNITION_WELCOME &&
+            welcome.status == RECOGNITION_OK);
+    shm_unlink(name.str().c_str()); //Mapped by both sides (or not wanted).
+    if (!welcomed) {
+        cout << "Not accepted by: " << socketPath << endl;
+        disconnect();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Disconnect. Requests in flight are forgotten.
+ */
+void RecognitionClient::disconnect() {
+    if (socket >= 0) {
+        close(socket);
+        socket = -1;
+    }
+    if (slots) {
+        munmap(slots, slotsSize);
+        slots = NULL;
+    }
+    busy.clear();
+}
+
+/**
+ * Send a frame to be recognised, without waiting for the reply.
+ *
+ * @param frame The frame (8 bit, 1 or 3 channels). Copied, so it may be
+ *        reused at once.
+ * @param id Id of the request, as given back in its reply.
+ * @return False if not connected, every slot is in flight, or the frame
+ *         doesn't fit a slot.
+ */
+bool RecognitionClient::submit(const cv::Mat& frame, uint64_t& id) {
+    if (socket < 0 || frame.empty() || frame.depth() != CV_8U ||
+            (frame.channels() != 1 && frame.channels() != 3) ||
+            frame.total() * frame.elemSize() > slotSize) {
+        return false;
+    }
+
+    unsigned int slot = 0;
+    while (slot < busy.size() && busy[slot]) {
+        slot++;
+    }
+    if (slot == busy.size()) {
+        return false; //Every slot is in flight.
+    }
+
+    cv::Mat slotFrame(frame.rows, frame.cols, frame.type(), slots + slot * slotSize);
+    frame.copyTo(slotFrame);
+
+    RecognitionRequest request;
+    memset(&request, 0, sizeof (request));
+    request.magic = RECOGNITION_MAGIC;
+    request.type = RECOGNITION_REQUEST;
+    request.id = nextId++;
+    request.slot = slot;
+    request.frameWidth = frame.cols;
+    request.frameHeight = frame.rows;
+    request.frameType = frame.type();
+    if (send(socket, &request, sizeof (request), MSG_NOSIGNAL) != sizeof (request)) {
+        return false;
+    }
+
+    busy[slot] = true;
+    id = request.id;
+    return true;
+}
+
+/**
+ * Wait for a reply to any request in flight. The reply's slot is free again
+ * once it has been received.
+ *
+ * @param reply The reply.
+ * @param timeoutMs Longest time to wait (milliseconds, negative to wait
+ *        until there is one).
+ * @return False if none came in time (or the server has gone).
+ */
+bool RecognitionClient::receive(RecognitionReply& reply, int timeoutMs) {
+    if (socket < 0) {
+        return false;
+    }
+
+    pollfd fd;
+    fd.fd = socket;
+    fd.events = POLLIN;
+    fd.revents = 0;
+    if (poll(&fd, 1, timeoutMs) <= 0) {
+        return false;
+    }
+
+    ssize_t size = recv(socket, &reply, sizeof (reply), 0);
+    if (size <= 0) {
+        cout << "Recognition server has gone" << endl;
+        disconnect();
+        return false;
+    }
+    if (size != sizeof (reply) || reply.magic != RECOGNITION_MAGIC) {
+        return false;
+    }
+
+    if (reply.type == RECOGNITION_REPLY && reply.slot < busy.size()) {
+        busy[reply.slot] = false;
+    }
+    return true;
+}
+
+/**
+ * Recognise objects in a frame and wait for the reply. Replies to other
+ * requests in flight are dropped.
+ *
+ * @param frame The frame (8 bit, 1 or 3 channels).
+ * @param reply The reply.
+ * @param timeoutMs Longest time to wait (milliseconds, negative to wait
+ *        until there is one).
+ * @return True if replied to.
+ */
+bool RecognitionClient::recognise(const cv::Mat& frame, RecognitionReply& reply, int timeoutMs) {
+    uint64_t id;
+    if (!submit(frame, id)) {
+        return false;
+    }
+    while (receive(reply, timeoutMs)) {
+        if (reply.type == RECOGNITION_REPLY && reply.id == id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @return Requests in flight.
+ */
+int RecognitionClient::getNumOfInFlight() const {
+    return std::count(busy.begin(), busy.end(), true);
+}
+
+/**
+ * @return True if connected.
+ */
+bool RecognitionClient::isConnected() const {
+    return socket >= 0;
+}
@@ -0,0 +1,109 @@
+/**
+ * @file RecognitionClient.h
+ * @author Aydin Arik
+ * @brief Sends frames to a RecognitionServer (see RecognitionProtocol.h) and
+ *        gets back the objects found in them. Frames are copied into shared
+ *        memory slots of the client's own, one per request in flight, so
+ *        several requests can be outstanding at once and their replies
+ *        collected as they come. Not safe to use from several threads at once.
+ */
+
+#ifndef RECOGNITIONCLIENT_H
+#define	RECOGNITIONCLIENT_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <opencv2/core/core.hpp>
+#include "RecognitionProtocol.h"
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+class RecognitionClient {
+private:
+    int socket; //Connected socket (-1 if not connected).
+    char* slots; //Mapped frame slots (NULL if not connected).
+    size_t slotsSize; //Bytes mapped.
+    uint64_t slotSize; //Bytes per slot.
+    std::vector<bool> busy; //True for each slot with a request in flight.
+    uint64_t nextId; //Id of the next request.
+
+    RecognitionClient(const RecognitionClient&); //Not copyable.
+    RecognitionClient& operator=(const RecognitionClient&);
+public:
+
+    /**
+     * Constructor.
+     */
+    RecognitionClient();
+
+    /**
+     * Destructor. Disconnects.
+     */
+    ~RecognitionClient();
+
+    /**
+     * Make frame slots and connect to a server.
+     *
+     * @param socketPath Socket the server listens on.
+     * @param numOfSlots Most requests in flight at once.
+     * @param slotSize Bytes of the largest frame to be sent.
+     * @return True if the server accepted the client.
+     */
+    bool connect(const std::string& socketPath = RECOGNITION_SOCKET,
+            unsigned int numOfSlots = 4, uint64_t slotSize = 640 * 480 * 3);
+
+    /**
+     * Disconnect. Requests in flight are forgotten.
+     */
+    void disconnect();
+
+    /**
+     * Send a frame to be recognised, without waiting for the reply.
+     *
+     * @param frame The frame (8 bit, 1 or 3 channels). Copied, so it may be
+     *        reused at once.
+     * @param id Id of the request, as given back in its reply.
+     * @return False if not connected, every slot is in flight, or the frame
+     *         doesn't fit a slot.
+     */
+    bool submit(const cv::Mat& frame, uint64_t& id);
+
+    /**
+     * Wait for a reply to any request in flight.
+     *
+     * @param reply The reply.
+     * @param timeoutMs Longest time to wait (milliseconds, negative to wait
+     *        until there is one).
+     * @return False if none came in time (or the server has gone).
+     */
+    bool receive(RecognitionReply& reply, int timeoutMs = -1);
+
+    /**
+     * Recognise objects in a frame and wait for the reply. Replies to other
+     * requests in flight are dropped.
+     *
+     * @param frame The frame (8 bit, 1 or 3 channels).
+     * @param reply The reply.
+     * @param timeoutMs Longest time to wait (milliseconds, negative to wait
+     *        until there is one).
+     * @return True if replied to.
+     */
+    bool recognise(const cv::Mat& frame, RecognitionReply& reply, int timeoutMs = -1);
+
+    /**
+     * @return Requests in flight.
+     */
+    int getNumOfInFlight() const;
+
+    /**
+     * @return True if connected.
+     */
+    bool isConnected() const;
+};
+
+#endif	/* RECOGNITIONCLIENT_H */
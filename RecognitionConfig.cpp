@@ -0,0 +1,186 @@
+/**
+ * @file RecognitionConfig.cpp
+ * @author Aydin Arik
+ * @brief Settings that trade recognition speed against accuracy.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "RecognitionConfig.h"
+#include <opencv2/core/core.hpp>
+#include "Detection.h"
+
+using namespace std;
+
+// Most times a frame may be halved in size (a 640x480 frame becomes 40x30).
+#define MAX_PYRAMID_LEVEL 4
+
+
+/******************************************************************************
+ *                              Functions
+ ******************************************************************************/
+/**
+ * Read a number, if the file has it.
+ *
+ * @param node Node of the setting.
+ * @param value Set to the number (left as is if missing).
+ */
+template <typename T>
+static void readSetting(const cv::FileNode& node, T& value) {
+    if (!node.empty() && !node.isNone()) {
+        double number = (double) node;
+        value = (T) number;
+    }
+}
+
+/**
+ * Put back a setting that was loaded with a bad value, saying so.
+ *
+ * @param name Name of the setting.
+ * @param value The setting (set back to previous if not valid).
+ * @param previous Value before loading.
+ * @param valid True if the loaded value is in range.
+ */
+template <typename T>
+static void checkSetting(const char* name, T& value, const T& previous, bool valid) {
+    if (!valid) {
+        cout << "Bad setting " << name << " (" << value << "); keeping " << previous << endl;
+        value = previous;
+    }
+}
+
+/**
+ * Print settings on one line.
+ */
+ostream& operator<<(ostream& out, const RecognitionConfig& config) {
+    out << "hessian " << config.hessianThreshold
+            << ", ratio " << config.ratio
+            << ", epipolar " << config.minDistanceToEpipolar
+            << ", confidence " << config.confidenceLevel
+            << ", share " << config.minMatchedShare
+            << ", frame keypoints " << config.maxFrameKeypoints
+            << (config.gridSelection ? " (grid)" : " (anms)")
+            << ", pyramid " << config.pyramidLevel
+            << ", pose clustering " << (config.poseClustering ? "on" : "off")
+            << ", candidates " << config.maxCandidates
+            << ", budget " << config.frameBudget << "s (stale " << config.maxObjectStaleness << "s)"
+            << ", keypoints " << config.keypointsPerObject
+            << ", reuse " << config.maxReuseAge
+            << ", target " << config.targetFps << " fps";
+    return out;
+}
+
+
+/******************************************************************************
+ *                              Methods
+ ******************************************************************************/
+/**
+ * Constructor. Default settings (frame keypoints are capped at 600, and the
+ * best 5 objects of the shortlist are verified in each frame; the time
+ * budgeted scheduler is off).
+ */
+RecognitionConfig::RecognitionConfig()
+: hessianThreshold(DEFAULT_HESSIAN_THRESHOLD), ratio(1.5f), minDistanceToEpipolar(3.0),
+confidenceLevel(0.85), minMatchedShare(MIN_MATCHED_SHARE), maxFrameKeypoints(600), pyramidLevel(0),
+gridSelection(false), poseClustering(true), maxCandidates(5), frameBudget(0), maxObjectStaleness(2.0),
+keypointsPerObject(0), maxReuseAge(1.0), targetFps(0) {
+}
+
+/**
+ * Load settings. Settings missing from the file, or out of range, keep their
+ * values.
+ *
+ * @param filename YAML (or XML) file.
+ * @return True if the file was read.
+ */
+bool RecognitionConfig::load(const string& filename) {
+    try {
+        cv::FileStorage fs(filename, cv::FileStorage::READ);
+        if (!fs.isOpened()) {
+            return false;
+        }
+
+        RecognitionConfig previous = *this;
+        readSetting(fs["hessianThreshold"], hessianThreshold);
+        readSetting(fs["ratio"], ratio);
+        readSetting(fs["minDistanceToEpipolar"], minDistanceToEpipolar);
+        readSetting(fs["confidenceLevel"], confidenceLevel);
+        readSetting(fs["minMatchedShare"], minMatchedShare);
+        readSetting(fs["maxFrameKeypoints"], maxFrameKeypoints);
+        readSetting(fs["pyramidLevel"], pyramidLevel);
+        int grid = gridSelection ? 1 : 0;
+        readSetting(fs["gridSelection"], grid);
+        gridSelection = (grid != 0);
+        int pose = poseClustering ? 1 : 0;
+        readSetting(fs["poseClustering"], pose);
+        poseClustering = (pose != 0);
+        readSetting(fs["maxCandidates"], maxCandidates);
+        readSetting(fs["frameBudget"], frameBudget);
+        readSetting(fs["maxObjectStaleness"], maxObjectStaleness);
+        readSetting(fs["keypointsPerObject"], keypointsPerObject);
+        readSetting(fs["maxReuseAge"], maxReuseAge);
+        readSetting(fs["targetFps"], targetFps);
+
+        //Written so NaN fails too.
+        checkSetting("hessianThreshold", hessianThreshold, previous.hessianThreshold, hessianThreshold >= 0);
+        checkSetting("ratio", ratio, previous.ratio, ratio > 0);
+        checkSetting("minDistanceToEpipolar", minDistanceToEpipolar, previous.minDistanceToEpipolar,
+                minDistanceToEpipolar > 0);
+        checkSetting("confidenceLevel", confidenceLevel, previous.confidenceLevel,
+                confidenceLevel > 0 && confidenceLevel < 1);
+        checkSetting("minMatchedShare", minMatchedShare, previous.minMatchedShare,
+                minMatchedShare >= 0 && minMatchedShare <= 1);
+        checkSetting("maxFrameKeypoints", maxFrameKeypoints, previous.maxFrameKeypoints, maxFrameKeypoints >= 0);
+        checkSetting("pyramidLevel", pyramidLevel, previous.pyramidLevel,
+                pyramidLevel >= 0 && pyramidLevel <= MAX_PYRAMID_LEVEL);
+        checkSetting("maxCandidates", maxCandidates, previous.maxCandidates, maxCandidates >= 1);
+        checkSetting("frameBudget", frameBudget, previous.frameBudget, frameBudget >= 0);
+        checkSetting("maxObjectStaleness", maxObjectStaleness, previous.maxObjectStaleness,
+                maxObjectStaleness >= 0);
+        checkSetting("keypointsPerObject", keypointsPerObject, previous.keypointsPerObject,
+                keypointsPerObject >= 0);
+        checkSetting("maxReuseAge", maxReuseAge, previous.maxReuseAge, maxReuseAge >= 0);
+        checkSetting("targetFps", targetFps, previous.targetFps, targetFps >= 0);
+    } catch (cv::Exception& ex) {
+        cout << "Could not load configuration: " << filename << endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Save settings.
+ *
+ * @param filename YAML (or XML) file.
+ * @return True if the file was written.
+ */
+bool RecognitionConfig::save(const string& filename) const {
+    try {
+        cv::FileStorage fs(filename, cv::FileStorage::WRITE);
+        if (!fs.isOpened()) {
+            cout << "Could not save configuration: " << filename << endl;
+            return false;
+        }
+
+        fs << "hessianThreshold" << hessianThreshold;
+        fs << "ratio" << ratio;
+        fs << "minDistanceToEpipolar" << minDistanceToEpipolar;
+        fs << "confidenceLevel" << confidenceLevel;
+        fs << "minMatchedShare" << minMatchedShare;
+        fs << "maxFrameKeypoints" << maxFrameKeypoints;
+        fs << "pyramidLevel" << pyramidLevel;
+        fs << "gridSelection" << (gridSelection ? 1 : 0);
+        fs << "poseClustering" << (poseClustering ? 1 : 0);
+        fs << "maxCandidates" << maxCandidates;
+        fs << "frameBudget" << frameBudget;
+        fs << "maxObjectStaleness" << maxObjectStaleness;
+        fs << "keypointsPerObject" << keypointsPerObject;
+        fs << "maxReuseAge" << maxReuseAge;
+        fs << "targetFps" << targetFps;
+    } catch (cv::Exception& ex) {
+        cout << "Could not save configuration: " << filename << endl;
+        return false;
+    }
+    return true;
+}
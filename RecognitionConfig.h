@@ -0,0 +1,72 @@
+/**
+ * @file RecognitionConfig.h
+ * @author Aydin Arik
+ * @brief Settings that trade recognition speed against accuracy. Loaded at
+ *        startup from a YAML file (e.g. one written by ParameterTuner), so they
+ *        can be changed without rebuilding.
+ */
+
+#ifndef RECOGNITIONCONFIG_H
+#define	RECOGNITIONCONFIG_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <string>
+#include <iostream>
+
+// SURF Hessian threshold used when no configuration is given.
+#define DEFAULT_HESSIAN_THRESHOLD 1250
+
+
+/******************************************************************************
+ *                              Classes
+ ******************************************************************************/
+struct RecognitionConfig {
+    double hessianThreshold; //SURF Hessian threshold (library and frames).
+    float ratio; //Max ratio between 1st and 2nd nearest neighbour (1 or more keeps all).
+    double minDistanceToEpipolar; //RANSAC inlier distance (pixels).
+    double confidenceLevel; //RANSAC confidence (probability).
+    float minMatchedShare; //Share of a view's keypoints that must match.
+    int maxFrameKeypoints; //Most frame keypoints described and matched (0 for no limit).
+    int pyramidLevel; //Times frames are halved in size before finding features (0 for full size).
+    bool gridSelection; //If true, choose frame keypoints by grid, else by ANMS.
+    bool poseClustering; //If true, only matches agreeing on a pose go to RANSAC.
+    int maxCandidates; //Most objects shortlisted by the library index per frame (without a frame budget).
+    double frameBudget; //Time to find objects in a frame (seconds, 0 to use the shortlist instead).
+    double maxObjectStaleness; //Longest an object may go unverified (seconds, with a frame budget).
+    int keypointsPerObject; //Most stable keypoints kept per object image (0 keeps all, and skips the slow stability test).
+    double maxReuseAge; //Seconds a result may be reused while frames are unchanged.
+    double targetFps; //Frame rate each camera is held at by lowering quality (0 to not adapt, see QualityController).
+
+    /**
+     * Constructor. Default settings (frame keypoints are capped at 600, and the
+     * best 5 objects of the shortlist are verified in each frame; the time
+     * budgeted scheduler is off).
+     */
+    RecognitionConfig();
+
+    /**
+     * Load settings. Settings missing from the file, or out of range (which
+     * are reported), keep their values.
+     *
+     * @param filename YAML (or XML) file.
+     * @return True if the file was read.
+     */
+    bool load(const std::string& filename);
+
+    /**
+     * Save settings.
+     *
+     * @param filename YAML (or XML) file.
+     * @return True if the file was written.
+     */
+    bool save(const std::string& filename) const;
+};
+
+/**
+ * Print settings on one line.
+ */
+std::ostream& operator<<(std::ostream& out, const RecognitionConfig& config);
+
+#endif	/* RECOGNITIONCONFIG_H */
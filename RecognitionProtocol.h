@@ -0,0 +1,101 @@
+/**
+ * @file RecognitionProtocol.h
+ * @author Aydin Arik
+ * @brief Messages between a RecognitionServer and its clients (see
+ *        RecognitionClient). Clients connect to the server's Unix domain
+ *        socket (SOCK_SEQPACKET, so each message arrives whole) and send a
+ *        hello naming a shared memory object of frame slots they created.
+ *        Frames are written to a slot, and a request names the slot, so only
+ *        small fixed-size messages go through the socket. A slot belongs to
+ *        the server from its request being sent until the reply arrives.
+ *
+ *        A client may have a request outstanding per slot. Replies come back
+ *        as batches finish, not necessarily in request order, and carry the
+ *        request's id.
+ */
+
+#ifndef RECOGNITIONPROTOCOL_H
+#define	RECOGNITIONPROTOCOL_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <stdint.h>
+#include "ResultRing.h"
+
+// Identifies a message ("ORSV"), and the protocol version.
+#define RECOGNITION_MAGIC 0x4f525356
+#define RECOGNITION_VERSION 1
+
+// Socket the server listens on by default.
+#define RECOGNITION_SOCKET "/tmp/object-recognition.sock"
+
+// Longest shared memory object name (including '\0'), and most frame slots a
+// client may have.
+#define RECOGNITION_MAX_NAME 64
+#define RECOGNITION_MAX_SLOTS 64
+
+
+/******************************************************************************
+ *                              Types
+ ******************************************************************************/
+/**
+ * Kinds of message.
+ */
+enum RecognitionMessageType {
+    RECOGNITION_HELLO = 1, //Client to server: where its frame slots are.
+    RECOGNITION_WELCOME = 2, //Server to client: the hello was accepted (or not).
+    RECOGNITION_REQUEST = 3, //Client to server: recognise objects in a slot's frame.
+    RECOGNITION_REPLY = 4 //Server to client: objects found in a request's frame.
+};
+
+/**
+ * How a request went.
+ */
+enum RecognitionStatus {
+    RECOGNITION_OK = 0,
+    RECOGNITION_BUSY = 1, //Too many requests queued; try again later.
+    RECOGNITION_BAD_REQUEST = 2, //Unknown slot, or a frame that doesn't fit it.
+    RECOGNITION_BAD_HELLO = 3 //Frame slots couldn't be mapped.
+};
+
+/**
+ * Client to server, once, straight after connecting.
+ */
+struct RecognitionHello {
+    uint32_t magic;
+    uint32_t type; //RECOGNITION_HELLO.
+    uint32_t version;
+    uint32_t numOfSlots;
+    uint64_t slotSize; //Bytes per slot.
+    char slotsName[RECOGNITION_MAX_NAME]; //Shared memory object holding the slots.
+};
+
+/**
+ * Client to server, for each frame.
+ */
+struct RecognitionRequest {
+    uint32_t magic;
+    uint32_t type; //RECOGNITION_REQUEST.
+    uint64_t id; //Chosen by the client, and returned in the reply.
+    uint32_t slot; //Slot holding the frame.
+    int32_t frameWidth, frameHeight, frameType; //cv::Mat size and type (8 bit, 1 or 3 channels).
+};
+
+/**
+ * Server to client, in answer to a hello or a request.
+ */
+struct RecognitionReply {
+    uint32_t magic;
+    uint32_t type; //RECOGNITION_WELCOME or RECOGNITION_REPLY.
+    uint64_t id; //Id of the request (0 for a welcome).
+    uint32_t slot; //Slot of the request, now the client's again.
+    int32_t status; //A RecognitionStatus.
+    int32_t batchSize; //Requests recognised in the same batch.
+    int32_t numOfDetections; //Detections used (the rest are left over).
+    int64_t queued; //Nanoseconds from the request arriving to its batch starting.
+    int64_t recognised; //Nanoseconds its batch took.
+    DetectionRecord detections[RESULT_RING_MAX_DETECTIONS]; //Best first.
+};
+
+#endif	/* RECOGNITIONPROTOCOL_H */
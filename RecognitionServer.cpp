@@ -0,0 +1,498 @@
+/**
+ * @file RecognitionServer.cpp
+ * @author Aydin Arik
+ * @brief Recognises objects in frames sent by other local processes, a batch
+ *        of requests at a time.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "RecognitionServer.h"
+#include "FrameTrace.h"
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace std;
+
+// Largest frame slot a client may have (bytes).
+#define MAX_SLOT_SIZE (64 * 1024 * 1024)
+
+
+/******************************************************************************
+ *                              Private Methods
+ ******************************************************************************/
+RecognitionServer::Client::Client(int socket)
+: socket(socket), slots(NULL), slotsSize(0), numOfSlots(0), slotSize(0), dropped(false) {
+}
+
+RecognitionServer::Client::~Client() {
+    if (slots) {
+        munmap(const_cast<char*> (slots), slotsSize);
+    }
+    close(socket);
+}
+
+/**
+ * Send a reply without blocking. A client that has stopped reading, so its
+ * socket is full, is disconnected rather than holding up everyone else's
+ * replies (the I/O thread then drops it).
+ *
+ * @param reply Reply to send (dropped if the client has gone).
+ */
+void RecognitionServer::Client::send(const RecognitionReply& reply) {
+    ScopedLock lock(sendMutex);
+    if (dropped) {
+        return;
+    }
+    if (::send(socket, &reply, sizeof (reply), MSG_NOSIGNAL | MSG_DONTWAIT) < 0 &&
+            (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        std::cout << "Recognition client isn't reading its replies; disconnecting it" << std::endl;
+        dropped = true;
+        shutdown(socket, SHUT_RDWR);
+    }
+}
+
+/**
+ * Entry point of the I/O thread. Accepts clients and queues their requests,
+ * until stopped.
+ *
+ * @param server The RecognitionServer that started the thread.
+ * @return NULL.
+ */
+void* RecognitionServer::runIo(void* server) {
+    RecognitionServer* self = static_cast<RecognitionServer*> (server);
+    vector<pollfd> fds;
+
+    while (true) {
+        fds.resize(2 + self->clients.size());
+        fds[0].fd = self->wakePipe[0];
+        fds[1].fd = self->listener;
+        for (unsigned int i = 0; i < self->clients.size(); i++) {
+            fds[2 + i].fd = self->clients[i]->socket;
+        }
+        for (unsigned int i = 0; i < fds.size(); i++) {
+            fds[i].events = POLLIN;
+            fds[i].revents = 0;
+        }
+
+        if (poll(&fds[0], fds.size(), -1) < 0) {
+            continue; //Interrupted.
+        }
+
+        self->mutex.lock();
+        bool stop = self->stopping;
+        self->mutex.unlock();
+        if (stop) {
+            break;
+        }
+
+        //Clients that have gone are dropped; their queued requests keep them
+        //open until replied to.
+        vector<ClientPtr> connected;
+        for (unsigned int i = 0; i < self->clients.size(); i++) {
+            const ClientPtr& client = self->clients[i];
+            if (fds[2 + i].revents == 0 || self->receive(client)) {
+                connected.push_back(client);
+            } else {
+                shutdown(client->socket, SHUT_RDWR); //Replies to it now fail at once.
+            }
+        }
+        self->clients.swap(connected);
+
+        if (fds[1].revents & POLLIN) {
+            int socket = accept(self->listener, NULL, NULL);
+            if (socket >= 0) {
+                fcntl(socket, F_SETFD, FD_CLOEXEC);
+                self->clients.push_back(ClientPtr(new Client(socket)));
+            }
+        }
+
+        self->mutex.lock();
+        self->stats.numOfClients = self->clients.size();
+        self->mutex.unlock();
+    }
+
+    self->clients.clear();
+    return NULL;
+}
+
+/**
+ * Entry point of the batch thread. Waits for a request, then for more to
+ * arrive, until the batch is full or the first request has waited the batch
+ * window. Requests that queued up while the last batch ran go straight into
+ * the next.
+ *
+ * @param server The RecognitionServer that started the thread.
+ * @return NULL.
+ */
+void* RecognitionServer::runBatches(void* server) {
+    RecognitionServer* self = static_cast<RecognitionServer*> (server);
+
+    while (true) {
+        self->mutex.lock();
+        while (self->requests.empty() && !self->stopping) {
+            self->queued.wait(self->mutex);
+        }
+
+        double deadline = self->stopping ? 0 :
+                self->requests.front().arrived + self->batchWindowMs / 1000.0;
+        while (self->requests.size() < self->maxBatch && !self->stopping) {
+            int remainingMs = (int) ceil((deadline - FrameTrace::now()) * 1000);
+            if (remainingMs <= 0) {
+                break;
+            }
+            self->queued.wait(self->mutex, remainingMs);
+        }
+        if (self->stopping) {
+            self->mutex.unlock();
+            break;
+        }
+
+        unsigned int batchSize = std::min((unsigned int) self->requests.size(), self->maxBatch);
+        vector<Request> batch(self->requests.begin(), self->requests.begin() + batchSize);
+        self->requests.erase(self->requests.begin(), self->requests.begin() + batchSize);
+        self->mutex.unlock();
+
+        //Frames stay in the clients' slots; nobody writes them until replied to.
+        vector<cv::Mat> frames(batchSize);
+        for (unsigned int i = 0; i < batchSize; i++) {
+            frames[i] = getFrame(*batch[i].client, batch[i].request);
+        }
+
+        double start = FrameTrace::now();
+        vector<vector<Detection> > detections;
+        self->recognition.runBatch(frames, detections);
+        double end = FrameTrace::now();
+
+        double totalQueued = 0;
+        for (unsigned int i = 0; i < batchSize; i++) {
+            const RecognitionRequest& request = batch[i].request;
+            RecognitionReply reply = makeReply(RECOGNITION_REPLY, request.id, request.slot, RECOGNITION_OK);
+            reply.batchSize = batchSize;
+            reply.queued = (int64_t) ((start - batch[i].arrived) * 1e9);
+            reply.recognised = (int64_t) ((end - start) * 1e9);
+            totalQueued += start - batch[i].arrived;
+
+            int numOfDetections = std::min((int) detections[i].size(), RESULT_RING_MAX_DETECTIONS);
+            reply.numOfDetections = numOfDetections;
+            for (int d = 0; d < numOfDetections; d++) {
+                const Detection& detection = detections[i][d];
+                DetectionRecord& out = reply.detections[d];
+                strncpy(out.objectName, detection.objectName.c_str(), RESULT_RING_MAX_NAME - 1);
+                out.score = detection.score;
+                out.numOfMatches = (int32_t) detection.matches.size();
+                out.x = detection.boundingBox.x;
+                out.y = detection.boundingBox.y;
+                out.width = detection.boundingBox.width;
+                out.height = detection.boundingBox.height;
+            }
+            batch[i].client->send(reply);
+        }
+
+        ScopedLock lock(self->mutex);
+        self->stats.numOfRequests += batchSize;
+        self->stats.numOfBatches++;
+        self->totalBatchSize += batchSize;
+        self->totalQueued += totalQueued;
+        self->totalRecognised += end - start;
+    }
+
+    return NULL;
+}
+
+/**
+ * Read a message from a client and act on it. Hellos are answered at once,
+ * and requests are queued (or turned away if the queue is full).
+ *
+ * @param client The client.
+ * @return False if the client has gone (or broke the protocol).
+ */
+bool RecognitionServer::receive(const ClientPtr& client) {
+    union {
+        RecognitionHello hello;
+        RecognitionRequest request;
+    } message;
+    ssize_t size = recv(client->socket, &message, sizeof (message), MSG_DONTWAIT);
+    if (size < (ssize_t) (2 * sizeof (uint32_t))) {
+        return false; //Gone (or not a message).
+    }
+
+    if (message.hello.magic != RECOGNITION_MAGIC) {
+        return false;
+    }
+    if (message.hello.type == RECOGNITION_HELLO && size == sizeof (RecognitionHello)) {
+        if (client->slots) {
+            return false; //Only one hello.
+        }
+        bool mapped = mapSlots(*client, message.hello);
+        client->send(makeReply(RECOGNITION_WELCOME, 0, 0, mapped ? RECOGNITION_OK : RECOGNITION_BAD_HELLO));
+        return mapped;
+    }
+    if (message.request.type != RECOGNITION_REQUEST || size != sizeof (RecognitionRequest) || !client->slots) {
+        return false;
+    }
+
+    const RecognitionRequest& request = message.request;
+    if (getFrame(*client, request).empty()) {
+        client->send(makeReply(RECOGNITION_REPLY, request.id, request.slot, RECOGNITION_BAD_REQUEST));
+        ScopedLock lock(mutex);
+        stats.numOfRejected++;
+        return true;
+    }
+
+    mutex.lock();
+    bool busy = (requests.size() >= maxQueued);
+    if (busy) {
+        stats.numOfRejected++;
+    } else {
+        Request queuedRequest;
+        queuedRequest.client = client;
+        queuedRequest.request = request;
+        queuedRequest.arrived = FrameTrace::now();
+        requests.push_back(queuedRequest);
+        queued.signal();
+    }
+    mutex.unlock();
+
+    if (busy) {
+        client->send(makeReply(RECOGNITION_REPLY, request.id, request.slot, RECOGNITION_BUSY));
+    }
+    return true;
+}
+
+/**
+ * Map a client's frame slots, read only.
+ *
+ * @param client The client.
+ * @param hello Its hello.
+ * @return True if mapped.
+ */
+bool RecognitionServer::mapSlots(Client& client, const RecognitionHello& hello) {
+    if (hello.version != RECOGNITION_VERSION || hello.numOfSlots == 0 ||
+            hello.numOfSlots > RECOGNITION_MAX_SLOTS || hello.slotSize == 0 ||
+            hello.slotSize > MAX_SLOT_SIZE) {
+        return false;
+    }
+    string name(hello.slotsName, strnlen(hello.slotsName, RECOGNITION_MAX_NAME));
+    if (name.size() < 2 || name.size() == RECOGNITION_MAX_NAME || name[0] != '/') {
+        return false;
+    }
+
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        cout << "Unable to open client frames: " << name << endl;
+        return false;
+    }
+    size_t size = (size_t) hello.numOfSlots * hello.slotSize;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size < size) {
+        close(fd);
+        return false;
+    }
+    void* memory = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        cout << "Unable to map client frames: " << name << endl;
+        return false;
+    }
+
+    client.slots = static_cast<const char*> (memory);
+    client.slotsSize = size;
+    client.numOfSlots = hello.numOfSlots;
+    client.slotSize = hello.slotSize;
+    return true;
+}
+
+/**
+ * @param client The client.
+ * @param request A request of the client's.
+ * @return The request's frame (refers to the client's slot), or an empty
+ *         frame if the request doesn't fit the slots.
+ */
+cv::Mat RecognitionServer::getFrame(const Client& client, const RecognitionRequest& request) {
+    int type = request.frameType;
+    if (!client.slots || request.slot >= client.numOfSlots || request.frameWidth <= 0 ||
+            request.frameHeight <= 0 || CV_MAT_DEPTH(type) != CV_8U ||
+            (CV_MAT_CN(type) != 1 && CV_MAT_CN(type) != 3)) {
+        return cv::Mat();
+    }
+    uint64_t bytes = (uint64_t) request.frameWidth * request.frameHeight * CV_MAT_CN(type);
+    if (bytes > client.slotSize) {
+        return cv::Mat();
+    }
+
+    void* data = const_cast<char*> (client.slots + request.slot * client.slotSize);
+    return cv::Mat(request.frameHeight, request.frameWidth, type, data);
+}
+
+/**
+ * @param type RECOGNITION_WELCOME or RECOGNITION_REPLY.
+ * @param id Id of the request (0 for a welcome).
+ * @param slot Slot of the request.
+ * @param status A RecognitionStatus.
+ * @return A reply with no detections.
+ */
+RecognitionReply RecognitionServer::makeReply(uint32_t type, uint64_t id, uint32_t slot, int32_t status) {
+    RecognitionReply reply;
+    memset(&reply, 0, sizeof (reply));
+    reply.magic = RECOGNITION_MAGIC;
+    reply.type = type;
+    reply.id = id;
+    reply.slot = slot;
+    reply.status = status;
+    return reply;
+}
+
+
+/******************************************************************************
+ *                              Public Methods
+ ******************************************************************************/
+/**
+ * Constructor.
+ *
+ * @param library Library to recognise objects of. Must outlive the server.
+ * @param socketPath Unix domain socket to listen on.
+ * @param maxBatch Most requests in a batch.
+ * @param batchWindowMs Longest a batch waits for more requests after its
+ *        first (milliseconds).
+ * @param maxQueued Most requests queued before turning more away.
+ */
+RecognitionServer::RecognitionServer(ObjectLibrary& library, const string& socketPath,
+        unsigned int maxBatch, int batchWindowMs, unsigned int maxQueued)
+: socketPath(socketPath), recognition(library), maxBatch(std::max(maxBatch, 1u)),
+batchWindowMs(std::max(batchWindowMs, 0)), maxQueued(std::max(maxQueued, 1u)), listener(-1),
+running(false), totalQueued(0), totalRecognised(0), totalBatchSize(0), stopping(false) {
+    wakePipe[0] = wakePipe[1] = -1;
+}
+
+/**
+ * Destructor. Stops the server.
+ */
+RecognitionServer::~RecognitionServer() {
+    stop();
+}
+
+/**
+ * Listen on the socket (replacing any left behind) and start the I/O and
+ * batch threads.
+ *
+ * @return True if started.
+ */
+bool RecognitionServer::start() {
+    if (running) {
+        return true;
+    }
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof (address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof (address.sun_path)) {
+        cout << "Socket path too long: " << socketPath << endl;
+        return false;
+    }
+    strcpy(address.sun_path, socketPath.c_str());
+
+    listener = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (listener < 0) {
+        cout << "Unable to create socket" << endl;
+        return false;
+    }
+    fcntl(listener, F_SETFD, FD_CLOEXEC);
+    unlink(socketPath.c_str());
+    if (bind(listener, (sockaddr*) &address, sizeof (address)) != 0 || listen(listener, 16) != 0) {
+        cout << "Unable to listen on: " << socketPath << endl;
+        close(listener);
+        listener = -1;
+        return false;
+    }
+    if (pipe(wakePipe) != 0) {
+        close(listener);
+        listener = -1;
+        unlink(socketPath.c_str());
+        return false;
+    }
+
+    stopping = false;
+    if (pthread_create(&ioThread, NULL, &RecognitionServer::runIo, this) != 0) {
+        stop();
+        return false;
+    }
+    if (pthread_create(&batchThread, NULL, &RecognitionServer::runBatches, this) != 0) {
+        mutex.lock();
+        stopping = true;
+        mutex.unlock();
+        if (write(wakePipe[1], "x", 1) != 1) {
+            //Do nothing... the pipe is never full.
+        }
+        pthread_join(ioThread, NULL);
+        stop();
+        return false;
+    }
+    running = true;
+    return true;
+}
+
+/**
+ * Disconnect every client, stop the threads and remove the socket. Requests
+ * still queued are dropped.
+ */
+void RecognitionServer::stop() {
+    if (running) {
+        mutex.lock();
+        stopping = true;
+        queued.broadcast();
+        mutex.unlock();
+        if (write(wakePipe[1], "x", 1) != 1) {
+            //Do nothing... the pipe is never full.
+        }
+
+        pthread_join(batchThread, NULL);
+        pthread_join(ioThread, NULL);
+        running = false;
+    }
+
+    mutex.lock();
+    requests.clear();
+    stats.numOfClients = 0;
+    stopping = false;
+    mutex.unlock();
+
+    if (listener >= 0) {
+        close(listener);
+        listener = -1;
+        unlink(socketPath.c_str());
+    }
+    for (int i = 0; i < 2; i++) {
+        if (wakePipe[i] >= 0) {
+            close(wakePipe[i]);
+            wakePipe[i] = -1;
+        }
+    }
+}
+
+/**
+ * @return What the server has done since it started.
+ */
+RecognitionServer::Stats RecognitionServer::getStats() {
+    ScopedLock lock(mutex);
+    Stats summary = stats;
+    if (stats.numOfBatches > 0) {
+        summary.meanBatchSize = totalBatchSize / stats.numOfBatches;
+        summary.meanRecognised = totalRecognised / stats.numOfBatches;
+    }
+    if (stats.numOfRequests > 0) {
+        summary.meanQueued = totalQueued / stats.numOfRequests;
+    }
+    return summary;
+}
@@ -0,0 +1,202 @@
+/**
+ * @file RecognitionServer.h
+ * @author Aydin Arik
+ * @brief Recognises objects in frames sent by other local processes (see
+ *        RecognitionClient and RecognitionProtocol.h), so several
+ *        applications on one host share one loaded library rather than each
+ *        loading their own. Clients connect over a Unix domain socket and
+ *        pass frames in shared memory. Requests arriving close together,
+ *        from any clients, are recognised as one batch (see
+ *        ObjectRecognition::runBatch()), and each client is replied to as its
+ *        batch finishes.
+ */
+
+#ifndef RECOGNITIONSERVER_H
+#define	RECOGNITIONSERVER_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <string>
+#include <vector>
+#include <deque>
+#include <pthread.h>
+#include <boost/shared_ptr.hpp>
+#include <opencv2/core/core.hpp>
+#include "ObjectLibrary.h"
+#include "ObjectRecognition.h"
+#include "RecognitionProtocol.h"
+#include "Mutex.h"
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+class RecognitionServer {
+public:
+
+    /**
+     * What the server has done since it started.
+     */
+    struct Stats {
+        long numOfClients; //Clients connected now.
+        long numOfRequests; //Requests recognised.
+        long numOfRejected; //Requests turned away (busy or bad).
+        long numOfBatches;
+        double meanBatchSize;
+        double meanQueued; //Seconds from a request arriving to its batch starting.
+        double meanRecognised; //Seconds per batch.
+
+        Stats() : numOfClients(0), numOfRequests(0), numOfRejected(0), numOfBatches(0),
+        meanBatchSize(0), meanQueued(0), meanRecognised(0) {
+        }
+    };
+
+private:
+
+    /**
+     * A connected client. Shared by the requests it has queued, so its
+     * socket and slots stay open until they have been replied to.
+     */
+    struct Client {
+        int socket;
+        const char* slots; //Mapped frame slots (NULL until the hello).
+        size_t slotsSize; //Bytes mapped.
+        uint32_t numOfSlots;
+        uint64_t slotSize;
+        Mutex sendMutex; //Serialises replies from the I/O and batch threads.
+        bool dropped; //Set once disconnected for not reading replies (guarded by sendMutex).
+
+        Client(int socket);
+        ~Client();
+
+        /**
+         * Send a reply without blocking. Disconnects the client if its
+         * socket is full.
+         *
+         * @param reply Reply to send (dropped if the client has gone).
+         */
+        void send(const RecognitionReply& reply);
+    };
+    typedef boost::shared_ptr<Client> ClientPtr;
+
+    struct Request {
+        ClientPtr client;
+        RecognitionRequest request;
+        double arrived; //Seconds, CLOCK_MONOTONIC.
+    };
+
+    std::string socketPath;
+    ObjectRecognition recognition; //Used by the batch thread only.
+    unsigned int maxBatch; //Most requests in a batch.
+    int batchWindowMs; //Longest a batch waits for more requests after its first.
+    unsigned int maxQueued; //Most requests queued before turning more away.
+    int listener; //Listening socket (-1 if not open).
+    int wakePipe[2]; //Written to wake the I/O thread.
+    pthread_t ioThread, batchThread;
+    bool running; //True if the threads were started.
+
+    std::vector<ClientPtr> clients; //I/O thread only.
+
+    //
+    //Guarded by mutex.
+    //
+    Mutex mutex;
+    Condition queued; //Signalled when a request is queued, or on stopping.
+    std::deque<Request> requests; //Oldest first.
+    Stats stats;
+    double totalQueued, totalRecognised, totalBatchSize;
+    bool stopping; //Set to make the threads exit.
+
+    /**
+     * Entry point of the I/O thread. Accepts clients and queues their requests.
+     *
+     * @param server The RecognitionServer that started the thread.
+     * @return NULL.
+     */
+    static void* runIo(void* server);
+
+    /**
+     * Entry point of the batch thread. Recognises queued requests a batch at a
+     * time and replies to each.
+     *
+     * @param server The RecognitionServer that started the thread.
+     * @return NULL.
+     */
+    static void* runBatches(void* server);
+
+    /**
+     * Read a message from a client and act on it.
+     *
+     * @param client The client.
+     * @return False if the client has gone (or broke the protocol).
+     */
+    bool receive(const ClientPtr& client);
+
+    /**
+     * Map a client's frame slots.
+     *
+     * @param client The client.
+     * @param hello Its hello.
+     * @return True if mapped.
+     */
+    bool mapSlots(Client& client, const RecognitionHello& hello);
+
+    /**
+     * @param client The client.
+     * @param request A request of the client's.
+     * @return The request's frame (refers to the client's slot), or an empty
+     *         frame if the request doesn't fit the slots.
+     */
+    static cv::Mat getFrame(const Client& client, const RecognitionRequest& request);
+
+    /**
+     * @param type RECOGNITION_WELCOME or RECOGNITION_REPLY.
+     * @param id Id of the request (0 for a welcome).
+     * @param slot Slot of the request.
+     * @param status A RecognitionStatus.
+     * @return A reply with no detections.
+     */
+    static RecognitionReply makeReply(uint32_t type, uint64_t id, uint32_t slot, int32_t status);
+
+    RecognitionServer(const RecognitionServer&); //Not copyable.
+    RecognitionServer& operator=(const RecognitionServer&);
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param library Library to recognise objects of. Must outlive the server.
+     * @param socketPath Unix domain socket to listen on.
+     * @param maxBatch Most requests in a batch.
+     * @param batchWindowMs Longest a batch waits for more requests after its
+     *        first (milliseconds).
+     * @param maxQueued Most requests queued before turning more away.
+     */
+    RecognitionServer(ObjectLibrary& library, const std::string& socketPath = RECOGNITION_SOCKET,
+            unsigned int maxBatch = 8, int batchWindowMs = 5, unsigned int maxQueued = 64);
+
+    /**
+     * Destructor. Stops the server.
+     */
+    ~RecognitionServer();
+
+    /**
+     * Listen on the socket (replacing any left behind) and start the I/O and
+     * batch threads.
+     *
+     * @return True if started.
+     */
+    bool start();
+
+    /**
+     * Disconnect every client, stop the threads and remove the socket.
+     */
+    void stop();
+
+    /**
+     * @return What the server has done since it started.
+     */
+    Stats getStats();
+};
+
+#endif	/* RECOGNITIONSERVER_H */
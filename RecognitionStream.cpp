@@ -0,0 +1,202 @@
+/**
+ * @file RecognitionStream.cpp
+ * @author Aydin Arik
+ * @brief Runs object recognition on one camera in its own thread.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "RecognitionStream.h"
+#include <iostream>
+#include <unistd.h>
+#include <sched.h>
+
+using namespace std;
+
+// Longest a stream waits for a frame before checking whether to stop
+// (milliseconds).
+#define FRAME_WAIT_MS 100
+
+
+/******************************************************************************
+ *                              Private Methods
+ ******************************************************************************/
+/**
+ * Entry point of the stream thread. Recognises objects in every new frame
+ * from the source until stopped.
+ *
+ * @param stream The RecognitionStream that started the thread.
+ * @return NULL.
+ */
+void* RecognitionStream::runStream(void* stream) {
+    RecognitionStream* self = static_cast<RecognitionStream*> (stream);
+
+#ifdef __linux__
+    if (!self->cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (unsigned int i = 0; i < self->cpus.size(); i++) {
+            CPU_SET(self->cpus[i], &set);
+        }
+        pthread_setaffinity_np(pthread_self(), sizeof (set), &set);
+    }
+#endif
+
+    while (true) {
+        self->mutex.lock();
+        bool stop = self->stopping;
+        self->mutex.unlock();
+        if (stop) {
+            break;
+        }
+
+        //A new frame each time, as the published result keeps it.
+        //Woken as soon as a frame arrives. The timeout only bounds how long
+        //stopping takes.
+        cv::Mat frame;
+        FrameTrace trace;
+        if (!self->source.waitVideo(frame, trace, FRAME_WAIT_MS)) {
+            continue; //No new frame yet.
+        }
+
+        RecognitionResultPtr result = self->recognition.recognise(frame, trace);
+        if (result) {
+            self->renderer.publish(self->window, result);
+            if (self->recorder) {
+                self->recorder->record(result); //Dropped if the recorder is behind.
+            }
+            if (self->publisher) {
+                self->publisher->publish(self->window, *result);
+            }
+            if (self->tracker) {
+                self->tracker->published(self->window, result->trace, FrameTrace::now());
+            }
+
+            //Reused results cost next to nothing, so say nothing of the settings.
+            if (self->controller && !result->reused &&
+                    self->controller->update(result->trace.recognised - result->trace.acquired,
+                    result->trace.recognised)) {
+                RecognitionConfig config = self->controller->getConfig();
+                std::cout << "Camera " << self->window << " quality level " << self->controller->getLevel()
+                        << " (" << self->controller->getFrameTime() * 1000 << " ms per frame): "
+                        << config << std::endl;
+                self->recognition.configure(config);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+
+/******************************************************************************
+ *                              Public Methods
+ ******************************************************************************/
+/**
+ * Constructor.
+ *
+ * @param source Camera to recognise objects in. Must already be started.
+ * @param library Library shared by every stream.
+ * @param renderer Renderer results are published to.
+ * @param window Window of the renderer to draw results in.
+ * @param cpus CPUs the stream may run on (empty for any).
+ *        The library's target frame rate (if any) is held.
+ */
+RecognitionStream::RecognitionStream(FrameSource& source, ObjectLibrary& library,
+        OverlayRenderer& renderer, int window, const vector<int>& cpus)
+: source(source), recognition(library), renderer(renderer), window(window), recorder(NULL),
+publisher(NULL), tracker(NULL), cpus(cpus), running(false), stopping(false) {
+    if (library.getConfig().targetFps > 0) {
+        controller.reset(new QualityController(library.getConfig(), library.getConfig().targetFps));
+    }
+}
+
+/**
+ * Destructor. Stops the stream thread.
+ */
+RecognitionStream::~RecognitionStream() {
+    stop();
+}
+
+/**
+ * Start the stream thread.
+ *
+ * @return True if the thread was started.
+ */
+bool RecognitionStream::start() {
+    if (!running) {
+        running = (pthread_create(&thread, NULL, &RecognitionStream::runStream, this) == 0);
+    }
+    return running;
+}
+
+/**
+ * Stop the stream thread and wait for it to finish.
+ */
+void RecognitionStream::stop() {
+    if (!running) {
+        return;
+    }
+
+    mutex.lock();
+    stopping = true;
+    mutex.unlock();
+
+    pthread_join(thread, NULL);
+    running = false;
+    stopping = false;
+}
+
+/**
+ * Record every result. Call before start().
+ *
+ * @param recorder Recorder (NULL for none). Must outlive the stream.
+ */
+void RecognitionStream::setRecorder(Recorder* recorder) {
+    this->recorder = recorder;
+}
+
+/**
+ * Publish every result to other processes. Call before start().
+ *
+ * @param publisher Publisher (NULL for none). Must outlive the stream.
+ */
+void RecognitionStream::setPublisher(ResultPublisher* publisher) {
+    this->publisher = publisher;
+}
+
+/**
+ * Measure how old every result is when published. Call before start().
+ *
+ * @param tracker Tracker (NULL for none). Must outlive the stream.
+ */
+void RecognitionStream::setTracker(LatencyTracker* tracker) {
+    this->tracker = tracker;
+}
+
+/**
+ * Share the online CPUs fairly between streams. With at least as many
+ * CPUs as streams, stream i gets CPUs i, i + n, i + 2n, ... Otherwise
+ * streams take turns sharing CPUs.
+ *
+ * @param numOfStreams Number of streams (n).
+ * @param cpus CPUs of each stream.
+ */
+void RecognitionStream::allocateCpus(int numOfStreams, vector<vector<int> >& cpus) {
+    int numOfCpus = sysconf(_SC_NPROCESSORS_ONLN);
+    cpus.assign(numOfStreams, vector<int>());
+    if (numOfCpus <= 0) {
+        return; //Unknown; let the scheduler decide.
+    }
+
+    if (numOfStreams <= numOfCpus) {
+        for (int cpu = 0; cpu < numOfCpus; cpu++) {
+            cpus[cpu % numOfStreams].push_back(cpu);
+        }
+    } else {
+        for (int i = 0; i < numOfStreams; i++) {
+            cpus[i].push_back(i % numOfCpus);
+        }
+    }
+}
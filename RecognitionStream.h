@@ -0,0 +1,129 @@
+/**
+ * @file RecognitionStream.h
+ * @author Aydin Arik
+ * @brief Runs object recognition on one camera in its own thread. Each stream
+ *        has its own matcher and display state, but every stream shares the
+ *        one ObjectLibrary, so adding a camera doesn't add another copy of the
+ *        library. Streams are pinned to their own share of the CPUs. Results
+ *        are published to an OverlayRenderer, which draws them. With a target
+ *        frame rate, each stream lowers its own quality to hold it (see
+ *        QualityController).
+ */
+
+#ifndef RECOGNITIONSTREAM_H
+#define	RECOGNITIONSTREAM_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <boost/scoped_ptr.hpp>
+#include <opencv2/core/core.hpp>
+#include "FrameSource.h"
+#include "ObjectLibrary.h"
+#include "ObjectRecognition.h"
+#include "OverlayRenderer.h"
+#include "Recorder.h"
+#include "ResultPublisher.h"
+#include "LatencyTracker.h"
+#include "QualityController.h"
+#include "Mutex.h"
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+class RecognitionStream {
+private:
+    FrameSource& source;
+    ObjectRecognition recognition;
+    OverlayRenderer& renderer;
+    int window; //Window of the renderer results are published to.
+    Recorder* recorder; //Records every result (NULL for none).
+    ResultPublisher* publisher; //Shares every result with other processes (NULL for none).
+    LatencyTracker* tracker; //Measures how old results are (NULL for none).
+    boost::scoped_ptr<QualityController> controller; //Holds the target frame rate (NULL for none).
+    std::vector<int> cpus; //CPUs the stream's thread may run on (empty for any).
+    pthread_t thread;
+    bool running; //True if thread was started.
+
+    Mutex mutex;
+    bool stopping; //Set to make the stream thread exit (guarded by mutex).
+
+    /**
+     * Entry point of the stream thread. Recognises objects in every new frame
+     * from the source until stopped.
+     *
+     * @param stream The RecognitionStream that started the thread.
+     * @return NULL.
+     */
+    static void* runStream(void* stream);
+
+    RecognitionStream(const RecognitionStream&); //Not copyable.
+    RecognitionStream& operator=(const RecognitionStream&);
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param source Camera to recognise objects in. Must already be started.
+     * @param library Library shared by every stream.
+     * @param renderer Renderer results are published to.
+     * @param window Window of the renderer to draw results in.
+     * @param cpus CPUs the stream may run on (empty for any).
+     *        The library's target frame rate (if any) is held.
+     */
+    RecognitionStream(FrameSource& source, ObjectLibrary& library,
+            OverlayRenderer& renderer, int window, const std::vector<int>& cpus);
+
+    /**
+     * Destructor. Stops the stream thread.
+     */
+    ~RecognitionStream();
+
+    /**
+     * Start the stream thread.
+     *
+     * @return True if the thread was started.
+     */
+    bool start();
+
+    /**
+     * Stop the stream thread and wait for it to finish.
+     */
+    void stop();
+
+    /**
+     * Record every result. Call before start().
+     *
+     * @param recorder Recorder (NULL for none). Must outlive the stream.
+     */
+    void setRecorder(Recorder* recorder);
+
+    /**
+     * Publish every result to other processes. Call before start().
+     *
+     * @param publisher Publisher (NULL for none). Must outlive the stream.
+     */
+    void setPublisher(ResultPublisher* publisher);
+
+    /**
+     * Measure how old every result is when published. Call before start().
+     *
+     * @param tracker Tracker (NULL for none). Must outlive the stream.
+     */
+    void setTracker(LatencyTracker* tracker);
+
+    /**
+     * Share the online CPUs fairly between streams. With at least as many
+     * CPUs as streams, stream i gets CPUs i, i + n, i + 2n, ... Otherwise
+     * streams take turns sharing CPUs.
+     *
+     * @param numOfStreams Number of streams (n).
+     * @param cpus CPUs of each stream.
+     */
+    static void allocateCpus(int numOfStreams, std::vector<std::vector<int> >& cpus);
+};
+
+#endif	/* RECOGNITIONSTREAM_H */
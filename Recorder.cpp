@@ -0,0 +1,260 @@
+/**
+ * @file Recorder.cpp
+ * @author Aydin Arik
+ * @brief Writes snapshots and a continuous video of recognition results on a
+ *        thread of its own.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "Recorder.h"
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include "boost/filesystem/operations.hpp"
+#include "boost/filesystem/path.hpp"
+
+using namespace std;
+namespace fs = boost::filesystem;
+
+// Frames between checks of the video file size (checking needs a stat).
+#define SIZE_CHECK_INTERVAL 30
+
+
+/******************************************************************************
+ *                              Private Methods
+ ******************************************************************************/
+/**
+ * Entry point of the recorder thread. Writes queued jobs, oldest first,
+ * until stopped and the queue is empty.
+ *
+ * @param recorder The Recorder that started the thread.
+ * @return NULL.
+ */
+void* Recorder::runRecorder(void* recorder) {
+    Recorder* self = static_cast<Recorder*> (recorder);
+
+    while (true) {
+        self->mutex.lock();
+        while (self->jobs.empty() && !self->stopping) {
+            self->queued.wait(self->mutex);
+        }
+        if (self->jobs.empty()) {
+            self->mutex.unlock();
+            break; //Stopping and everything is written.
+        }
+        Job job = self->jobs.front();
+        self->jobs.pop_front();
+        self->mutex.unlock();
+
+        self->write(job);
+    }
+
+    self->writer.release();
+    return NULL;
+}
+
+/**
+ * Queue a job, unless the queue is full.
+ *
+ * @param job The job.
+ * @return True if the job was queued.
+ */
+bool Recorder::push(const Job& job) {
+    if (!job.result || !job.result->frame.data) {
+        return false;
+    }
+
+    ScopedLock lock(mutex);
+    if (!running || jobs.size() >= maxQueued) {
+        numOfDropped++;
+        return false;
+    }
+    jobs.push_back(job);
+    queued.signal();
+    return true;
+}
+
+/**
+ * Write a snapshot or video frame.
+ *
+ * @param job The job.
+ */
+void Recorder::write(const Job& job) {
+    const cv::Mat* image = &job.result->frame;
+    if (!job.filename.empty() || annotated) {
+        display.render(*job.result, canvas);
+        image = &canvas;
+    }
+
+    if (job.filename.empty()) {
+        writeVideo(*image);
+    } else if (!cv::imwrite(job.filename, *image)) {
+        cout << "Unable to write snapshot: " << job.filename << endl;
+    }
+}
+
+/**
+ * Write a video frame, starting a new file first if the current one is
+ * full or the image size has changed.
+ *
+ * @param image Image to write.
+ */
+void Recorder::writeVideo(const cv::Mat& image) {
+    bool rotate = !writer.isOpened() || image.size() != videoSize;
+
+    if (!rotate && maxSeconds > 0) {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double seconds = (now.tv_sec - videoStart.tv_sec) + (now.tv_nsec - videoStart.tv_nsec) / 1e9;
+        rotate = (seconds >= maxSeconds);
+    }
+
+    //The writer buffers, so the size on disk lags a little behind.
+    if (!rotate && maxBytes > 0 && framesWritten % SIZE_CHECK_INTERVAL == 0) {
+        try {
+            rotate = ((long) fs::file_size(fs::path(videoFile)) >= maxBytes);
+        } catch (fs::filesystem_error&) {
+            //Do nothing (not flushed yet).
+        }
+    }
+
+    if (rotate) {
+        writer.release();
+
+        ostringstream file;
+        file << videoName << "_" << setw(3) << setfill('0') << videoCount++ << ".avi";
+        videoFile = file.str();
+        videoSize = image.size();
+        framesWritten = 0;
+        clock_gettime(CLOCK_MONOTONIC, &videoStart);
+
+        if (!writer.open(videoFile, CV_FOURCC('M', 'J', 'P', 'G'), fps, videoSize, image.channels() == 3)) {
+            cout << "Unable to write video: " << videoFile << endl;
+            return;
+        }
+    }
+
+    writer.write(image);
+    framesWritten++;
+}
+
+
+/******************************************************************************
+ *                              Public Methods
+ ******************************************************************************/
+/**
+ * Constructor.
+ *
+ * @param maxQueued Longest the queue may get before results are dropped.
+ */
+Recorder::Recorder(unsigned int maxQueued)
+: maxQueued(maxQueued > 0 ? maxQueued : 1), running(false), annotated(true), fps(30.0),
+maxBytes(0), maxSeconds(0), videoCount(0), framesWritten(0), numOfDropped(0),
+stopping(false) {
+    videoStart.tv_sec = 0;
+    videoStart.tv_nsec = 0;
+}
+
+/**
+ * Destructor. Stops the recorder thread.
+ */
+Recorder::~Recorder() {
+    stop();
+}
+
+/**
+ * Record every result given to record() as video. Call before start().
+ *
+ * @param videoName Path and name of video files, without number or suffix.
+ * @param annotated If true, record annotated images, else raw frames.
+ * @param fps Frame rate written in video files.
+ * @param maxBytes Size at which to start a new file (0 for no limit).
+ * @param maxSeconds Length at which to start a new file (0 for no limit).
+ */
+void Recorder::setVideo(const string& videoName, bool annotated, double fps,
+        long maxBytes, double maxSeconds) {
+    this->videoName = videoName;
+    this->annotated = annotated;
+    this->fps = fps;
+    this->maxBytes = maxBytes;
+    this->maxSeconds = maxSeconds;
+}
+
+/**
+ * Start the recorder thread.
+ *
+ * @return True if the thread was started.
+ */
+bool Recorder::start() {
+    ScopedLock lock(mutex);
+    if (!running) {
+        running = (pthread_create(&thread, NULL, &Recorder::runRecorder, this) == 0);
+    }
+    return running;
+}
+
+/**
+ * Write everything queued, then stop the recorder thread and close the
+ * video file.
+ */
+void Recorder::stop() {
+    mutex.lock();
+    if (!running) {
+        mutex.unlock();
+        return;
+    }
+    stopping = true;
+    queued.signal();
+    mutex.unlock();
+
+    pthread_join(thread, NULL);
+
+    mutex.lock();
+    running = false;
+    stopping = false;
+    if (numOfDropped > 0) {
+        cout << "Recorder dropped " << numOfDropped << " frames" << endl;
+    }
+    mutex.unlock();
+}
+
+/**
+ * Queue a result to be written as a video frame. Does nothing if no
+ * video was set.
+ *
+ * @param result The result.
+ * @return True if queued, false if dropped.
+ */
+bool Recorder::record(const RecognitionResultPtr& result) {
+    if (videoName.empty()) {
+        return false;
+    }
+
+    Job job;
+    job.result = result;
+    return push(job);
+}
+
+/**
+ * Queue a result to be written as an annotated image.
+ *
+ * @param filename Image file (the suffix picks the format).
+ * @param result The result.
+ * @return True if queued, false if dropped.
+ */
+bool Recorder::snapshot(const string& filename, const RecognitionResultPtr& result) {
+    Job job;
+    job.result = result;
+    job.filename = filename;
+    return push(job);
+}
+
+/**
+ * @return Number of results dropped because the queue was full.
+ */
+long Recorder::getNumOfDropped() {
+    ScopedLock lock(mutex);
+    return numOfDropped;
+}
@@ -0,0 +1,165 @@
+/**
+ * @file Recorder.h
+ * @author Aydin Arik
+ * @brief Writes snapshots and a continuous video of recognition results on a
+ *        thread of its own. Results are queued and encoded in the background,
+ *        so recording never holds up recognition. When the queue is full, new
+ *        results are dropped rather than waited on. Video is split into
+ *        numbered files once a file reaches a size or length limit.
+ */
+
+#ifndef RECORDER_H
+#define	RECORDER_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <string>
+#include <deque>
+#include <pthread.h>
+#include <time.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include "Detection.h"
+#include "Display.h"
+#include "Mutex.h"
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+class Recorder {
+private:
+
+    struct Job {
+        RecognitionResultPtr result;
+        std::string filename; //Snapshot file, or empty for a video frame.
+    };
+
+    Display display; //Draws annotated images (recorder thread only).
+    cv::Mat canvas; //Annotated image (reused between results).
+    unsigned int maxQueued; //Longest the queue may get before results are dropped.
+    pthread_t thread;
+    bool running; //True if thread was started.
+
+    //
+    //Video. Set before start(), then used by the recorder thread only.
+    //
+    std::string videoName; //Path and name of video files, without number or suffix (empty for no video).
+    bool annotated; //If true, record annotated images, else raw frames.
+    double fps; //Frame rate written in video files.
+    long maxBytes; //Size at which to start a new file (0 for no limit).
+    double maxSeconds; //Length at which to start a new file (0 for no limit).
+    cv::VideoWriter writer;
+    std::string videoFile; //File being written.
+    int videoCount; //Number of video files started.
+    cv::Size videoSize; //Image size of the file being written.
+    timespec videoStart; //When the file being written was started.
+    int framesWritten; //Frames in the file being written.
+
+    //
+    //Guarded by mutex.
+    //
+    Mutex mutex;
+    Condition queued; //Signalled when a job is queued or on stopping.
+    std::deque<Job> jobs;
+    long numOfDropped; //Results dropped because the queue was full.
+    bool stopping; //Set to make the recorder thread exit once the queue is empty.
+
+    /**
+     * Entry point of the recorder thread.
+     *
+     * @param recorder The Recorder that started the thread.
+     * @return NULL.
+     */
+    static void* runRecorder(void* recorder);
+
+    /**
+     * Queue a job, unless the queue is full.
+     *
+     * @param job The job.
+     * @return True if the job was queued.
+     */
+    bool push(const Job& job);
+
+    /**
+     * Write a snapshot or video frame.
+     *
+     * @param job The job.
+     */
+    void write(const Job& job);
+
+    /**
+     * Write a video frame, starting a new file first if the current one is
+     * full or the image size has changed.
+     *
+     * @param image Image to write.
+     */
+    void writeVideo(const cv::Mat& image);
+
+    Recorder(const Recorder&); //Not copyable.
+    Recorder& operator=(const Recorder&);
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param maxQueued Longest the queue may get before results are dropped.
+     */
+    Recorder(unsigned int maxQueued = 8);
+
+    /**
+     * Destructor. Stops the recorder thread.
+     */
+    ~Recorder();
+
+    /**
+     * Record every result given to record() as video. Call before start().
+     *
+     * @param videoName Path and name of video files, without number or suffix
+     *        (e.g. "recordings/camera0" gives "recordings/camera0_000.avi", ...).
+     * @param annotated If true, record annotated images, else raw frames.
+     * @param fps Frame rate written in video files.
+     * @param maxBytes Size at which to start a new file (0 for no limit).
+     * @param maxSeconds Length at which to start a new file (0 for no limit).
+     */
+    void setVideo(const std::string& videoName, bool annotated = true, double fps = 30.0,
+            long maxBytes = 512L * 1024 * 1024, double maxSeconds = 600.0);
+
+    /**
+     * Start the recorder thread.
+     *
+     * @return True if the thread was started.
+     */
+    bool start();
+
+    /**
+     * Write everything queued, then stop the recorder thread and close the
+     * video file.
+     */
+    void stop();
+
+    /**
+     * Queue a result to be written as a video frame. Does nothing if no
+     * video was set.
+     *
+     * @param result The result.
+     * @return True if queued, false if dropped.
+     */
+    bool record(const RecognitionResultPtr& result);
+
+    /**
+     * Queue a result to be written as an annotated image.
+     *
+     * @param filename Image file (the suffix picks the format).
+     * @param result The result.
+     * @return True if queued, false if dropped.
+     */
+    bool snapshot(const std::string& filename, const RecognitionResultPtr& result);
+
+    /**
+     * @return Number of results dropped because the queue was full.
+     */
+    long getNumOfDropped();
+};
+
+#endif	/* RECORDER_H */
@@ -0,0 +1,433 @@
+/**
+ * @file ReplayCamera.cpp
+ * @author Aydin Arik
+ * @brief Plays back a capture written by CaptureWriter as if it were a Kinect.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "ReplayCamera.h"
+#include <opencv2/imgproc/imgproc.hpp>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+using namespace std;
+
+
+/******************************************************************************
+ *                              Private Methods
+ ******************************************************************************/
+/**
+ * Entry point of the replay thread. Plays each frame in turn, either when
+ * it is due (throttled) or, for RGB frames, once the one before has been
+ * got (unthrottled).
+ *
+ * @param camera The ReplayCamera that started the thread.
+ * @return NULL.
+ */
+void* ReplayCamera::runReplay(void* camera) {
+    ReplayCamera* self = static_cast<ReplayCamera*> (camera);
+    const vector<const RecordHeader*>& records = self->records;
+
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int64_t first = records.empty() ? 0 : records[0]->captured;
+    unsigned int i = 0;
+
+    self->mutex.lock();
+    while (!self->stopping) {
+        if (i >= records.size()) {
+            if (!self->loop || records.empty()) {
+                self->finished = true;
+                self->changed.broadcast();
+                self->videoReady.broadcast(); //No more frames to wait for.
+                break;
+            }
+            i = 0;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+        }
+        const RecordHeader* record = records[i];
+
+        if (self->throttled) {
+            while (!self->stopping) {
+                timespec now;
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                int64_t elapsed = (int64_t) (now.tv_sec - start.tv_sec) * 1000000000LL + (now.tv_nsec - start.tv_nsec);
+                int64_t due = record->captured - first;
+                if (elapsed >= due) {
+                    break;
+                }
+                self->changed.wait(self->mutex, std::max((int) ((due - elapsed) / 1000000), 1));
+            }
+        } else if (record->type == RGBD_VIDEO && self->videoStarted) {
+            while (!self->stopping && self->newRGBFrame) {
+                self->changed.wait(self->mutex);
+            }
+        }
+        if (self->stopping) {
+            break;
+        }
+
+        bool video = (record->type == RGBD_VIDEO && self->videoStarted);
+        bool depth = (record->type == RGBD_DEPTH && self->depthStarted);
+        self->mutex.unlock();
+
+        //The frame is handed over where it lies in the mapped capture.
+        void* data = const_cast<RecordHeader*> (record + 1);
+        if (video) {
+            self->VideoCallback(data, record->timestamp);
+        } else if (depth) {
+            self->DepthCallback(data, record->timestamp);
+        }
+
+        self->mutex.lock();
+        i++;
+    }
+    self->mutex.unlock();
+
+    return NULL;
+}
+
+/**
+ * @param offset Offset of a record.
+ * @return The record, or NULL if there isn't a complete one there.
+ */
+const RecordHeader* ReplayCamera::recordAt(uint64_t offset) const {
+    if (offset < sizeof (CaptureHeader) || offset % 8 != 0 || offset + sizeof (RecordHeader) > length) {
+        return NULL;
+    }
+
+    const RecordHeader* record = (const RecordHeader*) ((const char*) memory + offset);
+    if (record->magic != RGBD_RECORD_MAGIC || offset + rgbdRecordSize(record->size) > length) {
+        return NULL;
+    }
+    return record;
+}
+
+/**
+ * @param record A record.
+ * @return True if it is a frame of the capture's size.
+ */
+bool ReplayCamera::isFrame(const RecordHeader* record) const {
+    return record && (record->type == RGBD_VIDEO || record->type == RGBD_DEPTH) &&
+            record->size == rgbdFrameSize(record->type, header->width, header->height);
+}
+
+/**
+ * Find every frame by walking back through the indices from the end
+ * record. Fails if the capture wasn't closed.
+ *
+ * @return True if every frame was found.
+ */
+bool ReplayCamera::readIndex() {
+    uint64_t endSize = rgbdRecordSize(sizeof (uint64_t));
+    if (length < sizeof (CaptureHeader) + endSize) {
+        return false;
+    }
+    const RecordHeader* end = recordAt(length - endSize);
+    if (!end || end->type != RGBD_END) {
+        return false;
+    }
+
+    vector<const RecordHeader*> found; //Newest first.
+    uint64_t indexOffset = *(const uint64_t*) (end + 1);
+    while (indexOffset != 0) {
+        const RecordHeader* index = recordAt(indexOffset);
+        if (!index || index->type != RGBD_INDEX || index->size < sizeof (uint64_t)) {
+            return false;
+        }
+
+        const uint64_t* offsets = (const uint64_t*) (index + 1);
+        int numOfOffsets = index->size / sizeof (uint64_t);
+        for (int j = numOfOffsets - 1; j >= 1; j--) {
+            const RecordHeader* frame = recordAt(offsets[j]);
+            if (!isFrame(frame)) {
+                return false;
+            }
+            found.push_back(frame);
+        }
+
+        if (offsets[0] >= indexOffset) {
+            return false; //Indices only ever point back.
+        }
+        indexOffset = offsets[0];
+    }
+
+    records.assign(found.rbegin(), found.rend());
+    return true;
+}
+
+/**
+ * Find every frame by reading the records in order. Used for captures that
+ * weren't closed, up to the last complete record.
+ */
+void ReplayCamera::scanRecords() {
+    records.clear();
+    uint64_t offset = sizeof (CaptureHeader);
+    const RecordHeader* record;
+    while ((record = recordAt(offset)) != NULL) {
+        if (isFrame(record)) {
+            records.push_back(record);
+        }
+        offset += rgbdRecordSize(record->size);
+    }
+}
+
+/**
+ * Called with each RGB frame, as by Freenect::FreenectDevice.
+ *
+ * @param RGBData The frame (valid until the camera is destroyed).
+ * @param timestamp Driver timestamp.
+ */
+void ReplayCamera::VideoCallback(void* RGBData, uint32_t timestamp) {
+    double arrived = FrameTrace::now();
+    ScopedLock lock(mutex);
+    RGBMat = cv::Mat(header->height, header->width, CV_8UC3, RGBData);
+    RGBTimestamp = timestamp;
+    RGBSequence++;
+    RGBArrived = arrived;
+    newRGBFrame = true;
+    videoReady.broadcast();
+}
+
+/**
+ * Called with each depth frame, as by Freenect::FreenectDevice.
+ *
+ * @param depthData The frame (valid until the camera is destroyed).
+ * @param timestamp Driver timestamp.
+ */
+void ReplayCamera::DepthCallback(void* depthData, uint32_t timestamp) {
+    ScopedLock lock(mutex);
+    depthMat = cv::Mat(header->height, header->width, CV_16UC1, depthData);
+    depthTimestamp = timestamp;
+    newDepthFrame = true;
+}
+
+
+/******************************************************************************
+ *                              Public Methods
+ ******************************************************************************/
+/**
+ * Constructor.
+ *
+ * @param filename Capture to play.
+ * @param throttled If true, keep the capture's timing, else run unthrottled.
+ * @param loop If true, start again from the first frame at the end.
+ */
+ReplayCamera::ReplayCamera(const string& filename, bool throttled, bool loop)
+: filename(filename), throttled(throttled), loop(loop), memory(NULL), length(0),
+header(NULL), running(false), RGBTimestamp(0), RGBSequence(0), RGBArrived(0), depthTimestamp(0), newRGBFrame(false),
+newDepthFrame(false), videoStarted(false), depthStarted(false), finished(false),
+stopping(false) {
+}
+
+/**
+ * Destructor. Stops playback and unmaps the capture.
+ */
+ReplayCamera::~ReplayCamera() {
+    stopStream();
+    RGBMat.release();
+    depthMat.release();
+    if (memory) {
+        munmap(memory, length);
+    }
+}
+
+/**
+ * Map the capture and find its frames.
+ *
+ * @return True if the capture could be played.
+ */
+bool ReplayCamera::open() {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        cout << "Unable to open capture: " << filename << endl;
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof (CaptureHeader)) {
+        cout << "Not a capture: " << filename << endl;
+        close(fd);
+        return false;
+    }
+    length = info.st_size;
+    memory = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); //The mapping stays valid.
+    if (memory == MAP_FAILED) {
+        cout << "Unable to map capture: " << filename << endl;
+        memory = NULL;
+        return false;
+    }
+    madvise(memory, length, MADV_SEQUENTIAL);
+
+    header = (const CaptureHeader*) memory;
+    if (header->magic != RGBD_CAPTURE_MAGIC || header->version != RGBD_CAPTURE_VERSION) {
+        cout << "Not a capture: " << filename << endl;
+        return false;
+    }
+
+    if (!readIndex()) {
+        cout << "Capture wasn't closed, reading it through: " << filename << endl;
+        scanRecords();
+    }
+    return !records.empty();
+}
+
+void ReplayCamera::startVideo() {
+    ScopedLock lock(mutex);
+    videoStarted = true;
+}
+
+void ReplayCamera::stopVideo() {
+    ScopedLock lock(mutex);
+    videoStarted = false;
+    changed.broadcast();
+}
+
+void ReplayCamera::startDepth() {
+    ScopedLock lock(mutex);
+    depthStarted = true;
+}
+
+void ReplayCamera::stopDepth() {
+    ScopedLock lock(mutex);
+    depthStarted = false;
+    changed.broadcast();
+}
+
+/**
+ * Start playing RGB and depth frames.
+ */
+void ReplayCamera::startStream() {
+    startVideo();
+    startDepth();
+
+    ScopedLock lock(mutex);
+    if (!running && header) {
+        stopping = false;
+        finished = false;
+        running = (pthread_create(&thread, NULL, &ReplayCamera::runReplay, this) == 0);
+    }
+}
+
+/**
+ * Stop playing.
+ */
+void ReplayCamera::stopStream() {
+    mutex.lock();
+    if (!running) {
+        mutex.unlock();
+        return;
+    }
+    stopping = true;
+    changed.broadcast();
+    videoReady.broadcast();
+    mutex.unlock();
+
+    pthread_join(thread, NULL);
+
+    ScopedLock lock(mutex);
+    running = false;
+}
+
+/**
+ * Get the newest RGB frame. Converting to BGR is the only copy made.
+ *
+ * @param outputRGB The frame (BGR).
+ * @return True if there was a new frame.
+ */
+bool ReplayCamera::getVideo(cv::Mat& outputRGB) {
+    FrameTrace trace;
+    return getVideo(outputRGB, trace);
+}
+
+/**
+ * Get the newest RGB frame, and where and when it came from.
+ *
+ * @param outputRGB The frame (BGR).
+ * @param trace Sequence number, driver timestamp (as captured), and when the
+ *        frame was played and got.
+ * @return True if there was a new frame.
+ */
+bool ReplayCamera::getVideo(cv::Mat& outputRGB, FrameTrace& trace) {
+    return waitVideo(outputRGB, trace, 0);
+}
+
+/**
+ * Wait for the next RGB frame that hasn't been got already. The replay
+ * thread wakes the wait as soon as it plays a frame.
+ *
+ * @param outputRGB The frame (BGR).
+ * @param trace Sequence number, driver timestamp (as captured), and when the
+ *        frame was played and got.
+ * @param timeoutMs Longest time to wait (milliseconds, negative to wait until
+ *        there is a frame or playback stops).
+ * @return True if there was a new frame.
+ */
+bool ReplayCamera::waitVideo(cv::Mat& outputRGB, FrameTrace& trace, int timeoutMs) {
+    double deadline = FrameTrace::now() + timeoutMs / 1000.0;
+    ScopedLock lock(mutex);
+    while (!newRGBFrame && running && !stopping && !finished && timeoutMs != 0) {
+        if (timeoutMs < 0) {
+            videoReady.wait(mutex);
+            continue;
+        }
+        int remainingMs = (int) ceil((deadline - FrameTrace::now()) * 1000);
+        if (remainingMs <= 0) {
+            break;
+        }
+        videoReady.wait(mutex, remainingMs); //Woken early by a frame (or spuriously).
+    }
+    if (!newRGBFrame) {
+        return false;
+    }
+    cv::cvtColor(RGBMat, outputRGB, CV_RGB2BGR);
+    newRGBFrame = false;
+    changed.broadcast(); //Unthrottled playback moves on.
+
+    trace = FrameTrace();
+    trace.sequence = RGBSequence;
+    trace.driverTimestamp = RGBTimestamp;
+    trace.arrived = RGBArrived;
+    trace.acquired = FrameTrace::now();
+    return true;
+}
+
+/**
+ * Get the newest depth frame.
+ *
+ * @param outputDepth The frame.
+ * @return True if there was a new frame.
+ */
+bool ReplayCamera::getDepth(cv::Mat& outputDepth) {
+    ScopedLock lock(mutex);
+    if (!newDepthFrame) {
+        return false;
+    }
+    depthMat.copyTo(outputDepth);
+    newDepthFrame = false;
+    return true;
+}
+
+/**
+ * @return Frames (RGB and depth) in the capture.
+ */
+int ReplayCamera::getNumOfFrames() const {
+    return records.size();
+}
+
+/**
+ * @return True once every frame has been played (never, if looping).
+ */
+bool ReplayCamera::isFinished() {
+    ScopedLock lock(mutex);
+    return finished;
+}
@@ -0,0 +1,199 @@
+/**
+ * @file ReplayCamera.h
+ * @author Aydin Arik
+ * @brief Plays back a capture written by CaptureWriter as if it were a Kinect,
+ *        so field problems can be reproduced on machines without one. Frames
+ *        are handed to the same VideoCallback()/DepthCallback() a
+ *        Freenect::FreenectDevice gets, with the driver's timestamps, straight
+ *        out of the memory-mapped capture (no copies). Playback either keeps
+ *        the capture's original timing, or runs unthrottled: each RGB frame is
+ *        delivered as soon as the one before has been got, so every frame is
+ *        processed exactly once, as fast as the consumer can go.
+ */
+
+#ifndef REPLAYCAMERA_H
+#define	REPLAYCAMERA_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <opencv2/core/core.hpp>
+#include "RgbdCapture.h"
+#include "FrameSource.h"
+#include "Mutex.h"
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+class ReplayCamera : public FrameSource {
+private:
+
+    std::string filename;
+    bool throttled; //If true, keep the capture's timing, else run unthrottled.
+    bool loop; //If true, start again from the first frame at the end.
+    void* memory; //The mapped capture.
+    size_t length; //Bytes mapped.
+    const CaptureHeader* header;
+    std::vector<const RecordHeader*> records; //Frame records, in capture order (in the mapped capture).
+    pthread_t thread;
+    bool running; //True if thread was started.
+
+    //
+    //Guarded by mutex.
+    //
+    Mutex mutex;
+    Condition changed; //Signalled when a frame is got, or on stopping.
+    Condition videoReady; //Signalled when an RGB frame is played, or on stopping.
+    cv::Mat RGBMat; //Refers to the mapped capture.
+    cv::Mat depthMat; //Refers to the mapped capture.
+    uint32_t RGBTimestamp;
+    uint64_t RGBSequence; //Number of RGBMat (1 for the first frame played).
+    double RGBArrived; //When RGBMat was played (seconds, CLOCK_MONOTONIC).
+    uint32_t depthTimestamp;
+    bool newRGBFrame;
+    bool newDepthFrame;
+    bool videoStarted;
+    bool depthStarted;
+    bool finished; //True once every frame has been played (without looping).
+    bool stopping; //Set to make the replay thread exit.
+
+    /**
+     * Entry point of the replay thread.
+     *
+     * @param camera The ReplayCamera that started the thread.
+     * @return NULL.
+     */
+    static void* runReplay(void* camera);
+
+    /**
+     * Find every frame by walking back through the indices from the end
+     * record. Fails if the capture wasn't closed.
+     *
+     * @return True if every frame was found.
+     */
+    bool readIndex();
+
+    /**
+     * Find every frame by reading the records in order. Used for captures
+     * that weren't closed, up to the last complete record.
+     */
+    void scanRecords();
+
+    /**
+     * @param offset Offset of a record.
+     * @return The record, or NULL if there isn't a complete one there.
+     */
+    const RecordHeader* recordAt(uint64_t offset) const;
+
+    /**
+     * @param record A record.
+     * @return True if it is a frame of the capture's size.
+     */
+    bool isFrame(const RecordHeader* record) const;
+
+    ReplayCamera(const ReplayCamera&); //Not copyable.
+    ReplayCamera& operator=(const ReplayCamera&);
+protected:
+
+    /**
+     * Called with each RGB frame, as by Freenect::FreenectDevice.
+     *
+     * @param RGBData The frame (valid until the camera is destroyed).
+     * @param timestamp Driver timestamp.
+     */
+    virtual void VideoCallback(void* RGBData, uint32_t timestamp);
+
+    /**
+     * Called with each depth frame, as by Freenect::FreenectDevice.
+     *
+     * @param depthData The frame (valid until the camera is destroyed).
+     * @param timestamp Driver timestamp.
+     */
+    virtual void DepthCallback(void* depthData, uint32_t timestamp);
+
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param filename Capture to play.
+     * @param throttled If true, keep the capture's timing, else run unthrottled.
+     * @param loop If true, start again from the first frame at the end.
+     */
+    ReplayCamera(const std::string& filename, bool throttled = true, bool loop = false);
+
+    /**
+     * Destructor. Stops playback and unmaps the capture.
+     */
+    ~ReplayCamera();
+
+    /**
+     * Map the capture and find its frames.
+     *
+     * @return True if the capture could be played.
+     */
+    bool open();
+
+    void startVideo();
+    void stopVideo();
+    void startDepth();
+    void stopDepth();
+
+    /**
+     * Start playing RGB and depth frames.
+     */
+    void startStream();
+
+    /**
+     * Stop playing.
+     */
+    void stopStream();
+
+    /**
+     * @param outputRGB The newest RGB frame (BGR), if there is one that hasn't
+     *        been got already.
+     * @return True if there was a new frame.
+     */
+    bool getVideo(cv::Mat& outputRGB);
+
+    /**
+     * @param outputRGB The newest RGB frame (BGR), if there is one that hasn't
+     *        been got already.
+     * @param trace Sequence number, driver timestamp (as captured), and when
+     *        the frame was played and got.
+     * @return True if there was a new frame.
+     */
+    bool getVideo(cv::Mat& outputRGB, FrameTrace& trace);
+
+    /**
+     * @param outputRGB The next RGB frame (BGR) that hasn't been got already.
+     * @param trace Sequence number, driver timestamp (as captured), and when
+     *        the frame was played and got.
+     * @param timeoutMs Longest time to wait (milliseconds, negative to wait
+     *        until there is a frame or playback stops).
+     * @return True if there was a new frame.
+     */
+    bool waitVideo(cv::Mat& outputRGB, FrameTrace& trace, int timeoutMs);
+
+    /**
+     * @param outputDepth The newest depth frame, if there is one that hasn't
+     *        been got already.
+     * @return True if there was a new frame.
+     */
+    bool getDepth(cv::Mat& outputDepth);
+
+    /**
+     * @return Frames (RGB and depth) in the capture.
+     */
+    int getNumOfFrames() const;
+
+    /**
+     * @return True once every frame has been played (never, if looping).
+     */
+    bool isFinished();
+};
+
+#endif	/* REPLAYCAMERA_H */
@@ -0,0 +1,174 @@
+/**
+ * @file ResultPublisher.cpp
+ * @author Aydin Arik
+ * @brief Publishes recognition results in a shared memory ring.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "ResultPublisher.h"
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <time.h>
+
+using namespace std;
+
+
+/******************************************************************************
+ *                              Public Methods
+ ******************************************************************************/
+/**
+ * Constructor.
+ *
+ * @param name Shared memory object name (e.g. "/object-recognition").
+ */
+ResultPublisher::ResultPublisher(const string& name)
+: name(name), header(NULL), size(0), sequence(0) {
+}
+
+/**
+ * Destructor. Closes the ring.
+ */
+ResultPublisher::~ResultPublisher() {
+    close();
+}
+
+/**
+ * Create (or replace) the ring and map it.
+ *
+ * @param numOfSlots Number of results kept.
+ * @param maxFrameBytes Frame bytes a slot can hold (0 to not publish frames).
+ * @return True on success.
+ */
+bool ResultPublisher::open(unsigned int numOfSlots, unsigned int maxFrameBytes) {
+    ScopedLock lock(mutex);
+    if (header) {
+        return true;
+    }
+
+    uint32_t slotSize = ringSlotSize(maxFrameBytes);
+    size = sizeof (RingHeader) + (size_t) std::max(numOfSlots, 1u) * slotSize;
+
+    //Replace any ring left behind, so readers never see a stale layout.
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        cout << "Unable to create shared memory: " << name << endl;
+        return false;
+    }
+    if (ftruncate(fd, size) != 0) {
+        cout << "Unable to size shared memory: " << name << endl;
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        cout << "Unable to map shared memory: " << name << endl;
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    //Mapped memory starts zeroed, so every slot reads as being written.
+    header = static_cast<RingHeader*> (memory);
+    header->numOfSlots = std::max(numOfSlots, 1u);
+    header->slotSize = slotSize;
+    header->maxFrameBytes = maxFrameBytes;
+    header->version = RESULT_RING_VERSION;
+    header->sequence = 0;
+    __sync_synchronize(); //Layout before magic, which readers check first.
+    header->magic = RESULT_RING_MAGIC;
+    sequence = 0;
+    return true;
+}
+
+/**
+ * Unmap and remove the ring. Readers that have it mapped keep it until
+ * they close it.
+ */
+void ResultPublisher::close() {
+    ScopedLock lock(mutex);
+    if (!header) {
+        return;
+    }
+    munmap(header, size);
+    shm_unlink(name.c_str());
+    header = NULL;
+}
+
+/**
+ * Publish a result. Frames are only published if they fit in a slot and
+ * are continuous.
+ *
+ * @param camera Camera the frame came from.
+ * @param result The result.
+ * @return True if published.
+ */
+bool ResultPublisher::publish(int camera, const RecognitionResult& result) {
+    ScopedLock lock(mutex);
+    if (!header) {
+        return false;
+    }
+
+    uint64_t next = sequence + 1;
+    RingSlot* slot = ringSlot(header, next);
+
+    //Mark the slot as being written before touching the record.
+    slot->sequence = 0;
+    __sync_synchronize();
+
+    ResultRecord& record = slot->record;
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    record.sequence = next;
+    record.timestamp = (int64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+    record.camera = camera;
+    record.reused = result.reused ? 1 : 0;
+    record.frameSequence = result.trace.sequence;
+    record.driverTimestamp = result.trace.driverTimestamp;
+    record.frameAge = -1;
+    if (result.trace.arrived > 0) {
+        record.frameAge = (int64_t) ((FrameTrace::now() - result.trace.arrived) * 1e9);
+    }
+
+    int numOfDetections = std::min((int) result.detections.size(), RESULT_RING_MAX_DETECTIONS);
+    record.numOfDetections = numOfDetections;
+    for (int i = 0; i < numOfDetections; i++) {
+        const Detection& detection = result.detections[i];
+        DetectionRecord& out = record.detections[i];
+        strncpy(out.objectName, detection.objectName.c_str(), RESULT_RING_MAX_NAME - 1);
+        out.objectName[RESULT_RING_MAX_NAME - 1] = '\0';
+        out.score = detection.score;
+        out.numOfMatches = (int32_t) detection.matches.size();
+        out.x = detection.boundingBox.x;
+        out.y = detection.boundingBox.y;
+        out.width = detection.boundingBox.width;
+        out.height = detection.boundingBox.height;
+    }
+
+    const cv::Mat& frame = result.frame;
+    size_t frameBytes = frame.total() * frame.elemSize();
+    record.frameWidth = frame.cols;
+    record.frameHeight = frame.rows;
+    record.frameType = frame.type();
+    record.frameBytes = 0;
+    if (frame.data && frame.isContinuous() && frameBytes <= header->maxFrameBytes) {
+        memcpy((char*) slot + sizeof (RingSlot), frame.data, frameBytes);
+        record.frameBytes = (int32_t) frameBytes;
+    }
+
+    //Record (and frame) before sequence numbers, which make it visible.
+    __sync_synchronize();
+    slot->sequence = next;
+    __sync_synchronize();
+    header->sequence = next;
+    sequence = next;
+    return true;
+}
@@ -0,0 +1,75 @@
+/**
+ * @file ResultPublisher.h
+ * @author Aydin Arik
+ * @brief Publishes recognition results in a shared memory ring (see
+ *        ResultRing.h), so other local processes (e.g. a controller or logger)
+ *        can read them without going through sockets. Readers never lock and
+ *        never hold up the publisher; a slow reader just misses results.
+ */
+
+#ifndef RESULTPUBLISHER_H
+#define	RESULTPUBLISHER_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <string>
+#include <stdint.h>
+#include "Detection.h"
+#include "ResultRing.h"
+#include "Mutex.h"
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+class ResultPublisher {
+private:
+    std::string name; //Shared memory object name (e.g. "/object-recognition").
+    RingHeader* header; //Mapped ring (NULL if not open).
+    size_t size; //Bytes mapped.
+    uint64_t sequence; //Sequence number of the newest record written.
+    Mutex mutex; //Serialises publishers in this process (streams share a ring).
+
+    ResultPublisher(const ResultPublisher&); //Not copyable.
+    ResultPublisher& operator=(const ResultPublisher&);
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param name Shared memory object name (e.g. "/object-recognition").
+     */
+    ResultPublisher(const std::string& name);
+
+    /**
+     * Destructor. Closes the ring.
+     */
+    ~ResultPublisher();
+
+    /**
+     * Create (or replace) the ring and map it.
+     *
+     * @param numOfSlots Number of results kept.
+     * @param maxFrameBytes Frame bytes a slot can hold (0 to not publish frames).
+     * @return True on success.
+     */
+    bool open(unsigned int numOfSlots = 64, unsigned int maxFrameBytes = 0);
+
+    /**
+     * Unmap and remove the ring. Readers that have it mapped keep it until
+     * they close it.
+     */
+    void close();
+
+    /**
+     * Publish a result. Frames are only published if they fit in a slot and
+     * are continuous.
+     *
+     * @param camera Camera the frame came from.
+     * @param result The result.
+     * @return True if published.
+     */
+    bool publish(int camera, const RecognitionResult& result);
+};
+
+#endif	/* RESULTPUBLISHER_H */
@@ -0,0 +1,153 @@
+/**
+ * @file ResultReader.cpp
+ * @author Aydin Arik
+ * @brief Reads recognition results from the shared memory ring written by a
+ *        ResultPublisher.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "ResultReader.h"
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+
+/******************************************************************************
+ *                              Public Methods
+ ******************************************************************************/
+/**
+ * Constructor.
+ *
+ * @param name Shared memory object name (e.g. "/object-recognition").
+ */
+ResultReader::ResultReader(const string& name)
+: name(name), header(NULL), size(0), next(1), numOfMissed(0) {
+}
+
+/**
+ * Destructor. Closes the ring.
+ */
+ResultReader::~ResultReader() {
+    close();
+}
+
+/**
+ * Map the ring. Reading starts with the next result published.
+ *
+ * @return True on success (false if there is no publisher yet).
+ */
+bool ResultReader::open() {
+    if (header) {
+        return true;
+    }
+
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        return false; //Not published yet.
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof (RingHeader)) {
+        ::close(fd);
+        return false;
+    }
+
+    size = info.st_size;
+    void* memory = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        cout << "Unable to map shared memory: " << name << endl;
+        return false;
+    }
+
+    header = static_cast<const RingHeader*> (memory);
+    __sync_synchronize();
+    if (header->magic != RESULT_RING_MAGIC || header->version != RESULT_RING_VERSION ||
+            sizeof (RingHeader) + (size_t) header->numOfSlots * header->slotSize > size) {
+        cout << "Not a result ring: " << name << endl;
+        close();
+        return false;
+    }
+
+    next = header->sequence + 1;
+    numOfMissed = 0;
+    return true;
+}
+
+/**
+ * Unmap the ring.
+ */
+void ResultReader::close() {
+    if (header) {
+        munmap(const_cast<RingHeader*> (header), size);
+        header = NULL;
+    }
+}
+
+/**
+ * Read the next result, if there is one. A slot is copied and then its
+ * sequence number checked again; if the publisher started rewriting the
+ * slot meanwhile, the copy is thrown away and the result counted as missed.
+ *
+ * @param record The result.
+ * @param frame The frame data, if frames are published (may be NULL).
+ * @return True if a result was read, false if there is no new result.
+ */
+bool ResultReader::read(ResultRecord& record, vector<unsigned char>* frame) {
+    if (!header) {
+        return false;
+    }
+
+    while (true) {
+        uint64_t newest = header->sequence;
+        __sync_synchronize();
+        if (next > newest) {
+            return false;
+        }
+
+        //Skip whatever has already been overwritten.
+        if (newest - next >= header->numOfSlots) {
+            uint64_t oldest = newest - header->numOfSlots + 1;
+            numOfMissed += oldest - next;
+            next = oldest;
+        }
+
+        const RingSlot* slot = ringSlot(header, next);
+        uint64_t before = slot->sequence;
+        __sync_synchronize();
+        if (before == next) {
+            memcpy(&record, (const void*) &slot->record, sizeof (ResultRecord));
+            if (frame) {
+                size_t frameBytes = std::min((size_t) std::max(record.frameBytes, 0),
+                        (size_t) header->maxFrameBytes);
+                frame->resize(frameBytes);
+                if (frameBytes > 0) {
+                    memcpy(&(*frame)[0], (const char*) slot + sizeof (RingSlot), frameBytes);
+                }
+            }
+            __sync_synchronize();
+            if (slot->sequence == next) {
+                next++;
+                return true;
+            }
+        }
+
+        //Overwritten before (or while) it was read.
+        numOfMissed++;
+        next++;
+    }
+}
+
+/**
+ * @return Number of results overwritten before they were read.
+ */
+uint64_t ResultReader::getNumOfMissed() const {
+    return numOfMissed;
+}
@@ -0,0 +1,75 @@
+/**
+ * @file ResultReader.h
+ * @author Aydin Arik
+ * @brief Reads recognition results from the shared memory ring written by a
+ *        ResultPublisher (see ResultRing.h). Any number of readers, in any
+ *        local process, can read the same ring. Reading never locks, and a
+ *        reader that falls too far behind is told how many results it missed.
+ */
+
+#ifndef RESULTREADER_H
+#define	RESULTREADER_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "ResultRing.h"
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+class ResultReader {
+private:
+    std::string name; //Shared memory object name (e.g. "/object-recognition").
+    const RingHeader* header; //Mapped ring (NULL if not open).
+    size_t size; //Bytes mapped.
+    uint64_t next; //Sequence number of the next record to read.
+    uint64_t numOfMissed; //Records overwritten before they were read.
+
+    ResultReader(const ResultReader&); //Not copyable.
+    ResultReader& operator=(const ResultReader&);
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param name Shared memory object name (e.g. "/object-recognition").
+     */
+    ResultReader(const std::string& name);
+
+    /**
+     * Destructor. Closes the ring.
+     */
+    ~ResultReader();
+
+    /**
+     * Map the ring. Reading starts with the next result published.
+     *
+     * @return True on success (false if there is no publisher yet).
+     */
+    bool open();
+
+    /**
+     * Unmap the ring.
+     */
+    void close();
+
+    /**
+     * Read the next result, if there is one.
+     *
+     * @param record The result.
+     * @param frame The frame data, if frames are published (may be NULL).
+     * @return True if a result was read, false if there is no new result.
+     */
+    bool read(ResultRecord& record, std::vector<unsigned char>* frame = NULL);
+
+    /**
+     * @return Number of results overwritten before they were read.
+     */
+    uint64_t getNumOfMissed() const;
+};
+
+#endif	/* RESULTREADER_H */
@@ -0,0 +1,108 @@
+/**
+ * @file ResultRing.h
+ * @author Aydin Arik
+ * @brief Layout of the shared memory ring that recognition results are
+ *        published in (see ResultPublisher and ResultReader). The ring is a
+ *        header followed by fixed-size slots. Each slot holds one result record
+ *        and, optionally, the frame. Only plain fixed-size types are used, so
+ *        any local process can map the ring.
+ *
+ *        A slot's sequence number is cleared while the slot is being written
+ *        and set once it is complete. A reader copies a slot and then checks
+ *        the sequence number is still the one it expected. If not, the writer
+ *        lapped the reader, and the reader knows how many results it missed.
+ */
+
+#ifndef RESULTRING_H
+#define	RESULTRING_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <stdint.h>
+
+// Identifies a mapped ring ("ORRB"), and the layout version.
+#define RESULT_RING_MAGIC 0x4f525242
+#define RESULT_RING_VERSION 2
+
+// Most detections in a record, and longest object name (including '\0').
+#define RESULT_RING_MAX_DETECTIONS 16
+#define RESULT_RING_MAX_NAME 64
+
+
+/******************************************************************************
+ *                              Types
+ ******************************************************************************/
+/**
+ * An object found in a frame.
+ */
+struct DetectionRecord {
+    char objectName[RESULT_RING_MAX_NAME];
+    float score; //Share of the view's keypoints matched.
+    int32_t numOfMatches;
+    int32_t x, y, width, height; //Bounding box in the frame.
+};
+
+/**
+ * The result of recognising objects in a frame. Followed in its slot by
+ * frameBytes bytes of frame data, if frames are published.
+ */
+struct ResultRecord {
+    uint64_t sequence; //1 for the first result published, then 2, 3, ...
+    int64_t timestamp; //When published (nanoseconds since the epoch).
+    int64_t frameAge; //Nanoseconds from the frame arriving to being published (-1 if unknown).
+    uint64_t frameSequence; //Number of the frame at its camera (0 if unknown).
+    int32_t camera;
+    int32_t reused; //1 if detections were carried over from an earlier frame.
+    int32_t numOfDetections; //Detections used (the rest are left over).
+    int32_t frameWidth, frameHeight, frameType; //cv::Mat size and type.
+    int32_t frameBytes; //Bytes of frame data after the record (0 if none).
+    uint32_t driverTimestamp; //Timestamp the camera's driver gave the frame.
+    DetectionRecord detections[RESULT_RING_MAX_DETECTIONS]; //Best first.
+};
+
+/**
+ * Start of each slot.
+ */
+struct RingSlot {
+    volatile uint64_t sequence; //Sequence number of the record held, or 0 while being written.
+    uint64_t padding[7]; //Keeps the record on its own cache line.
+    ResultRecord record;
+};
+
+/**
+ * Start of the ring.
+ */
+struct RingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numOfSlots;
+    uint32_t slotSize; //Bytes per slot (a multiple of 64).
+    uint32_t maxFrameBytes; //Frame bytes a slot can hold (0 if frames aren't published).
+    uint32_t padding0[11];
+    volatile uint64_t sequence; //Sequence number of the newest complete record.
+    uint64_t padding1[7];
+};
+
+/******************************************************************************
+ *                              Functions
+ ******************************************************************************/
+/**
+ * @param maxFrameBytes Frame bytes a slot can hold.
+ * @return Bytes per slot, rounded up to a cache line.
+ */
+inline uint32_t ringSlotSize(uint32_t maxFrameBytes) {
+    return (uint32_t) ((sizeof (RingSlot) + maxFrameBytes + 63) / 64 * 64);
+}
+
+/**
+ * @param header Header of a ring.
+ * @param sequence Sequence number of a record.
+ * @return The slot the record is written in.
+ */
+inline RingSlot* ringSlot(const RingHeader* header, uint64_t sequence) {
+    char* slots = (char*) header + sizeof (RingHeader);
+    return (RingSlot*) (slots + (sequence % header->numOfSlots) * header->slotSize);
+}
+
+#endif	/* RESULTRING_H */
@@ -0,0 +1,92 @@
+/**
+ * @file RgbdCapture.h
+ * @author Aydin Arik
+ * @brief Layout of raw RGB-D capture files (see CaptureWriter and
+ *        ReplayCamera). A capture is a header followed by records, and is
+ *        only ever appended to, so a capture cut short (e.g. by a crash) is
+ *        still readable up to its last complete record.
+ *
+ *        Each record is a RecordHeader followed by its payload, padded to 8
+ *        bytes. Frame records hold a raw frame exactly as the driver gave it,
+ *        with the driver's timestamp and when it arrived. After every
+ *        chunkFrames frames an index record lists where those frames are,
+ *        and where the index before it is. A closed capture ends with an end
+ *        record pointing at the last index, so a reader can find every frame
+ *        by walking the indices back, without reading the frames.
+ */
+
+#ifndef RGBDCAPTURE_H
+#define	RGBDCAPTURE_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <stdint.h>
+
+// Identifies a capture ("RGBD") and a record ("RCRD"), and the layout version.
+#define RGBD_CAPTURE_MAGIC 0x52474244
+#define RGBD_RECORD_MAGIC 0x52435244
+#define RGBD_CAPTURE_VERSION 1
+
+// Frame records between index records.
+#define RGBD_CHUNK_FRAMES 64
+
+
+/******************************************************************************
+ *                              Types
+ ******************************************************************************/
+/**
+ * Kinds of record.
+ */
+enum RgbdRecordType {
+    RGBD_VIDEO = 1, //RGB frame (width * height * 3 bytes).
+    RGBD_DEPTH = 2, //11 bit depth frame (width * height * 2 bytes).
+    RGBD_INDEX = 3, //uint64_t offset of the previous index (0 if none), then a uint64_t offset per frame.
+    RGBD_END = 4 //uint64_t offset of the last index (0 if none).
+};
+
+/**
+ * Start of a capture.
+ */
+struct CaptureHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width, height; //Of both video and depth frames.
+    uint32_t chunkFrames; //Frame records between index records.
+    uint32_t padding;
+    int64_t started; //When the capture was started (nanoseconds since the epoch).
+};
+
+/**
+ * Start of each record.
+ */
+struct RecordHeader {
+    uint32_t magic;
+    uint32_t type; //An RgbdRecordType.
+    uint32_t timestamp; //Driver timestamp of a frame (0 for other records).
+    uint32_t size; //Bytes of payload, before padding.
+    int64_t captured; //When a frame arrived (nanoseconds since the capture started).
+};
+
+/******************************************************************************
+ *                              Functions
+ ******************************************************************************/
+/**
+ * @param size Bytes of payload.
+ * @return Bytes the record takes up, header and padding included.
+ */
+inline uint64_t rgbdRecordSize(uint32_t size) {
+    return sizeof (RecordHeader) + (size + 7) / 8 * 8;
+}
+
+/**
+ * @param type A frame record type.
+ * @param width Frame width.
+ * @param height Frame height.
+ * @return Bytes of a frame of that type.
+ */
+inline uint32_t rgbdFrameSize(uint32_t type, uint32_t width, uint32_t height) {
+    return width * height * (type == RGBD_VIDEO ? 3 : 2);
+}
+
+#endif	/* RGBDCAPTURE_H */
@@ -0,0 +1,804 @@
+/**
+ * @file ShardCoordinator.cpp
+ * @author Aydin Arik
+ * @brief Recognises objects in a library that is partitioned into shards,
+ *        each served by a ShardWorker in a process of its own.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "ShardCoordinator.h"
+#include "ShardMessage.h"
+#include "ObjectLibrary.h"
+#include "ObjectRecognition.h"
+#include "FrameTrace.h"
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <cstdlib>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "boost/filesystem/path.hpp"
+
+using namespace std;
+namespace fs = boost::filesystem;
+
+// Longest to wait for a worker to reply (milliseconds).
+#define SHARD_REPLY_TIMEOUT_MS 10000
+
+// Longest to wait for workers to exit before killing them (milliseconds).
+#define WORKER_EXIT_TIMEOUT_MS 2000
+
+// Keypoints assumed per view of an object no shard has extracted yet, until
+// some have been measured.
+#define ESTIMATED_KEYPOINTS_PER_VIEW 500
+
+// Shards are rebalanced while the most and least loaded differ by more than
+// this share of the mean load.
+#define REBALANCE_TOLERANCE 0.2
+
+// Most models kept in the cache.
+#define MAX_CACHED_MODELS 64
+
+
+/******************************************************************************
+ *                              Types
+ ******************************************************************************/
+/**
+ * A shard's vote for an object.
+ */
+struct Vote {
+    std::string objectName;
+    float score;
+    int rank; //Place in the shard's shortlist.
+    int shard;
+};
+
+
+/******************************************************************************
+ *                              Functions
+ ******************************************************************************/
+/**
+ * Best score first. Ties (e.g. every score is 0 without an index) go to the
+ * higher place in a shortlist, so shards take turns.
+ */
+static bool betterVote(const Vote& a, const Vote& b) {
+    if (a.score != b.score) {
+        return a.score > b.score;
+    }
+    return a.rank < b.rank;
+}
+
+/**
+ * Name of the object an image file is a view of (see
+ * ObjectLibrary::createObject()).
+ *
+ * @param file Image file.
+ * @return The object's name.
+ */
+static string objectNameOf(const string& file) {
+    string fileName = fs::path(file).stem().string();
+    return fileName.substr(0, fileName.find('.'));
+}
+
+
+/******************************************************************************
+ *                              Private Methods
+ ******************************************************************************/
+/**
+ * Start a worker process. The program is run again (rather than just
+ * forked), as the coordinator's other threads don't survive a fork.
+ *
+ * @param shard The shard to start a worker for.
+ * @return True if the worker was started.
+ */
+bool ShardCoordinator::spawn(Shard& shard) {
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+        std::cout << "Unable to make a socket for a shard worker" << std::endl;
+        return false;
+    }
+    fcntl(sockets[0], F_SETFD, FD_CLOEXEC); //Not inherited by later workers.
+
+    //Everything the child needs is made before forking.
+    std::ostringstream socketArg;
+    socketArg << sockets[1];
+    string socketString = socketArg.str();
+    vector<const char*> args;
+    args.push_back("/proc/self/exe");
+    args.push_back("--shard-worker");
+    args.push_back(socketString.c_str());
+    if (!configFile.empty()) {
+        args.push_back("--config");
+        args.push_back(configFile.c_str());
+    }
+    args.push_back(NULL);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        execv(args[0], const_cast<char* const*> (&args[0]));
+        _exit(127);
+    }
+    close(sockets[1]);
+    if (pid < 0) {
+        std::cout << "Unable to start a shard worker" << std::endl;
+        close(sockets[0]);
+        return false;
+    }
+
+    shard.pid = pid;
+    shard.socket = sockets[0];
+    shard.alive = true;
+    return true;
+}
+
+/**
+ * Give up on a worker that has failed. Its objects are moved to other shards
+ * by the next update().
+ *
+ * @param s Shard number.
+ */
+void ShardCoordinator::fail(int s) {
+    Shard& shard = shards[s];
+    if (!shard.alive) {
+        return;
+    }
+
+    std::cout << "Shard " << s << " (worker " << shard.pid << ") has failed" << std::endl;
+    shard.alive = false;
+    shard.loaded = false;
+    close(shard.socket);
+    shard.socket = -1;
+    kill(shard.pid, SIGKILL);
+}
+
+/**
+ * @param s Shard number.
+ * @return Keypoints of the objects assigned to a shard.
+ */
+long ShardCoordinator::getLoad(int s) const {
+    long load = 0;
+    for (map<string, LibraryObject>::const_iterator it = objects.begin(); it != objects.end(); ++it) {
+        if (it->second.shard == s) {
+            load += it->second.keypoints;
+        }
+    }
+    return load;
+}
+
+/**
+ * @return The live shard with the least load (-1 if none are alive).
+ */
+int ShardCoordinator::getLeastLoaded() const {
+    int least = -1;
+    long leastLoad = 0;
+    for (unsigned int s = 0; s < shards.size(); s++) {
+        long load = getLoad(s);
+        if (shards[s].alive && (least < 0 || load < leastLoad)) {
+            least = s;
+            leastLoad = load;
+        }
+    }
+    return least;
+}
+
+/**
+ * Find the objects in the library directory. New objects are assigned to the
+ * least loaded shard, and removed ones are dropped.
+ */
+void ShardCoordinator::scan() {
+    vector<string> files;
+    ObjectLibrary::findImageFiles(OBJECT_LIBRARY_DIR, files);
+    sort(files.begin(), files.end());
+
+    map<string, vector<string> > found; //Files of each object.
+    for (unsigned int i = 0; i < files.size(); i++) {
+        found[objectNameOf(files[i])].push_back(files[i]);
+    }
+
+    //Objects whose files have all gone.
+    for (map<string, LibraryObject>::iterator it = objects.begin(); it != objects.end();) {
+        if (found.find(it->first) == found.end()) {
+            if (it->second.shard >= 0) {
+                shards[it->second.shard].assignmentChanged = true;
+            }
+            cache.erase(it->first);
+            storeStale = true;
+            objects.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+
+    //Estimate the size of new objects from those already measured.
+    long measuredKeypoints = 0, measuredViews = 0;
+    for (map<string, LibraryObject>::iterator it = objects.begin(); it != objects.end(); ++it) {
+        if (it->second.measured) {
+            measuredKeypoints += it->second.keypoints;
+            measuredViews += it->second.files.size();
+        }
+    }
+    long keypointsPerView = measuredViews > 0 ? measuredKeypoints / measuredViews : ESTIMATED_KEYPOINTS_PER_VIEW;
+
+    //New objects, and objects with views added or removed.
+    for (map<string, vector<string> >::iterator it = found.begin(); it != found.end(); ++it) {
+        map<string, LibraryObject>::iterator existing = objects.find(it->first);
+        if (existing != objects.end()) {
+            if (existing->second.files != it->second) {
+                existing->second.files = it->second;
+                existing->second.keypoints = it->second.size() * keypointsPerView;
+                existing->second.measured = false;
+                if (existing->second.shard >= 0) {
+                    shards[existing->second.shard].assignmentChanged = true;
+                }
+            }
+            continue;
+        }
+
+        LibraryObject object;
+        object.files = it->second;
+        object.keypoints = it->second.size() * keypointsPerView;
+        object.measured = false;
+        object.shard = -1;
+        objects[it->first] = object;
+
+        int s = getLeastLoaded();
+        if (s >= 0) {
+            objects[it->first].shard = s;
+            shards[s].assignmentChanged = true;
+        }
+    }
+}
+
+/**
+ * Ask every shard which objects it has loaded, and how large they are.
+ */
+void ShardCoordinator::askStatus() {
+    ShardMessage request(SHARD_STATUS);
+    for (unsigned int s = 0; s < shards.size(); s++) {
+        if (shards[s].alive && !request.send(shards[s].socket)) {
+            fail(s);
+        }
+    }
+
+    for (unsigned int s = 0; s < shards.size(); s++) {
+        ShardMessage reply;
+        if (!shards[s].alive) {
+            continue;
+        }
+        if (!reply.receive(shards[s].socket, SHARD_REPLY_TIMEOUT_MS) || reply.getType() != SHARD_LOADS) {
+            fail(s);
+            continue;
+        }
+
+        bool loaded = (reply.getInt() != 0);
+        int numOfObjects = reply.getInt();
+        for (int i = 0; i < numOfObjects && reply.isValid(); i++) {
+            string name = reply.getString();
+            int numOfViews = reply.getInt();
+            long keypoints = reply.getInt();
+
+            //Only trust sizes of objects that are still on this shard, with
+            //every view loaded.
+            map<string, LibraryObject>::iterator object = objects.find(name);
+            if (object != objects.end() && object->second.shard == (int) s &&
+                    numOfViews == (int) object->second.files.size()) {
+                object->second.keypoints = keypoints;
+                object->second.measured = true;
+            }
+        }
+        shards[s].loaded = loaded && reply.isValid() && !shards[s].assignmentChanged;
+    }
+}
+
+/**
+ * Move objects from the most to the least loaded shard while their loads are
+ * too far apart. Only done once every shard has loaded its objects, so loads
+ * are measured rather than estimated.
+ */
+void ShardCoordinator::rebalance() {
+    int numOfAlive = 0;
+    for (unsigned int s = 0; s < shards.size(); s++) {
+        if (shards[s].alive) {
+            if (!shards[s].loaded) {
+                return;
+            }
+            numOfAlive++;
+        }
+    }
+    if (numOfAlive < 2) {
+        return;
+    }
+
+    //Each move shrinks the gap, so this ends, but bound it anyway.
+    for (unsigned int moves = 0; moves < objects.size(); moves++) {
+        int most = -1, least = -1;
+        long mostLoad = 0, leastLoad = 0, totalLoad = 0;
+        for (unsigned int s = 0; s < shards.size(); s++) {
+            if (!shards[s].alive) {
+                continue;
+            }
+            long load = getLoad(s);
+            totalLoad += load;
+            if (most < 0 || load > mostLoad) {
+                most = s;
+                mostLoad = load;
+            }
+            if (least < 0 || load < leastLoad) {
+                least = s;
+                leastLoad = load;
+            }
+        }
+        long gap = mostLoad - leastLoad;
+        if (gap <= REBALANCE_TOLERANCE * totalLoad / numOfAlive) {
+            break;
+        }
+
+        //The object that brings the two loads closest together. Moving one
+        //as large as the gap (or larger) would make things no better.
+        map<string, LibraryObject>::iterator best = objects.end();
+        for (map<string, LibraryObject>::iterator it = objects.begin(); it != objects.end(); ++it) {
+            if (it->second.shard == most && it->second.keypoints > 0 && it->second.keypoints < gap &&
+                    (best == objects.end() ||
+                    labs(gap - 2 * it->second.keypoints) < labs(gap - 2 * best->second.keypoints))) {
+                best = it;
+            }
+        }
+        if (best == objects.end()) {
+            break;
+        }
+
+        std::cout << "Moving " << best->first << " from shard " << most << " to shard " << least << std::endl;
+        best->second.shard = least;
+        shards[most].assignmentChanged = true;
+        shards[least].assignmentChanged = true;
+        shards[least].loaded = false;
+    }
+}
+
+/**
+ * Send each shard whose objects have changed the files it now owns.
+ */
+void ShardCoordinator::sendAssignments() {
+    for (unsigned int s = 0; s < shards.size(); s++) {
+        if (!shards[s].alive || !shards[s].assignmentChanged) {
+            continue;
+        }
+
+        vector<string> files;
+        for (map<string, LibraryObject>::iterator it = objects.begin(); it != objects.end(); ++it) {
+            if (it->second.shard == (int) s) {
+                files.insert(files.end(), it->second.files.begin(), it->second.files.end());
+            }
+        }
+
+        ShardMessage assign(SHARD_ASSIGN);
+        assign.putInt(files.size());
+        for (unsigned int i = 0; i < files.size(); i++) {
+            assign.putString(files[i]);
+        }
+        if (!assign.send(shards[s].socket)) {
+            fail(s);
+            continue;
+        }
+        shards[s].assignmentChanged = false;
+        shards[s].loaded = false;
+    }
+}
+
+/**
+ * Fetch the features of objects from their shards into the cache. Every
+ * shard is asked before any reply is read, so shards work at once.
+ *
+ * @param names Names of the objects to fetch from each shard.
+ */
+void ShardCoordinator::fetch(const map<int, vector<string> >& names) {
+    vector<int> asked;
+    for (map<int, vector<string> >::const_iterator it = names.begin(); it != names.end(); ++it) {
+        ShardMessage request(SHARD_FETCH);
+        request.putInt(it->second.size());
+        for (unsigned int i = 0; i < it->second.size(); i++) {
+            request.putString(it->second[i]);
+        }
+        if (shards[it->first].alive && request.send(shards[it->first].socket)) {
+            asked.push_back(it->first);
+        } else {
+            fail(it->first);
+        }
+    }
+
+    for (unsigned int a = 0; a < asked.size(); a++) {
+        int s = asked[a];
+        ShardMessage reply;
+        if (!reply.receive(shards[s].socket, SHARD_REPLY_TIMEOUT_MS) || reply.getType() != SHARD_MODELS) {
+            fail(s);
+            continue;
+        }
+
+        int64_t generation = reply.getInt();
+        int numOfModels = reply.getInt();
+        for (int m = 0; m < numOfModels && reply.isValid(); m++) {
+            string name = reply.getString();
+            int numOfViews = reply.getInt();
+
+            vector<ObjectPtr> views;
+            for (int v = 0; v < numOfViews && reply.isValid(); v++) {
+                cv::Mat keypoints = reply.getMat();
+                cv::Mat descriptors = reply.getMat();
+                if (keypoints.cols != 6 || keypoints.type() != CV_32F || descriptors.rows != keypoints.rows) {
+                    continue; //Malformed view.
+                }
+
+                KeypointArrays arrays;
+                arrays.reserve(keypoints.rows);
+                for (int i = 0; i < keypoints.rows; i++) {
+                    const float* row = keypoints.ptr<float>(i);
+                    arrays.x.push_back(row[0]);
+                    arrays.y.push_back(row[1]);
+                    arrays.size.push_back(row[2]);
+                    arrays.angle.push_back(row[3]);
+                    arrays.response.push_back(row[4]);
+                    arrays.octave.push_back((int) row[5]);
+                }
+                views.push_back(ObjectPtr(new Object(name, cv::Mat(), arrays, descriptors)));
+            }
+            if (!reply.isValid() || views.empty()) {
+                break;
+            }
+
+            CachedModel& cached = cache[name];
+            cached.shard = s;
+            cached.generation = generation;
+            cached.views = views;
+            cached.lastUsed = numOfFrames;
+            storeStale = true;
+            numOfFetched++;
+        }
+    }
+}
+
+/**
+ * Drop the least recently used models while the cache is over its limit.
+ * Models used for the current frame are kept.
+ */
+void ShardCoordinator::evict() {
+    while (cache.size() > MAX_CACHED_MODELS) {
+        map<string, CachedModel>::iterator oldest = cache.end();
+        for (map<string, CachedModel>::iterator it = cache.begin(); it != cache.end(); ++it) {
+            if (it->second.lastUsed < numOfFrames &&
+                    (oldest == cache.end() || it->second.lastUsed < oldest->second.lastUsed)) {
+                oldest = it;
+            }
+        }
+        if (oldest == cache.end()) {
+            break;
+        }
+        cache.erase(oldest);
+        storeStale = true;
+    }
+}
+
+/**
+ * Rebuild the store from the cache, if the cache has changed.
+ */
+void ShardCoordinator::updateStore() {
+    if (!storeStale) {
+        return;
+    }
+
+    vector<ObjectPtr> views;
+    for (map<string, CachedModel>::iterator it = cache.begin(); it != cache.end(); ++it) {
+        views.insert(views.end(), it->second.views.begin(), it->second.views.end());
+    }
+    boost::shared_ptr<LibraryStore> newStore(new LibraryStore(views, store.get()));
+
+    //Keep the stored views (without features) rather than the fetched ones,
+    //so the next rebuild recognises them and copies them from this store.
+    const vector<ObjectPtr>& stored = newStore->getObjects();
+    unsigned int i = 0;
+    for (map<string, CachedModel>::iterator it = cache.begin(); it != cache.end(); ++it) {
+        for (unsigned int v = 0; v < it->second.views.size(); v++) {
+            it->second.views[v] = stored[i++];
+        }
+    }
+
+    store = newStore;
+    storeSlots.clear();
+    for (int slot = 0; slot < store->size(); slot++) {
+        storeSlots[store->model(slot).getObjectName()] = slot;
+    }
+    storeStale = false;
+}
+
+
+/******************************************************************************
+ *                              Public Methods
+ ******************************************************************************/
+/**
+ * Constructor. See start().
+ *
+ * @param numOfShards Number of workers.
+ * @param config Recognition settings (workers load theirs from configFile).
+ * @param configFile Settings file passed to workers (empty for defaults).
+ */
+ShardCoordinator::ShardCoordinator(int numOfShards, const RecognitionConfig& config,
+        const string& configFile)
+: config(config), configFile(configFile), shards(std::max(numOfShards, 1)),
+storeStale(false), numOfFrames(0), numOfFetched(0) {
+    for (unsigned int s = 0; s < shards.size(); s++) {
+        shards[s].pid = -1;
+        shards[s].socket = -1;
+        shards[s].alive = false;
+        shards[s].loaded = false;
+        shards[s].assignmentChanged = false;
+        shards[s].generation = 0;
+        shards[s].numOfQueries = 0;
+        shards[s].totalQueryTime = 0;
+    }
+
+    matcher.refineFundamental(true);
+    ObjectRecognition::configureMatcher(matcher, config);
+}
+
+/**
+ * Destructor. Tells the workers to quit and waits for them (killing any that
+ * take too long).
+ */
+ShardCoordinator::~ShardCoordinator() {
+    ShardMessage quit(SHARD_QUIT);
+    for (unsigned int s = 0; s < shards.size(); s++) {
+        if (shards[s].alive) {
+            quit.send(shards[s].socket);
+            close(shards[s].socket);
+        }
+    }
+
+    double deadline = FrameTrace::now() + WORKER_EXIT_TIMEOUT_MS / 1000.0;
+    for (unsigned int s = 0; s < shards.size(); s++) {
+        if (shards[s].pid <= 0) {
+            continue;
+        }
+        while (waitpid(shards[s].pid, NULL, WNOHANG) == 0) {
+            if (FrameTrace::now() > deadline) {
+                kill(shards[s].pid, SIGKILL);
+                waitpid(shards[s].pid, NULL, 0);
+                break;
+            }
+            usleep(10 * 1000);
+        }
+    }
+}
+
+/**
+ * Start the workers and assign them the objects of the library directory.
+ * Workers load their objects in the background (see waitUntilLoaded()).
+ *
+ * @return True if at least one worker started.
+ */
+bool ShardCoordinator::start() {
+    bool started = false;
+    for (unsigned int s = 0; s < shards.size(); s++) {
+        started = spawn(shards[s]) || started;
+    }
+    if (!started) {
+        return false;
+    }
+
+    scan();
+    sendAssignments();
+    return true;
+}
+
+/**
+ * Pick up objects added to or removed from the library directory, move the
+ * objects of failed workers, and rebalance the shards.
+ */
+void ShardCoordinator::update() {
+    askStatus();
+    scan();
+
+    //Objects of failed workers (or not yet placed) go to the least loaded shard.
+    for (map<string, LibraryObject>::iterator it = objects.begin(); it != objects.end(); ++it) {
+        if (it->second.shard < 0 || !shards[it->second.shard].alive) {
+            int s = getLeastLoaded();
+            if (s < 0) {
+                break; //No workers left.
+            }
+            it->second.shard = s;
+            shards[s].assignmentChanged = true;
+        }
+    }
+
+    rebalance();
+    sendAssignments();
+}
+
+/**
+ * Wait until every shard has loaded and indexed its objects, then rebalance
+ * the shards on their measured loads.
+ *
+ * @param timeoutMs Longest time to wait (milliseconds, negative to wait until
+ *        loaded).
+ * @return True if every shard is loaded.
+ */
+bool ShardCoordinator::waitUntilLoaded(int timeoutMs) {
+    double deadline = FrameTrace::now() + timeoutMs / 1000.0;
+    while (true) {
+        update();
+
+        bool loaded = true, anyAlive = false;
+        for (unsigned int s = 0; s < shards.size(); s++) {
+            anyAlive = anyAlive || shards[s].alive;
+            loaded = loaded && (!shards[s].alive || shards[s].loaded);
+        }
+        if (!anyAlive) {
+            return false;
+        }
+        if (loaded) {
+            return true;
+        }
+        if (timeoutMs >= 0 && FrameTrace::now() > deadline) {
+            return false;
+        }
+        usleep(100 * 1000);
+    }
+}
+
+/**
+ * Get the objects worth matching against a frame: every shard votes for its
+ * best candidates, and the best of all their votes are fetched (if not
+ * cached) and returned.
+ *
+ * @param frameDescriptors Descriptors of the frame.
+ * @param candidates Objects to match against the frame, best first.
+ */
+void ShardCoordinator::getCandidates(const cv::Mat& frameDescriptors, vector<ModelView>& candidates) {
+    numOfFrames++;
+    int maxCandidates = std::max(config.maxCandidates, 1);
+
+    //1. Broadcast the frame, so every shard queries its index at once.
+    ShardMessage query(SHARD_QUERY);
+    query.putInt(maxCandidates);
+    query.putMat(frameDescriptors);
+    double sent = FrameTrace::now();
+    vector<int> asked;
+    for (unsigned int s = 0; s < shards.size(); s++) {
+        if (!shards[s].alive) {
+            continue;
+        }
+        if (query.send(shards[s].socket)) {
+            asked.push_back(s);
+        } else {
+            fail(s);
+        }
+    }
+
+    //2. Gather the votes.
+    vector<Vote> votes;
+    for (unsigned int a = 0; a < asked.size(); a++) {
+        int s = asked[a];
+        ShardMessage reply;
+        if (!reply.receive(shards[s].socket, SHARD_REPLY_TIMEOUT_MS) || reply.getType() != SHARD_VOTES) {
+            fail(s);
+            continue;
+        }
+        shards[s].numOfQueries++;
+        shards[s].totalQueryTime += FrameTrace::now() - sent;
+
+        shards[s].generation = reply.getInt();
+        int numOfVotes = reply.getInt();
+        for (int i = 0; i < numOfVotes && reply.isValid(); i++) {
+            Vote vote;
+            vote.objectName = reply.getString();
+            vote.score = (float) reply.getFloat();
+            vote.rank = i;
+            vote.shard = s;
+
+            //Objects being moved may still be voted for by their old shard.
+            map<string, LibraryObject>::iterator object = objects.find(vote.objectName);
+            if (reply.isValid() && object != objects.end() && object->second.shard == s) {
+                votes.push_back(vote);
+            }
+        }
+    }
+
+    //3. The best votes of every shard, fetching any that aren't cached (or
+    //have changed since).
+    std::stable_sort(votes.begin(), votes.end(), betterVote);
+    if ((int) votes.size() > maxCandidates) {
+        votes.resize(maxCandidates);
+    }
+
+    map<int, vector<string> > missing;
+    for (unsigned int i = 0; i < votes.size(); i++) {
+        map<string, CachedModel>::iterator cached = cache.find(votes[i].objectName);
+        if (cached == cache.end() || cached->second.shard != votes[i].shard ||
+                cached->second.generation != shards[votes[i].shard].generation) {
+            missing[votes[i].shard].push_back(votes[i].objectName);
+        } else {
+            cached->second.lastUsed = numOfFrames;
+        }
+    }
+    if (!missing.empty()) {
+        fetch(missing);
+    }
+    updateStore();
+
+    for (unsigned int i = 0; i < votes.size(); i++) {
+        map<string, int>::iterator slot = storeSlots.find(votes[i].objectName);
+        if (slot != storeSlots.end()) {
+            candidates.push_back(store->model(slot->second));
+        }
+    }
+
+    //Candidates hold the store, so evicting now only affects later frames.
+    evict();
+}
+
+/**
+ * Find objects in a frame.
+ *
+ * @param frame Input frame.
+ * @param detections Objects found, best first.
+ */
+void ShardCoordinator::recognise(cv::Mat frame, vector<Detection>& detections) {
+    detections.clear();
+    if (!frame.data) {
+        return;
+    }
+
+    vector<cv::KeyPoint> frameKeypoints;
+    cv::Mat frameDescriptors;
+    matcher.detectFeatures(frame, frameKeypoints, frameDescriptors);
+
+    vector<ModelView> candidates;
+    getCandidates(frameDescriptors, candidates);
+    ObjectRecognition::verify(matcher, candidates, frameKeypoints, frameDescriptors, detections);
+}
+
+/**
+ * @param stats What each shard holds and has done.
+ */
+void ShardCoordinator::getStats(vector<ShardStats>& stats) const {
+    stats.assign(shards.size(), ShardStats());
+    for (unsigned int s = 0; s < shards.size(); s++) {
+        stats[s].pid = shards[s].pid;
+        stats[s].alive = shards[s].alive;
+        stats[s].loaded = shards[s].loaded;
+        stats[s].numOfObjects = 0;
+        stats[s].numOfViews = 0;
+        stats[s].load = getLoad(s);
+        stats[s].numOfQueries = shards[s].numOfQueries;
+        stats[s].meanQueryTime = shards[s].numOfQueries > 0 ?
+                shards[s].totalQueryTime / shards[s].numOfQueries : 0;
+    }
+    for (map<string, LibraryObject>::const_iterator it = objects.begin(); it != objects.end(); ++it) {
+        if (it->second.shard >= 0) {
+            stats[it->second.shard].numOfObjects++;
+            stats[it->second.shard].numOfViews += it->second.files.size();
+        }
+    }
+}
+
+/**
+ * Write what each shard holds and has done (times in milliseconds), and how
+ * the cache is doing.
+ *
+ * @param out Stream to write to.
+ */
+void ShardCoordinator::report(ostream& out) const {
+    vector<ShardStats> stats;
+    getStats(stats);
+    for (unsigned int s = 0; s < stats.size(); s++) {
+        out << "Shard " << s << " (worker " << stats[s].pid << (stats[s].alive ? "" : ", failed")
+                << "): " << stats[s].numOfObjects << " objects, " << stats[s].numOfViews << " views, "
+                << stats[s].load << " keypoints" << (stats[s].loaded ? "" : " (loading)") << ", "
+                << stats[s].numOfQueries << " queries, " << stats[s].meanQueryTime * 1000 << " ms each" << endl;
+    }
+    out << cache.size() << " models cached, " << numOfFetched << " fetched over "
+            << numOfFrames << " frames" << endl;
+}
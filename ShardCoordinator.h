@@ -0,0 +1,258 @@
+/**
+ * @file ShardCoordinator.h
+ * @author Aydin Arik
+ * @brief Recognises objects in a library that is partitioned into shards,
+ *        each served by a ShardWorker in a process of its own with its own
+ *        index. The descriptors of each frame are broadcast to every shard,
+ *        each shard votes for its best candidates, and the coordinator merges
+ *        the votes into one shortlist and verifies it. The features of
+ *        shortlisted objects are fetched from their shard and cached, so
+ *        objects that stay in view are only fetched once.
+ *
+ *        Objects (every view of a name) are placed on the least loaded shard,
+ *        load being the number of object keypoints (estimated until the shard
+ *        has extracted them). update() picks up objects added to or removed
+ *        from the library directory, moves the objects of workers that have
+ *        died, and moves objects from the most to the least loaded shard
+ *        while their loads are too far apart.
+ *
+ *        Workers are spawned on this machine (the program re-run with
+ *        --shard-worker), standing in for separate nodes. Index scores are
+ *        found against each shard's own index, so they are only roughly
+ *        comparable between shards. Not safe to use from several threads at
+ *        once.
+ */
+
+#ifndef SHARDCOORDINATOR_H
+#define	SHARDCOORDINATOR_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <string>
+#include <vector>
+#include <map>
+#include <ostream>
+#include <stdint.h>
+#include <sys/types.h>
+#include <boost/shared_ptr.hpp>
+#include "LibraryStore.h"
+#include "Matcher.h"
+#include "Detection.h"
+#include "RecognitionConfig.h"
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+class ShardCoordinator {
+public:
+
+    /**
+     * What a shard holds and has done.
+     */
+    struct ShardStats {
+        int pid; //Worker process.
+        bool alive; //False once the worker has failed.
+        bool loaded; //True if every assigned file is loaded and indexed.
+        int numOfObjects; //Objects assigned.
+        int numOfViews; //Object images assigned.
+        long load; //Keypoints of the objects assigned (partly estimated until loaded).
+        long numOfQueries; //Frames voted on.
+        double meanQueryTime; //Query sent to votes received (seconds).
+    };
+
+private:
+
+    /**
+     * A worker, and what it has been assigned.
+     */
+    struct Shard {
+        pid_t pid;
+        int socket; //Connected to the worker.
+        bool alive;
+        bool loaded;
+        bool assignmentChanged; //True if the worker must be sent its files again.
+        int64_t generation; //Worker's store generation, from its last reply.
+        long numOfQueries;
+        double totalQueryTime;
+    };
+
+    /**
+     * Every view of an object in the library directory.
+     */
+    struct LibraryObject {
+        std::vector<std::string> files;
+        int shard; //Shard the object is assigned to.
+        long keypoints; //Of every view.
+        bool measured; //False while keypoints is an estimate.
+    };
+
+    /**
+     * Features of an object fetched from its shard.
+     */
+    struct CachedModel {
+        int shard; //Shard it was fetched from.
+        int64_t generation; //Shard's store generation when fetched.
+        std::vector<ObjectPtr> views;
+        long lastUsed; //Frame it was last a candidate for.
+    };
+
+    RecognitionConfig config;
+    std::string configFile; //Passed to workers (empty for default settings).
+    std::vector<Shard> shards;
+    std::map<std::string, LibraryObject> objects; //By name.
+    Matcher matcher;
+
+    //
+    //Models fetched from shards. The store is rebuilt from the cache when it
+    //has changed, keeping the representatives of models already in it.
+    //
+    std::map<std::string, CachedModel> cache; //By name.
+    boost::shared_ptr<const LibraryStore> store;
+    std::map<std::string, int> storeSlots; //Model number of each name in store.
+    bool storeStale; //True if the cache has changed since store was built.
+    long numOfFrames;
+    long numOfFetched; //Models fetched from shards.
+
+    /**
+     * Start a worker process.
+     *
+     * @param shard The shard to start a worker for.
+     * @return True if the worker was started.
+     */
+    bool spawn(Shard& shard);
+
+    /**
+     * Give up on a worker that has failed. Its objects are moved to other
+     * shards by the next update().
+     *
+     * @param s Shard number.
+     */
+    void fail(int s);
+
+    /**
+     * @param s Shard number.
+     * @return Keypoints of the objects assigned to a shard.
+     */
+    long getLoad(int s) const;
+
+    /**
+     * @return The live shard with the least load (-1 if none are alive).
+     */
+    int getLeastLoaded() const;
+
+    /**
+     * Find the objects in the library directory. New objects are assigned to
+     * the least loaded shard, and removed ones are dropped.
+     */
+    void scan();
+
+    /**
+     * Ask every shard which objects it has loaded, and how large they are.
+     */
+    void askStatus();
+
+    /**
+     * Move objects from the most to the least loaded shard while their loads
+     * are too far apart. Only done once every shard has loaded its objects,
+     * so loads are measured rather than estimated.
+     */
+    void rebalance();
+
+    /**
+     * Send each shard whose objects have changed the files it now owns.
+     */
+    void sendAssignments();
+
+    /**
+     * Fetch the features of objects from their shards into the cache.
+     *
+     * @param names Names of the objects to fetch from each shard.
+     */
+    void fetch(const std::map<int, std::vector<std::string> >& names);
+
+    /**
+     * Drop the least recently used models while the cache is over its limit.
+     */
+    void evict();
+
+    /**
+     * Rebuild the store from the cache, if the cache has changed.
+     */
+    void updateStore();
+
+    ShardCoordinator(const ShardCoordinator&); //Not copyable.
+    ShardCoordinator& operator=(const ShardCoordinator&);
+public:
+
+    /**
+     * Constructor. See start().
+     *
+     * @param numOfShards Number of workers.
+     * @param config Recognition settings (workers load theirs from configFile).
+     * @param configFile Settings file passed to workers (empty for defaults).
+     */
+    ShardCoordinator(int numOfShards, const RecognitionConfig& config,
+            const std::string& configFile = "");
+
+    /**
+     * Destructor. Tells the workers to quit and waits for them.
+     */
+    ~ShardCoordinator();
+
+    /**
+     * Start the workers and assign them the objects of the library directory.
+     * Workers load their objects in the background (see waitUntilLoaded()).
+     *
+     * @return True if at least one worker started.
+     */
+    bool start();
+
+    /**
+     * Pick up objects added to or removed from the library directory, move
+     * the objects of failed workers, and rebalance the shards.
+     */
+    void update();
+
+    /**
+     * Wait until every shard has loaded and indexed its objects, then
+     * rebalance the shards on their measured loads.
+     *
+     * @param timeoutMs Longest time to wait (milliseconds, negative to wait
+     *        until loaded).
+     * @return True if every shard is loaded.
+     */
+    bool waitUntilLoaded(int timeoutMs = -1);
+
+    /**
+     * Get the objects worth matching against a frame: every shard votes for
+     * its best candidates, and the best of all their votes are fetched (if
+     * not cached) and returned.
+     *
+     * @param frameDescriptors Descriptors of the frame.
+     * @param candidates Objects to match against the frame, best first.
+     */
+    void getCandidates(const cv::Mat& frameDescriptors, std::vector<ModelView>& candidates);
+
+    /**
+     * Find objects in a frame.
+     *
+     * @param frame Input frame.
+     * @param detections Objects found, best first.
+     */
+    void recognise(cv::Mat frame, std::vector<Detection>& detections);
+
+    /**
+     * @param stats What each shard holds and has done.
+     */
+    void getStats(std::vector<ShardStats>& stats) const;
+
+    /**
+     * Write what each shard holds and has done, and how the cache is doing.
+     *
+     * @param out Stream to write to.
+     */
+    void report(std::ostream& out) const;
+};
+
+#endif	/* SHARDCOORDINATOR_H */
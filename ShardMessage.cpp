@@ -0,0 +1,235 @@
+/**
+ * @file ShardMessage.cpp
+ * @author Aydin Arik
+ * @brief Messages between a ShardCoordinator and its ShardWorkers.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "ShardMessage.h"
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+using namespace std;
+
+
+/******************************************************************************
+ *                              Functions
+ ******************************************************************************/
+/**
+ * Write all of a buffer to a socket.
+ *
+ * @param socket Connected stream socket.
+ * @param data Bytes to write.
+ * @param size Number of bytes.
+ * @return False if the socket failed.
+ */
+static bool sendAll(int socket, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t sent = ::send(socket, data, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+/**
+ * Read a whole buffer from a socket.
+ *
+ * @param socket Connected stream socket.
+ * @param data Where to read to.
+ * @param size Number of bytes.
+ * @return False if the socket failed or was closed first.
+ */
+static bool receiveAll(int socket, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t received = recv(socket, data, size, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        data += received;
+        size -= received;
+    }
+    return true;
+}
+
+
+/******************************************************************************
+ *                              Private Methods
+ ******************************************************************************/
+/**
+ * Read bytes from the payload (zeros once it is used up).
+ *
+ * @param data Where to copy to.
+ * @param size Number of bytes.
+ */
+void ShardMessage::get(void* data, size_t size) {
+    if (overrun || size > payload.size() - readOffset) {
+        overrun = true;
+        memset(data, 0, size);
+        return;
+    }
+    if (size > 0) {
+        memcpy(data, &payload[readOffset], size);
+        readOffset += size;
+    }
+}
+
+/**
+ * Append bytes to the payload.
+ *
+ * @param data Bytes to append.
+ * @param size Number of bytes.
+ */
+void ShardMessage::put(const void* data, size_t size) {
+    const char* bytes = static_cast<const char*> (data);
+    payload.insert(payload.end(), bytes, bytes + size);
+}
+
+
+/******************************************************************************
+ *                              Public Methods
+ ******************************************************************************/
+/**
+ * Constructor. An empty message.
+ *
+ * @param type ShardMessageType of the message.
+ */
+ShardMessage::ShardMessage(uint32_t type) : type(type), readOffset(0), overrun(false) {
+}
+
+void ShardMessage::putInt(int64_t value) {
+    put(&value, sizeof (value));
+}
+
+void ShardMessage::putFloat(double value) {
+    put(&value, sizeof (value));
+}
+
+void ShardMessage::putString(const string& value) {
+    putInt(value.size());
+    put(value.data(), value.size());
+}
+
+/**
+ * Append a matrix (its size, type and rows, so it needn't be continuous).
+ *
+ * @param value The matrix.
+ */
+void ShardMessage::putMat(const cv::Mat& value) {
+    putInt(value.rows);
+    putInt(value.cols);
+    putInt(value.type());
+    size_t rowSize = value.cols * value.elemSize();
+    for (int r = 0; r < value.rows; r++) {
+        put(value.ptr(r), rowSize);
+    }
+}
+
+int64_t ShardMessage::getInt() {
+    int64_t value;
+    get(&value, sizeof (value));
+    return value;
+}
+
+double ShardMessage::getFloat() {
+    double value;
+    get(&value, sizeof (value));
+    return value;
+}
+
+string ShardMessage::getString() {
+    int64_t size = getInt();
+    if (size < 0 || (uint64_t) size > payload.size() - readOffset) {
+        overrun = true;
+        return string();
+    }
+    string value(payload.begin() + readOffset, payload.begin() + readOffset + size);
+    readOffset += size;
+    return value;
+}
+
+/**
+ * @return The next matrix (continuous, owning its data).
+ */
+cv::Mat ShardMessage::getMat() {
+    int64_t rows = getInt();
+    int64_t cols = getInt();
+    int64_t matType = getInt();
+    if (overrun || rows < 0 || cols < 0 || matType != CV_MAT_TYPE(matType)) {
+        overrun = true;
+        return cv::Mat();
+    }
+
+    uint64_t size = (uint64_t) rows * cols * CV_ELEM_SIZE(matType);
+    if (size > payload.size() - readOffset) {
+        overrun = true;
+        return cv::Mat();
+    }
+    cv::Mat value(rows, cols, matType);
+    get(value.data, size);
+    return value;
+}
+
+/**
+ * Send the message, blocking until all of it is written.
+ *
+ * @param socket Connected stream socket.
+ * @return False if the socket failed (or was closed).
+ */
+bool ShardMessage::send(int socket) const {
+    ShardHeader header;
+    header.magic = SHARD_MAGIC;
+    header.type = type;
+    header.size = payload.size();
+    return sendAll(socket, (const char*) &header, sizeof (header)) &&
+            (payload.empty() || sendAll(socket, &payload[0], payload.size()));
+}
+
+/**
+ * Wait for a message and read it, replacing this one.
+ *
+ * @param socket Connected stream socket.
+ * @param timeoutMs Longest time to wait for the message to start
+ *        (milliseconds, negative to wait until there is one).
+ * @return False if none came in time, or the socket failed (or was closed),
+ *         or the message was malformed.
+ */
+bool ShardMessage::receive(int socket, int timeoutMs) {
+    pollfd fd;
+    fd.fd = socket;
+    fd.events = POLLIN;
+    fd.revents = 0;
+    int ready;
+    do {
+        ready = poll(&fd, 1, timeoutMs);
+    } while (ready < 0 && errno == EINTR);
+    if (ready <= 0) {
+        return false;
+    }
+
+    ShardHeader header;
+    if (!receiveAll(socket, (char*) &header, sizeof (header)) ||
+            header.magic != SHARD_MAGIC || header.size > SHARD_MAX_PAYLOAD) {
+        return false;
+    }
+
+    type = header.type;
+    payload.resize(header.size);
+    readOffset = 0;
+    overrun = false;
+    return payload.empty() || receiveAll(socket, &payload[0], payload.size());
+}
@@ -0,0 +1,156 @@
+/**
+ * @file ShardMessage.h
+ * @author Aydin Arik
+ * @brief Messages between a ShardCoordinator and its ShardWorkers. Each
+ *        message is a header (magic, type and payload size) followed by a
+ *        payload of integers, floats, strings and matrices, read back in the
+ *        order they were written. Sent over a stream socket, so the same
+ *        messages would carry over TCP to workers on other machines (numbers
+ *        are in host byte order, so the machines must agree on it).
+ *
+ *        Coordinator to worker:
+ *        - ASSIGN: files of the library directory the worker owns (replaces
+ *          the last assignment). No reply.
+ *        - QUERY: max candidates, frame descriptors. Replied to with VOTES:
+ *          store generation, then name and score of each candidate.
+ *        - FETCH: object names. Replied to with MODELS: store generation,
+ *          then for each object found its name and views (keypoint arrays
+ *          and descriptors of each).
+ *        - STATUS: no payload. Replied to with LOADS: loaded flag, then name,
+ *          views and keypoints of each object.
+ *        - QUIT: no payload. No reply.
+ */
+
+#ifndef SHARDMESSAGE_H
+#define	SHARDMESSAGE_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <opencv2/core/core.hpp>
+
+// First field of every message ("SHRD").
+#define SHARD_MAGIC 0x44524853
+
+// Largest payload accepted (bytes).
+#define SHARD_MAX_PAYLOAD (256 * 1024 * 1024)
+
+
+/******************************************************************************
+ *                              Types
+ ******************************************************************************/
+enum ShardMessageType {
+    SHARD_ASSIGN = 1,
+    SHARD_QUERY,
+    SHARD_VOTES,
+    SHARD_FETCH,
+    SHARD_MODELS,
+    SHARD_STATUS,
+    SHARD_LOADS,
+    SHARD_QUIT
+};
+
+/**
+ * Start of every message.
+ */
+struct ShardHeader {
+    uint32_t magic;
+    uint32_t type; //ShardMessageType.
+    uint64_t size; //Bytes of payload that follow.
+};
+
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+class ShardMessage {
+private:
+    uint32_t type;
+    std::vector<char> payload;
+    size_t readOffset; //Next byte of payload to read.
+    bool overrun; //True if more was read than the payload holds.
+
+    /**
+     * Read bytes from the payload (zeros once it is used up).
+     *
+     * @param data Where to copy to.
+     * @param size Number of bytes.
+     */
+    void get(void* data, size_t size);
+
+    /**
+     * Append bytes to the payload.
+     *
+     * @param data Bytes to append.
+     * @param size Number of bytes.
+     */
+    void put(const void* data, size_t size);
+
+public:
+
+    /**
+     * Constructor. An empty message.
+     *
+     * @param type ShardMessageType of the message.
+     */
+    ShardMessage(uint32_t type = 0);
+
+    uint32_t getType() const {
+        return type;
+    }
+
+    /**
+     * @return True if nothing was read past the end of the payload.
+     */
+    bool isValid() const {
+        return !overrun;
+    }
+
+    void putInt(int64_t value);
+
+    void putFloat(double value);
+
+    void putString(const std::string& value);
+
+    /**
+     * Append a matrix (its size, type and rows, so it needn't be continuous).
+     *
+     * @param value The matrix.
+     */
+    void putMat(const cv::Mat& value);
+
+    int64_t getInt();
+
+    double getFloat();
+
+    std::string getString();
+
+    /**
+     * @return The next matrix (continuous, owning its data).
+     */
+    cv::Mat getMat();
+
+    /**
+     * Send the message, blocking until all of it is written.
+     *
+     * @param socket Connected stream socket.
+     * @return False if the socket failed (or was closed).
+     */
+    bool send(int socket) const;
+
+    /**
+     * Wait for a message and read it, replacing this one.
+     *
+     * @param socket Connected stream socket.
+     * @param timeoutMs Longest time to wait for the message to start
+     *        (milliseconds, negative to wait until there is one).
+     * @return False if none came in time, or the socket failed (or was
+     *         closed), or the message was malformed.
+     */
+    bool receive(int socket, int timeoutMs = -1);
+};
+
+#endif	/* SHARDMESSAGE_H */
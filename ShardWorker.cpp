@@ -0,0 +1,235 @@
+/**
+ * @file ShardWorker.cpp
+ * @author Aydin Arik
+ * @brief Serves one shard of the object library to a ShardCoordinator.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "ShardWorker.h"
+#include <iostream>
+#include <map>
+#include <unistd.h>
+
+using namespace std;
+
+
+/******************************************************************************
+ *                              Functions
+ ******************************************************************************/
+/**
+ * Append a view's keypoints to a message, one row of x, y, size, angle,
+ * response and octave per keypoint.
+ *
+ * @param view The view.
+ * @param message Message to append to.
+ */
+static void putKeypoints(const ObjectView& view, ShardMessage& message) {
+    cv::Mat keypoints(view.getNumOfKeypoints(), 6, CV_32F);
+    for (int i = 0; i < keypoints.rows; i++) {
+        float* row = keypoints.ptr<float>(i);
+        row[0] = view.getPoint(i).x;
+        row[1] = view.getPoint(i).y;
+        row[2] = view.getSize(i);
+        row[3] = view.getAngle(i);
+        row[4] = view.getResponse(i);
+        row[5] = (float) view.getOctave(i);
+    }
+    message.putMat(keypoints);
+}
+
+
+/******************************************************************************
+ *                              Private Methods
+ ******************************************************************************/
+/**
+ * @return Generation of the library's current store.
+ */
+int64_t ShardWorker::getGeneration() {
+    LibrarySnapshotPtr current = library->getSnapshot();
+    if (current->store != lastStore) {
+        lastStore = current->store;
+        generation++;
+    }
+    return generation;
+}
+
+/**
+ * Shortlist objects for a frame.
+ *
+ * @param request QUERY message.
+ * @param reply VOTES message.
+ */
+void ShardWorker::query(ShardMessage& request, ShardMessage& reply) {
+    int maxCandidates = request.getInt();
+    cv::Mat frameDescriptors = request.getMat();
+
+    vector<ModelView> candidates;
+    vector<float> scores;
+    if (request.isValid()) {
+        library->getCandidates(frameDescriptors, maxCandidates, candidates, scores, objectIterator);
+    }
+
+    reply.putInt(getGeneration());
+    reply.putInt(candidates.size());
+    for (unsigned int i = 0; i < candidates.size(); i++) {
+        reply.putString(candidates[i].getObjectName());
+        reply.putFloat(scores[i]);
+    }
+}
+
+/**
+ * Hand out the features of objects. A store holds one representative
+ * descriptor for near identical descriptors of several views, so each view's
+ * descriptors are rebuilt from the representatives its keypoints refer to.
+ *
+ * @param request FETCH message.
+ * @param reply MODELS message.
+ */
+void ShardWorker::fetch(ShardMessage& request, ShardMessage& reply) {
+    vector<string> names;
+    int numOfNames = request.getInt();
+    for (int i = 0; i < numOfNames && request.isValid(); i++) {
+        names.push_back(request.getString());
+    }
+
+    vector<ModelView> models;
+    for (unsigned int i = 0; i < names.size() && request.isValid(); i++) {
+        ModelView model;
+        if (library->getModel(names[i], model) && model.getNumOfViews() > 0) {
+            models.push_back(model);
+        }
+    }
+
+    reply.putInt(getGeneration());
+    reply.putInt(models.size());
+    for (unsigned int m = 0; m < models.size(); m++) {
+        const ModelView& model = models[m];
+        const cv::Mat& representatives = model.getDescriptors();
+
+        vector<cv::Mat> descriptors(model.getNumOfViews());
+        for (int v = 0; v < model.getNumOfViews(); v++) {
+            descriptors[v] = cv::Mat::zeros(model.getView(v).getNumOfKeypoints(),
+                    representatives.cols, representatives.type());
+        }
+        for (int r = 0; r < representatives.rows; r++) {
+            for (int j = model.getRefBegin(r); j < model.getRefEnd(r); j++) {
+                cv::Mat row = descriptors[model.getRefView(j)].row(model.getRefKeypoint(j));
+                representatives.row(r).copyTo(row);
+            }
+        }
+
+        reply.putString(model.getObjectName());
+        reply.putInt(model.getNumOfViews());
+        for (int v = 0; v < model.getNumOfViews(); v++) {
+            putKeypoints(model.getView(v), reply);
+            reply.putMat(descriptors[v]);
+        }
+    }
+}
+
+/**
+ * Report the size of each object, and whether loading has finished (every
+ * assigned file loaded and indexed).
+ *
+ * @param reply LOADS message.
+ */
+void ShardWorker::status(ShardMessage& reply) {
+    LibrarySnapshotPtr current = library->getSnapshot();
+
+    //Views of an object may be split between the store and pending.
+    map<string, pair<int, int> > sizes; //Views and keypoints of each object.
+    int stored = current->store ? current->store->size() : 0;
+    for (int i = 0; i < stored; i++) {
+        ModelView model = current->store->model(i);
+        pair<int, int>& size = sizes[model.getObjectName()];
+        for (int v = 0; v < model.getNumOfViews(); v++) {
+            size.first++;
+            size.second += model.getView(v).getNumOfKeypoints();
+        }
+    }
+    for (unsigned int i = 0; i < current->pending.size(); i++) {
+        pair<int, int>& size = sizes[current->pending[i]->getObjectName()];
+        size.first++;
+        size.second += current->pending[i]->getKeypoints().count();
+    }
+
+    reply.putInt(library->isLoaded() && current->pending.empty() ? 1 : 0);
+    reply.putInt(sizes.size());
+    for (map<string, pair<int, int> >::iterator it = sizes.begin(); it != sizes.end(); ++it) {
+        reply.putString(it->first);
+        reply.putInt(it->second.first);
+        reply.putInt(it->second.second);
+    }
+}
+
+
+/******************************************************************************
+ *                              Public Methods
+ ******************************************************************************/
+/**
+ * Constructor. The worker owns no files until the coordinator assigns some.
+ *
+ * @param socket Connected to the coordinator. Closed by the destructor.
+ * @param config Settings used to find and prune object features.
+ */
+ShardWorker::ShardWorker(int socket, const RecognitionConfig& config)
+: socket(socket), objectIterator(0), generation(0) {
+    vector<string> none;
+    library.reset(new ObjectLibrary(0, false, false, config, &none));
+}
+
+ShardWorker::~ShardWorker() {
+    library.reset();
+    close(socket);
+}
+
+/**
+ * Answer the coordinator until it says to quit, or goes away.
+ *
+ * @return 0 if told to quit, 1 if the coordinator went away.
+ */
+int ShardWorker::run() {
+    ShardMessage request;
+    while (request.receive(socket)) {
+        ShardMessage reply;
+        switch (request.getType()) {
+            case SHARD_ASSIGN:
+            {
+                vector<string> files;
+                int numOfFiles = request.getInt();
+                for (int i = 0; i < numOfFiles && request.isValid(); i++) {
+                    files.push_back(request.getString());
+                }
+                if (request.isValid()) {
+                    library->assignFiles(files);
+                }
+                continue; //No reply.
+            }
+            case SHARD_QUERY:
+                reply = ShardMessage(SHARD_VOTES);
+                query(request, reply);
+                break;
+            case SHARD_FETCH:
+                reply = ShardMessage(SHARD_MODELS);
+                fetch(request, reply);
+                break;
+            case SHARD_STATUS:
+                reply = ShardMessage(SHARD_LOADS);
+                status(reply);
+                break;
+            case SHARD_QUIT:
+                return 0;
+            default:
+                std::cout << "Shard worker " << getpid() << ": unknown message " << request.getType() << std::endl;
+                continue;
+        }
+
+        if (!reply.send(socket)) {
+            break;
+        }
+    }
+
+    return 1;
+}
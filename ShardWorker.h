@@ -0,0 +1,85 @@
+/**
+ * @file ShardWorker.h
+ * @author Aydin Arik
+ * @brief Serves one shard of the object library to a ShardCoordinator. The
+ *        worker runs in a process of its own, with an ObjectLibrary (and
+ *        index) of just the files assigned to it, and answers the
+ *        coordinator's messages (see ShardMessage.h) one at a time: it
+ *        shortlists its objects for each frame, and hands out the features
+ *        of the objects the coordinator goes on to verify.
+ */
+
+#ifndef SHARDWORKER_H
+#define	SHARDWORKER_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <boost/scoped_ptr.hpp>
+#include "ObjectLibrary.h"
+#include "RecognitionConfig.h"
+#include "ShardMessage.h"
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+class ShardWorker {
+private:
+    int socket; //Connected to the coordinator.
+    boost::scoped_ptr<ObjectLibrary> library; //Objects of the assigned files.
+    int objectIterator; //Place in the library rotation (without an index).
+    boost::shared_ptr<const LibraryStore> lastStore; //Store the generation was counted for.
+    int64_t generation; //Counts store rebuilds, so the coordinator knows when its copies are stale.
+
+    /**
+     * @return Generation of the library's current store.
+     */
+    int64_t getGeneration();
+
+    /**
+     * Shortlist objects for a frame.
+     *
+     * @param request QUERY message.
+     * @param reply VOTES message.
+     */
+    void query(ShardMessage& request, ShardMessage& reply);
+
+    /**
+     * Hand out the features of objects.
+     *
+     * @param request FETCH message.
+     * @param reply MODELS message.
+     */
+    void fetch(ShardMessage& request, ShardMessage& reply);
+
+    /**
+     * Report the size of each object, and whether loading has finished.
+     *
+     * @param reply LOADS message.
+     */
+    void status(ShardMessage& reply);
+
+    ShardWorker(const ShardWorker&); //Not copyable.
+    ShardWorker& operator=(const ShardWorker&);
+public:
+
+    /**
+     * Constructor. The worker owns no files until the coordinator assigns
+     * some.
+     *
+     * @param socket Connected to the coordinator. Closed by the destructor.
+     * @param config Settings used to find and prune object features.
+     */
+    ShardWorker(int socket, const RecognitionConfig& config);
+
+    ~ShardWorker();
+
+    /**
+     * Answer the coordinator until it says to quit, or goes away.
+     *
+     * @return 0 if told to quit, 1 if the coordinator went away.
+     */
+    int run();
+};
+
+#endif	/* SHARDWORKER_H */
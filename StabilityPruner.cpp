@@ -0,0 +1,182 @@
+/**
+ * @file StabilityPruner.cpp
+ * @author Aydin Arik
+ * @brief Keeps only the keypoints of an object image that survive changes in
+ *        viewpoint, focus and lighting.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "StabilityPruner.h"
+#include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <iostream>
+
+using namespace std;
+
+// Fewest keypoints kept per object. If fewer are stable, the strongest of the
+// rest (by detector response) make up the difference, so an object can always
+// be recognised.
+#define MIN_KEPT_KEYPOINTS 50
+
+
+/******************************************************************************
+ *                              Private Methods
+ ******************************************************************************/
+/**
+ * Make a random synthetic view of an image: a perspective warp (each corner
+ * moved by up to maxWarp of the image size), a blur and a change in
+ * brightness and contrast.
+ *
+ * @param image The image.
+ * @param view Resulting view.
+ * @return Homography from the image to the view.
+ */
+cv::Mat StabilityPruner::makeView(const cv::Mat& image, cv::Mat& view) {
+    float w = image.cols;
+    float h = image.rows;
+    cv::Point2f corners[4] = {cv::Point2f(0, 0), cv::Point2f(w, 0), cv::Point2f(w, h), cv::Point2f(0, h)};
+    cv::Point2f moved[4];
+    for (int i = 0; i < 4; i++) {
+        moved[i] = cv::Point2f(corners[i].x + rng.uniform(-maxWarp, maxWarp) * w,
+                corners[i].y + rng.uniform(-maxWarp, maxWarp) * h);
+    }
+
+    cv::Mat homography = cv::getPerspectiveTransform(corners, moved);
+    cv::warpPerspective(image, view, homography, image.size(), cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+
+    double sigma = rng.uniform(0.0, maxBlur);
+    if (sigma > 0.1) {
+        cv::GaussianBlur(view, view, cv::Size(0, 0), sigma);
+    }
+
+    view.convertTo(view, -1, rng.uniform(0.7, 1.3), rng.uniform(-30.0, 30.0)); //Contrast, brightness.
+
+    return homography;
+}
+
+
+/******************************************************************************
+ *                              Public Methods
+ ******************************************************************************/
+/**
+ * Constructor.
+ *
+ * @param maxKeypoints Most keypoints to keep per object (top-K).
+ * @param numOfTrials Number of synthetic views to test against.
+ */
+StabilityPruner::StabilityPruner(int maxKeypoints, int numOfTrials)
+: maxKeypoints(maxKeypoints), numOfTrials(numOfTrials), maxWarp(0.15f), maxBlur(1.5),
+maxReprojectionError(3.0f) {
+}
+
+/**
+ * Score each of an object's keypoints by the number of synthetic views it
+ * was re-detected and re-matched in. A keypoint counts as re-matched if its
+ * nearest descriptor in the view is within maxReprojectionError of where the
+ * warp puts it.
+ *
+ * @param object The object.
+ * @param detector Feature detector used on the object.
+ * @param extractor Descriptor extractor used on the object.
+ * @param scores Score of each keypoint, from 0 to numOfTrials.
+ */
+void StabilityPruner::score(const Object& object,
+        const cv::Ptr<cv::FeatureDetector>& detector,
+        const cv::Ptr<cv::DescriptorExtractor>& extractor,
+        vector<int>& scores) {
+    const KeypointArrays& keypoints = object.getKeypoints();
+    const cv::Mat& descriptors = object.getDescriptors();
+    scores.assign(keypoints.count(), 0);
+    if (keypoints.count() == 0 || !object.getImage().data) {
+        return;
+    }
+
+    vector<cv::Point2f> points(keypoints.count());
+    for (int i = 0; i < keypoints.count(); i++) {
+        points[i] = cv::Point2f(keypoints.x[i], keypoints.y[i]);
+    }
+
+    float maxError = maxReprojectionError * maxReprojectionError;
+    cv::BruteForceMatcher<cv::L2<float> > matcher;
+    for (int t = 0; t < numOfTrials; t++) {
+        cv::Mat view;
+        cv::Mat homography = makeView(object.getImage(), view);
+
+        vector<cv::KeyPoint> viewKeypoints;
+        cv::Mat viewDescriptors;
+        detector->detect(view, viewKeypoints);
+        extractor->compute(view, viewKeypoints, viewDescriptors);
+        if (viewDescriptors.rows == 0) {
+            continue;
+        }
+
+        //Where each keypoint should be in the view.
+        vector<cv::Point2f> expected;
+        cv::perspectiveTransform(points, expected, homography);
+
+        vector<cv::DMatch> nearest;
+        matcher.match(descriptors, viewDescriptors, nearest);
+        for (unsigned int m = 0; m < nearest.size(); m++) {
+            const cv::Point2f& found = viewKeypoints[nearest[m].trainIdx].pt;
+            const cv::Point2f& should = expected[nearest[m].queryIdx];
+            float dx = found.x - should.x;
+            float dy = found.y - should.y;
+            if (dx * dx + dy * dy <= maxError) {
+                scores[nearest[m].queryIdx]++;
+            }
+        }
+    }
+}
+
+/**
+ * Remove an object's unstable keypoints, keeping at most maxKeypoints of
+ * the most stable ones. Keypoints never re-detected are removed, unless
+ * fewer than MIN_KEPT_KEYPOINTS were re-detected, in which case the
+ * strongest of them are kept as well. Ties are broken by detector response.
+ *
+ * @param object The object (before it is quantised).
+ * @param detector Feature detector used on the object.
+ * @param extractor Descriptor extractor used on the object.
+ * @return Number of keypoints kept.
+ */
+int StabilityPruner::prune(Object& object,
+        const cv::Ptr<cv::FeatureDetector>& detector,
+        const cv::Ptr<cv::DescriptorExtractor>& extractor) {
+    vector<int> scores;
+    score(object, detector, extractor, scores);
+
+    const KeypointArrays& keypoints = object.getKeypoints();
+    vector<pair<pair<int, float>, int> > ranked; //((score, response), keypoint)
+    int numOfStable = 0;
+    for (unsigned int i = 0; i < scores.size(); i++) {
+        ranked.push_back(make_pair(make_pair(scores[i], keypoints.response[i]), (int) i));
+        if (scores[i] > 0) {
+            numOfStable++;
+        }
+    }
+
+    //Unstable keypoints rank last, strongest first.
+    int k = min(maxKeypoints, (int) ranked.size());
+    if (numOfStable >= MIN_KEPT_KEYPOINTS) {
+        k = min(k, numOfStable);
+    } else {
+        k = min(max(numOfStable, MIN_KEPT_KEYPOINTS), k);
+        std::cout << "Only " << numOfStable << " stable keypoints in " << object.getObjectName()
+                << "; keeping the " << k << " strongest" << std::endl;
+    }
+    partial_sort(ranked.begin(), ranked.begin() + k, ranked.end(),
+            greater<pair<pair<int, float>, int> >());
+
+    vector<int> kept;
+    for (int i = 0; i < k; i++) {
+        kept.push_back(ranked[i].second);
+    }
+    sort(kept.begin(), kept.end());
+
+    object.keepKeypoints(kept);
+    return kept.size();
+}
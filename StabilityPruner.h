@@ -0,0 +1,82 @@
+/**
+ * @file StabilityPruner.h
+ * @author Aydin Arik
+ * @brief Keeps only the keypoints of an object image that survive changes in
+ *        viewpoint, focus and lighting. The image is warped, blurred and
+ *        relit several times at random, and each keypoint is scored by how
+ *        often it is re-detected and re-matched where the warp says it should
+ *        be. Only the best scoring keypoints are kept.
+ */
+
+#ifndef STABILITYPRUNER_H
+#define	STABILITYPRUNER_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <opencv2/features2d/features2d.hpp>
+#include "Object.h"
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+class StabilityPruner {
+private:
+    int maxKeypoints; //Most keypoints to keep per object (top-K).
+    int numOfTrials; //Number of synthetic views to test against.
+    float maxWarp; //Largest corner displacement of a warp, as a fraction of the image size.
+    double maxBlur; //Largest Gaussian blur sigma.
+    float maxReprojectionError; //Pixels between a re-detected keypoint and where it should be.
+    cv::RNG rng;
+
+    /**
+     * Make a random synthetic view of an image.
+     *
+     * @param image The image.
+     * @param view Resulting view.
+     * @return Homography from the image to the view.
+     */
+    cv::Mat makeView(const cv::Mat& image, cv::Mat& view);
+
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param maxKeypoints Most keypoints to keep per object (top-K).
+     * @param numOfTrials Number of synthetic views to test against.
+     */
+    StabilityPruner(int maxKeypoints = 400, int numOfTrials = 6);
+
+    /**
+     * Score each of an object's keypoints by the number of synthetic views it
+     * was re-detected and re-matched in.
+     *
+     * @param object The object.
+     * @param detector Feature detector used on the object.
+     * @param extractor Descriptor extractor used on the object.
+     * @param scores Score of each keypoint, from 0 to numOfTrials.
+     */
+    void score(const Object& object,
+            const cv::Ptr<cv::FeatureDetector>& detector,
+            const cv::Ptr<cv::DescriptorExtractor>& extractor,
+            std::vector<int>& scores);
+
+    /**
+     * Remove an object's unstable keypoints, keeping at most maxKeypoints of
+     * the most stable ones. Keypoints never re-detected are removed, unless
+     * too few were re-detected to recognise the object.
+     *
+     * @param object The object (before it is quantised).
+     * @param detector Feature detector used on the object.
+     * @param extractor Descriptor extractor used on the object.
+     * @return Number of keypoints kept.
+     */
+    int prune(Object& object,
+            const cv::Ptr<cv::FeatureDetector>& detector,
+            const cv::Ptr<cv::DescriptorExtractor>& extractor);
+};
+
+#endif	/* STABILITYPRUNER_H */
@@ -0,0 +1,433 @@
+/**
+ * @file TaskExecutor.cpp
+ * @author Aydin Arik
+ * @brief A pool of worker threads with work stealing, shared by every
+ *        parallel stage.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "TaskExecutor.h"
+#include <exception>
+#include <iostream>
+#include <unistd.h>
+#include <sched.h>
+
+using namespace std;
+
+// Longest a waiting group sleeps before looking for queued tasks to help with.
+#define HELP_INTERVAL_MS 5
+
+
+/******************************************************************************
+ *                              Functions
+ ******************************************************************************/
+/**
+ * Find a task of a group in a deque.
+ *
+ * @param tasks The deque.
+ * @param group The group (NULL for any task).
+ * @param newest True to find the newest such task, false for the oldest.
+ * @return Position of the task (-1 if there is none).
+ */
+template <typename Task>
+static int findTask(const deque<Task>& tasks, const TaskGroup* group, bool newest) {
+    int numOfTasks = tasks.size();
+    for (int i = 0; i < numOfTasks; i++) {
+        int position = newest ? numOfTasks - 1 - i : i;
+        if (!group || tasks[position].group == group) {
+            return position;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @param start Start time.
+ * @param end End time.
+ * @return Seconds from start to end.
+ */
+static double secondsBetween(const timespec& start, const timespec& end) {
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+static TaskExecutor* defaultExecutor = NULL;
+static pthread_once_t defaultOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * Create the shared executor (once).
+ */
+static void createDefaultExecutor() {
+    defaultExecutor = new TaskExecutor(); //Lives until the process exits.
+}
+
+
+/******************************************************************************
+ *                              Private Methods
+ ******************************************************************************/
+/**
+ * Entry point of a worker thread. Runs tasks until stopped and every deque
+ * is empty.
+ *
+ * @param worker The Worker.
+ * @return NULL.
+ */
+void* TaskExecutor::runWorker(void* worker) {
+    Worker* self = static_cast<Worker*> (worker);
+    TaskExecutor* executor = self->executor;
+    pthread_setspecific(executor->currentWorker, self);
+
+#ifdef __linux__
+    if (self->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(self->cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof (set), &set);
+    }
+#endif
+
+    while (true) {
+        Task task;
+        bool stolen;
+        if (executor->take(self->index, task, stolen)) {
+            executor->execute(task, self, stolen);
+            continue;
+        }
+
+        executor->mutex.lock();
+        while (executor->numOfQueued == 0 && !executor->stopping) {
+            executor->workAvailable.wait(executor->mutex);
+        }
+        bool stop = executor->stopping && executor->numOfQueued == 0;
+        executor->mutex.unlock();
+        if (stop) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Queue a task. Tasks queued by a worker go on its own deque, so related
+ * work stays on one CPU unless another worker runs dry; others are spread
+ * over the workers in turn.
+ *
+ * @param task The task.
+ */
+void TaskExecutor::submit(const Task& task) {
+    Worker* worker = static_cast<Worker*> (pthread_getspecific(currentWorker));
+    if (!worker || worker->executor != this) {
+        mutex.lock();
+        worker = workers[nextWorker++ % workers.size()];
+        mutex.unlock();
+    }
+
+    worker->mutex.lock();
+    worker->tasks.push_back(task);
+    worker->mutex.unlock();
+
+    mutex.lock();
+    numOfQueued++;
+    workAvailable.signal();
+    mutex.unlock();
+}
+
+/**
+ * Take a task: the newest of a worker's own (most likely still in its
+ * cache), or else the oldest of another worker's.
+ *
+ * @param self Index of the worker taking the task (-1 if not a worker).
+ * @param task The task taken.
+ * @param stolen True if taken from another worker.
+ * @param group Only take a task of this group (NULL for any task).
+ * @return True if a task was taken.
+ */
+bool TaskExecutor::take(int self, Task& task, bool& stolen, TaskGroup* group) {
+    bool taken = false;
+    stolen = false;
+
+    if (self >= 0) {
+        Worker* own = workers[self];
+        own->mutex.lock();
+        int position = findTask(own->tasks, group, true);
+        if (position >= 0) {
+            task = own->tasks[position];
+            own->tasks.erase(own->tasks.begin() + position);
+            taken = true;
+        }
+        own->mutex.unlock();
+    }
+
+    int numOfWorkers = workers.size();
+    for (int i = 1; i <= numOfWorkers && !taken; i++) {
+        Worker* victim = workers[(self + i + numOfWorkers) % numOfWorkers];
+        if (victim->index == self) {
+            continue;
+        }
+        victim->mutex.lock();
+        int position = findTask(victim->tasks, group, false);
+        if (position >= 0) {
+            task = victim->tasks[position];
+            victim->tasks.erase(victim->tasks.begin() + position);
+            taken = true;
+            stolen = (self >= 0);
+        }
+        victim->mutex.unlock();
+    }
+
+    if (taken) {
+        mutex.lock();
+        numOfQueued--;
+        mutex.unlock();
+    }
+    return taken;
+}
+
+/**
+ * Run a task (unless its group was cancelled) and count it.
+ *
+ * @param task The task.
+ * @param worker Worker running it (NULL if not a worker).
+ * @param stolen True if taken from another worker.
+ */
+void TaskExecutor::execute(const Task& task, Worker* worker, bool stolen) {
+    timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (!task.group || !task.group->isCancelled()) {
+        try {
+            task.function(task.arg);
+        } catch (const std::exception& ex) {
+            //Do nothing...the task is responsible for its own errors.
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (worker) {
+        worker->mutex.lock();
+        worker->tasksRun++;
+        worker->tasksStolen += stolen ? 1 : 0;
+        worker->busySeconds += secondsBetween(start, end);
+        worker->mutex.unlock();
+    }
+
+    if (task.group) {
+        task.group->done();
+    }
+}
+
+/**
+ * Run one queued task on the calling thread, if there is one. Lets a
+ * thread waiting for a group help, rather than block a worker.
+ *
+ * @param group Only run a task of this group (NULL for any task).
+ * @return True if a task was run.
+ */
+bool TaskExecutor::runPending(TaskGroup* group) {
+    Worker* worker = static_cast<Worker*> (pthread_getspecific(currentWorker));
+    if (worker && worker->executor != this) {
+        worker = NULL;
+    }
+
+    Task task;
+    bool stolen;
+    if (!take(worker ? worker->index : -1, task, stolen, group)) {
+        return false;
+    }
+    execute(task, worker, stolen);
+    return true;
+}
+
+
+/******************************************************************************
+ *                              Public Methods
+ ******************************************************************************/
+/**
+ * Constructor. Starts the workers.
+ *
+ * @param numOfThreads Number of workers (0 for one per CPU).
+ * @param cpus CPUs to pin workers to, in turn (empty for any).
+ */
+TaskExecutor::TaskExecutor(int numOfThreads, const vector<int>& cpus)
+: numOfQueued(0), nextWorker(0), stopping(false) {
+    if (numOfThreads <= 0) {
+        numOfThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (numOfThreads <= 0) {
+        numOfThreads = 1;
+    }
+
+    pthread_key_create(&currentWorker, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    //Every worker exists before any starts, as they steal from each other.
+    for (int i = 0; i < numOfThreads; i++) {
+        Worker* worker = new Worker();
+        worker->executor = this;
+        worker->index = i;
+        worker->cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+        worker->tasksRun = 0;
+        worker->tasksStolen = 0;
+        worker->busySeconds = 0;
+        workers.push_back(worker);
+    }
+
+    int numOfStarted = 0;
+    for (unsigned int i = 0; i < workers.size(); i++) {
+        if (pthread_create(&workers[i]->thread, NULL, &TaskExecutor::runWorker, workers[i]) == 0) {
+            numOfStarted++;
+        } else {
+            workers[i]->cpu = -2; //Not started.
+        }
+    }
+    if (numOfStarted == 0) {
+        cout << "Unable to start task executor workers; tasks run when waited for" << endl;
+    }
+}
+
+/**
+ * Destructor. Runs every queued task, then stops the workers.
+ */
+TaskExecutor::~TaskExecutor() {
+    mutex.lock();
+    stopping = true;
+    workAvailable.broadcast();
+    mutex.unlock();
+
+    for (unsigned int i = 0; i < workers.size(); i++) {
+        if (workers[i]->cpu != -2) {
+            pthread_join(workers[i]->thread, NULL);
+        }
+    }
+    while (runPending()) {
+        //Left behind if no worker started.
+    }
+
+    for (unsigned int i = 0; i < workers.size(); i++) {
+        delete workers[i];
+    }
+    pthread_key_delete(currentWorker);
+}
+
+/**
+ * @return Number of workers.
+ */
+int TaskExecutor::size() const {
+    return workers.size();
+}
+
+/**
+ * @param stats How much work each worker has done.
+ */
+void TaskExecutor::getStats(vector<WorkerStats>& stats) {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double lifetime = secondsBetween(started, now);
+
+    stats.resize(workers.size());
+    for (unsigned int i = 0; i < workers.size(); i++) {
+        ScopedLock lock(workers[i]->mutex);
+        stats[i].tasksRun = workers[i]->tasksRun;
+        stats[i].tasksStolen = workers[i]->tasksStolen;
+        stats[i].busySeconds = workers[i]->busySeconds;
+        stats[i].utilisation = (lifetime > 0) ? workers[i]->busySeconds / lifetime : 0;
+    }
+}
+
+/**
+ * @return The executor shared by the whole process (one worker per CPU).
+ */
+TaskExecutor& TaskExecutor::getDefault() {
+    pthread_once(&defaultOnce, createDefaultExecutor);
+    return *defaultExecutor;
+}
+
+/**
+ * Constructor.
+ *
+ * @param executor Executor to run tasks on.
+ */
+TaskGroup::TaskGroup(TaskExecutor& executor)
+: executor(executor), pending(0), cancelled(false) {
+}
+
+/**
+ * Destructor. Waits for the group's tasks.
+ */
+TaskGroup::~TaskGroup() {
+    wait();
+}
+
+/**
+ * Count a task as finished.
+ */
+void TaskGroup::done() {
+    ScopedLock lock(mutex);
+    if (--pending == 0) {
+        finished.broadcast();
+    }
+}
+
+/**
+ * Queue a task.
+ *
+ * @param function Function to run.
+ * @param arg Argument to pass it.
+ */
+void TaskGroup::run(TaskFunction function, void* arg) {
+    mutex.lock();
+    pending++;
+    mutex.unlock();
+
+    TaskExecutor::Task task;
+    task.function = function;
+    task.arg = arg;
+    task.group = this;
+    executor.submit(task);
+}
+
+/**
+ * Wait for every task in the group to finish, running the group's queued
+ * tasks on this thread meanwhile. Safe to call from inside a task, as the
+ * waiting worker keeps running tasks rather than blocking the pool. Tasks of
+ * other groups are left to the workers, so a waiter isn't held up by
+ * unrelated long running tasks (such as library loading).
+ */
+void TaskGroup::wait() {
+    while (true) {
+        mutex.lock();
+        bool idle = (pending == 0);
+        mutex.unlock();
+        if (idle) {
+            return;
+        }
+
+        if (!executor.runPending(this)) {
+            //Everything left is running; wake now and then in case a task queues more.
+            mutex.lock();
+            if (pending > 0) {
+                finished.wait(mutex, HELP_INTERVAL_MS);
+            }
+            mutex.unlock();
+        }
+    }
+}
+
+/**
+ * Skip the group's tasks that haven't started. Running tasks can check
+ * isCancelled() to stop early.
+ */
+void TaskGroup::cancel() {
+    ScopedLock lock(mutex);
+    cancelled = true;
+}
+
+/**
+ * @return True if the group was cancelled.
+ */
+bool TaskGroup::isCancelled() {
+    ScopedLock lock(mutex);
+    return cancelled;
+}
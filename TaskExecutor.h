@@ -0,0 +1,221 @@
+/**
+ * @file TaskExecutor.h
+ * @author Aydin Arik
+ * @brief A pool of worker threads that every parallel stage (library loading,
+ *        batch recognition, matching candidate objects) schedules tasks onto,
+ *        rather than each starting threads of its own and oversubscribing the
+ *        CPUs. Each worker has its own deque of tasks: it takes the newest of
+ *        its own tasks, and when it runs out it steals the oldest task of
+ *        another worker. Tasks are grouped (see TaskGroup) so a caller can wait
+ *        for, or cancel, the tasks it started.
+ */
+
+#ifndef TASKEXECUTOR_H
+#define	TASKEXECUTOR_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <vector>
+#include <deque>
+#include <pthread.h>
+#include <time.h>
+#include "Mutex.h"
+
+/******************************************************************************
+ *                              Types
+ ******************************************************************************/
+typedef void (*TaskFunction)(void* arg);
+
+class TaskGroup;
+
+/******************************************************************************
+ *                              Classes
+ ******************************************************************************/
+class TaskExecutor {
+public:
+
+    /**
+     * How much work a worker has done.
+     */
+    struct WorkerStats {
+        long tasksRun;
+        long tasksStolen; //Tasks taken from another worker's deque.
+        double busySeconds; //Time spent running tasks.
+        double utilisation; //Share of the executor's lifetime spent running tasks.
+    };
+
+private:
+    friend class TaskGroup;
+
+    struct Task {
+        TaskFunction function;
+        void* arg;
+        TaskGroup* group;
+    };
+
+    struct Worker {
+        TaskExecutor* executor;
+        int index;
+        int cpu; //CPU the worker runs on (-1 for any).
+        pthread_t thread;
+        Mutex mutex; //Guards tasks and the counters.
+        std::deque<Task> tasks; //Own tasks are taken from the back, stolen from the front.
+        long tasksRun;
+        long tasksStolen;
+        double busySeconds;
+    };
+
+    std::vector<Worker*> workers;
+    pthread_key_t currentWorker; //Worker running on this thread (NULL if not a worker).
+    timespec started; //When the executor was constructed (CLOCK_MONOTONIC).
+
+    //
+    //Guarded by mutex.
+    //
+    Mutex mutex;
+    Condition workAvailable; //Signalled when a task is queued, or on stopping.
+    int numOfQueued; //Tasks in all deques.
+    unsigned int nextWorker; //Deque given the next task queued from outside the pool.
+    bool stopping; //Set to make workers exit once every deque is empty.
+
+    /**
+     * Entry point of a worker thread.
+     *
+     * @param worker The Worker.
+     * @return NULL.
+     */
+    static void* runWorker(void* worker);
+
+    /**
+     * Queue a task. Tasks queued by a worker go on its own deque; others are
+     * spread over the workers in turn.
+     *
+     * @param task The task.
+     */
+    void submit(const Task& task);
+
+    /**
+     * Take a task: the newest of a worker's own, or else the oldest of
+     * another worker's.
+     *
+     * @param self Index of the worker taking the task (-1 if not a worker).
+     * @param task The task taken.
+     * @param stolen True if taken from another worker.
+     * @param group Only take a task of this group (NULL for any task).
+     * @return True if a task was taken.
+     */
+    bool take(int self, Task& task, bool& stolen, TaskGroup* group = NULL);
+
+    /**
+     * Run a task (unless its group was cancelled) and count it.
+     *
+     * @param task The task.
+     * @param worker Worker running it (NULL if not a worker).
+     * @param stolen True if taken from another worker.
+     */
+    void execute(const Task& task, Worker* worker, bool stolen);
+
+    /**
+     * Run one queued task on the calling thread, if there is one. Lets a
+     * thread waiting for a group help, rather than block a worker.
+     *
+     * @param group Only run a task of this group (NULL for any task).
+     * @return True if a task was run.
+     */
+    bool runPending(TaskGroup* group = NULL);
+
+    TaskExecutor(const TaskExecutor&); //Not copyable.
+    TaskExecutor& operator=(const TaskExecutor&);
+public:
+
+    /**
+     * Constructor. Starts the workers.
+     *
+     * @param numOfThreads Number of workers (0 for one per CPU).
+     * @param cpus CPUs to pin workers to, in turn (empty for any).
+     */
+    TaskExecutor(int numOfThreads = 0, const std::vector<int>& cpus = std::vector<int>());
+
+    /**
+     * Destructor. Runs every queued task, then stops the workers.
+     */
+    ~TaskExecutor();
+
+    /**
+     * @return Number of workers.
+     */
+    int size() const;
+
+    /**
+     * @param stats How much work each worker has done.
+     */
+    void getStats(std::vector<WorkerStats>& stats);
+
+    /**
+     * @return The executor shared by the whole process (one worker per CPU).
+     */
+    static TaskExecutor& getDefault();
+};
+
+/**
+ * Tasks that are waited for, or cancelled, together.
+ */
+class TaskGroup {
+private:
+    friend class TaskExecutor;
+
+    TaskExecutor& executor;
+    Mutex mutex;
+    Condition finished; //Signalled when the last pending task finishes.
+    int pending; //Tasks queued or running (guarded by mutex).
+    bool cancelled; //Set to skip tasks that haven't started (guarded by mutex).
+
+    /**
+     * Count a task as finished.
+     */
+    void done();
+
+    TaskGroup(const TaskGroup&); //Not copyable.
+    TaskGroup& operator=(const TaskGroup&);
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param executor Executor to run tasks on.
+     */
+    TaskGroup(TaskExecutor& executor = TaskExecutor::getDefault());
+
+    /**
+     * Destructor. Waits for the group's tasks.
+     */
+    ~TaskGroup();
+
+    /**
+     * Queue a task.
+     *
+     * @param function Function to run.
+     * @param arg Argument to pass it.
+     */
+    void run(TaskFunction function, void* arg);
+
+    /**
+     * Wait for every task in the group to finish, running the group's queued
+     * tasks on this thread meanwhile. Safe to call from inside a task.
+     */
+    void wait();
+
+    /**
+     * Skip the group's tasks that haven't started. Running tasks can check
+     * isCancelled() to stop early.
+     */
+    void cancel();
+
+    /**
+     * @return True if the group was cancelled.
+     */
+    bool isCancelled();
+};
+
+#endif	/* TASKEXECUTOR_H */
@@ -0,0 +1,229 @@
+/**
+ * @file VocabularyTree.cpp
+ * @author Aydin Arik
+ * @brief Hierarchical visual vocabulary (Nister and Stewenius, 2006). Descriptors
+ *        are clustered with k-means, each cluster is clustered again, and so on
+ *        to a fixed depth. The leaves are visual words.
+ */
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include "VocabularyTree.h"
+#include "CvMatSerialization.h"
+#include <map>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+
+/******************************************************************************
+ *                              Private Methods
+ ******************************************************************************/
+/**
+ * Add a node to the tree.
+ *
+ * @param center Cluster centre of the node.
+ * @return Index of the new node.
+ */
+int VocabularyTree::addNode(const cv::Mat& center) {
+    centers.push_back(center);
+    firstChild.push_back(-1);
+    numOfChildren.push_back(0);
+    words.push_back(-1);
+
+    return words.size() - 1;
+}
+
+/**
+ * Cluster descriptors under a node, adding child nodes.
+ *
+ * @param node Node to split.
+ * @param descriptors Descriptors that belong to the node (one per row).
+ * @param level Level of the node (root is 0).
+ */
+void VocabularyTree::split(int node, const cv::Mat& descriptors, int level) {
+    //Too deep or too few descriptors to cluster, so this is a leaf.
+    if (level == depth || descriptors.rows < branching) {
+        words[node] = numOfWords++;
+        return;
+    }
+
+    cv::Mat labels;
+    cv::Mat clusterCenters;
+    cv::kmeans(descriptors, branching, labels,
+            cv::TermCriteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS, 10, 1e-3),
+            1, cv::KMEANS_PP_CENTERS, clusterCenters);
+
+    //Children are added contiguously so quantize() can scan them in one go.
+    firstChild[node] = words.size();
+    numOfChildren[node] = branching;
+    for (int i = 0; i < branching; i++) {
+        addNode(clusterCenters.row(i));
+    }
+
+    for (int i = 0; i < branching; i++) {
+        //Gather the descriptors of this cluster.
+        cv::Mat cluster;
+        for (int j = 0; j < descriptors.rows; j++) {
+            if (labels.at<int>(j) == i) {
+                cluster.push_back(descriptors.row(j));
+            }
+        }
+
+        split(firstChild[node] + i, cluster, level + 1);
+    }
+}
+
+
+/******************************************************************************
+ *                              Public Methods
+ ******************************************************************************/
+VocabularyTree::VocabularyTree() : branching(0), depth(0), numOfWords(0) {
+}
+
+/**
+ * Build the vocabulary from a set of training descriptors. This is slow and
+ * should be done offline (see save()).
+ *
+ * @param descriptors Training descriptors (one per row, CV_32F).
+ * @param branching Number of children of each node (k).
+ * @param depth Number of levels below the root (L). At most k^L words.
+ */
+void VocabularyTree::train(const cv::Mat& descriptors, int branching, int depth) {
+    this->branching = branching;
+    this->depth = depth;
+    numOfWords = 0;
+    centers.release();
+    firstChild.clear();
+    numOfChildren.clear();
+    words.clear();
+
+    addNode(cv::Mat::zeros(1, descriptors.cols, CV_32F)); //Root.
+    split(0, descriptors, 0);
+}
+
+/**
+ * Save the vocabulary. Writes filename.centers and filename.nodes.
+ *
+ * @param filename Base name of the files.
+ */
+void VocabularyTree::save(string filename) {
+    //Node structure: first child, number of children and word of each node.
+    cv::Mat nodes(words.size(), 3, CV_32S);
+    for (unsigned int i = 0; i < words.size(); i++) {
+        nodes.at<int>(i, 0) = firstChild[i];
+        nodes.at<int>(i, 1) = numOfChildren[i];
+        nodes.at<int>(i, 2) = words[i];
+    }
+
+    saveMat(centers, filename + ".centers");
+    saveMat(nodes, filename + ".nodes");
+}
+
+/**
+ * Load a vocabulary written by save().
+ *
+ * @param filename Base name of the files.
+ * @return True if the vocabulary was loaded.
+ */
+bool VocabularyTree::load(string filename) {
+    if (!std::ifstream((filename + ".centers").c_str()) || !std::ifstream((filename + ".nodes").c_str())) {
+        return false;
+    }
+
+    cv::Mat nodes;
+    try {
+        loadMat(centers, filename + ".centers");
+        loadMat(nodes, filename + ".nodes");
+    } catch (const std::exception& ex) {
+        std::cout << "Could not load vocabulary: " << filename << std::endl;
+        return false;
+    }
+
+    firstChild.resize(nodes.rows);
+    numOfChildren.resize(nodes.rows);
+    words.resize(nodes.rows);
+    branching = 0;
+    numOfWords = 0;
+    for (int i = 0; i < nodes.rows; i++) {
+        firstChild[i] = nodes.at<int>(i, 0);
+        numOfChildren[i] = nodes.at<int>(i, 1);
+        words[i] = nodes.at<int>(i, 2);
+        branching = std::max(branching, numOfChildren[i]);
+        numOfWords = std::max(numOfWords, words[i] + 1);
+    }
+
+    return true;
+}
+
+/**
+ * @return True if the vocabulary has been trained or loaded.
+ */
+bool VocabularyTree::empty() const {
+    return numOfWords == 0;
+}
+
+/**
+ * @return Number of visual words (leaves).
+ */
+int VocabularyTree::getNumOfWords() const {
+    return numOfWords;
+}
+
+/**
+ * Find the visual word of a descriptor.
+ *
+ * @param descriptor Pointer to the descriptor (centers.cols floats).
+ * @return The word.
+ */
+int VocabularyTree::quantize(const float* descriptor) const {
+    int node = 0;
+    const int dims = centers.cols;
+
+    //Descend to the nearest child until a leaf is reached.
+    while (numOfChildren[node] > 0) {
+        int best = firstChild[node];
+        float bestDistance = -1;
+        for (int child = firstChild[node]; child < firstChild[node] + numOfChildren[node]; child++) {
+            const float* center = centers.ptr<float>(child);
+            float distance = 0;
+            for (int i = 0; i < dims; i++) {
+                float diff = descriptor[i] - center[i];
+                distance += diff * diff;
+            }
+            if (bestDistance < 0 || distance < bestDistance) {
+                bestDistance = distance;
+                best = child;
+            }
+        }
+        node = best;
+    }
+
+    return words[node];
+}
+
+/**
+ * Quantise a set of descriptors into a bag of words.
+ *
+ * @param descriptors Descriptors (one per row, CV_32F).
+ * @param bagOfWords Resulting word histogram.
+ */
+void VocabularyTree::quantize(const cv::Mat& descriptors, BagOfWords& bagOfWords) const {
+    bagOfWords.clear();
+    if (empty() || descriptors.rows == 0) {
+        return;
+    }
+
+    std::map<int, int> counts;
+    for (int i = 0; i < descriptors.rows; i++) {
+        counts[quantize(descriptors.ptr<float>(i))]++;
+    }
+
+    bagOfWords.reserve(counts.size());
+    for (std::map<int, int>::iterator it = counts.begin(); it != counts.end(); ++it) {
+        bagOfWords.push_back(std::make_pair(it->first, (float) it->second / descriptors.rows));
+    }
+}
@@ -0,0 +1,115 @@
+/**
+ * @file VocabularyTree.h
+ * @author Aydin Arik
+ * @brief Hierarchical visual vocabulary (Nister and Stewenius, 2006). Descriptors
+ *        are clustered with k-means, each cluster is clustered again, and so on
+ *        to a fixed depth. The leaves are visual words. A descriptor is quantised
+ *        by descending the tree, comparing it to only k centres per level.
+ */
+
+#ifndef VOCABULARYTREE_H
+#define	VOCABULARYTREE_H
+
+/******************************************************************************
+ *                              Header Files
+ ******************************************************************************/
+#include <string>
+#include <vector>
+#include <utility>
+#include <opencv2/core/core.hpp>
+
+/******************************************************************************
+ *                              Types
+ ******************************************************************************/
+/**
+ * Sparse histogram of visual words, sorted by word. Each entry is a word and
+ * its term frequency (occurrences / total words).
+ */
+typedef std::vector<std::pair<int, float> > BagOfWords;
+
+/******************************************************************************
+ *                              Class
+ ******************************************************************************/
+class VocabularyTree {
+private:
+    int branching; //Number of children of each node (k).
+    int depth; //Number of levels below the root (L).
+    int numOfWords;
+    cv::Mat centers; //Cluster centre of each node (one row per node, CV_32F). Root row unused.
+    std::vector<int> firstChild; //Index of each node's first child. Children are contiguous.
+    std::vector<int> numOfChildren; //Number of children of each node (0 for leaves).
+    std::vector<int> words; //Word of each node (-1 for non-leaves).
+
+    /**
+     * Cluster descriptors under a node, adding child nodes.
+     *
+     * @param node Node to split.
+     * @param descriptors Descriptors that belong to the node (one per row).
+     * @param level Level of the node (root is 0).
+     */
+    void split(int node, const cv::Mat& descriptors, int level);
+
+    /**
+     * Add a node to the tree.
+     *
+     * @param center Cluster centre of the node.
+     * @return Index of the new node.
+     */
+    int addNode(const cv::Mat& center);
+
+public:
+    VocabularyTree();
+
+    /**
+     * Build the vocabulary from a set of training descriptors. This is slow and
+     * should be done offline (see save()).
+     *
+     * @param descriptors Training descriptors (one per row, CV_32F).
+     * @param branching Number of children of each node (k).
+     * @param depth Number of levels below the root (L). At most k^L words.
+     */
+    void train(const cv::Mat& descriptors, int branching, int depth);
+
+    /**
+     * Save the vocabulary. Writes filename.centers and filename.nodes.
+     *
+     * @param filename Base name of the files.
+     */
+    void save(std::string filename);
+
+    /**
+     * Load a vocabulary written by save().
+     *
+     * @param filename Base name of the files.
+     * @return True if the vocabulary was loaded.
+     */
+    bool load(std::string filename);
+
+    /**
+     * @return True if the vocabulary has been trained or loaded.
+     */
+    bool empty() const;
+
+    /**
+     * @return Number of visual words (leaves).
+     */
+    int getNumOfWords() const;
+
+    /**
+     * Find the visual word of a descriptor.
+     *
+     * @param descriptor Pointer to the descriptor (centers.cols floats).
+     * @return The word.
+     */
+    int quantize(const float* descriptor) const;
+
+    /**
+     * Quantise a set of descriptors into a bag of words.
+     *
+     * @param descriptors Descriptors (one per row, CV_32F).
+     * @param bagOfWords Resulting word histogram.
+     */
+    void quantize(const cv::Mat& descriptors, BagOfWords& bagOfWords) const;
+};
+
+#endif	/* VOCABULARYTREE_H */
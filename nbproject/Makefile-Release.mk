@@ -42,7 +42,40 @@ OBJECTFILES= \
 	${OBJECTDIR}/Main.o \
 	${OBJECTDIR}/Matcher.o \
 	${OBJECTDIR}/Timer.o \
-	${OBJECTDIR}/CvMatSerialization.o
+	${OBJECTDIR}/CvMatSerialization.o \
+	${OBJECTDIR}/DirectoryWatcher.o \
+	${OBJECTDIR}/VocabularyTree.o \
+	${OBJECTDIR}/ObjectIndex.o \
+	${OBJECTDIR}/LibraryStore.o \
+	${OBJECTDIR}/StabilityPruner.o \
+	${OBJECTDIR}/RecognitionStream.o \
+	${OBJECTDIR}/FrameChangeDetector.o \
+	${OBJECTDIR}/OverlayRenderer.o \
+	${OBJECTDIR}/Recorder.o \
+	${OBJECTDIR}/ResultPublisher.o \
+	${OBJECTDIR}/ResultReader.o \
+	${OBJECTDIR}/RecognitionConfig.o \
+	${OBJECTDIR}/ParameterTuner.o \
+	${OBJECTDIR}/KeypointBudget.o \
+	${OBJECTDIR}/ObjectScheduler.o \
+	${OBJECTDIR}/TaskExecutor.o \
+	${OBJECTDIR}/CaptureWriter.o \
+	${OBJECTDIR}/ReplayCamera.o \
+	${OBJECTDIR}/LatencyTracker.o \
+	${OBJECTDIR}/RecognitionServer.o \
+	${OBJECTDIR}/RecognitionClient.o \
+	${OBJECTDIR}/LoadGenerator.o \
+	${OBJECTDIR}/ShardCoordinator.o \
+	${OBJECTDIR}/ShardMessage.o \
+	${OBJECTDIR}/ShardWorker.o \
+	${OBJECTDIR}/QualityController.o
+
+# Object Files of matcher_bench (MatcherBenchmark replaces operator new, so
+# it is kept out of enel427_project)
+BENCHMARKFILES= \
+	$(filter-out ${OBJECTDIR}/Main.o,${OBJECTFILES}) \
+	${OBJECTDIR}/MatcherBenchmark.o \
+	${OBJECTDIR}/BenchmarkMain.o
 
 
 # C Compiler Flags
@@ -64,11 +97,16 @@ LDLIBSOPTIONS=
 # Build Targets
 .build-conf: ${BUILD_SUBPROJECTS}
 	"${MAKE}"  -f nbproject/Makefile-${CND_CONF}.mk ${CND_DISTDIR}/${CND_CONF}/${CND_PLATFORM}/enel427_project
+	"${MAKE}"  -f nbproject/Makefile-${CND_CONF}.mk ${CND_DISTDIR}/${CND_CONF}/${CND_PLATFORM}/matcher_bench
 
 ${CND_DISTDIR}/${CND_CONF}/${CND_PLATFORM}/enel427_project: ${OBJECTFILES}
 	${MKDIR} -p ${CND_DISTDIR}/${CND_CONF}/${CND_PLATFORM}
 	${LINK.cc} -o ${CND_DISTDIR}/${CND_CONF}/${CND_PLATFORM}/enel427_project ${OBJECTFILES} ${LDLIBSOPTIONS} 
 
+${CND_DISTDIR}/${CND_CONF}/${CND_PLATFORM}/matcher_bench: ${BENCHMARKFILES}
+	${MKDIR} -p ${CND_DISTDIR}/${CND_CONF}/${CND_PLATFORM}
+	${LINK.cc} -o ${CND_DISTDIR}/${CND_CONF}/${CND_PLATFORM}/matcher_bench ${BENCHMARKFILES} ${LDLIBSOPTIONS} 
+
 ${OBJECTDIR}/KinectCamera.o: KinectCamera.cpp 
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} $@.d
@@ -114,6 +152,146 @@ ${OBJECTDIR}/CvMatSerialization.o: CvMatSerialization.cpp
 	${RM} $@.d
 	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/CvMatSerialization.o CvMatSerialization.cpp
 
+${OBJECTDIR}/DirectoryWatcher.o: DirectoryWatcher.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/DirectoryWatcher.o DirectoryWatcher.cpp
+
+${OBJECTDIR}/VocabularyTree.o: VocabularyTree.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/VocabularyTree.o VocabularyTree.cpp
+
+${OBJECTDIR}/ObjectIndex.o: ObjectIndex.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/ObjectIndex.o ObjectIndex.cpp
+
+${OBJECTDIR}/LibraryStore.o: LibraryStore.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/LibraryStore.o LibraryStore.cpp
+
+${OBJECTDIR}/StabilityPruner.o: StabilityPruner.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/StabilityPruner.o StabilityPruner.cpp
+
+${OBJECTDIR}/RecognitionStream.o: RecognitionStream.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/RecognitionStream.o RecognitionStream.cpp
+
+${OBJECTDIR}/FrameChangeDetector.o: FrameChangeDetector.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/FrameChangeDetector.o FrameChangeDetector.cpp
+
+${OBJECTDIR}/OverlayRenderer.o: OverlayRenderer.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/OverlayRenderer.o OverlayRenderer.cpp
+
+${OBJECTDIR}/Recorder.o: Recorder.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/Recorder.o Recorder.cpp
+
+${OBJECTDIR}/ResultPublisher.o: ResultPublisher.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/ResultPublisher.o ResultPublisher.cpp
+
+${OBJECTDIR}/ResultReader.o: ResultReader.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/ResultReader.o ResultReader.cpp
+
+${OBJECTDIR}/RecognitionConfig.o: RecognitionConfig.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/RecognitionConfig.o RecognitionConfig.cpp
+
+${OBJECTDIR}/ParameterTuner.o: ParameterTuner.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/ParameterTuner.o ParameterTuner.cpp
+
+${OBJECTDIR}/KeypointBudget.o: KeypointBudget.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/KeypointBudget.o KeypointBudget.cpp
+
+${OBJECTDIR}/ObjectScheduler.o: ObjectScheduler.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/ObjectScheduler.o ObjectScheduler.cpp
+
+${OBJECTDIR}/TaskExecutor.o: TaskExecutor.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/TaskExecutor.o TaskExecutor.cpp
+
+${OBJECTDIR}/MatcherBenchmark.o: MatcherBenchmark.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/MatcherBenchmark.o MatcherBenchmark.cpp
+
+${OBJECTDIR}/BenchmarkMain.o: BenchmarkMain.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/BenchmarkMain.o BenchmarkMain.cpp
+
+${OBJECTDIR}/CaptureWriter.o: CaptureWriter.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/CaptureWriter.o CaptureWriter.cpp
+
+${OBJECTDIR}/ReplayCamera.o: ReplayCamera.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/ReplayCamera.o ReplayCamera.cpp
+
+${OBJECTDIR}/LatencyTracker.o: LatencyTracker.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/LatencyTracker.o LatencyTracker.cpp
+
+${OBJECTDIR}/RecognitionServer.o: RecognitionServer.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/RecognitionServer.o RecognitionServer.cpp
+
+${OBJECTDIR}/RecognitionClient.o: RecognitionClient.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/RecognitionClient.o RecognitionClient.cpp
+
+${OBJECTDIR}/LoadGenerator.o: LoadGenerator.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/LoadGenerator.o LoadGenerator.cpp
+
+${OBJECTDIR}/ShardCoordinator.o: ShardCoordinator.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/ShardCoordinator.o ShardCoordinator.cpp
+
+${OBJECTDIR}/ShardMessage.o: ShardMessage.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/ShardMessage.o ShardMessage.cpp
+
+${OBJECTDIR}/ShardWorker.o: ShardWorker.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/ShardWorker.o ShardWorker.cpp
+
+${OBJECTDIR}/QualityController.o: QualityController.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} $@.d
+	$(COMPILE.cc) -O2 -MMD -MP -MF $@.d -o ${OBJECTDIR}/QualityController.o QualityController.cpp
+
 # Subprojects
 .build-subprojects:
 
@@ -121,6 +299,7 @@ ${OBJECTDIR}/CvMatSerialization.o: CvMatSerialization.cpp
 .clean-conf: ${CLEAN_SUBPROJECTS}
 	${RM} -r ${CND_BUILDDIR}/${CND_CONF}
 	${RM} ${CND_DISTDIR}/${CND_CONF}/${CND_PLATFORM}/enel427_project
+	${RM} ${CND_DISTDIR}/${CND_CONF}/${CND_PLATFORM}/matcher_bench
 
 # Subprojects
 .clean-subprojects: